@@ -1,9 +1,9 @@
 /* File conpix.c
- * July 5, 2006
+ * October 19, 2026
  * By Jessica Mink, Harvard-Smithsonian Center for Astrophysics
  * Send bug reports to jmink@cfa.harvard.edu
 
-   Copyright (C) 2006 
+   Copyright (C) 2006-2026
    Smithsonian Astrophysical Observatory, Cambridge, MA USA
 
    This program is free software; you can redistribute it and/or
@@ -28,6 +28,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <math.h>
+#include <pthread.h>
 #include "libwcs/fitsfile.h"
 #include "libwcs/wcs.h"
 
@@ -40,9 +41,38 @@
 #define PIX_NOISE 7
 #define PIX_ADDNOISE 8
 #define PIX_LOG10 9
+#define PIX_EXPR 10
+#define MAXOP 10
+
+/* Image whose rows are being changed, shared by threads */
+struct OpJob {
+    char *image;	/* Image pixels */
+    int bitpix;		/* FITS bits per pixel */
+    double bzero;	/* Zero point for pixel scaling */
+    double bscale;	/* Scale factor for pixel scaling */
+    int xdim;		/* Number of columns */
+    int ydim;		/* Number of rows */
+    int nop;		/* Number of operations */
+    int *op;		/* List of operations to perform */
+    double *opcon;	/* Constants for operations */
+    int nextrow;	/* First row of next band to be changed */
+    pthread_mutex_t lock; /* Lock for nextrow */
+};
+
+/* Other image used in expressions as b, c, ... */
+struct OpImage {
+    char *filename;	/* File name */
+    char *header;	/* FITS header */
+    char *image;	/* Image pixels */
+    int bitpix;		/* FITS bits per pixel */
+    double bzero;	/* Zero point for pixel scaling */
+    double bscale;	/* Scale factor for pixel scaling */
+};
 
 static void usage();
 static void OpPix();
+static void *OpRows();
+static int ReadImage();
 static double gnoise();
 
 static int nlog = 0;		/* Logging frequency */
@@ -51,6 +81,12 @@ static int verbose = 0;		/* verbose flag */
 static int version = 0;		/* If 1, print only program name and version */
 static int setgnoise = 0;	/* If 1, pixels have been set to random noise */
 static int addgnoise = 0;	/* If 1, pixels have random noise added */
+static int nthreads = 1;	/* Number of threads changing rows */
+static int nrband = 32;		/* Number of rows per band claimed by a thread */
+static char *exprs[MAXOP];	/* Expression for each -e operation */
+static struct PixExpr *pexprs[MAXOP]; /* Compiled expression for each -e */
+static struct OpImage opimages[PEMAXIMG]; /* Images b, c, ... */
+static int nopimages = 0;	/* Number of images besides a */
 
 static char *RevMsg = "CONPIX WCSTools 3.9.7, 26 April 2022, Jessica Mink (jmink@cfa.harvard.edu)";
 
@@ -65,8 +101,9 @@ char **av;
     char filename[128];
     FILE *flist;
     char *listfile = NULL;
-    int nop, op[10];
-    double opcon[10];
+    int nop, op[MAXOP];
+    double opcon[MAXOP];
+    int iop, iim;
 
     /* Check for help or version command first */
     str = *(av+1);
@@ -82,7 +119,7 @@ char **av;
     /* crack arguments */
     for (av++; --ac > 0 && *(str = *av) == '-'; av++) {
 	char c;
-	while ((c = *++str))
+	while (nop < MAXOP && (c = *++str))
 	switch (c) {
 
 	case 'a':	/* add constant to all pixels */
@@ -100,6 +137,18 @@ char **av;
 	    ac--;
 	    break;
 
+	case 'b':	/* Image b, c, ... for expressions */
+            if (ac < 2)
+                usage ();
+	    if (nopimages >= PEMAXIMG - 1) {
+		fprintf (stderr, "CONPIX: No more than %d images after a\n",
+			 PEMAXIMG - 1);
+		exit (1);
+		}
+	    opimages[nopimages++].filename = *++av;
+	    ac--;
+	    break;
+
 	case 'c':	/* Set all pixels to a constant value */
 	    op[nop] = PIX_SET;
             if (ac < 2)
@@ -116,6 +165,17 @@ char **av;
 	    ac--;
 	    break;
 
+	case 'e':	/* Replace pixels by value of an expression */
+            if (ac < 2)
+                usage ();
+	    op[nop] = PIX_EXPR;
+	    exprs[nop] = *++av;
+	    if ((pexprs[nop] = pixexpr (exprs[nop])) == NULL)
+		exit (1);
+	    nop++;
+	    ac--;
+	    break;
+
 	case 'g':	/* Gaussian noise for square root of pixel value */
 	    op[nop] = PIX_NOISE;
 	    nop++;
@@ -130,6 +190,15 @@ char **av;
 	    ac--;
 	    break;
 
+	case 'j':	/* Number of threads to use */
+            if (ac < 2)
+                usage ();
+	    nthreads = (int) atof (*++av);
+	    if (nthreads < 1)
+		nthreads = 1;
+	    ac--;
+	    break;
+
 	case 'l':	/* Log base 10 of pixel values */
 	    op[nop] = PIX_LOG10;
 	    nop++;
@@ -176,8 +245,25 @@ char **av;
 	    usage ();
 	    break;
 	}
+	if (nop >= MAXOP && *str && *(str+1)) {
+	    fprintf (stderr, "CONPIX: No more than %d operations\n", MAXOP);
+	    exit (1);
+	    }
     }
 
+    /* Make sure that images used in expressions have been named */
+    for (iop = 0; iop < nop; iop++) {
+	if (op[iop] == PIX_EXPR && pexprs[iop]->nimage > nopimages + 1) {
+	    fprintf (stderr, "CONPIX: %s uses image %c but only %d -b images\n",
+		     exprs[iop], 'a' + pexprs[iop]->nimage - 1, nopimages);
+	    exit (1);
+	    }
+	}
+    for (iim = 0; iim < nopimages; iim++) {
+	if (ReadImage (opimages + iim))
+	    exit (1);
+	}
+
     /* Process files in file of filenames */
     if (readlist) {
 	if ((flist = fopen (listfile, "r")) == NULL) {
@@ -221,12 +307,16 @@ usage ()
     if (version)
 	exit (-1);
     fprintf (stderr,"Operate on all pixels of a FITS or IRAF image file\n");
-    fprintf(stderr,"Usage: conpix [-vnpr][-asmd constant][-l num] file.fits ...\n");
-    fprintf(stderr,"  or : conpix [-vnpr][-asmd constant][-l num] @filelist\n");
+    fprintf(stderr,"Usage: conpix [-vnpr][-asmd constant][-e expr][-b file][-l num] file.fits ...\n");
+    fprintf(stderr,"  or : conpix [-vnpr][-asmd constant][-e expr][-b file][-l num] @filelist\n");
     fprintf(stderr,"  -a: add constant to all pixels (g=noise)\n");
+    fprintf(stderr,"  -b: image b, then c, ..., of same size for -e\n");
     fprintf(stderr,"  -d: divide all pixels by constant\n");
+    fprintf(stderr,"  -e: replace pixels a by expression, such as \"(a - 100) * 1.02\"\n");
+    fprintf(stderr,"      using + - * / ^ ( ) sqrt log log10 exp abs min max x y\n");
     fprintf(stderr,"  -g: Gaussian noise from each pixel\n");
     fprintf(stderr,"  -i: logging interval (default = 10)\n");
+    fprintf(stderr,"  -j: number of threads to use (default = 1)\n");
     fprintf(stderr,"  -l: log10 of each pixel\n");
     fprintf(stderr,"  -m: multiply all pixels by constant\n");
     fprintf(stderr,"  -n: write new file, else overwrite\n");
@@ -257,11 +347,12 @@ double	*opcon;		/* Constants for operations */
     char newname[256];
     char pixname[256];
     char tempname[256];
-    char history[64];
+    char history[80];
     char *ext, *fname;
     char echar;
-    double *imvec, *dvec, *endvec;
-    int bitpix, xdim, ydim, y, pixoff, iop;
+    struct OpJob job;
+    pthread_t *threads;
+    int bitpix, xdim, ydim, iop, iim, ithread, nx, ny;
     double bzero;		/* Zero point for pixel scaling */
     double bscale;		/* Scale factor for pixel scaling */
 
@@ -319,71 +410,62 @@ double	*opcon;		/* Constants for operations */
     bscale = 1.0;
     hgetr8 (header,"BSCALE",&bscale);
 
-    if (!(imvec = (double *) calloc (xdim, sizeof (double))))
-	return;
-    endvec = imvec + xdim;
-
-    pixoff = 0;
-    for (y = 0; y < ydim; y++) {
-	getvec (image, bitpix, bzero, bscale, pixoff, xdim, imvec);
-	for (iop = 0; iop < nop; iop++) {
-	    double dpix = opcon[iop];
-	    switch (op[iop]) {
-		case PIX_ADD:
-		    for (dvec = imvec; dvec < endvec; dvec++)
-			*dvec = *dvec + dpix;
-		    break;
-		case PIX_SUB:
-		    for (dvec = imvec; dvec < endvec; dvec++)
-			*dvec = *dvec - dpix;
-		    break;
-		case PIX_MUL:
-		    for (dvec = imvec; dvec < endvec; dvec++)
-			*dvec = *dvec * dpix;
-		    break;
-		case PIX_DIV:
-		    for (dvec = imvec; dvec < endvec; dvec++)
-			*dvec = *dvec / dpix;
-		    break;
-		case PIX_SET:
-		    for (dvec = imvec; dvec < endvec; dvec++)
-			*dvec = dpix;
-		    break;
-		case PIX_SQRT:
-		    for (dvec = imvec; dvec < endvec; dvec++)
-			*dvec = sqrt (*dvec);
-		    break;
-		case PIX_NOISE:
-		    for (dvec = imvec; dvec < endvec; dvec++)
-			*dvec = gnoise (*dvec);
-		    break;
-		case PIX_ADDNOISE:
-		    for (dvec = imvec; dvec < endvec; dvec++)
-			*dvec = *dvec + gnoise (*dvec);
-		    break;
-		case PIX_LOG10:
-		    for (dvec = imvec; dvec < endvec; dvec++) {
-			if (*dvec > 0.0)
-			    *dvec = log10 (*dvec);
-			}
-		    break;
-		default:
-		    break;
-		}
+    /* Images used in expressions must be the same size */
+    for (iim = 0; iim < nopimages; iim++) {
+	nx = 1;
+	hgeti4 (opimages[iim].header, "NAXIS1", &nx);
+	ny = 1;
+	hgeti4 (opimages[iim].header, "NAXIS2", &ny);
+	if (nx != xdim || ny != ydim) {
+	    fprintf (stderr, "CONPIX: %s is %dx%d, not %dx%d like %s\n",
+		     opimages[iim].filename, nx, ny, xdim, ydim, filename);
+	    free (image);
+	    free (header);
+	    if (irafheader != NULL)
+		free (irafheader);
+	    return;
 	    }
-	putvec (image, bitpix, bzero, bscale, pixoff, xdim, imvec);
-	pixoff = pixoff + xdim;
-	if (nlog > 0 && y % nlog == 0) {
-	    fprintf (stderr, "Row %4d operations complete\r", y);
+	}
+
+    /* Change bands of rows in as many threads as requested */
+    job.image = image;
+    job.bitpix = bitpix;
+    job.bzero = bzero;
+    job.bscale = bscale;
+    job.xdim = xdim;
+    job.ydim = ydim;
+    job.nop = nop;
+    job.op = op;
+    job.opcon = opcon;
+    job.nextrow = 0;
+    pthread_mutex_init (&job.lock, NULL);
+
+    /* Random noise is drawn in one sequence */
+    if (nthreads > 1 && !setgnoise && !addgnoise) {
+	threads = (pthread_t *) calloc (nthreads, sizeof (pthread_t));
+	for (ithread = 0; ithread < nthreads; ithread++) {
+	    if (pthread_create (&threads[ithread], NULL, OpRows,
+				(void *) &job))
+		break;
 	    }
+	if (ithread == 0)
+	    (void) OpRows ((void *) &job);
+	while (ithread-- > 0)
+	    pthread_join (threads[ithread], NULL);
+	free (threads);
 	}
+    else
+	(void) OpRows ((void *) &job);
+    pthread_mutex_destroy (&job.lock);
     if (verbose)
 	fprintf (stderr,"\n");
 
     /* Note operation as history line in header */
     for (iop = 0; iop < nop; iop++) {
 	double dpix = opcon[iop];
-	if (bitpix > 0) {
+	if (op[iop] == PIX_EXPR)
+	    sprintf (history, "CONPIX: all pixels replaced by %.48s", exprs[iop]);
+	else if (bitpix > 0) {
 	    int ipix = (int)dpix;
 	    switch (op[iop]) {
 		case PIX_ADD:
@@ -598,6 +680,163 @@ double	*opcon;		/* Constants for operations */
     return;
 }
 
+
+/* OPROWS -- Apply operations to bands of rows until all rows are done */
+
+static void *
+OpRows (arg)
+
+void	*arg;		/* Image shared by threads */
+
+{
+    struct OpJob *job = (struct OpJob *) arg;
+    double *rows[PEMAXIMG];	/* One row from image a and each -b image */
+    double *imvec, *dvec, *endvec;
+    int xdim = job->xdim;
+    int iim, iop, y, y0, y1, pixoff;
+
+    if (!(imvec = (double *) calloc (xdim, sizeof (double))))
+	return (NULL);
+    endvec = imvec + xdim;
+    rows[0] = imvec;
+    for (iim = 0; iim < nopimages; iim++) {
+	if (!(rows[iim+1] = (double *) calloc (xdim, sizeof (double))))
+	    return (NULL);
+	}
+
+    while (1) {
+
+	/* Claim the next band of rows */
+	pthread_mutex_lock (&job->lock);
+	y0 = job->nextrow;
+	job->nextrow = job->nextrow + nrband;
+	pthread_mutex_unlock (&job->lock);
+	if (y0 >= job->ydim)
+	    break;
+	y1 = y0 + nrband;
+	if (y1 > job->ydim)
+	    y1 = job->ydim;
+
+	for (y = y0; y < y1; y++) {
+	    pixoff = y * xdim;
+	    getvec (job->image, job->bitpix, job->bzero, job->bscale, pixoff,
+		    xdim, imvec);
+	    for (iim = 0; iim < nopimages; iim++) {
+		getvec (opimages[iim].image, opimages[iim].bitpix,
+			opimages[iim].bzero, opimages[iim].bscale, pixoff, xdim,
+			rows[iim+1]);
+		}
+	    for (iop = 0; iop < job->nop; iop++) {
+		double dpix = job->opcon[iop];
+		switch (job->op[iop]) {
+		    case PIX_ADD:
+			for (dvec = imvec; dvec < endvec; dvec++)
+			    *dvec = *dvec + dpix;
+			break;
+		    case PIX_SUB:
+			for (dvec = imvec; dvec < endvec; dvec++)
+			    *dvec = *dvec - dpix;
+			break;
+		    case PIX_MUL:
+			for (dvec = imvec; dvec < endvec; dvec++)
+			    *dvec = *dvec * dpix;
+			break;
+		    case PIX_DIV:
+			for (dvec = imvec; dvec < endvec; dvec++)
+			    *dvec = *dvec / dpix;
+			break;
+		    case PIX_SET:
+			for (dvec = imvec; dvec < endvec; dvec++)
+			    *dvec = dpix;
+			break;
+		    case PIX_SQRT:
+			for (dvec = imvec; dvec < endvec; dvec++)
+			    *dvec = sqrt (*dvec);
+			break;
+		    case PIX_NOISE:
+			for (dvec = imvec; dvec < endvec; dvec++)
+			    *dvec = gnoise (*dvec);
+			break;
+		    case PIX_ADDNOISE:
+			for (dvec = imvec; dvec < endvec; dvec++)
+			    *dvec = *dvec + gnoise (*dvec);
+			break;
+		    case PIX_LOG10:
+			for (dvec = imvec; dvec < endvec; dvec++) {
+			    if (*dvec > 0.0)
+				*dvec = log10 (*dvec);
+			    }
+			break;
+		    case PIX_EXPR:
+			pixexprvec (pexprs[iop], rows, xdim, 1, y+1, imvec);
+			break;
+		    default:
+			break;
+		    }
+		}
+	    putvec (job->image, job->bitpix, job->bzero, job->bscale, pixoff,
+		    xdim, imvec);
+	    if (nlog > 0 && y % nlog == 0) {
+		fprintf (stderr, "Row %4d operations complete\r", y);
+		}
+	    }
+	}
+
+    for (iim = 0; iim < nopimages; iim++)
+	free (rows[iim+1]);
+    free (imvec);
+    return (NULL);
+}
+
+
+/* READIMAGE -- Read image used in expressions; return 1 if it cannot be read */
+
+static int
+ReadImage (im)
+
+struct OpImage *im;	/* Image to read */
+
+{
+    char *irafheader;		/* IRAF image header */
+    int lhead;			/* Maximum number of bytes in FITS header */
+    int nbhead;			/* Actual number of bytes in FITS header */
+
+    if (isiraf (im->filename)) {
+	if ((irafheader = irafrhead (im->filename, &lhead)) == NULL) {
+	    fprintf (stderr, "CONPIX: Cannot read IRAF header file %s\n",
+		     im->filename);
+	    return (1);
+	    }
+	im->header = iraf2fits (im->filename, irafheader, lhead, &nbhead);
+	free (irafheader);
+	if (im->header == NULL) {
+	    fprintf (stderr, "CONPIX: Cannot translate IRAF header %s\n",
+		     im->filename);
+	    return (1);
+	    }
+	im->image = irafrimage (im->header);
+	}
+    else {
+	if ((im->header = fitsrhead (im->filename, &lhead, &nbhead)) == NULL) {
+	    fprintf (stderr, "CONPIX: Cannot read FITS file %s\n",
+		     im->filename);
+	    return (1);
+	    }
+	im->image = fitsrimage (im->filename, nbhead, im->header);
+	}
+    if (im->image == NULL) {
+	fprintf (stderr, "CONPIX: Cannot read image %s\n", im->filename);
+	free (im->header);
+	return (1);
+	}
+    hgeti4 (im->header, "BITPIX", &im->bitpix);
+    im->bzero = 0.0;
+    hgetr8 (im->header, "BZERO", &im->bzero);
+    im->bscale = 1.0;
+    hgetr8 (im->header, "BSCALE", &im->bscale);
+    return (0);
+}
+
 static int iset = 0;
 static double gset;
 
@@ -654,4 +893,7 @@ double	flux;	/* Square root of this is 1/2.35 of Gaussian FWHM */
  *
  * Jun 21 2006	Clean up code
  * Jul  5 2006	Add option to take base 10 log of entire image
+ *
+ * Oct 19 2026	Add -e to replace pixels by an expression of one or more images
+ * Oct 19 2026	Add -b to read more images for -e and -j to use threads
  */
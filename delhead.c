@@ -1,9 +1,9 @@
 /* File delhead.c
- * September 25, 2009
+ * October 18, 2026
  * By Jessica Mink Harvard-Smithsonian Center for Astrophysics)
  * Send bug reports to jmink@cfa.harvard.edu
 
-   Copyright (C) 1998-2009
+   Copyright (C) 1998-2026
    Smithsonian Astrophysical Observatory, Cambridge, MA USA
 
    This program is free software; you can redistribute it and/or
@@ -110,6 +110,13 @@ char **av;
 		    nkwd++;
 		    break;
 	
+		case 'p':	/* Reserve spare header blocks when writing header */
+		    if (ac < 2)
+			usage();
+		    setfitsspare (atoi (*++av));
+		    ac--;
+		    break;
+
 		case 'l':	/* Log files changed */
 		    logfile++;
 		    break;
@@ -254,6 +261,7 @@ usage ()
     fprintf(stderr,"  -c: delete blank COMMENT lines\n");
     fprintf(stderr,"  -n: write new file\n");
     fprintf(stderr,"  -o: overwrite file\n");
+    fprintf(stderr,"  -p num: reserve num spare header blocks when writing\n");
     fprintf(stderr,"  -v: verbose\n");
     fprintf(stderr,"  -w: delete all WCS keywords in header\n");
     exit (1);
@@ -283,7 +291,6 @@ char	*kwd[];		/* Names of those keywords */
     char echar;
     int ikwd;
     int fdr, fdw, ipos, nbr, nbw, bitpix, i;
-    int imageread = 0;
     int nbold, nbnew;
 
     image = NULL;
@@ -335,6 +342,10 @@ char	*kwd[];		/* Names of those keywords */
 	return;
 
     nbold = fitsheadsize (header);
+    bitpix = 0;
+    hgeti4 (header,"BITPIX",&bitpix);
+    naxis = 0;
+    hgeti4 (header,"NAXIS",&naxis);
 
     /* Remove directory path and extension from file name */
     fname = strrchr (filename, '/');
@@ -499,19 +510,9 @@ char	*kwd[];		/* Names of those keywords */
 	    }
 	}
 
-    /* Rewrite header and data to a new image file */
+    /* Copy header and data to a new image file */
     else if (naxis > 0 && readimage) {
-	hgeti4 (header,"BITPIX",&bitpix);
-	if (naxis > 0 && bitpix != 0) {
-	    if ((image = fitsrfull (filename, nbhead, header)) == NULL) {
-		if (verbose)
-		    fprintf (stderr, "No FITS image in %s\n", filename);
-		imageread = 0;
-		}
-	    else
-		imageread = 1;
-	    }
-	if (fitswimage (newname, header, image) > 0 && verbose)
+	if (fitscimage (newname, header, filename) > 0 && verbose)
 	    printf ("%s: rewritten successfully.\n", newname);
 	else if (verbose)
 	    printf ("%s could not be written.\n", newname);
@@ -651,4 +652,9 @@ int verbose;	/* If true, print deletion confirmations */
  *
  * Aug 19 2009	Fix bug to remove limit to the number of files on command line
  * Sep 25 2009	Declare DelWCSFITS() and drop unused variable v1
+ *
+ * Oct 18 2026	Copy data to new file with fitscimage() without reading it
+ * Oct 18 2026	Add -p to reserve spare header blocks when writing
+ *
+ * Oct 19 2026	Read BITPIX and NAXIS before deciding how to rewrite the file
  */
@@ -1,9 +1,9 @@
 /* File edhead.c
- * October 31, 2006
+ * October 18, 2026
  * By Jessica Mink, Harvard-Smithsonian Center for Astrophysics
  * Send bug reports to jmink@cfa.harvard.edu
 
-   Copyright (C) 2006 
+   Copyright (C) 2006-2026
    Smithsonian Astrophysical Observatory, Cambridge, MA USA
 
    This program is free software; you can redistribute it and/or
@@ -74,6 +74,13 @@ char **av;
 	    newimage++;
 	    break;
 
+	case 'p':	/* Reserve spare header blocks when header grows */
+	    if (ac < 2)
+		usage ();
+	    setfitsspare (atoi (*++av));
+	    ac--;
+	    break;
+
 	case 'e':	/* Specify editor */
 	    if (ac < 2)
 		usage ();
@@ -108,9 +115,10 @@ usage ()
     if (version)
 	exit (-1);
     fprintf (stderr,"Edit header of FITS or IRAF image file\n");
-    fprintf(stderr,"usage: edhead [-nv] [-e editor] file.fits file.imh...\n");
+    fprintf(stderr,"usage: edhead [-nv] [-e editor] [-p num] file.fits file.imh...\n");
     fprintf(stderr,"  -e: Set editor, overiding environment EDITOR \n");
     fprintf(stderr,"  -n: write new file, else overwrite \n");
+    fprintf(stderr,"  -p num: Reserve num spare header blocks if header grows\n");
     fprintf(stderr,"  -v: verbose\n");
     exit (1);
 }
@@ -135,7 +143,6 @@ char	*filename;	/* FITS or IRAF file filename */
     int naxis = 0;
     int nblock, nlines;
     int bitpix = 0;
-    int imageread = 0;
     char *head, *headend, *hlast;
     char headline[160];
     char newname[128];
@@ -174,12 +181,6 @@ char	*filename;	/* FITS or IRAF file filename */
 	if ((header = fitsrhead (filename, &lhead, &nbhead)) != NULL) {
 	    hgeti4 (header,"NAXIS",&naxis);
 	    hgeti4 (header,"BITPIX",&bitpix);
-	    if ((image = fitsrfull (filename, nbhead, header)) == NULL) {
-		fprintf (stderr, "Cannot read FITS image %s\n", filename);
-		imageread = 0;
-		}
-	    else
-		imageread = 1;
 	    }
 	else {
 	    fprintf (stderr, "Cannot read FITS file %s\n", filename);
@@ -404,9 +405,19 @@ char	*filename;	/* FITS or IRAF file filename */
 	    }
 	}
 
-    /* Rewrite header and data to a new image file */
-    else if (naxis > 0 && imageread) {
-	if (fitswimage (newname, header, image) > 0 && verbose)
+    /* If header is longer than original, move data down to make room */
+    else if (!newimage) {
+	if (!fitsgrowhead (newname, header)) {
+	    if (verbose)
+		printf ("%s: rewritten successfully.\n", newname);
+	    }
+	else if (verbose)
+	    printf ("%s could not be written.\n", newname);
+	}
+
+    /* Copy header and data to a new image file */
+    else if (naxis > 0) {
+	if (fitscimage (newname, header, filename) > 0 && verbose)
 	    printf ("%s: rewritten successfully.\n", newname);
 	else if (verbose)
 	    printf ("%s could not be written.\n", newname);
@@ -476,4 +487,7 @@ char	*filename;	/* FITS or IRAF file filename */
  * Jun 20 2006	Clean up code
  * Sep  1 2006	Change temphead declaration to [] from *
  * Oct 31 2006	Check for vim as well as vi if EDITOR not in environment
+ *
+ * Oct 18 2026	Do not read image; lengthen header in place with fitsgrowhead()
+ * Oct 18 2026	Add -p to reserve spare header blocks when header grows
  */
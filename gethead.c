@@ -1,9 +1,9 @@
 /* File gethead.c
- * January 20, 2015
+ * October 18, 2026
  * By Jessica Mink Harvard-Smithsonian Center for Astrophysics)
  * Send bug reports to jmink@cfa.harvard.edu
 
-   Copyright (C) 1996-2015
+   Copyright (C) 1996-2026
    Smithsonian Astrophysical Observatory, Cambridge, MA USA
 
    This program is free software; you can redistribute it and/or
@@ -28,6 +28,11 @@
 #include <errno.h>
 #include <unistd.h>
 #include <math.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <signal.h>
 #include "libwcs/wcs.h"
 #include "libwcs/fitsfile.h"
 #include "libwcs/wcscat.h"
@@ -38,6 +43,13 @@ static int maxnkwd = MAXKWD;
 static int maxncond = MAXKWD;
 static int maxnfile = MAXFILES;
 
+/* Nanoseconds of file modification time */
+#ifdef __APPLE__
+#define MTIMENS(st) ((long) (st)->st_mtimespec.tv_nsec)
+#else
+#define MTIMENS(st) ((long) (st)->st_mtim.tv_nsec)
+#endif
+
 #define FILE_FITS 1
 #define FILE_IRAF 2
 #define FILE_ASCII 3
@@ -46,6 +58,11 @@ static void usage();
 extern char *GetFITShead();
 static char nextnsp();
 static int PrintValues();
+static char *GetHead();
+static int ReadCache();
+static char *GetCache();
+static void PutCache();
+static void PruneCache();
 
 static char *RevMsg = "GETHEAD WCSTools 3.9.7, 26 April 2022, Jessica Mink (jmink@cfa.harvard.edu)";
 
@@ -80,6 +97,24 @@ static char *extensions;	/* Extension number(s) or name to read */
 static char *extension;		/* Extension number or name to read */
 static int filekey = 0;		/* If 1, FILENAME keyword has been requested */
 static char *mstring;		/* IRAF keyword multi-line value */
+static int nworkers = 1;	/* Number of processes reading headers */
+static char *cachefile = NULL;	/* Persistent header cache file */
+static int fdcache = -1;	/* Descriptor for appending to cache file */
+
+/* Header saved in cache file, valid while file size and time are unchanged */
+struct HeadCache {
+    char *path;		/* Full pathname of file, with extension */
+    off_t size;		/* Size of file in bytes */
+    time_t mtime;	/* Modification time of file */
+    long mtimens;	/* Nanoseconds of modification time */
+    int nbhead;		/* Number of bytes in header */
+    char *header;	/* Header in cache buffer */
+};
+static struct HeadCache *hcache = NULL;
+static char *hcbuff = NULL;	/* Contents of cache file */
+static int nhcache = 0;		/* Number of headers in cache */
+static int *hcindex = NULL;	/* Hash table of cache entries, -1 if empty */
+static int nhindex = 0;		/* Size of hash table (power of 2) */
 
 int
 main (ac, av)
@@ -118,6 +153,16 @@ char **av;
     int nfext = 0;
     int nrmax=10;
     struct Range *erange = NULL;
+    int iworker, nstart, status, inext, iw;
+    int worker = -1;		/* Number of this worker process, -1 if none */
+    int pfd[2];			/* Pipe handing out file numbers to workers */
+    FILE **fwork = NULL;	/* Output of each worker process */
+    FILE **findex = NULL;	/* File number, offset, length of each output */
+    int *recw = NULL;
+    off_t *recoff = NULL, *reclen = NULL, off0, off1;
+    pid_t pid;
+    char buff[4096];
+    size_t nbr, nbw;
 
     mstring = (char *) calloc (maxml, 1);
 
@@ -193,6 +238,13 @@ char **av;
                     j2000++;
                     break;
 	
+		case 'k': /* Persistent cache of headers */
+		    if (ac < 2)
+			usage();
+		    cachefile = *++av;
+		    ac--;
+		    break;
+
 		case 'l': /* Return values to end of line */
 		    toeol++;
 		    break;
@@ -242,6 +294,15 @@ char **av;
 		    verbose++;
 		    break;
 	
+		case 'w': /* Number of processes reading headers */
+		    if (ac < 2)
+			usage();
+		    nworkers = atoi (*++av);
+		    if (nworkers < 1)
+			nworkers = 1;
+		    ac--;
+		    break;
+
 		case 'x': /* FITS extension to read */
 		    if (ac < 2)
 			usage();
@@ -589,7 +650,145 @@ char **av;
 	    }
 	}
 
-    /* Open file containing a list of images, if there is one */
+    /* Read header cache and open it to add new headers */
+    if (cachefile != NULL) {
+	ReadCache (cachefile);
+	fdcache = open (cachefile, O_WRONLY | O_APPEND | O_CREAT, 0644);
+	if (fdcache < 0)
+	    fprintf (stderr, "GETHEAD: Cannot write header cache %s\n",
+		     cachefile);
+	else if (nhcache == 0 && lseek (fdcache, 0, SEEK_END) == 0) {
+	    if (write (fdcache, "GETHEAD CACHE 1\n", 16) < 16) {
+		close (fdcache);
+		fdcache = -1;
+		}
+	    }
+	}
+
+    /* Hand out file numbers one at a time to worker processes through a
+       pipe, so a slow file holds up only its own worker; each worker
+       writes to a temporary file, and records where the output for each
+       file is, so output is copied out in input order */
+    inext = 0;
+    if (nworkers > nfile)
+	nworkers = nfile;
+    if (nworkers > 1 && pipe (pfd) < 0) {
+	fprintf (stderr, "GETHEAD: Cannot make pipe to workers; reading serially\n");
+	nworkers = 1;
+	}
+    if (nworkers > 1) {
+	fwork = (FILE **) calloc (nworkers, sizeof (FILE *));
+	findex = (FILE **) calloc (nworkers, sizeof (FILE *));
+	fflush (stdout);
+	fflush (stderr);
+	nstart = 0;
+	for (iworker = 0; iworker < nworkers; iworker++) {
+	    if ((fwork[iworker] = tmpfile ()) == NULL ||
+		(findex[iworker] = tmpfile ()) == NULL) {
+		fprintf (stderr, "GETHEAD: Cannot create output for worker %d\n",
+			 iworker);
+		break;
+		}
+	    if ((pid = fork ()) < 0) {
+		fprintf (stderr, "GETHEAD: Cannot start worker %d\n", iworker);
+		break;
+		}
+	    else if (pid == 0) {
+		close (pfd[1]);
+		dup2 (fileno (fwork[iworker]), 1);
+		worker = iworker;
+		if (read (pfd[0], &inext, sizeof (int)) != sizeof (int))
+		    inext = nfile;
+		break;
+		}
+	    nstart++;
+	    }
+
+	/* If no worker could be started, read all of the files here */
+	if (worker < 0 && nstart == 0) {
+	    close (pfd[0]);
+	    close (pfd[1]);
+	    for (iworker = 0; iworker < nworkers; iworker++) {
+		if (fwork[iworker] != NULL)
+		    fclose (fwork[iworker]);
+		if (findex[iworker] != NULL)
+		    fclose (findex[iworker]);
+		}
+	    free (fwork);
+	    free (findex);
+	    nworkers = 1;
+	    }
+
+	/* Parent hands out file numbers, then copies output in order */
+	else if (worker < 0) {
+	    close (pfd[0]);
+	    signal (SIGPIPE, SIG_IGN);
+	    for (ifile = 0; ifile < nfile; ifile++) {
+		if (write (pfd[1], &ifile, sizeof (int)) != sizeof (int))
+		    break;
+		}
+	    close (pfd[1]);
+	    status = 0;
+	    for (iworker = 0; iworker < nstart; iworker++) {
+		int wstatus;
+		if (wait (&wstatus) < 0 || !WIFEXITED (wstatus) ||
+		    WEXITSTATUS (wstatus) != 0)
+		    status = 1;
+		}
+	    recw = (int *) malloc (nfile * sizeof (int));
+	    recoff = (off_t *) calloc (nfile, sizeof (off_t));
+	    reclen = (off_t *) calloc (nfile, sizeof (off_t));
+	    for (ifile = 0; ifile < nfile; ifile++)
+		recw[ifile] = -1;
+	    for (iworker = 0; iworker < nstart; iworker++) {
+		rewind (findex[iworker]);
+		while (fread (&ifile, sizeof (int), 1, findex[iworker]) == 1 &&
+		       fread (&off0, sizeof (off_t), 1, findex[iworker]) == 1 &&
+		       fread (&off1, sizeof (off_t), 1, findex[iworker]) == 1) {
+		    if (ifile < 0 || ifile >= nfile)
+			continue;
+		    recw[ifile] = iworker;
+		    recoff[ifile] = off0;
+		    reclen[ifile] = off1 - off0;
+		    }
+		}
+	    for (ifile = 0; ifile < nfile; ifile++) {
+		if ((iw = recw[ifile]) < 0) {
+		    status = 1;
+		    continue;
+		    }
+		(void) fseeko (fwork[iw], recoff[ifile], SEEK_SET);
+		for (off0 = reclen[ifile]; off0 > 0; off0 = off0 - nbr) {
+		    nbw = (off0 < (off_t) sizeof (buff)) ? (size_t) off0 : sizeof (buff);
+		    if ((nbr = fread (buff, 1, nbw, fwork[iw])) == 0)
+			break;
+		    fwrite (buff, 1, nbr, stdout);
+		    }
+		}
+	    if (status)
+		fprintf (stderr, "GETHEAD: Not all headers were read by workers\n");
+	    for (iworker = 0; iworker < nworkers; iworker++) {
+		if (fwork[iworker] != NULL)
+		    fclose (fwork[iworker]);
+		if (findex[iworker] != NULL)
+		    fclose (findex[iworker]);
+		}
+	    free (fwork);
+	    free (findex);
+	    free (recw);
+	    free (recoff);
+	    free (reclen);
+	    if (fdcache > -1) {
+		close (fdcache);
+		PruneCache (cachefile);
+		}
+	    free (mstring);
+	    return (status);
+	    }
+	}
+
+    /* Open file containing a list of images, if there is one,
+       after starting workers so each has its own file position */
     if (ilistfile != NULL) {
 	if ((flist = fopen (ilistfile, "r")) == NULL) {
 	    fprintf (stderr,"GETHEAD: Image list file %s cannot be read\n",
@@ -600,6 +799,18 @@ char **av;
 
     /* Read through headers of images */
     for (ifile = 0; ifile < nfile; ifile++) {
+
+	/* Skip files read by other worker processes */
+	if (worker >= 0) {
+	    if (ifile != inext) {
+		if (ilistfile != NULL)
+		    first_token (flist, 254, filename);
+		continue;
+		}
+	    fflush (stdout);
+	    off0 = lseek (1, (off_t) 0, SEEK_CUR);
+	    }
+
 	if (ilistfile != NULL) {
 	    first_token (flist, 254, filename);
 	    if (forceascii)
@@ -732,11 +943,31 @@ char **av;
 	    nproc++;
 	    fprintf (stderr, "%d: %s processed.\r", nproc, filename);
 	    }
+
+	/* Record where this file's output is and ask for another file */
+	if (worker >= 0) {
+	    fflush (stdout);
+	    off1 = lseek (1, (off_t) 0, SEEK_CUR);
+	    fwrite (&ifile, sizeof (int), 1, findex[worker]);
+	    fwrite (&off0, sizeof (off_t), 1, findex[worker]);
+	    fwrite (&off1, sizeof (off_t), 1, findex[worker]);
+	    if (read (pfd[0], &inext, sizeof (int)) != sizeof (int))
+		break;
+	    }
 	}
     if (ilistfile != NULL)
 	fclose (flist);
+    if (fdcache > -1)
+	close (fdcache);
 
     free (mstring);
+    if (worker >= 0) {
+	fflush (findex[worker]);
+	fflush (stdout);
+	exit (0);
+	}
+    if (cachefile != NULL)
+	PruneCache (cachefile);
     return (0);
 }
 
@@ -760,6 +991,7 @@ usage ()
     fprintf(stderr,"  -g: Output keyword=value's on one line per keyword\n");
     fprintf(stderr,"  -h: Print column headings\n");
     fprintf(stderr,"  -j: Print output ra and dec in J2000\n");
+    fprintf(stderr,"  -k file: Keep headers in this cache file for later runs\n");
     fprintf(stderr,"  -m num: Change maximum length of IRAF multi-line value\n");
     fprintf(stderr,"  -n num: Number of decimal places in numeric output\n");
     fprintf(stderr,"  -o: OR conditions instead of ANDing them\n");
@@ -769,6 +1001,7 @@ usage ()
     fprintf(stderr,"  -t: Output in tab-separated table format\n");
     fprintf(stderr,"  -u: Always print ___ if keyword not found or null value\n");
     fprintf(stderr,"  -v: Verbose\n");
+    fprintf(stderr,"  -w num: Read headers in num processes at once\n");
     fprintf(stderr,"  -x [range]: Read header for these extensions (no arg=all)\n");
     exit (1);
 }
@@ -878,7 +1111,7 @@ char	*kwd[];		/* Names of keywords for which to print values */
 	}
 
     /* Retrieve FITS header from FITS or IRAF .imh file */
-    else if ((header = GetFITShead (filepath, verbose)) == NULL) {
+    else if ((header = GetHead (filepath)) == NULL) {
 	if (namext != NULL)
 	    free (namext);
 	if (filepath != NULL)
@@ -1420,6 +1653,305 @@ char	*kwd[];		/* Names of keywords for which to print values */
 }
 
 
+/* Return header from cache if file is unchanged, else read and cache it */
+
+static char *
+GetHead (filepath)
+
+char	*filepath;	/* Pathname of FITS or IRAF file, with extension */
+{
+    char *header;
+    char *fullpath;
+    char *ext;
+    char cext = (char) 0;
+    char rpath[PATH_MAX];
+    struct stat st;
+
+    if (fdcache < 0 && nhcache == 0)
+	return (GetFITShead (filepath, verbose));
+
+    /* Key cache on full pathname and extension, validated by size and time */
+    if ((ext = strchr (filepath, ',')) == NULL)
+	ext = strchr (filepath, '[');
+    if (ext != NULL) {
+	cext = *ext;
+	*ext = (char) 0;
+	}
+    if (realpath (filepath, rpath) == NULL || stat (rpath, &st) < 0) {
+	if (ext != NULL)
+	    *ext = cext;
+	return (GetFITShead (filepath, verbose));
+	}
+    if (ext != NULL) {
+	*ext = cext;
+	fullpath = (char *) calloc (1, strlen (rpath) + strlen (ext) + 1);
+	strcpy (fullpath, rpath);
+	strcat (fullpath, ext);
+	}
+    else {
+	fullpath = (char *) calloc (1, strlen (rpath) + 1);
+	strcpy (fullpath, rpath);
+	}
+
+    if ((header = GetCache (fullpath, &st)) == NULL) {
+	if ((header = GetFITShead (filepath, verbose)) != NULL)
+	    PutCache (fullpath, &st, header);
+	}
+    else if (verbose)
+	fprintf (stderr, "Header for %s from cache\n", fullpath);
+    free (fullpath);
+    return (header);
+}
+
+
+/* Hash a pathname into the cache index */
+
+static unsigned int
+HashPath (path)
+
+char	*path;
+{
+    unsigned int hash = 5381;
+
+    while (*path)
+	hash = (hash * 33) ^ (unsigned char) *path++;
+    return (hash);
+}
+
+
+/* Read header cache file into memory and index it by pathname.  Each entry
+ * is a line with file size, modification time (seconds.nanoseconds), header
+ * length, and path,
+ * followed by the header itself and a newline.  Later entries for the same
+ * path replace earlier ones. */
+
+static int
+ReadCache (filename)
+
+char	*filename;	/* Name of header cache file */
+{
+    FILE *fcache;
+    struct stat st;
+    char *cbuff, *cb, *cbend, *nl;
+    long long size, mtime;
+    long mtimens;
+    int nbhead, nch, nmax, ih, i;
+
+    /* Drop cache already read */
+    if (hcbuff != NULL) {
+	free (hcache);
+	free (hcindex);
+	free (hcbuff);
+	hcache = NULL;
+	hcindex = NULL;
+	hcbuff = NULL;
+	nhcache = 0;
+	}
+
+    if (stat (filename, &st) < 0 || st.st_size < 16)
+	return (0);
+    if ((fcache = fopen (filename, "r")) == NULL)
+	return (0);
+    cbuff = (char *) malloc (st.st_size + 1);
+    if (fread (cbuff, 1, st.st_size, fcache) != (size_t) st.st_size ||
+	strncmp (cbuff, "GETHEAD CACHE 1\n", 16)) {
+	fprintf (stderr, "GETHEAD: %s is not a header cache\n", filename);
+	fclose (fcache);
+	free (cbuff);
+	return (0);
+	}
+    fclose (fcache);
+    cbuff[st.st_size] = (char) 0;
+    cbend = cbuff + st.st_size;
+
+    /* Count complete entries to size arrays */
+    nmax = 0;
+    for (cb = cbuff + 16; cb < cbend; ) {
+	if (sscanf (cb, "%lld %lld.%ld %d %n", &size, &mtime, &mtimens,
+		    &nbhead, &nch) < 4)
+	    break;
+	if ((nl = strchr (cb, '\n')) == NULL || nl + nbhead + 2 > cbend)
+	    break;
+	cb = nl + nbhead + 2;
+	nmax++;
+	}
+    if (nmax == 0) {
+	free (cbuff);
+	return (0);
+	}
+    hcbuff = cbuff;
+    hcache = (struct HeadCache *) calloc (nmax, sizeof (struct HeadCache));
+    for (nhindex = 64; nhindex < 2 * nmax; nhindex = nhindex * 2);
+    hcindex = (int *) malloc (nhindex * sizeof (int));
+    for (i = 0; i < nhindex; i++)
+	hcindex[i] = -1;
+
+    nhcache = 0;
+    for (cb = cbuff + 16; nhcache < nmax; ) {
+	sscanf (cb, "%lld %lld.%ld %d %n", &size, &mtime, &mtimens, &nbhead,
+		&nch);
+	nl = strchr (cb, '\n');
+	*nl = (char) 0;
+	hcache[nhcache].path = cb + nch;
+	hcache[nhcache].size = (off_t) size;
+	hcache[nhcache].mtime = (time_t) mtime;
+	hcache[nhcache].mtimens = mtimens;
+	hcache[nhcache].nbhead = nbhead;
+	hcache[nhcache].header = nl + 1;
+	cb = nl + nbhead + 2;
+
+	/* Replace earlier entry for the same path */
+	ih = HashPath (hcache[nhcache].path) & (nhindex - 1);
+	while (hcindex[ih] > -1 &&
+	       strcmp (hcache[hcindex[ih]].path, hcache[nhcache].path))
+	    ih = (ih + 1) & (nhindex - 1);
+	hcindex[ih] = nhcache++;
+	}
+    return (nhcache);
+}
+
+
+/* Return a copy of a cached header if the file has not changed */
+
+static char *
+GetCache (path, st)
+
+char	*path;		/* Full pathname of file, with extension */
+struct stat *st;	/* Current size and modification time of file */
+{
+    struct HeadCache *hc;
+    char *header;
+    int ih;
+
+    if (nhcache == 0)
+	return (NULL);
+    ih = HashPath (path) & (nhindex - 1);
+    while (hcindex[ih] > -1) {
+	hc = hcache + hcindex[ih];
+	if (!strcmp (hc->path, path)) {
+	    if (hc->size != st->st_size || hc->mtime != st->st_mtime ||
+		hc->mtimens != MTIMENS (st))
+		return (NULL);
+	    header = (char *) calloc (1, hc->nbhead + FITSBLOCK);
+	    memcpy (header, hc->header, hc->nbhead);
+	    return (header);
+	    }
+	ih = (ih + 1) & (nhindex - 1);
+	}
+    return (NULL);
+}
+
+
+/* Append a header to the cache file in a single write, so that worker
+ * processes sharing the file do not interleave their entries */
+
+static void
+PutCache (path, st, header)
+
+char	*path;		/* Full pathname of file, with extension */
+struct stat *st;	/* Current size and modification time of file */
+char	*header;	/* FITS header to save */
+{
+    char *hend, *entry;
+    char line[64];
+    int nbhead, nline, lpath, nentry;
+
+    if (fdcache < 0 || (hend = ksearch (header, "END")) == NULL)
+	return;
+    nbhead = hend + 80 - header;
+    sprintf (line, "%lld %lld.%09ld %d ", (long long) st->st_size,
+	     (long long) st->st_mtime, MTIMENS (st), nbhead);
+    nline = strlen (line);
+    lpath = strlen (path);
+    nentry = nline + lpath + nbhead + 2;
+    entry = (char *) malloc (nentry);
+    memcpy (entry, line, nline);
+    memcpy (entry + nline, path, lpath);
+    entry[nline+lpath] = '\n';
+    memcpy (entry + nline + lpath + 1, header, nbhead);
+    entry[nentry-1] = '\n';
+    if (write (fdcache, entry, nentry) < nentry)
+	fprintf (stderr, "GETHEAD: Cannot add %s to header cache\n", path);
+    free (entry);
+    return;
+}
+
+/* Rewrite the header cache file with only the latest entry for each file
+ * whose size and modification time are unchanged, if it has any others */
+
+static void
+PruneCache (filename)
+
+char	*filename;	/* Name of header cache file */
+{
+    struct HeadCache *hc;
+    struct stat st;
+    FILE *fcache;
+    char *tmpname, *keep, *ext;
+    char cext = (char) 0;
+    int nread, nkeep, ih, i, iserr;
+
+    if ((nread = ReadCache (filename)) < 1)
+	return;
+
+    /* Keep the entry indexed for each path if its file has not changed */
+    keep = (char *) calloc (nread, 1);
+    nkeep = 0;
+    for (ih = 0; ih < nhindex; ih++) {
+	if ((i = hcindex[ih]) < 0)
+	    continue;
+	hc = hcache + i;
+	if ((ext = strrchr (hc->path, ',')) == NULL)
+	    ext = strrchr (hc->path, '[');
+	if (ext != NULL) {
+	    cext = *ext;
+	    *ext = (char) 0;
+	    }
+	if (stat (hc->path, &st) == 0 && hc->size == st.st_size &&
+	    hc->mtime == st.st_mtime && hc->mtimens == MTIMENS (&st)) {
+	    keep[i] = 1;
+	    nkeep++;
+	    }
+	if (ext != NULL)
+	    *ext = cext;
+	}
+
+    /* Write kept entries to a new file which then replaces the old one */
+    if (nkeep < nread) {
+	tmpname = (char *) calloc (1, strlen (filename) + 16);
+	sprintf (tmpname, "%s.%d", filename, (int) getpid ());
+	if ((fcache = fopen (tmpname, "w")) == NULL)
+	    iserr = 1;
+	else {
+	    iserr = (fputs ("GETHEAD CACHE 1\n", fcache) < 0);
+	    for (i = 0; i < nread && !iserr; i++) {
+		if (!keep[i])
+		    continue;
+		hc = hcache + i;
+		if (fprintf (fcache, "%lld %lld.%09ld %d %s\n",
+			     (long long) hc->size, (long long) hc->mtime,
+			     hc->mtimens, hc->nbhead, hc->path) < 0 ||
+		    fwrite (hc->header, 1, hc->nbhead, fcache) <
+		    (size_t) hc->nbhead || fputc ('\n', fcache) == EOF)
+		    iserr = 1;
+		}
+	    if (fclose (fcache) != 0)
+		iserr = 1;
+	    }
+	if (iserr || rename (tmpname, filename) < 0) {
+	    fprintf (stderr, "GETHEAD: Cannot rewrite header cache %s\n",
+		     filename);
+	    unlink (tmpname);
+	    }
+	else if (verbose)
+	    fprintf (stderr, "GETHEAD: Dropped %d old headers from cache %s\n",
+		     nread - nkeep, filename);
+	free (tmpname);
+	}
+    free (keep);
+    return;
+}
+
 /* Return next character in string which is not a space */
 static char
 nextnsp (string)
@@ -1543,4 +2075,10 @@ char *string;
  * Jan 20 2015	Add quotes to string values with spaces in -e option 
  *
  * Mar 12 2019	Fill in single-character null returns
+ *
+ * Oct 18 2026	Add -w to read headers in several processes, keeping output order
+ * Oct 18 2026	Add -k to keep headers in a cache file keyed by path, size, and time
+ *
+ * Oct 19 2026	Hand out files to -w workers one at a time; read here if none start
+ * Oct 19 2026	Drop replaced and out-of-date headers from -k cache file
  */
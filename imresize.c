@@ -1,9 +1,9 @@
 /* File imresize.c
- * June 12, 2007
+ * October 19, 2026
  * By Jessica Mink, Harvard-Smithsonian Center for Astrophysics
  * Send bug reports to jmink@cfa.harvard.edu
 
-   Copyright (C) 2006-2007 
+   Copyright (C) 2006-2026
    Smithsonian Astrophysical Observatory, Cambridge, MA USA
 
    This program is free software; you can redistribute it and/or
@@ -37,9 +37,12 @@
 
 static void usage();
 static void imResize();
+static void imPyramid();
+static int PyrRow();
 extern char *FiltFITS();
 extern char *ShrinkFITSHeader();
 extern char *ShrinkFITSImage();
+extern void setshrinkproc();
 extern void setghwidth();
 
 #define MAXFILES 1000
@@ -59,8 +62,10 @@ static int xfactor = 0;		/* Horizontal axis reduction factor */
 static int yfactor = 0;		/* Vertical axis reduction factor */
 static double ghwidth = 1.0;	/* Gaussian half width for smoothing */
 static int bitpix = 0;		/* Bits per output pixel */
-static int mean = 0;		/* 1 if mean for regrouped pixels */
+static int mean = 0;		/* 1 if mean, 2 if median for regrouped pixels */
 static int northup = 0;		/* 1 to rotate to north up, east left */
+static int pyramid = 0;		/* Largest dimension of smallest pyramid level */
+static int pyrext = 0;		/* 1 to write pyramid levels as extensions */
 
 static char *RevMsg = "IMRESIZE WCSTools 3.9.7, 26 April 2022, Jessica Mink (jmink@cfa.harvard.edu)";
 
@@ -128,6 +133,28 @@ char **av;
 		    ac--;
 		    break;
 
+		case 'c':	/* Combine regrouped pixels by sum, mean, or median */
+		    if (ac < 2)
+			usage ();
+		    av++;
+		    ac--;
+		    if (!strcmp (*av, "sum"))
+			mean = -1;
+		    else if (!strcmp (*av, "mean"))
+			mean = 1;
+		    else if (!strcmp (*av, "median"))
+			mean = 2;
+		    else {
+			fprintf (stderr,"IMRESIZE: %s is not sum, mean, or median\n",
+				 *av);
+			usage ();
+			}
+		    break;
+
+		case 'e':	/* Write pyramid levels as extensions of one file */
+		    pyrext++;
+		    break;
+
 		case 'f':	/* Horizontal and vertical reduction factor */
 		    if (ac < 2)
 			usage ();
@@ -154,6 +181,13 @@ char **av;
 		    ac--;
 		    break;
 
+		case 'j': /* Number of processes to resize image */
+		    if (ac < 2)
+			usage ();
+		    setshrinkproc ((int) atof (*++av));
+		    ac--;
+		    break;
+
 		case 'l': /* Number of lines to log */
 		    if (ac < 2)
 			usage ();
@@ -188,6 +222,15 @@ char **av;
 			}
 		    break;
 
+		case 'p':	/* Write pyramid of images, each half the last */
+		    if (ac < 2)
+			usage ();
+		    pyramid = (int) atof (*++av);
+		    if (pyramid < 1)
+			pyramid = 1;
+		    ac--;
+		    break;
+
 		case 'v':	/* more verbosity */
 		    verbose++;
 		    break;
@@ -247,7 +290,10 @@ char **av;
 	while (fgets (filename, 128, flist) != NULL) {
 	    lastchar = filename + strlen (filename) - 1;
 	    if (*lastchar < 32) *lastchar = 0;
-	    imResize (filename);
+	    if (pyramid)
+		imPyramid (filename);
+	    else
+		imResize (filename);
 	    if (verbose)
 		printf ("\n");
 	    }
@@ -264,7 +310,10 @@ char **av;
 	    else {
 		if (verbose)
 		    printf ("%s:\n", fname);
-		imResize (fname);
+		if (pyramid)
+		    imPyramid (fname);
+		else
+		    imResize (fname);
 		if (verbose)
   		    printf ("\n");
 		}
@@ -286,15 +335,20 @@ usage ()
 	exit (-1);
     fprintf (stderr,"Resize FITS and IRAF image files\n");
     fprintf(stderr,"Usage: [-v][-a dx[,dy]][-g dx[,dy]][-m dx[,dy]] file.fits ...\n");
+    fprintf(stderr,"  or : [-v][-e][-c sum|mean|median][-o name] -p size file.fits ...\n");
     fprintf(stderr,"  -a dx dy: Mean filter dx x dy pixels\n");
     fprintf(stderr,"  -b bitpix: FITS bits per pixel in output image\n");
+    fprintf(stderr,"  -c sum|mean|median: Combine regrouped pixels (default mean)\n");
+    fprintf(stderr,"  -e: Write pyramid levels as extensions of one file\n");
     fprintf(stderr,"  -f factor: Reduce both image dimensions by factor\n");
     fprintf(stderr,"  -g dx: Gaussian filter dx pixels square\n");
     fprintf(stderr,"  -h halfwidth: Gaussian half-width at half-height\n");
+    fprintf(stderr,"  -j num: Reduce image dimensions in num processes\n");
     fprintf(stderr,"  -l num: Logging interval in lines\n");
     fprintf(stderr,"  -m dx dy: Median filter dx x dy pixels\n");
     fprintf(stderr,"  -n: Rotate to North Up East Left\n");
     fprintf(stderr,"  -o: Allow overwriting of input image, else write new one\n");
+    fprintf(stderr,"  -p size: Halve image repeatedly until no wider than size\n");
     fprintf(stderr,"  -v: Verbose\n");
     fprintf(stderr,"  -x factor: Reduce image horizontal dimension by factor\n");
     fprintf(stderr,"  -y factor: Reduce image vertical dimension by factor\n");
@@ -328,6 +382,7 @@ char *name;
     char pixname[256];
     char *RotFITS();
     struct WorldCoor *wcs;
+    int imean, nbits;
 
     /* If not overwriting input file, make up a name for the output file */
     if (!overwrite) {
@@ -499,10 +554,19 @@ char *name;
 
     /* Resize image, if requested */
     if (resize) {
-	if ((newhead = ShrinkFITSHeader (name, header, xfactor, yfactor, mean, bitpix)) == NULL)
+
+	/* Sum pixels into the input pixel size if -c sum without -b */
+	imean = mean;
+	nbits = bitpix;
+	if (mean < 0) {
+	    imean = 0;
+	    if (nbits == 0)
+		hgeti4 (header, "BITPIX", &nbits);
+	    }
+	if ((newhead = ShrinkFITSHeader (name, header, xfactor, yfactor, imean, nbits)) == NULL)
 	    fprintf (stderr,"Cannot make new image header for %s; file is unchanged.\n",newname);
 	else if ((newimage = ShrinkFITSImage (header, image, xfactor, yfactor,
-					      mean, bitpix, nlog)) == NULL) {
+					      imean, nbits, nlog)) == NULL) {
 	    fprintf (stderr,"Cannot shrink image %s.\n",name);
 	    free (newhead);
 	    }
@@ -588,6 +652,462 @@ char *name;
     free (image);
     return;
 }
+
+
+/* One level of an image pyramid, made two rows at a time from the level above */
+
+struct PyrLevel {
+    int nx, ny;		/* Number of columns and rows in this level */
+    int fd;		/* File to which this level is written */
+    off_t offset;	/* Byte offset of first pixel of this level in file */
+    int nbrow;		/* Number of bytes in one output row */
+    int iy;		/* Number of rows written so far */
+    int npend;		/* 1 if a row from the level above awaits its pair */
+    double *pend;	/* Row from the level above waiting for its pair */
+    double *row;	/* Last row of this level */
+    char *buff;		/* Last row of this level in output BITPIX */
+    char *header;	/* FITS header for this level */
+};
+
+#define MAXLEVEL 32
+
+/* Write levels 1/2, 1/4, ... of an image, reading the input image once and
+ * making each level from the one above it as its rows arrive */
+
+static void
+imPyramid (name)
+char *name;
+{
+    struct PyrLevel lev[MAXLEVEL];
+    struct PyrLevel *pl;
+    char *header;		/* FITS header of input image */
+    char *irafheader = NULL;	/* IRAF image header */
+    char *image = NULL;		/* IRAF image, which is read all at once */
+    char *band = NULL;		/* Band of rows from FITS image */
+    char *fname, *ext, *imext, *endhead, *lasthead, *hplace, *zeros;
+    char rootname[256];		/* Output file name without extension */
+    char newname[256];		/* Name of file to which a level is written */
+    char extname[16];
+    char extnum[16];
+    char history[64];
+    double *row;		/* One row of the input image */
+    double bzero, bscale;
+    int lhead, nbhead, iraffile, fdin, nlev, ilev, imean, nbits, nbout;
+    int bitsin, bytein, naxis, nx, ny, nxl, nyl, fac, nyin;
+    int nrband, nyband, nbband, nbread, nbr, iy, jy, nbh, nbdata, nbpad;
+    int status = 0;
+    off_t offset;
+
+    /* Read input header, and the whole image if it is in IRAF format */
+    if (isiraf (name)) {
+	iraffile = 1;
+	if ((irafheader = irafrhead (name, &lhead)) == NULL) {
+	    fprintf (stderr, "Cannot read IRAF header file %s\n", name);
+	    return;
+	    }
+	if ((header = iraf2fits (name, irafheader, lhead, &nbhead)) == NULL) {
+	    fprintf (stderr, "Cannot translate IRAF header %s/n",name);
+	    free (irafheader);
+	    return;
+	    }
+	if ((image = irafrimage (header)) == NULL) {
+	    fprintf (stderr, "Cannot read IRAF pixel file for %s\n", name);
+	    free (irafheader);
+	    free (header);
+	    return;
+	    }
+	}
+    else {
+	iraffile = 0;
+	if ((header = fitsrhead (name, &lhead, &nbhead)) == NULL) {
+	    fprintf (stderr, "Cannot read FITS file %s\n", name);
+	    return;
+	    }
+	}
+
+    bitsin = 0;
+    hgeti4 (header, "BITPIX", &bitsin);
+    bytein = bitsin / 8;
+    if (bytein < 0)
+	bytein = -bytein;
+    naxis = 0;
+    hgeti4 (header, "NAXIS", &naxis);
+    nx = 1;
+    hgeti4 (header, "NAXIS1", &nx);
+    ny = 1;
+    hgeti4 (header, "NAXIS2", &ny);
+    bzero = 0.0;
+    hgetr8 (header, "BZERO", &bzero);
+    bscale = 1.0;
+    hgetr8 (header, "BSCALE", &bscale);
+
+    /* Set output pixel size as for a single reduction */
+    imean = mean;
+    nbits = bitpix;
+    if (mean < 0) {
+	imean = 0;
+	if (nbits == 0)
+	    nbits = bitsin;
+	}
+    if (nbits == 0) {
+	nbits = bitsin;
+	if (!imean)
+	    imean = 1;
+	}
+    if (nbits != 16 && nbits != 32 && nbits != -32 && nbits != -64) {
+	fprintf (stderr, "IMRESIZE: Cannot write pyramid of BITPIX=%d images\n",
+		 nbits);
+	status = -1;
+	}
+    else if (naxis < 2 || bytein == 0) {
+	fprintf (stderr, "IMRESIZE: %s is not a 2-D image\n", name);
+	status = -1;
+	}
+    if (status) {
+	free (header);
+	if (iraffile) {
+	    free (irafheader);
+	    free (image);
+	    }
+	return;
+	}
+    nbout = nbits / 8;
+    if (nbout < 0)
+	nbout = -nbout;
+
+    /* Halve both dimensions until the image is no wider than pyramid */
+    nlev = 0;
+    nxl = nx;
+    nyl = ny;
+    while (nlev < MAXLEVEL && (nxl > pyramid || nyl > pyramid) &&
+	   nxl > 1 && nyl > 1) {
+	nxl = nxl / 2;
+	nyl = nyl / 2;
+	pl = lev + nlev;
+	pl->nx = nxl;
+	pl->ny = nyl;
+	pl->fd = -1;
+	pl->nbrow = nxl * nbout;
+	pl->iy = 0;
+	pl->npend = 0;
+	pl->pend = (double *) calloc (2 * nxl, sizeof (double));
+	pl->row = (double *) calloc (nxl, sizeof (double));
+	pl->buff = (char *) calloc (nxl, nbout);
+	pl->header = NULL;
+	if (pl->pend == NULL || pl->row == NULL || pl->buff == NULL)
+	    status = -1;
+	nlev++;
+	}
+    if (nlev == 0)
+	fprintf (stderr, "IMRESIZE: %s is already no wider than %d pixels\n",
+		 name, pyramid);
+    else if (status)
+	fprintf (stderr, "IMRESIZE: Cannot allocate pyramid rows for %s\n",
+		 name);
+
+    /* Output files are named from the input file or -o name */
+    if (outname[0] > 0)
+	strcpy (rootname, outname);
+    else {
+	fname = strrchr (name, '/');
+	if (fname)
+	    fname = fname + 1;
+	else
+	    fname = name;
+	strcpy (rootname, fname);
+	}
+    imext = strpbrk (rootname, ",[");
+    if (imext != NULL) {
+	strncpy (extnum, imext + 1, 15);
+	extnum[15] = (char) 0;
+	if ((ext = strchr (extnum, ']')) != NULL)
+	    *ext = (char) 0;
+	*imext = (char) 0;
+	}
+    ext = strrchr (rootname, '.');
+    if (ext != NULL && strchr (ext, '/') == NULL && !(pyrext && outname[0]))
+	*ext = (char) 0;
+    if (outname[0] == 0 && imext != NULL) {
+	if (hgets (header, "EXTNAME", 8, extname)) {
+	    strcat (rootname, ".");
+	    strcat (rootname, extname);
+	    }
+	else {
+	    strcat (rootname, "_");
+	    strcat (rootname, extnum);
+	    }
+	}
+    if (pyrext && outname[0] == 0)
+	strcat (rootname, "p.fits");
+
+    /* Make header for each level and write it at the start of its data */
+    offset = (off_t) 0;
+    for (ilev = 0; ilev < nlev && !status; ilev++) {
+	pl = lev + ilev;
+	fac = 2 << ilev;
+	if ((pl->header = ShrinkFITSHeader (name, header, fac, fac, imean,
+					    nbits)) == NULL) {
+	    fprintf (stderr, "Cannot make new image header for %s\n", name);
+	    status = -1;
+	    break;
+	    }
+	hputi4 (pl->header, "NAXIS1", pl->nx);
+	hputi4 (pl->header, "NAXIS2", pl->ny);
+	if (hgets (pl->header, "IMRESIZE", 63, history))
+	    hputs (pl->header, "HISTORY", history);
+	sprintf (history, "Image size reduced by %d in x, %d in y", fac, fac);
+	hputs (pl->header, "IMRESIZE", history);
+
+	/* All levels after the first are image extensions of one file */
+	if (pyrext) {
+	    if (ilev == 0)
+		hputl (pl->header, "EXTEND", 1);
+	    else {
+		hdel (pl->header, "EXTEND");
+		hchange (pl->header, "SIMPLE", "XTENSION");
+		hputs (pl->header, "XTENSION", "IMAGE");
+		hplace = ksearch (pl->header, "NAXIS2") + 80;
+		hadd (hplace, "PCOUNT");
+		hputi4 (pl->header, "PCOUNT", 0);
+		hadd (hplace + 80, "GCOUNT");
+		hputi4 (pl->header, "GCOUNT", 1);
+		}
+	    sprintf (extname, "LEVEL%d", ilev + 1);
+	    hputs (pl->header, "EXTNAME", extname);
+	    strcpy (newname, rootname);
+	    }
+	else
+	    sprintf (newname, "%ss%dx%d.fits", rootname, fac, fac);
+
+	/* Pad header with spaces to a whole number of FITS blocks */
+	nbh = fitsheadsize (pl->header);
+	endhead = ksearch (pl->header, "END") + 80;
+	lasthead = pl->header + nbh;
+	while (endhead < lasthead)
+	    *(endhead++) = ' ';
+
+	if (pyrext && ilev > 0)
+	    pl->fd = lev[0].fd;
+	else {
+	    pl->fd = open (newname, O_WRONLY+O_CREAT+O_TRUNC, 0666);
+	    if (pl->fd < 0) {
+		fprintf (stderr, "IMRESIZE: Cannot write file %s\n", newname);
+		status = -1;
+		break;
+		}
+	    offset = (off_t) 0;
+	    }
+	if (lseek (pl->fd, offset, SEEK_SET) < 0 ||
+	    write (pl->fd, pl->header, nbh) < nbh) {
+	    fprintf (stderr, "IMRESIZE: Cannot write header to %s\n", newname);
+	    status = -1;
+	    break;
+	    }
+	pl->offset = offset + nbh;
+	nbdata = pl->ny * pl->nbrow;
+	offset = pl->offset + (((nbdata + FITSBLOCK - 1) / FITSBLOCK) * FITSBLOCK);
+	if (verbose)
+	    fprintf (stderr, "IMRESIZE: %d x %d level %d -> %s\n",
+		     pl->nx, pl->ny, ilev + 1, newname);
+	if (!pyrext || ilev == 0)
+	    printf ("%s\n", newname);
+	}
+
+    /* Only rows which fill the first level are needed from the input */
+    row = NULL;
+    fdin = -1;
+    nrband = 0;
+    if (!status && nlev > 0) {
+	nyin = 2 * lev[0].ny;
+	row = (double *) calloc (nx, sizeof (double));
+	if (!iraffile) {
+	    nrband = (1 << 20) / (nx * bytein);
+	    if (nrband < 1)
+		nrband = 1;
+	    if (nrband > nyin)
+		nrband = nyin;
+	    band = (char *) malloc (nrband * nx * bytein);
+	    if ((fdin = fitsropen (name)) < 0 ||
+		lseek (fdin, nbhead, SEEK_SET) < 0) {
+		fprintf (stderr, "Cannot read FITS image %s\n", name);
+		status = -1;
+		}
+	    }
+	if (row == NULL || (!iraffile && band == NULL)) {
+	    fprintf (stderr, "IMRESIZE: Cannot allocate %d-pixel rows\n", nx);
+	    status = -1;
+	    }
+
+	/* Read bands of rows, passing each one down through the levels */
+	for (iy = 0; iy < nyin && !status; iy = iy + nyband) {
+	    nyband = nyin - iy;
+	    if (!iraffile) {
+		if (nyband > nrband)
+		    nyband = nrband;
+		nbband = nyband * nx * bytein;
+		for (nbread = 0; nbread < nbband; nbread = nbread + nbr) {
+		    nbr = read (fdin, band + nbread, nbband - nbread);
+		    if (nbr <= 0)
+			break;
+		    }
+		if (nbread < nbband) {
+		    fprintf (stderr, "IMRESIZE: %d of %d bytes read from %s\n",
+			     nbread, nbband, name);
+		    status = -1;
+		    break;
+		    }
+		}
+	    for (jy = 0; jy < nyband && !status; jy++) {
+		if (iraffile)
+		    getvec (image, bitsin, bzero, bscale, (iy + jy) * nx, nx,
+			    row);
+		else
+		    getvecfits (band, bitsin, bzero, bscale, jy * nx, nx, row);
+		if (PyrRow (lev, 0, nlev, row, imean, nbits)) {
+		    fprintf (stderr, "IMRESIZE: Cannot write pyramid of %s\n",
+			     name);
+		    status = -1;
+		    }
+		if (nlog > 0 && (iy+jy+1)%nlog == 0)
+		    fprintf (stderr,"IMRESIZE: %d/%d lines read\r",
+			     iy+jy+1, nyin);
+		}
+	    }
+	if (nlog > 0)
+	    fprintf (stderr,"\n");
+
+	/* Pad each level with zeroes to a whole number of FITS blocks */
+	zeros = (char *) calloc (FITSBLOCK, 1);
+	for (ilev = 0; ilev < nlev && !status; ilev++) {
+	    pl = lev + ilev;
+	    nbdata = pl->ny * pl->nbrow;
+	    nbpad = (((nbdata + FITSBLOCK - 1) / FITSBLOCK) * FITSBLOCK) - nbdata;
+	    if (nbpad > 0 &&
+		(lseek (pl->fd, pl->offset + nbdata, SEEK_SET) < 0 ||
+		 write (pl->fd, zeros, nbpad) < nbpad)) {
+		fprintf (stderr, "IMRESIZE: Cannot write pyramid of %s\n", name);
+		status = -1;
+		}
+	    }
+	free (zeros);
+	}
+
+    for (ilev = 0; ilev < nlev; ilev++) {
+	pl = lev + ilev;
+	if (pl->fd >= 0 && (!pyrext || ilev == 0))
+	    close (pl->fd);
+	free (pl->pend);
+	free (pl->row);
+	free (pl->buff);
+	if (pl->header != NULL)
+	    free (pl->header);
+	}
+    if (fdin >= 0)
+	close (fdin);
+    if (band != NULL)
+	free (band);
+    if (row != NULL)
+	free (row);
+    free (header);
+    if (iraffile) {
+	free (irafheader);
+	free (image);
+	}
+    return;
+}
+
+
+/* Add a row from the level above to one pyramid level, and when it completes
+ * a pair of rows, write the new row and add it to the level below */
+
+static int
+PyrRow (lev, ilev, nlev, row, mean, bitpix)
+
+struct PyrLevel *lev;	/* Pyramid levels */
+int	ilev;		/* Level to which row is added */
+int	nlev;		/* Number of levels */
+double	*row;		/* Row of level above, or of the input image */
+int	mean;		/* If 0, sum pixels, 1 substitute mean, 2 median */
+int	bitpix;		/* Number of bits per output pixel (neg=f.p.) */
+{
+    struct PyrLevel *pl;
+    double *r0, *r1, a[4], t, pixij;
+    int jx, i, j;
+
+    if (ilev >= nlev)
+	return (0);
+    pl = lev + ilev;
+    if (pl->iy >= pl->ny)
+	return (0);
+
+    /* Hold the first row of each pair until the second arrives */
+    if (!pl->npend) {
+	for (jx = 0; jx < 2 * pl->nx; jx++)
+	    pl->pend[jx] = row[jx];
+	pl->npend = 1;
+	return (0);
+	}
+    pl->npend = 0;
+
+    /* Combine each 2x2 block as ShrinkFITSImage() does */
+    r0 = pl->pend;
+    r1 = row;
+    for (jx = 0; jx < pl->nx; jx++, r0 += 2, r1 += 2) {
+	if (mean == 2) {
+	    a[0] = r0[0];
+	    a[1] = r0[1];
+	    a[2] = r1[0];
+	    a[3] = r1[1];
+	    for (i = 1; i < 4; i++) {
+		t = a[i];
+		for (j = i; j > 0 && a[j-1] > t; j--)
+		    a[j] = a[j-1];
+		a[j] = t;
+		}
+	    pixij = a[2];
+	    }
+	else {
+	    pixij = ((r0[0] + r0[1]) + r1[0]) + r1[1];
+	    if (mean)
+		pixij = pixij / 4.0;
+	    }
+	pl->row[jx] = pixij;
+	switch (bitpix) {
+	    case 16:
+		if (pixij >= 32767.0)
+		    ((short *) pl->buff)[jx] = 32767;
+		else if (pixij <= -32768.0)
+		    ((short *) pl->buff)[jx] = -32768;
+		else
+		    ((short *) pl->buff)[jx] = (short) pixij;
+		break;
+	    case 32:
+		if (pixij >= 2147483647.0)
+		    ((int *) pl->buff)[jx] = 2147483647;
+		else if (pixij <= -2147483648.0)
+		    ((int *) pl->buff)[jx] = -2147483647 - 1;
+		else
+		    ((int *) pl->buff)[jx] = (int) pixij;
+		break;
+	    case -32:
+		((float *) pl->buff)[jx] = (float) pixij;
+		break;
+	    case -64:
+		((double *) pl->buff)[jx] = pixij;
+		break;
+	    }
+	}
+
+    /* Write row in FITS byte order where it belongs in its level */
+    if (imswapped ())
+	imswap (bitpix, pl->buff, pl->nbrow);
+    if (lseek (pl->fd, pl->offset + ((off_t) pl->iy * pl->nbrow), SEEK_SET) < 0
+	|| write (pl->fd, pl->buff, pl->nbrow) < pl->nbrow)
+	return (-1);
+    pl->iy++;
+
+    return (PyrRow (lev, ilev + 1, nlev, pl->row, mean, bitpix));
+}
 /* Apr 19 2006	New program from imsmooth.c
  * Jun 21 2006	Write keywords IMRESIZE and IMSMOOTH to header describing action
  * Jun 21 2006	Clean up code
@@ -595,4 +1115,9 @@ char *name;
  *
  * Jan  5 2007	Add string length argument to hgets() call
  * Jun 12 2007	Add -n option to rotate WCS-ed image to north up, east left
+ *
+ * Oct 19 2026	Add -c to sum, average, or take median of regrouped pixels
+ * Oct 19 2026	Add -j to reduce image dimensions in several processes
+ * Oct 19 2026	Add -p and -e to write a pyramid of halved images in one pass
+ * Oct 19 2026	Clamp summed pyramid pixels to the integer BITPIX range
  */
@@ -1,5 +1,5 @@
 /* File imrot.c
- * September 25, 2009
+ * October 19, 2026
  * By Jessica Mink, Harvard-Smithsonian Center for Astrophysics
  * Send bug reports to jmink@cfa.harvard.edu
  */
@@ -16,6 +16,7 @@
 static void usage();
 static void imRot ();
 extern char *RotFITS();
+extern int FlipFITS();
 extern int DelWCSFITS();
 
 #define MAXFILES 1000
@@ -511,8 +512,14 @@ char *name;
 	DelWCSFITS (header, verbose);
 	}
 
-    if ((newimage = RotFITS (name,header,image,xshift,yshift,rotate,mirror,
-			     bitpix,rotatewcs,verbose)) == NULL) {
+    /* Reflect or turn image over in place if rows stay rows */
+    if (xshift == 0 && yshift == 0 &&
+	FlipFITS (name,header,image,rotate,mirror,bitpix,rotatewcs,verbose))
+	newimage = image;
+    else
+	newimage = RotFITS (name,header,image,xshift,yshift,rotate,mirror,
+			    bitpix,rotatewcs,verbose);
+    if (newimage == NULL) {
 	fprintf (stderr,"Cannot rotate image %s; file is unchanged.\n",name);
 	}
     else {
@@ -538,7 +545,8 @@ char *name;
 	    else if (verbose)
 		printf ("IMROT: File %s not written.\n", newname);
 	    }
-	free (newimage);
+	if (newimage != image)
+	    free (newimage);
 	}
 
     free (header);
@@ -601,4 +609,6 @@ char *name;
  * Mar 27 2009	Use _ instead of . to separate extension name or number in output filename
  * Mar 27 2009	Add -n option to force use of extension number instead of EXTNAME
  * Sep 25 2009	Declare DelWCSFITS()
+ *
+ * Oct 19 2026	Reflect or rotate by 180 degrees in place with FlipFITS()
  */
@@ -1,9 +1,9 @@
 /* File imstack.c
- * August 30, 2007
+ * October 18, 2026
  * By Jessica Mink, Harvard-Smithsonian Center for Astrophysics
  * Send bug reports to jmink@cfa.harvard.edu
 
-   Copyright (C) 1997-2007
+   Copyright (C) 1997-2026
    Smithsonian Astrophysical Observatory, Cambridge, MA USA
 
    This program is free software; you can redistribute it and/or
@@ -28,23 +28,73 @@
 #include <errno.h>
 #include <unistd.h>
 #include <math.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "libwcs/fitsfile.h"
 #include "libwcs/wcs.h"
 
+/* Methods for combining images instead of stacking them */
+#define COMB_NONE	0	/* Stack images into cube or MEF file */
+#define COMB_MEAN	1	/* Mean of all good pixels */
+#define COMB_MEDIAN	2	/* Median of all good pixels */
+#define COMB_MINMAX	3	/* Mean after dropping lowest and highest */
+#define COMB_SIGMA	4	/* Mean after iterative sigma clipping */
+
+/* Input image for combining */
+struct CombImage {
+    char *filename;	/* Name of input file */
+    int fd;		/* File descriptor, open for reading */
+    off_t nbhead;	/* Offset in bytes to start of data */
+    int bitpix;		/* FITS bits per pixel */
+    int bytepix;	/* Bytes per pixel */
+    double bzero;	/* Zero point for pixel scaling */
+    double bscale;	/* Scale factor for pixel scaling */
+    int hasblank;	/* 1 if integer image has a BLANK value */
+    double blank;	/* Scaled value of BLANK pixels */
+};
+
+/* Information shared by threads combining bands of rows */
+struct CombJob {
+    struct CombImage *images;	/* Input images */
+    int nimages;	/* Number of input images */
+    int nx;		/* Number of columns in each image */
+    int ny;		/* Number of rows in each image */
+    int fdout;		/* File descriptor for output file */
+    off_t nbout;	/* Offset in bytes to start of output data */
+    int nextrow;	/* First row of next band to be combined */
+    int nerr;		/* Number of bands which could not be read or written */
+    pthread_mutex_t lock; /* Lock for nextrow and nerr */
+};
+
 static void usage();
 static int StackImage();
+static int CombineImages();
+static void *CombineBands();
+static int CompValue();
+static double CombinePixel();
+static double outblank();
+static int ReadBand();
 
 static int verbose = 0;		/* verbose flag */
 static int wfits = 1;		/* if 1, write FITS header before data */
 static char *newname = NULL;
 static char *RevMsg = "IMSTACK WCSTools 3.9.7, 26 April 2022, Jessica Mink (jmink@cfa.harvard.edu)";
 static int nfiles = 0;
-static int nbstack = 0;
+static off_t nbstack = 0;
+static int stackbitpix = 0;	/* BITPIX of first stacked image */
 static int extend = 0;		/* If 1, output multi-extension FITS file */
 static FILE *fstack = NULL;
 static int version = 0;		/* If 1, print only program name and version */
 static int multispec = 0;	/* Add header keywords for IRAF multispec format */
 static char *extroot;
+static int combine = COMB_NONE;	/* Method for combining images, if not stacking */
+static int nthreads = 1;	/* Number of threads to use when combining */
+static int nrband = 32;		/* Number of rows per band when combining */
+static int nlow = 1;		/* Number of low pixels to reject for minmax */
+static int nhigh = 1;		/* Number of high pixels to reject for minmax */
+static double nsigma = 3.0;	/* Rejection threshold in sigma for sigma clip */
+static int outbitpix = -32;	/* BITPIX of combined output image */
 
 int
 main (ac, av)
@@ -53,12 +103,14 @@ char **av;
 {
     char filename[128];
     char *filelist[100];
+    char **combfiles;
+    char *comma;
     char *listfile = NULL;
     char *str;
     int readlist = 0;
     int ntimes = 1;
     FILE *flist;
-    int ifile, nblocks, nbytes, i;
+    int ifile, nbytes, i;
     char *blanks;
 
     /* Check for help or version command first */
@@ -81,6 +133,51 @@ char **av;
 	    verbose++;
 	    break;
 
+	case 'b':	/* Number of rows per band when combining */
+	    if (ac < 2)
+                usage ();
+	    nrband = (int) atof (*++av);
+	    if (nrband < 1)
+		nrband = 1;
+	    ac--;
+	    break;
+
+	case 'c':	/* Combine images into one instead of stacking them */
+	    if (ac < 2)
+                usage ();
+	    str = *++av;
+	    ac--;
+	    if (!strncasecmp (str, "med", 3))
+		combine = COMB_MEDIAN;
+	    else if (!strncasecmp (str, "mea", 3) || !strncasecmp (str, "ave", 3))
+		combine = COMB_MEAN;
+	    else if (!strncasecmp (str, "min", 3))
+		combine = COMB_MINMAX;
+	    else if (!strncasecmp (str, "sig", 3))
+		combine = COMB_SIGMA;
+	    else {
+		fprintf (stderr, "IMSTACK: Unknown combine method %s\n", str);
+		usage ();
+		}
+	    str = str + strlen (str) - 1;
+	    break;
+
+	case 'j':	/* Number of threads to use when combining */
+	    if (ac < 2)
+                usage ();
+	    nthreads = (int) atof (*++av);
+	    if (nthreads < 1)
+		nthreads = 1;
+	    ac--;
+	    break;
+
+	case 'k':	/* Clipping threshold in sigma */
+	    if (ac < 2)
+                usage ();
+	    nsigma = atof (*++av);
+	    ac--;
+	    break;
+
 	case 'i':	/* Write only image data to output file */
 	    wfits = 0;
 	    if (newname == NULL) {
@@ -100,6 +197,26 @@ char **av;
 	    ac--;
 	    break;
 
+	case 'p':	/* BITPIX of combined image */
+	    if (ac < 2)
+                usage ();
+	    outbitpix = (int) atof (*++av);
+	    ac--;
+	    break;
+
+	case 'r':	/* Number of low,high pixels to reject for minmax */
+	    if (ac < 2)
+                usage ();
+	    str = *++av;
+	    ac--;
+	    nlow = (int) atof (str);
+	    if ((comma = strchr (str, ',')) != NULL)
+		nhigh = (int) atof (comma+1);
+	    else
+		nhigh = nlow;
+	    str = str + strlen (str) - 1;
+	    break;
+
 	case 'o':	/* Set output file name */
 	    if (ac < 2)
                 usage ();
@@ -168,6 +285,33 @@ char **av;
 	    }
 	}
 
+    /* Combine images into a single image instead of stacking them */
+    if (combine != COMB_NONE) {
+	if (nfiles < 1)
+	    usage ();
+	if (readlist) {
+	    combfiles = (char **) calloc (nfiles, sizeof (char *));
+	    for (ifile = 0;  ifile < nfiles; ifile++) {
+		if (fgets (filename, 128, flist) == NULL)
+		    break;
+		filename[strlen (filename) - 1] = 0;
+		combfiles[ifile] = (char *) calloc (strlen (filename)+1, 1);
+		strcpy (combfiles[ifile], filename);
+		}
+	    fclose (flist);
+	    nfiles = ifile;
+	    }
+	else
+	    combfiles = filelist;
+	i = CombineImages (nfiles, combfiles);
+	if (readlist) {
+	    for (ifile = 0;  ifile < nfiles; ifile++)
+		free (combfiles[ifile]);
+	    free (combfiles);
+	    }
+	return (i);
+	}
+
     /* Stack images from list in file */
     if (readlist) {
 	for (ifile = 0;  ifile < nfiles; ifile++) {
@@ -189,12 +333,11 @@ char **av;
 	}
 
 
-    /* Pad out FITS file to 2880 blocks */
-    if (wfits && fstack != NULL) {
-	nblocks = nbstack / FITSBLOCK;
-	if (nblocks * FITSBLOCK < nbstack)
-	    nblocks = nblocks + 1;
-	nbytes = (nblocks * FITSBLOCK) - nbstack;
+    /* Pad out FITS file to 2880 blocks; extensions are padded as written */
+    if (wfits && !extend && fstack != NULL) {
+	nbytes = (int) (nbstack % FITSBLOCK);
+	if (nbytes > 0)
+	    nbytes = FITSBLOCK - nbytes;
 	if (nbytes > 0) {
 	    blanks = (char *) malloc ((size_t) nbytes);
 	    for (i = 0;  i < nbytes; i++)
@@ -218,10 +361,17 @@ usage ()
     fprintf (stderr,"Stack FITS or IRAF images into single FITS image\n");
     fprintf(stderr,"Usage: imstack [-vi][-o filename][-n num] file1.fits file2.fits ... filen.fits\n");
     fprintf(stderr,"  or : imstack [-vi][-n num] @filelist\n");
+    fprintf(stderr,"  or : imstack -c method [-v][-j num][-o filename] @filelist\n");
+    fprintf(stderr,"  -b num: Number of rows per band when combining (default 32)\n");
+    fprintf(stderr,"  -c method: Combine images: median, mean, minmax, or sigma\n");
     fprintf(stderr,"  -i: Do not put FITS header in output file\n");
+    fprintf(stderr,"  -j num: Number of threads to use when combining\n");
+    fprintf(stderr,"  -k num: Clipping threshold in sigma (default 3)\n");
     fprintf(stderr,"  -n num: Use each file this many times\n");
     fprintf(stderr,"  -m: Write IRAF multispec file\n");
     fprintf(stderr,"  -o name: Output filename\n");
+    fprintf(stderr,"  -p bitpix: BITPIX of combined image (default -32)\n");
+    fprintf(stderr,"  -r lo,hi: Number of low and high pixels to reject for minmax\n");
     fprintf(stderr,"  -v: Verbose\n");
     fprintf(stderr,"  -x root: Make first file root, others extensions\n");
     exit (1);
@@ -242,9 +392,15 @@ char	*filename;	/* FITS or IRAF file filename */
     int lhead;			/* Maximum number of bytes in FITS header */
     int nbhead;			/* Actual number of bytes in FITS header */
     char *irafheader;		/* IRAF image header */
-    int nbimage, naxis, naxis1, naxis2, naxis3, bytepix;
+    off_t nbimage;		/* Number of bytes in image */
+    off_t nbcopy;		/* Number of bytes copied from input file */
+    int naxis, naxis1, naxis2, naxis3, bytepix;
     int bitpix, nblocks, nbytes;
     int iraffile;
+    struct stat st;
+    int copydata = 0;		/* 1 to copy data directly from input file */
+    int fdin;			/* File descriptor for input file */
+    off_t nbskip = 0;		/* Offset of input data in bytes */
     int i, itime, nout;
     char spaces[80];
     char pixname[256];
@@ -284,14 +440,32 @@ char	*filename;	/* FITS or IRAF file filename */
 	    hgeti4 (header, "NAXIS", &naxis);
 	    bitpix = 0;
 	    hgeti4 (header, "BITPIX", &bitpix);
+	    if (ifile == 0)
+		stackbitpix = bitpix;
 	    if (naxis < 1 || bitpix == 0) {
 		if (verbose)
 		    fprintf (stderr, "Dataless FITS file %s\n", filename);
 		}
-	    else if ((image = fitsrimage (filename, nbhead, header)) == NULL) {
-		fprintf (stderr, "Cannot read FITS image %s\n", filename);
-		free (header);
-		return (1);
+
+	    else {
+
+		/* Copy data without reading it if it needs no conversion
+		   and it can be read again from a regular file */
+		if ((extend || bitpix == stackbitpix) &&
+		    strncasecmp (filename, "stdin", 5) &&
+		    (fdin = fitsropen (filename)) >= 0) {
+		    if (fstat (fdin, &st) == 0 && S_ISREG (st.st_mode)) {
+			copydata = 1;
+			nbskip = (off_t) nbhead;
+			}
+		    close (fdin);
+		    }
+		if (!copydata &&
+		    (image = fitsrimage (filename, nbhead, header)) == NULL) {
+		    fprintf (stderr, "Cannot read FITS image %s\n", filename);
+		    free (header);
+		    return (1);
+		    }
 		}
 	    }
 	else {
@@ -309,7 +483,7 @@ char	*filename;	/* FITS or IRAF file filename */
     hgeti4 (header,"NAXIS1",&naxis1);
     if (naxis1 > 1) {
 	naxis = naxis + 1;
-	nbimage = naxis1;
+	nbimage = (off_t) naxis1;
 	}
     naxis2 = 0;
     hgeti4 (header,"NAXIS2",&naxis2);
@@ -327,7 +501,7 @@ char	*filename;	/* FITS or IRAF file filename */
     bytepix = bitpix / 8;
     if (bytepix < 0) bytepix = -bytepix;
     nbimage = nbimage * bytepix;
-    nbstack = nbstack + nbimage;
+    nbstack = nbstack + (nbimage * ntimes);
 
     /* Set NAXIS2 to # of images stacked; pad out FITS header to 2880 blocks */
     if (ifile < 1 && wfits) {
@@ -381,11 +555,12 @@ char	*filename;	/* FITS or IRAF file filename */
 	    }
 	}
     else if (fstack == NULL) {
-	fstack = fopen (newname, "a");
+	fstack = fopen (newname, "r+");
 	if (fstack == NULL) {
 	    fprintf (stderr, "Cannot write image %s\n", newname);
 	    return (1);
 	    }
+	(void) fseeko (fstack, (off_t) 0, SEEK_END);
 	}
     if (extend && ifile > 0) {
 	hchange (header, "SIMPLE", "XTENSION");
@@ -403,6 +578,11 @@ char	*filename;	/* FITS or IRAF file filename */
 		}
 	    }
 	}
+
+    /* Swap data back to FITS byte order once if it was read into memory */
+    if (image != NULL && nbimage > 0 && imswapped())
+	imswap (bitpix,image, (int) nbimage);
+
     for (itime = 0; itime < ntimes; itime++) {
 	nout = (ifile * ntimes) + itime + 1;
 
@@ -449,30 +629,50 @@ char	*filename;	/* FITS or IRAF file filename */
 		printf ("FITS file %s cannot be written.\n", newname);
 	    }
 
-	/* Write data */
-        if (nbimage > 0 && image != NULL) {
+	/* Copy data from input file to output file unchanged */
+	if (nbimage > 0 && copydata) {
+	    (void) fflush (fstack);
+	    if ((fdin = fitsropen (filename)) < 0)
+		nbcopy = 0;
+	    else if (lseek (fdin, nbskip, SEEK_SET) < 0) {
+		close (fdin);
+		nbcopy = 0;
+		}
+	    else {
+		nbcopy = fitscdata (fileno (fstack), fdin, nbimage);
+		close (fdin);
+		}
+	    (void) fseeko (fstack, (off_t) 0, SEEK_END);
+	    if (nbcopy < nbimage) {
+		printf ("FITS file %s NOT added to %s[%d]\n",
+		        filename, newname, nout);
+		fclose (fstack);
+		fstack = NULL;
+		free (header);
+		return (1);
+		}
+	    }
 
-	    /* Swap data if it has been swapped for this architecture */
-	    if (imswapped())
-		imswap (bitpix,image, nbimage);
+	/* Write data */
+        if (nbimage > 0 && (image != NULL || copydata)) {
 
-	    if (fwrite (image, (size_t) 1, (size_t) nbimage, fstack)) {
+	    if (copydata ||
+		fwrite (image, (size_t) 1, (size_t) nbimage, fstack)) {
 		if (verbose) {
 		    if (iraffile)
-			printf ("IRAF %d bytes of file %s added to %s[%d]",
-			    nbimage, filename, newname, nout);
+			printf ("IRAF %lld bytes of file %s added to %s[%d]",
+			    (long long) nbimage, filename, newname, nout);
 		    else
-			printf ("FITS %d bytes of file %s added to %s[%d]",
-			    nbimage, filename, newname, nout);
+			printf ("FITS %lld bytes of file %s added to %s[%d]",
+			    (long long) nbimage, filename, newname, nout);
 		    }
 
 		/* if extension, pad it out to 2880 blocks */
 		if (extend) {
 		    if (wfits && fstack != NULL) {
-			nblocks = nbimage / FITSBLOCK;
-			if (nblocks * FITSBLOCK < nbimage)
-			    nblocks = nblocks + 1;
-			nbytes = (nblocks * FITSBLOCK) - nbimage;
+			nbytes = (int) (nbimage % FITSBLOCK);
+			if (nbytes > 0)
+			    nbytes = FITSBLOCK - nbytes;
 			if (nbytes > 0) {
 			    blanks = (char *) malloc ((size_t) nbytes);
 			    for (i = 0;  i < nbytes; i++)
@@ -510,6 +710,487 @@ char	*filename;	/* FITS or IRAF file filename */
     return (0);
 }
 
+
+/* COMBINEIMAGES -- Combine aligned images pixel by pixel into one image,
+ * reading and combining a band of rows from all of the images at a time so
+ * that the whole images never need to be in memory */
+
+static int
+CombineImages (nimages, filenames)
+
+int	nimages;	/* Number of images to combine */
+char	**filenames;	/* Names of FITS files to combine */
+
+{
+    struct CombImage *images, *im;
+    struct CombJob job;
+    pthread_t *threads;
+    char *header = NULL;	/* FITS header for output image */
+    char *header1;		/* FITS header for an input image */
+    char *endhead, *lasthead;
+    char *padding;
+    char history[72];
+    char *methods[5] = {"stack", "mean", "median", "minmax", "sigma"};
+    int lhead, nbhead, naxis1, naxis2, bitpix, bytepix;
+    int iim, ithread, nbw, nbpad, nbytes, nblocks, ierr;
+    off_t nbdata;
+
+    images = (struct CombImage *) calloc (nimages, sizeof (struct CombImage));
+    if (images == NULL) {
+	fprintf (stderr, "IMSTACK: Cannot allocate %d image structures\n",
+		 nimages);
+	return (1);
+	}
+
+    /* Read all of the headers and check that the images are the same size */
+    ierr = 0;
+    job.nx = 0;
+    job.ny = 0;
+    for (iim = 0; iim < nimages; iim++) {
+	im = images + iim;
+	im->filename = filenames[iim];
+	im->fd = -1;
+	if (isiraf (im->filename)) {
+	    fprintf (stderr, "IMSTACK: Cannot combine IRAF image %s\n",
+		     im->filename);
+	    ierr++;
+	    break;
+	    }
+	if ((header1 = fitsrhead (im->filename, &lhead, &nbhead)) == NULL) {
+	    fprintf (stderr, "IMSTACK: Cannot read FITS file %s\n",
+		     im->filename);
+	    ierr++;
+	    break;
+	    }
+	naxis1 = 1;
+	hgeti4 (header1, "NAXIS1", &naxis1);
+	naxis2 = 1;
+	hgeti4 (header1, "NAXIS2", &naxis2);
+	bitpix = 0;
+	hgeti4 (header1, "BITPIX", &bitpix);
+	im->bzero = 0.0;
+	hgetr8 (header1, "BZERO", &im->bzero);
+	im->bscale = 1.0;
+	hgetr8 (header1, "BSCALE", &im->bscale);
+	im->hasblank = 0;
+	if (bitpix > 0 && hgetr8 (header1, "BLANK", &im->blank)) {
+	    im->hasblank = 1;
+	    if (im->bzero != 0.0 || im->bscale != 1.0)
+		im->blank = (im->blank * im->bscale) + im->bzero;
+	    }
+	im->bitpix = bitpix;
+	im->bytepix = bitpix / 8;
+	if (im->bytepix < 0)
+	    im->bytepix = -im->bytepix;
+	im->nbhead = (off_t) nbhead;
+	if (bitpix == 0) {
+	    fprintf (stderr, "IMSTACK: Dataless FITS file %s\n", im->filename);
+	    ierr++;
+	    }
+	else if (iim == 0) {
+	    job.nx = naxis1;
+	    job.ny = naxis2;
+	    }
+	else if (naxis1 != job.nx || naxis2 != job.ny) {
+	    fprintf (stderr, "IMSTACK: %s is %dx%d, not %dx%d\n",
+		     im->filename, naxis1, naxis2, job.nx, job.ny);
+	    ierr++;
+	    }
+	if (!ierr && (im->fd = fitsropen (im->filename)) < 0) {
+	    fprintf (stderr, "IMSTACK: Cannot open FITS file %s\n",
+		     im->filename);
+	    ierr++;
+	    }
+
+	/* Keep the first header as the basis for the output header */
+	if (iim == 0 && !ierr)
+	    header = header1;
+	else
+	    free (header1);
+	if (ierr)
+	    break;
+	}
+    if (ierr) {
+	for (iim = 0; iim < nimages; iim++) {
+	    if (images[iim].fd >= 0)
+		close (images[iim].fd);
+	    }
+	free (images);
+	if (header != NULL)
+	    free (header);
+	return (1);
+	}
+    if (verbose)
+	fprintf (stderr,"%s\n",RevMsg);
+
+    /* Set up output header for a single 2-D image */
+    hputi4 (header, "BITPIX", outbitpix);
+    hputi4 (header, "NAXIS", 2);
+    hdel (header, "NAXIS3");
+    hdel (header, "NAXIS4");
+    hdel (header, "BZERO");
+    hdel (header, "BSCALE");
+    hdel (header, "BLANK");
+    if (outbitpix > 0)
+	hputi4 (header, "BLANK", (int) outblank ());
+    hputi4 (header, "NCOMBINE", nimages);
+    snprintf (history, 72, "IMSTACK %s of %d images", methods[combine],
+	      nimages);
+    hputc (header, "HISTORY", history);
+
+    /* Open output file and write header, padded to an integral block */
+    job.fdout = open (newname, O_RDWR+O_CREAT+O_TRUNC, 0666);
+    if (job.fdout < 0) {
+	fprintf (stderr, "IMSTACK: Cannot write image %s\n", newname);
+	ierr++;
+	}
+    else if (wfits) {
+	endhead = ksearch (header, "END") + 80;
+	nbhead = fitsheadsize (header);
+	lasthead = header + nbhead;
+	while (endhead < lasthead)
+	    *(endhead++) = ' ';
+	nbw = write (job.fdout, header, nbhead);
+	if (nbw < nbhead) {
+	    fprintf (stderr, "IMSTACK: Wrote %d / %d bytes of header to %s\n",
+		     nbw, nbhead, newname);
+	    ierr++;
+	    }
+	}
+    else
+	nbhead = 0;
+    free (header);
+    if (ierr) {
+	for (iim = 0; iim < nimages; iim++)
+	    close (images[iim].fd);
+	free (images);
+	if (job.fdout >= 0)
+	    close (job.fdout);
+	return (1);
+	}
+
+    /* Combine bands of rows in as many threads as requested */
+    job.images = images;
+    job.nimages = nimages;
+    job.nbout = (off_t) nbhead;
+    job.nextrow = 0;
+    job.nerr = 0;
+    pthread_mutex_init (&job.lock, NULL);
+    if (nthreads > 1) {
+	threads = (pthread_t *) calloc (nthreads, sizeof (pthread_t));
+	for (ithread = 0; ithread < nthreads; ithread++) {
+	    if (pthread_create (&threads[ithread], NULL, CombineBands,
+				(void *) &job))
+		break;
+	    }
+	if (ithread == 0)
+	    (void) CombineBands ((void *) &job);
+	while (ithread-- > 0)
+	    pthread_join (threads[ithread], NULL);
+	free (threads);
+	}
+    else
+	(void) CombineBands ((void *) &job);
+    pthread_mutex_destroy (&job.lock);
+
+    for (iim = 0; iim < nimages; iim++)
+	close (images[iim].fd);
+    free (images);
+
+    /* Pad out data to an integral number of 2880-byte blocks */
+    bytepix = outbitpix / 8;
+    if (bytepix < 0)
+	bytepix = -bytepix;
+    nbdata = (off_t) job.nx * (off_t) job.ny * (off_t) bytepix;
+    if (wfits) {
+	nblocks = (int) (nbdata / FITSBLOCK);
+	if ((off_t) nblocks * FITSBLOCK < nbdata)
+	    nblocks = nblocks + 1;
+	nbpad = (int) (((off_t) nblocks * FITSBLOCK) - nbdata);
+	if (nbpad > 0) {
+	    padding = (char *) calloc (1, nbpad);
+	    nbytes = pwrite (job.fdout, padding, nbpad, job.nbout + nbdata);
+	    if (nbytes < nbpad)
+		job.nerr++;
+	    free (padding);
+	    }
+	}
+    close (job.fdout);
+
+    if (job.nerr > 0) {
+	fprintf (stderr, "IMSTACK: %d bands of %s could not be combined\n",
+		 job.nerr, newname);
+	return (1);
+	}
+    if (verbose)
+	printf ("%d %dx%d images combined by %s into %s\n",
+		nimages, job.nx, job.ny, methods[combine], newname);
+    return (0);
+}
+
+
+/* COMBINEBANDS -- Combine bands of rows until all rows have been done */
+
+static void *
+CombineBands (arg)
+
+void	*arg;		/* Information shared by combining threads */
+
+{
+    struct CombJob *job = (struct CombJob *) arg;
+    struct CombImage *im;
+    char **bands;	/* Band of rows from each input image */
+    double **rows;	/* One row from each input image, scaled */
+    double *values;	/* One pixel from each input image */
+    double *outrow;	/* One row of the combined image */
+    char *outband;	/* Band of rows of the combined image */
+    int nimages = job->nimages;
+    int nx = job->nx;
+    int iim, ix, iy, y0, ny, nval, bytepix, nbout, nbw;
+    off_t nbline, offset;
+
+    bytepix = outbitpix / 8;
+    if (bytepix < 0)
+	bytepix = -bytepix;
+    bands = (char **) calloc (nimages, sizeof (char *));
+    rows = (double **) calloc (nimages, sizeof (double *));
+    values = (double *) calloc (nimages, sizeof (double));
+    outrow = (double *) calloc (nx, sizeof (double));
+    outband = (char *) calloc (nrband * nx, bytepix);
+    if (bands == NULL || rows == NULL || values == NULL || outrow == NULL ||
+	outband == NULL) {
+	pthread_mutex_lock (&job->lock);
+	job->nerr++;
+	pthread_mutex_unlock (&job->lock);
+	return (NULL);
+	}
+    for (iim = 0; iim < nimages; iim++) {
+	bands[iim] = (char *) malloc (nrband * nx * job->images[iim].bytepix);
+	rows[iim] = (double *) malloc (nx * sizeof (double));
+	}
+
+    while (1) {
+
+	/* Claim the next band of rows */
+	pthread_mutex_lock (&job->lock);
+	y0 = job->nextrow;
+	job->nextrow = job->nextrow + nrband;
+	pthread_mutex_unlock (&job->lock);
+	if (y0 >= job->ny)
+	    break;
+	ny = nrband;
+	if (y0 + ny > job->ny)
+	    ny = job->ny - y0;
+
+	/* Read the same band from every input image */
+	for (iim = 0; iim < nimages; iim++) {
+	    im = job->images + iim;
+	    nbline = (off_t) nx * (off_t) im->bytepix;
+	    if (ReadBand (im->fd, im->nbhead + (y0 * nbline), bands[iim],
+			  (int) (ny * nbline))) {
+		fprintf (stderr, "IMSTACK: Cannot read rows %d-%d of %s\n",
+			 y0+1, y0+ny, im->filename);
+		pthread_mutex_lock (&job->lock);
+		job->nerr++;
+		pthread_mutex_unlock (&job->lock);
+		}
+	    }
+
+	/* Combine one row at a time */
+	for (iy = 0; iy < ny; iy++) {
+	    for (iim = 0; iim < nimages; iim++) {
+		im = job->images + iim;
+		getvecfits (bands[iim], im->bitpix, im->bzero, im->bscale,
+			iy * nx, nx, rows[iim]);
+		}
+	    for (ix = 0; ix < nx; ix++) {
+		nval = 0;
+		for (iim = 0; iim < nimages; iim++) {
+		    im = job->images + iim;
+		    if (!isnan (rows[iim][ix]) &&
+			!(im->hasblank && rows[iim][ix] == im->blank))
+			values[nval++] = rows[iim][ix];
+		    }
+		outrow[ix] = CombinePixel (values, nval);
+		if (outbitpix > 0 && isnan (outrow[ix]))
+		    outrow[ix] = outblank ();
+		}
+	    putvecfits (outband, outbitpix, 0.0, 1.0, iy * nx, nx, outrow);
+	    }
+
+	/* Write the combined band, which is already in FITS byte order */
+	nbout = ny * nx * bytepix;
+	offset = job->nbout + ((off_t) y0 * (off_t) nx * (off_t) bytepix);
+	nbw = pwrite (job->fdout, outband, nbout, offset);
+	if (nbw < nbout) {
+	    fprintf (stderr, "IMSTACK: Cannot write rows %d-%d of %s\n",
+		     y0+1, y0+ny, newname);
+	    pthread_mutex_lock (&job->lock);
+	    job->nerr++;
+	    pthread_mutex_unlock (&job->lock);
+	    }
+	if (verbose > 1) {
+	    fprintf (stderr, "Rows %5d-%5d combined  ", y0+1, y0+ny);
+	    (void) putc (13, stderr);
+	    }
+	}
+
+    for (iim = 0; iim < nimages; iim++) {
+	free (bands[iim]);
+	free (rows[iim]);
+	}
+    free (bands);
+    free (rows);
+    free (values);
+    free (outrow);
+    free (outband);
+    return (NULL);
+}
+
+
+/* READBAND -- Read nbytes bytes starting at offset, returning 0 if all read */
+
+static int
+ReadBand (fd, offset, buff, nbytes)
+
+int	fd;		/* File descriptor */
+off_t	offset;		/* Offset in bytes from start of file */
+char	*buff;		/* Buffer for data (returned) */
+int	nbytes;		/* Number of bytes to read */
+
+{
+    int nbr;
+
+    while (nbytes > 0) {
+	nbr = pread (fd, buff, nbytes, offset);
+	if (nbr <= 0)
+	    break;
+	buff = buff + nbr;
+	offset = offset + nbr;
+	nbytes = nbytes - nbr;
+	}
+
+    /* Zero anything past the end of the file */
+    if (nbytes > 0) {
+	memset (buff, 0, nbytes);
+	return (1);
+	}
+    return (0);
+}
+
+
+/* Comparison for sorting pixel values */
+
+static int
+CompValue (pval1, pval2)
+
+const void *pval1, *pval2;
+
+{
+    double val1 = *(double *) pval1;
+    double val2 = *(double *) pval2;
+
+    if (val1 < val2)
+	return (-1);
+    else if (val1 > val2)
+	return (1);
+    else
+	return (0);
+}
+
+
+/* OUTBLANK -- Value of combined integer pixels with no good input values */
+
+static double
+outblank ()
+{
+    if (outbitpix == 8)
+	return (0.0);
+    else if (outbitpix == 16)
+	return (-32768.0);
+    else
+	return (-2147483648.0);
+}
+
+
+/* COMBINEPIXEL -- Combine values of one pixel from nval images, returning
+ * NaN if there are none */
+
+static double
+CombinePixel (values, nval)
+
+double	*values;	/* Pixel values; reordered by this subroutine */
+int	nval;		/* Number of values */
+
+{
+    double sum, sumsq, mean, sigma, dlim;
+    int i, j, nkeep, ilo, ihi, iter;
+
+    if (nval < 1)
+	return (NAN);
+    else if (nval == 1)
+	return (values[0]);
+
+    switch (combine) {
+
+	case COMB_MEAN:
+	    sum = 0.0;
+	    for (i = 0; i < nval; i++)
+		sum = sum + values[i];
+	    return (sum / (double) nval);
+
+	case COMB_MINMAX:
+	    qsort (values, nval, sizeof (double), CompValue);
+	    ilo = nlow;
+	    ihi = nval - nhigh;
+	    if (ihi <= ilo) {
+		ilo = (nval - 1) / 2;
+		ihi = (nval / 2) + 1;
+		}
+	    sum = 0.0;
+	    for (i = ilo; i < ihi; i++)
+		sum = sum + values[i];
+	    return (sum / (double) (ihi - ilo));
+
+	case COMB_SIGMA:
+	    nkeep = nval;
+	    mean = 0.0;
+	    for (iter = 0; iter <= 10; iter++) {
+		sum = 0.0;
+		sumsq = 0.0;
+		for (i = 0; i < nkeep; i++) {
+		    sum = sum + values[i];
+		    sumsq = sumsq + (values[i] * values[i]);
+		    }
+		mean = sum / (double) nkeep;
+		if (nkeep < 3 || iter == 10)
+		    break;
+		sigma = (sumsq / (double) nkeep) - (mean * mean);
+		if (sigma <= 0.0)
+		    break;
+		dlim = nsigma * sqrt (sigma);
+		j = 0;
+		for (i = 0; i < nkeep; i++) {
+		    if (fabs (values[i] - mean) <= dlim)
+			values[j++] = values[i];
+		    }
+		if (j == nkeep || j == 0)
+		    break;
+		nkeep = j;
+		}
+	    return (mean);
+
+	case COMB_MEDIAN:
+	default:
+	    qsort (values, nval, sizeof (double), CompValue);
+	    if (nval % 2)
+		return (values[nval / 2]);
+	    else
+		return (0.5 * (values[(nval / 2) - 1] + values[nval / 2]));
+	}
+}
+
+
 /* May 15 1997	New program
  * May 30 1997	Fix FITS data padding to integral multiple of 2880 bytes
  *
@@ -538,4 +1219,14 @@ char	*filename;	/* FITS or IRAF file filename */
  *
  * Jan  5 2007	Drop extra argument in call to hadd()
  * Aug 30 2007	Add -m to stack IRAF multispec files
+ *
+ * Oct 18 2026	Add -c to combine images by median, mean, minmax, or sigma clip
+ * Oct 18 2026	Add -j to combine bands of rows in parallel threads
+ * Oct 18 2026	Copy FITS data straight from input to output with fitscdata()
+ * Oct 18 2026	Swap in-memory data only once when repeating an image
+ * Oct 18 2026	Fix final padding when repeating images or writing extensions
+ * Oct 18 2026	Convert rows while swapping bytes when combining with -j
+ *
+ * Oct 19 2026	Skip BLANK input pixels; set pixels with no good inputs to BLANK
+ * Oct 19 2026	Keep image size in off_t; copy data directly only from regular files
  */
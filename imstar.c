@@ -1,9 +1,9 @@
 /* File imstar.c
- * June 24, 2016
+ * October 18, 2026
  * By Jessica Mink, Harvard-Smithsonian Center for Astrophysics
  * Send bug reports to jmink@cfa.harvard.edu
 
-   Copyright (C) 1996-2016
+   Copyright (C) 1996-2026
    Smithsonian Astrophysical Observatory, Cambridge, MA USA
 
    This program is free software; you can redistribute it and/or
@@ -59,6 +59,8 @@ extern void setmaxrad();
 extern void setborder();
 extern void setimcat();
 extern void setparm();
+extern void setnworkers();
+extern int PhotStars();
 extern void setrot();
 extern void setcenter();
 extern void setsys();
@@ -78,6 +80,12 @@ static int nstar = 0;
 static double eqout = 0.0;
 static int sysout = -1;
 static int outform = 0;		/* Output catalog format */
+static double nbradius = 0.0;	/* If > 0, count neighbors within this radius */
+#define MAXAPER 10
+static int naper = 0;		/* Number of photometry apertures */
+static double aprad[MAXAPER];	/* Radii of photometry apertures in pixels */
+static double skyrad1 = 0.0;	/* Inner radius of background annulus */
+static double skyrad2 = 0.0;	/* Outer radius of background annulus */
 static int setuns = 0;		/* Change to unsigned integer flag */
 static int imsearch = 1;	/* If 1, search for stars in image */
 static int region_char;
@@ -157,6 +165,32 @@ char **av;
 		    verbose++;
 		    break;
 	
+		case 'A':	/* Aperture photometry radii */
+		    if (ac < 2)
+			PrintUsage (str);
+		    {
+			char *rstr = strtok (*++av, ",");
+			naper = 0;
+			while (rstr != NULL && naper < MAXAPER) {
+			    aprad[naper++] = atof (rstr);
+			    rstr = strtok (NULL, ",");
+			    }
+		    }
+		    ac--;
+		    break;
+
+		case 'B':	/* Background annulus radii */
+		    if (ac < 2)
+			PrintUsage (str);
+		    {
+			char *rstr = *++av;
+			skyrad1 = atof (rstr);
+			if ((rstr = strchr (rstr, ',')) != NULL)
+			    skyrad2 = atof (rstr+1);
+		    }
+		    ac--;
+		    break;
+
 		case 'a':       /* Initial rotation angle in degrees */
 		    if (ac < 2)
 			PrintUsage (str);
@@ -220,8 +254,14 @@ char **av;
 		    break;
 	
 		case 'j':	/* Output FK5 (J2000) coordinates */
-		    eqout = 2000.0;
-		    sysout = WCS_J2000;
+		    if (ac > 1 && isnum (*(av+1)) == 1) {
+			setnworkers (atoi (*++av));	/* or search in parallel */
+			ac--;
+			}
+		    else {
+			eqout = 2000.0;
+			sysout = WCS_J2000;
+			}
 		    break;
 	
 		case 'k':	/* Print each star as it is found */
@@ -333,6 +373,13 @@ char **av;
     		    setrefpix (xr, yr);
     		    break;
 
+		case 'y':	/* Count neighbors within this many pixels */
+		    if (ac < 2)
+			PrintUsage (str);
+		    nbradius = atof (*++av);
+		    ac--;
+		    break;
+
 		case 'z':       /* Use AIPS classic WCS */
 		    setdefwcs (1);
 		    break;
@@ -413,6 +460,8 @@ char	*command;	/* Name of program being executed */
 
     fprintf (stderr,"Find stars in FITS and IRAF image files\n");
     fprintf(stderr,"usage: imstar [-vbsjt] [-m mag_off] [-n num] [-d file][ra dec sys] file.fits ...\n");
+    fprintf(stderr,"  -A: Aperture radii in pixels for photometry, separated by commas\n");
+    fprintf(stderr,"  -B: Inner and outer radii of photometry background annulus\n");
     fprintf(stderr,"  -a: Rotation angle in degrees (default 0)\n");
     fprintf(stderr,"  -b: Output B1950 (FK4) coordinates \n");
     fprintf(stderr,"  -c: Output total flux in counts instead of magnitudes\n");
@@ -423,6 +472,7 @@ char	*command;	/* Name of program being executed */
     fprintf(stderr,"  -h: Print heading, else do not \n");
     fprintf(stderr,"  -i: Minimum peak value for star in image (<0=-sigma)\n");
     fprintf(stderr,"  -j: Output J2000 (FK5) coordinates \n");
+    fprintf(stderr,"  -j <n>: Search image in n parallel processes\n");
     fprintf(stderr,"  -k: Print each star as it is found for debugging \n");
     fprintf(stderr,"  -l: reflect left<->right before rotating and searching\n");
     fprintf(stderr,"  -m: Magnitude offset (set brightest to abs(offset) if < 0)\n");
@@ -437,7 +487,10 @@ char	*command;	/* Name of program being executed */
     fprintf(stderr,"  -v: Verbose; print star list to stdout\n");
     fprintf(stderr,"  -w: write star list to output file\n");
     fprintf(stderr,"  -x: X and Y coordinates of reference pixel (if not in header or center)\n");
+    fprintf(stderr,"  -y: Add number of stars within this many pixels and nearest star distance\n");
     fprintf (stderr,"  -z: use AIPS classic projections instead of WCSLIB\n");
+    fprintf(stderr,"  bkgmesh=n: Use background mesh of n-pixel cells for thresholds\n");
+    fprintf(stderr,"  bkgfile=name: Write background and noise mesh to FITS file\n");
     fprintf(stderr,"  @listfile: file containing a list of filenames to search\n");
     exit (1);
 }
@@ -463,6 +516,13 @@ char	*filename;	/* FITS or IRAF file filename */
     int ns;			/* n image stars */
     double *smag;		/* image star magnitudes */
     int *sp;			/* peak flux in counts */
+    int *snear = NULL;		/* number of stars within nbradius */
+    double *sdnear = NULL;	/* distance to nearest star in pixels */
+    char *phimage = NULL;	/* Copy of image for photometry */
+    double *apflux = NULL;	/* Flux in each aperture for each star */
+    double *aparea = NULL;	/* Pixels in each aperture for each star */
+    double *apsky = NULL;	/* Background per pixel for each star */
+    int ia;
     double cra,cdec,dra,ddec,secpix;
     int wp, hp;
     char rastr[32], decstr[32];
@@ -484,7 +544,7 @@ char	*filename;	/* FITS or IRAF file filename */
 		free (irafheader);
 		return;
 		}
-	    if (imsearch) {
+	    if (imsearch || naper > 0) {
 		if ((image = irafrimage (header)) == NULL) {
 		    hgetm (header,"PIXFIL", 255, pixname);
 		    fprintf (stderr, "Cannot read IRAF pixel file %s\n", pixname);
@@ -504,7 +564,7 @@ char	*filename;	/* FITS or IRAF file filename */
     /* Read FITS image header */
     else {
 	if ((header = fitsrhead (filename, &lhead, &nbhead)) != NULL) {
-	    if (imsearch) {
+	    if (imsearch || naper > 0) {
 		if ((image = fitsrimage (filename, nbhead, header)) == NULL) {
 		    fprintf (stderr, "Cannot read FITS image %s\n", filename);
 		    free (header);
@@ -528,7 +588,7 @@ char	*filename;	/* FITS or IRAF file filename */
 	}
 
     /* Rotate and/or reflect image */
-    if (imsearch && (rot != 0 || mirror)) {
+    if (image != NULL && (rot != 0 || mirror)) {
 	if ((newimage = RotFITS (filename,header,image,0,0,rot,mirror,bitpix,
 				 rotatewcs,verbose)) == NULL) {
 	    fprintf (stderr,"Image %s could not be rotated\n", filename);
@@ -556,14 +616,31 @@ char	*filename;	/* FITS or IRAF file filename */
     if (wcs == NULL)
 	outform = CAT_DAOFIND;
 
+    /* Keep unmarked pixels for photometry, as found stars are zapped */
+    if (naper > 0 && image != NULL) {
+	size_t nbimage;
+	int naxis1, naxis2;
+	hgeti4 (header, "BITPIX", &bitpix);
+	hgeti4 (header, "NAXIS1", &naxis1);
+	hgeti4 (header, "NAXIS2", &naxis2);
+	nbimage = (size_t) naxis1 * (size_t) naxis2 * (size_t) (abs (bitpix) / 8);
+	if ((phimage = (char *) malloc (nbimage)) != NULL)
+	    memcpy (phimage, image, nbimage);
+	else
+	    fprintf (stderr,"ListStars: cannot allocate %lu bytes for photometry of %s\n",
+		     (unsigned long) nbimage, filename);
+	}
+
     /* Discover star-like things in the image, in pixels */
     ns = FindStars (header, image, &sx, &sy, &smag, &sp, debug, 1);
     if (ns < 1) {
 	fprintf (stderr,"ListStars: no stars found in image %s\n", filename);
 	wcsfree (wcs);
 	free (header);
-	if (imsearch)
+	if (image != NULL)
 	    free (image);
+	if (phimage != NULL)
+	    free (phimage);
 	return;
 	}
 
@@ -599,6 +676,42 @@ char	*filename;	/* FITS or IRAF file filename */
     /* Sort star-like objects in image by right ascension */
     if (rasort && iswcs (wcs))
 	RASortStars (0, sra, sdec, NULL, NULL, sx, sy, &smag, sp, NULL, ns, 1);
+
+    /* Count neighbors and find nearest star for blend and isolation flags */
+    if (nbradius > 0.0) {
+	struct StarGrid *grid;
+	int nx, ny;
+	nx = 0;
+	ny = 0;
+	hgeti4 (header, "NAXIS1", &nx);
+	hgeti4 (header, "NAXIS2", &ny);
+	grid = StarGridInit (nx, ny, (int) (nbradius + 0.5));
+	for (i = 0; i < ns; i++)
+	    (void) StarGridAdd (grid, sx[i], sy[i]);
+	snear = (int *) calloc (ns, sizeof (int));
+	sdnear = (double *) calloc (ns, sizeof (double));
+	for (i = 0; i < ns; i++)
+	    snear[i] = StarGridNear (grid, i, nbradius, &sdnear[i]);
+	StarGridFree (grid);
+	}
+
+    /* Measure fluxes through each aperture, less annulus background */
+    if (phimage != NULL) {
+	apflux = (double *) calloc (ns * naper, sizeof (double));
+	aparea = (double *) calloc (ns * naper, sizeof (double));
+	apsky = (double *) calloc (ns, sizeof (double));
+	(void) PhotStars (header, phimage, ns, sx, sy, naper, aprad,
+			  skyrad1, skyrad2, apflux, aparea, apsky);
+	for (i = 0; i < ns * naper; i++) {
+	    if (printcounts)
+		continue;
+	    else if (apflux[i] > 0.0)
+		apflux[i] = -2.5 * log10 (apflux[i]) + magoff;
+	    else
+		apflux[i] = 99.99;
+	    }
+	free (phimage);
+	}
     sprintf (headline, "IMAGE	%s", filename);
 
     /* Open plate catalog file */
@@ -774,11 +887,24 @@ char	*filename;	/* FITS or IRAF file filename */
 		sprintf (headline,"id 	ra      	dec     	counts	x    	y    	peak");
 	    else
 		sprintf (headline,"id 	ra      	dec     	mag   	x    	y    	peak");
+	    if (snear != NULL)
+		strcat (headline, "	nnear	dnear");
+	    for (ia = 0; apflux != NULL && ia < naper; ia++)
+		sprintf (headline+strlen(headline), printcounts ? "	flux%d" :
+			 "	mag%d", ia+1);
+	    if (apflux != NULL)
+		strcat (headline, "	sky");
 	    if (wfile)
 		fprintf (fd, "%s\n", headline);
 	    else
 		printf ("%s\n", headline);
 	    sprintf (headline,"---	------------	------------	------	-----	-----	------");
+	    if (snear != NULL)
+		strcat (headline, "	-----	-----");
+	    for (ia = 0; apflux != NULL && ia < naper; ia++)
+		strcat (headline, "	-----");
+	    if (apflux != NULL)
+		strcat (headline, "	-----");
 	    if (wfile)
 		fprintf (fd, "%s\n", headline);
 	    else
@@ -809,6 +935,14 @@ char	*filename;	/* FITS or IRAF file filename */
 	if (outform == CAT_STARBASE) {
 	    sprintf (headline, "%d	%s	%s	%.2f	%.2f	%.2f	%d",
 		     i+1, rastr,decstr, smag[i], sx[i], sy[i], sp[i]);
+	    if (snear != NULL)
+		sprintf (headline+strlen(headline), "	%d	%.2f",
+			 snear[i], sdnear[i]);
+	    for (ia = 0; apflux != NULL && ia < naper; ia++)
+		sprintf (headline+strlen(headline), printcounts ? "	%.1f" :
+			 "	%.3f", apflux[(i*naper)+ia]);
+	    if (apflux != NULL)
+		sprintf (headline+strlen(headline), "	%.2f", apsky[i]);
 	    if (wfile)
 		fprintf (fd, "%s\n", headline);
 	    else
@@ -819,6 +953,14 @@ char	*filename;	/* FITS or IRAF file filename */
 		    sx[i],sy[i],smag[i],sp[i]);
 	    if (iswcs (wcs))
 		sprintf (headline+strlen(headline), " %s %s", rastr, decstr);
+	    if (snear != NULL)
+		sprintf (headline+strlen(headline), " %d %.2f",
+			 snear[i], sdnear[i]);
+	    for (ia = 0; apflux != NULL && ia < naper; ia++)
+		sprintf (headline+strlen(headline), printcounts ? " %.1f" :
+			 " %6.3f", apflux[(i*naper)+ia]);
+	    if (apflux != NULL)
+		sprintf (headline+strlen(headline), " %.2f", apsky[i]);
 	    if (wfile)
 		fprintf (fd, "%s\n", headline);
 	    else
@@ -832,6 +974,14 @@ char	*filename;	/* FITS or IRAF file filename */
 		sprintf (headline+strlen(headline), " %6.2f %6.2f %d", sx[i],sy[i], sp[i]);
 	    else
 		sprintf (headline+strlen(headline), " %7.2f %7.2f %d", sx[i],sy[i], sp[i]);
+	    if (snear != NULL)
+		sprintf (headline+strlen(headline), " %d %.2f",
+			 snear[i], sdnear[i]);
+	    for (ia = 0; apflux != NULL && ia < naper; ia++)
+		sprintf (headline+strlen(headline), printcounts ? " %.1f" :
+			 " %6.3f", apflux[(i*naper)+ia]);
+	    if (apflux != NULL)
+		sprintf (headline+strlen(headline), " %.2f", apsky[i]);
 	    if (wfile)
 		fprintf (fd, "%s\n", headline);
 	    else
@@ -847,9 +997,14 @@ char	*filename;	/* FITS or IRAF file filename */
     if (sra) free ((char *)sra);
     if (sdec) free ((char *)sdec);
     if (smag) free ((char *)smag);
+    if (snear) free ((char *)snear);
+    if (sdnear) free ((char *)sdnear);
+    if (apflux) free ((char *)apflux);
+    if (aparea) free ((char *)aparea);
+    if (apsky) free ((char *)apsky);
     wcsfree (wcs);
     free (header);
-    if (imsearch)
+    if (image != NULL)
 	free (image);
     return;
 }
@@ -945,4 +1100,11 @@ char	*filename;	/* FITS or IRAF file filename */
  * May 13 2015	Print two decimal place, not integer, pixel coordinates
  *
  * Jun 24 2016	Fix sprintf of headline after Ole Streicher
+ *
+ * Oct 18 2026	Add -y to list neighbor count and nearest star distance
+ * Oct 18 2026	List bkgmesh and bkgfile parameters in usage
+ * Oct 18 2026	Add -j <n> to search image strips in n processes
+ * Oct 18 2026	Add -A and -B for multiple-aperture photometry with PhotStars()
+ *
+ * Oct 19 2026	Copy image for photometry with a size_t size; report if it fails
  */
@@ -1,5 +1,5 @@
 /* File imwcs.c
- * April 6, 2007
+ * October 18, 2026
  * By Jessica Mink, after Elwood Downey
  * (Harvard-Smithsonian Center for Astrophysics)
  * Send bug reports to jmink@cfa.harvard.edu
@@ -83,6 +83,10 @@ extern void setfrac();
 extern void setrefpix();
 extern void setwcsproj();
 extern void setfitplate();
+extern void setfitsip();
+extern void setnrefine();
+extern void setquadmatch();
+extern void setfitamoeba();
 extern void setproj();
 extern void setiterate();
 extern void setiteratet();
@@ -318,10 +322,25 @@ char **av;
 		    while ((c1 = *str1) != 0) {
     		    switch (c1) {
 	
+			case 'a':	/* Fit with simplex instead of least squares */
+			    setfitamoeba (1);
+			    break;
+
 			case 'b':	/* Bin star matches for speed */
 			    setbin (1);
 			    break;
 
+			case 'd':	/* Fit SIP distortion of this order */
+			    c2 = *(str1+1);
+			    if ((int)c2 > 49 && (int)c2 < 58) {
+				i = (int) c2 - 48;
+				str1++;
+				}
+			    else
+				i = 3;
+    			    setfitsip (i);
+			    break;
+
 			case 'i':	/* Iterate fit: new area */
 			    c2 = *(str1+1);
 			    if ((int)c2 > 47 && (int)c2 < 58) {
@@ -344,6 +363,10 @@ char **av;
     			    setnfiterate (i);
 			    break;
 	
+			case 'q':	/* Match star quads, ignoring scale and rotation */
+    			    setquadmatch (1);
+			    break;
+	
 			case 'r':	/* Recenter fit and rerun */
     			    setrecenter (1);
 			    break;
@@ -363,10 +386,21 @@ char **av;
     			    setiteratet (i);
 			    break;
 	
+			case 'o':	/* Reject outliers and refit */
+			    c2 = *(str1+1);
+			    if ((int)c2 > 47 && (int)c2 < 58) {
+				i = (int) c2 - 48;
+				str1++;
+				}
+			    else
+				i = 5;
+    			    setnrefine (i);
+			    break;
+	
 			case 'p':	/* Use polynomial WCS */
 			    c2 = *(str1+1);
 			    if ((int)c2 > 47 && (int)c2 < 58) {
-				i = (int) c2;
+				i = (int) c2 - 48;
 				str1++;
 				}
 			    else
@@ -592,7 +626,7 @@ char    *command;
     fprintf(stderr,"  -n: list of parameters to fit (12345678; negate for refinement)\n");
     fprintf(stderr,"  -o: name for output image, no argument to overwrite\n");
     fprintf(stderr,"  -p: initial plate scale in arcsec per pixel (default 0)\n");
-    fprintf(stderr,"  -q: <i>terate, <r>ecenter, <s>igma clip, <p>olynomial, <t>olerance reduce, <w>do not rotate WCS, <n>more params\n");
+    fprintf(stderr,"  -q: <i>terate, <r>ecenter, <s>igma clip, <p>olynomial, <t>olerance reduce, <w>do not rotate WCS, <n>more params, <a>moeba fit, <d>SIP distortion order, <o>utlier rejection rounds, <q>uad match without initial scale and rotation\n");
     fprintf(stderr,"  -r: rotation angle in degrees before fitting (default 0)\n");
     fprintf(stderr,"  -s: use this fraction extra stars (default 1.0)\n");
     fprintf(stderr,"  -t: offset tolerance in pixels (default %d)\n", PIXDIFF);
@@ -983,4 +1017,10 @@ char	*name;		/* FITS or IRAF image filename */
  *
  * Jan 10 2007	Call setgsclass() instead of setclass()
  * Apr  6 2007	Add -q w to not rotate initial image WCS
+ *
+ * Oct 18 2026	Add -q a to fit with amoeba() simplex instead of least squares
+ * Oct 18 2026	Fix -q p number of polynomial coefficients
+ * Oct 18 2026	Add -q d to fit SIP distortion polynomials
+ * Oct 18 2026	Add -q o to reject outlying matches and refit
+ * Oct 18 2026	Add -q q to match star quads without initial scale and rotation
  */
@@ -1,9 +1,9 @@
 /* File keyhead.c
- * August 19, 2009
+ * October 18, 2026
  * By Jessica Mink Harvard-Smithsonian Center for Astrophysics)
  * Send bug reports to jmink@cfa.harvard.edu
 
-   Copyright (C) 1997-2009
+   Copyright (C) 1997-2026
    Smithsonian Astrophysical Observatory, Cambridge, MA USA
 
    This program is free software; you can redistribute it and/or
@@ -113,6 +113,13 @@ char **av;
 		    newimage = 1;
 		    break;
 
+		case 'p':	/* Reserve spare header blocks when header grows */
+		    if (ac < 2)
+			usage();
+		    setfitsspare (atoi (*++av));
+		    ac--;
+		    break;
+
 		case 'r':	/* write to new file */
 		    replace = 1;
 		    break;
@@ -243,6 +250,7 @@ usage ()
     fprintf(stderr,"  -h: save procesing in HISTORY keyword in files\n");
     fprintf(stderr,"  -k: save procesing in KEYHEAD keyword in files\n");
     fprintf(stderr,"  -n: write new file\n");
+    fprintf(stderr,"  -p num: reserve num spare header blocks if header grows\n");
     fprintf(stderr,"  -r: replace value of 1st keyword with value of 2nd keyword\n");
     fprintf(stderr,"  -v: verbose\n");
     exit (1);
@@ -280,7 +288,6 @@ char	*kwd[];		/* Names and values of those keywords */
     int dquote = 34;
     int bitpix = 0;
     int naxis = 0;
-    int imageread = 0;
     char cval[24];
     int fdr, fdw, ipos, nbr, nbw, nchange;
     char history[128];
@@ -311,15 +318,6 @@ char	*kwd[];		/* Names and values of those keywords */
 	if ((header = fitsrhead (filename, &lhead, &nbhead)) != NULL) {
 	    hgeti4 (header,"NAXIS",&naxis);
 	    hgeti4 (header,"BITPIX",&bitpix);
-	    if (naxis > 0 && bitpix != 0) {
-		if ((image = fitsrfull (filename, nbhead, header)) == NULL) {
-		    if (verbose)
-			fprintf (stderr, "No FITS image in %s\n", filename);
-		    imageread = 0;
-		    }
-		else
-		    imageread = 1;
-		}
 	    }
 	else {
 	    fprintf (stderr, "Cannot read FITS file %s\n", filename);
@@ -588,13 +586,22 @@ char	*kwd[];		/* Names and values of those keywords */
 	    }
 	}
 
-    /* Rewrite header and data to a new image file */
-    else if (naxis > 0 && imageread) {
-	if (fitswimage (newname, header, image) > 0 && verbose)
+    /* If header is longer than original, move data down to make room */
+    else if (!newimage) {
+	if (!fitsgrowhead (newname, header)) {
+	    if (verbose)
+		printf ("%s: rewritten successfully.\n", newname);
+	    }
+	else if (verbose)
+	    printf ("%s could not be written.\n", newname);
+	}
+
+    /* Copy header and data to a new image file */
+    else if (naxis > 0) {
+	if (fitscimage (newname, header, filename) > 0 && verbose)
 	    printf ("%s: rewritten successfully.\n", newname);
 	else if (verbose)
 	    printf ("%s could not be written.\n", newname);
-	free (image);
 	}
 
     else {
@@ -669,4 +676,7 @@ char	*kwd[];		/* Names and values of those keywords */
  * Aug 19 2009	Fix bug to remove limit to the number of files on command line
  *
  * Sep  1 2011	Fix overflow bug by increasing size of history from 72 to 128
+ *
+ * Oct 18 2026	Do not read image; lengthen header in place with fitsgrowhead()
+ * Oct 18 2026	Add -p to reserve spare header blocks when header grows
  */
@@ -1,9 +1,9 @@
 /*** File libwcs/distort.c
- *** January 4, 2007
+ *** October 18, 2026
  *** By Jessica Mink, jmink@cfa.harvard.edu, 
  *** Based on code written by Jing Li, IPAC
  *** Harvard-Smithsonian Center for Astrophysics
- *** Copyright (C) 2004-2007
+ *** Copyright (C) 2004-2026
  *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
 
     This library is free software; you can redistribute it and/or
@@ -31,7 +31,9 @@
  * Purpose:	Convert focal plane coordinates to pixels and vice versa:
  * Subroutine:  distortinit (wcs, hstring) set distortion coefficients from FITS header
  * Subroutine:  DelDistort (header, verbose) delete distortion coefficients in FITS header
+ * Subroutine:  SetFITSDistort (header, wcs) set distortion coefficients in FITS header
  * Subroutine:	pix2foc (wcs, x, y, u, v) pixel coordinates -> focal plane coordinates
+ * Subroutine:	pix2focrow (wcs, u0, du, v, nu, x, y) row of pixels -> focal plane coordinates
  * Subroutine:	foc2pix (wcs, u, v, x, y) focal plane coordinates -> pixel coordinates
  * Subroutine:  setdistcode (wcs,ctype) sets distortion code from CTYPEi
  * Subroutine:  getdistcode (wcs) returns distortion code string for CTYPEi
@@ -43,6 +45,8 @@
 #include <string.h>
 #include "wcs.h"
 
+static int deldistkey();
+
 void
 distortinit (wcs, hstring)
 struct WorldCoor *wcs;  /* World coordinate system structure */
@@ -146,61 +150,14 @@ char *header;
 int verbose;
 
 {
-    char keyword[16];
     char str[32];
-    int i, j, m;
     int lctype;
     int n;
 
-    n = 0;
-
-    if (hgeti4 (header, "A_ORDER", &m)) {
-	for (i = 0; i <= m; i++) {
-	    for (j = 0; j <= m-i; j++) {
-		sprintf (keyword, "A_%d_%d", i, j);
-		hdel (header, keyword);
-		n++;
-		}
-	    }
-	hdel (header, "A_ORDER");
-	n++;
-	}
-
-    if (hgeti4 (header, "AP_ORDER", &m)) {
-	for (i = 0; i <= m; i++) {
-	    for (j = 0; j <= m-i; j++) {
-		sprintf (keyword, "AP_%d_%d", i, j);
-		hdel (header, keyword);
-		n++;
-		}
-	    }
-	hdel (header, "AP_ORDER");
-	n++;
-	}
-
-    if (hgeti4 (header, "B_ORDER", &m)) {
-	for (i = 0; i <= m; i++) {
-	    for (j = 0; j <= m-i; j++) {
-		sprintf (keyword, "B_%d_%d", i, j);
-		hdel (header, keyword);
-		n++;
-		}
-	    }
-	hdel (header, "B_ORDER");
-	n++;
-	}
-
-    if (hgeti4 (header, "BP_ORDER", &m)) {
-	for (i = 0; i <= m; i++) {
-	    for (j = 0; j <= m-i; j++) {
-		sprintf (keyword, "BP_%d_%d", i, j);
-		hdel (header, keyword);
-		n++;
-		}
-	    }
-	hdel (header, "BP_ORDER");
-	n++;
-	}
+    n = deldistkey (header, "A");
+    n = n + deldistkey (header, "AP");
+    n = n + deldistkey (header, "B");
+    n = n + deldistkey (header, "BP");
 
     if (n > 0 && verbose)
 	fprintf (stderr,"%d keywords deleted\n", n);
@@ -224,6 +181,92 @@ int verbose;
     return (n);
 }
 
+
+/* Delete one set of distortion coefficients and its order keyword */
+
+static int
+deldistkey (header, prefix)
+
+char *header;	/* FITS header */
+char *prefix;	/* Coefficient keyword prefix (A, B, AP, or BP) */
+
+{
+    char keyword[32];
+    int i, j, m, n;
+
+    n = 0;
+    snprintf (keyword, sizeof (keyword), "%s_ORDER", prefix);
+    if (hgeti4 (header, keyword, &m)) {
+	for (i = 0; i <= m; i++) {
+	    for (j = 0; j <= m-i; j++) {
+		snprintf (keyword, sizeof (keyword), "%s_%d_%d", prefix, i, j);
+		hdel (header, keyword);
+		n++;
+		}
+	    }
+	snprintf (keyword, sizeof (keyword), "%s_ORDER", prefix);
+	hdel (header, keyword);
+	n++;
+	}
+    return (n);
+}
+
+
+/* Set distortion coefficients in FITS header from WCS structure,
+ * replacing any which are already there.  CTYPEi are set by SetFITSWCS() */
+
+void
+SetFITSDistort (header, wcs)
+
+char *header;		/* FITS header */
+struct WorldCoor *wcs;	/* World coordinate system structure */
+
+{
+    char keyword[32];
+    int i, j, k, m;
+    char *prefix[4];
+    int order[4];
+    double *coeff[4];
+
+    (void) deldistkey (header, "A");
+    (void) deldistkey (header, "AP");
+    (void) deldistkey (header, "B");
+    (void) deldistkey (header, "BP");
+    if (wcs->distcode != DISTORT_SIRTF)
+	return;
+
+    prefix[0] = "A";
+    prefix[1] = "B";
+    prefix[2] = "AP";
+    prefix[3] = "BP";
+    order[0] = wcs->distort.a_order;
+    order[1] = wcs->distort.b_order;
+    order[2] = wcs->distort.ap_order;
+    order[3] = wcs->distort.bp_order;
+    coeff[0] = wcs->distort.a[0];
+    coeff[1] = wcs->distort.b[0];
+    coeff[2] = wcs->distort.ap[0];
+    coeff[3] = wcs->distort.bp[0];
+
+    for (k = 0; k < 4; k++) {
+	m = order[k];
+	if (m < 1)
+	    continue;
+	snprintf (keyword, sizeof (keyword), "%s_ORDER", prefix[k]);
+	hputi4 (header, keyword, m);
+	for (i = 0; i <= m; i++) {
+	    for (j = 0; j <= m-i; j++) {
+		if (coeff[k][i*DISTMAX + j] != 0.0) {
+		    snprintf (keyword, sizeof (keyword), "%s_%d_%d", prefix[k], i, j);
+		    hputnr8 (header, keyword, -15, coeff[k][i*DISTMAX + j]);
+		    }
+		}
+	    }
+	}
+    return;
+}
+
+
 void
 foc2pix (wcs, x, y, u, v)
 
@@ -349,6 +392,68 @@ double *x, *y;		/* Focal plane coordinates (returned) */
 }
 
 
+/* Convert a row of nu pixels starting at u0, du apart, at v to focal
+ * plane coordinates.  The polynomial in v for each power of u is summed
+ * once for the row, so each pixel takes only order multiply-adds per axis.
+ */
+
+void
+pix2focrow (wcs, u0, du, v, nu, x, y)
+
+struct WorldCoor *wcs;  /* World coordinate system structure */
+double	u0;		/* First image pixel horizontal coordinate */
+double	du;		/* Horizontal pixel coordinate increment */
+double	v;		/* Image pixel vertical coordinate of row */
+int	nu;		/* Number of pixels in row */
+double	*x, *y;		/* Focal plane coordinates (returned) */
+{
+    int m, n, i, j, k;
+    double sa[DISTMAX], sb[DISTMAX], sum, temp_u, temp_v;
+
+    /* If no distortion, return pixel positions unchanged */
+    if (wcs->distcode != DISTORT_SIRTF) {
+	for (i = 0; i < nu; i++) {
+	    x[i] = u0 + du * (double) i;
+	    y[i] = v;
+	    }
+	return;
+	}
+
+    /* Sum polynomial in v for each power of u once for the row */
+    m = wcs->distort.a_order;
+    n = wcs->distort.b_order;
+    temp_v = v - wcs->yrefpix;
+    for (j = 0; j <= m; j++) {
+	sum = wcs->distort.a[j][m-j];
+	for (k = m-j-1; k >= 0; k--)
+	    sum = temp_v * sum + wcs->distort.a[j][k];
+	sa[j] = sum;
+	}
+    for (j = 0; j <= n; j++) {
+	sum = wcs->distort.b[j][n-j];
+	for (k = n-j-1; k >= 0; k--)
+	    sum = temp_v * sum + wcs->distort.b[j][k];
+	sb[j] = sum;
+	}
+    sb[0] = sb[0] + temp_v;
+
+    /* Each pixel is then a polynomial in u alone */
+    for (i = 0; i < nu; i++) {
+	temp_u = u0 + du * (double) i - wcs->xrefpix;
+	sum = sa[m];
+	for (j = m-1; j >= 0; j--)
+	    sum = temp_u * sum + sa[j];
+	x[i] = temp_u + sum + wcs->xrefpix;
+	sum = sb[n];
+	for (j = n-1; j >= 0; j--)
+	    sum = temp_u * sum + sb[j];
+	y[i] = sum + wcs->yrefpix;
+	}
+
+    return;
+}
+
+
 /* SETDISTCODE -- Set WCS distortion code from CTYPEi in FITS header */
 
 void
@@ -404,4 +509,9 @@ struct WorldCoor *wcs;  /* World coordinate system structure */
  * Jan  4 2007	Declare header const char*
  *
  * Feb 25 2011	Change SIRTF to Spitzer (long overdue!)
+ *
+ * Oct 18 2026	Add SetFITSDistort() to write SIP coefficients to a FITS header
+ * Oct 18 2026	Add pix2focrow() to convert a row of pixels with per-row sums
+ *
+ * Oct 19 2026	Build SIP keyword names with snprintf() into a longer buffer
  */
@@ -1,8 +1,8 @@
 /* File wcstools/libwcs/fileutil.c
- * February 2, 2022
+ * October 18, 2026
  * By Jessica Mink, SAO Telescope Data Center
 
- * Copyright (C) 1999-2022
+ * Copyright (C) 1999-2026
  * Smithsonian Astrophysical Observatory, Cambridge, MA, USA
     This library is free software; you can redistribute it and/or
     modify it under the terms of the GNU Lesser General Public
@@ -73,6 +73,10 @@
  *		Get next token from tokenized string
  * Subroutine:	getoken (tokens, itok, token, maxchars)
  *		Get specified token from tokenized string
+ * Subroutine:	strtor8 (string, next)
+ *		Read a decimal number quickly, returning the next character
+ * Subroutine:	r8tostr (string, num, ndec)
+ *		Write a number with ndec decimal places quickly
  *
  ** Ranges
  *
@@ -121,6 +125,7 @@
 #include <sys/file.h>
 #include <errno.h>
 #include <string.h>
+#include <math.h>
 #include "fitsfile.h"
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -962,6 +967,175 @@ int	maxchars;	/* Maximum length of token */
     return (ltok);
 }
 
+/* Powers of ten which are exact as doubles */
+static double pow10r8[23] = {
+    1.0e0, 1.0e1, 1.0e2, 1.0e3, 1.0e4, 1.0e5, 1.0e6, 1.0e7, 1.0e8, 1.0e9,
+    1.0e10, 1.0e11, 1.0e12, 1.0e13, 1.0e14, 1.0e15, 1.0e16, 1.0e17, 1.0e18,
+    1.0e19, 1.0e20, 1.0e21, 1.0e22};
+
+
+/* STRTOR8 -- Read a decimal number from a string without strtod() when
+ * its digits and exponent fit exactly in a double, else with strtod() */
+
+double
+strtor8 (string, next)
+
+char	*string;	/* Character string starting with a number */
+char	**next;		/* Character after number (returned),
+			 * or string if there is no number */
+{
+    char *s;
+    double num;
+    int neg, nsig, ndig, nexp, iexp, eneg;
+
+    s = string;
+    while (*s == ' ' || *s == '\t')
+	s++;
+    neg = 0;
+    if (*s == '-') {
+	neg = 1;
+	s++;
+	}
+    else if (*s == '+')
+	s++;
+
+    /* Accumulate up to 15 significant digits, which are exact */
+    num = 0.0;
+    nsig = 0;
+    ndig = 0;
+    nexp = 0;
+    while (*s >= '0' && *s <= '9') {
+	if (nsig > 0 || *s != '0') {
+	    if (nsig++ > 14)
+		return (strtod (string, next));
+	    }
+	num = (num * 10.0) + (double) (*s++ - '0');
+	ndig++;
+	}
+    if (*s == '.') {
+	s++;
+	while (*s >= '0' && *s <= '9') {
+	    if (nsig > 0 || *s != '0') {
+		if (nsig++ > 14)
+		    return (strtod (string, next));
+		}
+	    num = (num * 10.0) + (double) (*s++ - '0');
+	    nexp--;
+	    ndig++;
+	    }
+	}
+    if (ndig == 0) {
+	if (next != NULL)
+	    *next = string;
+	return (0.0);
+	}
+
+    /* Exponent */
+    if (*s == 'e' || *s == 'E') {
+	char *se = s + 1;
+	eneg = 0;
+	if (*se == '-') {
+	    eneg = 1;
+	    se++;
+	    }
+	else if (*se == '+')
+	    se++;
+	if (*se >= '0' && *se <= '9') {
+	    iexp = 0;
+	    while (*se >= '0' && *se <= '9' && iexp < 10000)
+		iexp = (iexp * 10) + (*se++ - '0');
+	    if (*se >= '0' && *se <= '9')
+		return (strtod (string, next));
+	    nexp = eneg ? nexp - iexp : nexp + iexp;
+	    s = se;
+	    }
+	}
+
+    /* Scale by an exact power of ten, which rounds correctly, or let
+       strtod() do it */
+    if (nexp < -22 || nexp > 22)
+	return (strtod (string, next));
+    if (nexp < 0)
+	num = num / pow10r8[-nexp];
+    else if (nexp > 0)
+	num = num * pow10r8[nexp];
+    if (next != NULL)
+	*next = s;
+    if (neg)
+	return (-num);
+    else
+	return (num);
+}
+
+
+/* R8TOSTR -- Write a number with ndec decimal places into a string
+ * without sprintf() if it is small enough, returning its length.  The last
+ * digit may differ from sprintf() when the number is within a rounding
+ * error of halfway between two outputs. */
+
+int
+r8tostr (string, num, ndec)
+
+char	*string;	/* Character string (returned) */
+double	num;		/* Number */
+int	ndec;		/* Number of decimal places */
+{
+    double dnum, dhi;
+    unsigned int hi, lo;
+    char digits[32];
+    int nd, i, lstr;
+
+    /* Numbers whose scaled value is not an exact integer */
+    if (ndec < 0 || ndec > 9 || !(num > -1.0e9 && num < 1.0e9) ||
+	fabs (num) * pow10r8[ndec] > 1.0e13) {
+	if (ndec < 0)
+	    ndec = 0;
+	return (sprintf (string, "%.*f", ndec, num));
+	}
+
+    /* Round to an integer, then split into two 8-digit halves */
+    dnum = floor ((fabs (num) * pow10r8[ndec]) + 0.5);
+    dhi = floor (dnum / 1.0e8);
+    dnum = dnum - (dhi * 1.0e8);
+    if (dnum < 0.0) {
+	dhi = dhi - 1.0;
+	dnum = dnum + 1.0e8;
+	}
+    else if (dnum >= 1.0e8) {
+	dhi = dhi + 1.0;
+	dnum = dnum - 1.0e8;
+	}
+    hi = (unsigned int) dhi;
+    lo = (unsigned int) dnum;
+
+    /* Digits from the least significant, at least one before the point */
+    nd = 0;
+    for (i = 0; i < 8; i++) {
+	digits[nd++] = (char) ('0' + (lo % 10));
+	lo = lo / 10;
+	}
+    while (hi > 0) {
+	digits[nd++] = (char) ('0' + (hi % 10));
+	hi = hi / 10;
+	}
+    while (nd < ndec + 1)
+	digits[nd++] = '0';
+    while (nd > ndec + 1 && digits[nd-1] == '0')
+	nd--;
+
+    /* Keep the sign of negative numbers which round to zero, as printf() */
+    lstr = 0;
+    if (num < 0.0)
+	string[lstr++] = '-';
+    for (i = nd - 1; i >= 0; i--) {
+	if (i == ndec - 1)
+	    string[lstr++] = '.';
+	string[lstr++] = digits[i];
+	}
+    string[lstr] = (char) 0;
+    return (lstr);
+}
+
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -1752,4 +1926,6 @@ double	*a;	/* Vector containing coeffiecients */
  * Jan 20 2022	Separate subroutine list by topic at top of file
  * Feb  1 2022	Add putfilebuff() and agetl()
  * Feb  2 2022	Use token subroutines to parse value strings in agets()
+ *
+ * Oct 18 2026	Add strtor8() and r8tostr() for fast number parsing and output
  */
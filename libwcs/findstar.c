@@ -1,7 +1,7 @@
 /*** File libwcs/findstar.c
- *** June 24, 2016
+ *** October 18, 2026
  *** By Jessica Mink, after Elwood Downey
- *** Copyright (C) 1996-2016
+ *** Copyright (C) 1996-2026
  *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
 
     This library is free software; you can redistribute it and/or
@@ -30,6 +30,9 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #include "fitsfile.h"
 #include "wcs.h"
 #include "wcscat.h"
@@ -45,12 +48,22 @@ static double FindFlux ();
 static void mean2d();
 static void mean1d();
 static void rotstars();
+static int gridcell();
+static int MergeWorkers();
+static void bkgcells();
+static void bkgfilter();
+static double meshval();
+static int dcompare();
 extern void setminmatch();
 extern void setnitmax();
 extern void setminstars();
 extern void setminpmqual();
 extern void setminid();
 extern void setnxydec();
+extern void setnrefine();
+extern void setrefclip();
+extern void setquadcache();
+extern void setquadtol();
 
 /* Set input catalog for image stars */
 static char imcatname[256] = "";
@@ -62,6 +75,21 @@ char *cat;
 char *getimcat ()
 {return (imcatname); }
 
+static int bkgcell = 0;		/* Background mesh cell size, 0 for running stats */
+void setbkgmesh (cell)
+int cell;
+{ bkgcell = cell; return; }
+
+static char bkgfile[256] = "";	/* File for background mesh FITS image */
+void setbkgfile (file)
+char *file;
+{ strncpy (bkgfile, file, 255); if (bkgcell < 1) bkgcell = BKGCELL; return; }
+
+static int nfworkers = 1;	/* Number of processes searching image strips */
+void setnworkers (nworkers)
+int nworkers;
+{ nfworkers = (nworkers < 1) ? 1 : nworkers; return; }
+
 static int nspix = NSTATPIX;	/* Stats are computed for +- this many pixels */
 void setnspix (nsp)
 int nsp;
@@ -158,19 +186,31 @@ int	zap;		/* If 1, set star to background after reading */
     int nstars;
     double minll;
     int bitpix;
-    int w, h, ilp, irp, i, idx, idy;
+    int w, h, ilp, irp, i;
     int x, y, x1, x2, y1, y2;
     double xai, yai, bai;
     double minsig, sigma;
     double *svec, *svb, *sv, *sv1, *sv2, *svlim;
+    double *dimage;		/* Image pixels scaled to double */
+    double *bkgrow = NULL;	/* Background level along row from mesh */
+    double *rmsrow = NULL;	/* Noise level along row from mesh */
+    struct BkgMesh *mesh = NULL; /* Background mesh, if not running stats */
     double rmax;
     double bz, bs;		/* Pixel value scaling */
-    int *ixa, *iya;
     int lwidth;
     int nextline;
     int xborder1, xborder2, yborder1, yborder2;
     char trimsec[32];
     int nstarmax = 100;
+    struct StarGrid *grid;	/* Grid of stars found so far */
+    int ys1, ys2;		/* First and last+1 rows whose stars are kept here */
+    int ysearch;		/* First row searched here */
+    int nover;			/* Rows searched above a strip before its first */
+    int nabove;			/* Number of stars found above first strip row */
+    int nrows, iworker, nwork;
+    int child = 0;		/* 1 if this is a worker process */
+    FILE **fwork = NULL;	/* Star lists returned by worker processes */
+    pid_t *pids = NULL;
     extern void setscale();
 
     hgeti4 (header,"NAXIS1", &w);
@@ -190,8 +230,6 @@ int	zap;		/* If 1, set star to background after reading */
     *ya = (double *) calloc (nstarmax, sizeof(double));
     *ba = (double *) calloc (nstarmax, sizeof(double));
     *pa = (int *) calloc (nstarmax, sizeof(int));
-    ixa = (int *) calloc (nstarmax, sizeof (int));
-    iya = (int *) calloc (nstarmax, sizeof (int));
 
     /* Read star list from file */
     if (imcatname[0] != 0) {
@@ -233,6 +271,24 @@ int	zap;		/* If 1, set star to background after reading */
 	yborder2 = fsborder;
 	}
 
+    /* Convert the image to doubles once so pixels are read without
+     * switching on BITPIX and rescaling for every access */
+    dimage = (double *) malloc ((size_t) w * (size_t) h * sizeof (double));
+    if (dimage == NULL) {
+	fprintf (stderr, "FindStars: cannot allocate %d x %d pixel buffer\n",
+		 w, h);
+	free (*xa);
+	free (*ya);
+	free (*ba);
+	free (*pa);
+	*xa = NULL;
+	*ya = NULL;
+	*ba = NULL;
+	*pa = NULL;
+	return (-1);
+	}
+    getvec (image, bitpix, bz, bs, 0, w * h, dimage);
+
     /* Allocate a buffer to hold one image line */
     svec = (double *) malloc (w * sizeof (double));
 
@@ -249,7 +305,7 @@ int	zap;		/* If 1, set star to background after reading */
     y2 = (h / 2) + rnoise;
     if (y2 > h)
 	y2 = h;
-    mean2d (image,bitpix,w,h,bz,bs, x1, x2, y1, y2, &noise, &nsigma);
+    mean2d (dimage, w, h, x1, x2, y1, y2, &noise, &nsigma);
     if (verbose)
 	fprintf (stderr, "FindStar mean is %.2f, sigma is %.2f\n",
 		 noise, nsigma);
@@ -277,15 +333,97 @@ int	zap;		/* If 1, set star to background after reading */
     else
 	minsig = nsigma;
 
+    /* Compute background and noise once over the whole image, if requested */
+    if (bkgcell > 0) {
+	mesh = BkgMeshInit (dimage, w, h, bkgcell);
+	if (mesh != NULL) {
+	    bkgrow = (double *) malloc (w * sizeof (double));
+	    rmsrow = (double *) malloc (w * sizeof (double));
+	    if (bkgrow == NULL || rmsrow == NULL) {
+		fprintf (stderr, "FindStars: Cannot allocate background rows\n");
+		if (bkgrow != NULL)
+		    free (bkgrow);
+		if (rmsrow != NULL)
+		    free (rmsrow);
+		BkgMeshFree (mesh);
+		mesh = NULL;
+		}
+	    }
+	if (mesh == NULL)
+	    fprintf (stderr, "FindStars: Using running background instead of mesh\n");
+	else {
+	    if (verbose)
+		fprintf (stderr, "FindStar background mesh is %d x %d %d-pixel cells\n",
+			 mesh->ncx, mesh->ncy, bkgcell);
+	    if (bkgfile[0] != (char) 0 && BkgMeshWrite (mesh, header, bkgfile) &&
+		verbose)
+		fprintf (stderr, "FindStar background written to %s\n", bkgfile);
+	    }
+	}
+
+    /* Index stars by position so duplicates are found without a full search */
+    grid = StarGridInit (w, h, minsep + 1);
+
+    /* Split rows into strips searched by separate processes, each with its
+     * own copy of the image to mark; the last strip is searched here.
+     * Each process also searches enough rows above its strip to find and
+     * mark the stars which a search of the whole image would already have
+     * found there: a seed walks up to maxw pixels to its peak, a star is
+     * measured and zapped out to 2*maxrad pixels, and stars within minsep
+     * pixels are duplicates.
+     * Stars found above the strip are dropped, as its neighbor keeps them. */
+    ys1 = yborder1;
+    ys2 = h - yborder1;
+    nwork = 0;
+    iworker = 0;
+    nrows = ys2 - ys1;
+    nover = 2 * (maxw + maxrad) + minsep + 1;
+    if (nfworkers > 1 && nrows > nfworkers * nover) {
+	fwork = (FILE **) calloc (nfworkers, sizeof (FILE *));
+	pids = (pid_t *) calloc (nfworkers, sizeof (pid_t));
+	fflush (stdout);
+	fflush (stderr);
+	for (iworker = 0; iworker < nfworkers - 1; iworker++) {
+	    if ((fwork[iworker] = tmpfile ()) == NULL) {
+		fprintf (stderr, "FindStars: Cannot create output for worker %d\n",
+			 iworker);
+		break;
+		}
+	    if ((pids[iworker] = fork ()) < 0) {
+		fprintf (stderr, "FindStars: Cannot start worker %d\n", iworker);
+		fclose (fwork[iworker]);
+		break;
+		}
+	    else if (pids[iworker] == 0) {
+		child = 1;
+		ys1 = yborder1 + (int) (((long) nrows * iworker) / nfworkers);
+		ys2 = yborder1 + (int) (((long) nrows * (iworker+1)) / nfworkers);
+		break;
+		}
+	    nwork++;
+	    }
+	if (!child)
+	    ys1 = yborder1 + (int) (((long) nrows * nwork) / nfworkers);
+	}
+
     /* Scan for stars based on surrounding local noise figure */
     nstars = 0;
+    nabove = 0;
+    ysearch = ys1 - nover;
+    if (ysearch < yborder1)
+	ysearch = yborder1;
     lwidth = w - xborder2 - xborder1 + 1;
-    for (y = yborder1; y < h-yborder1; y++) {
+    for (y = ysearch; y < ys2; y++) {
         int ipix = 0;
 
+	if (y == ys1)
+	    nabove = nstars;
+
 	/* Get one line of the image minus the noise-filled borders */
 	nextline = (w * (y-1)) + xborder1 - 1;
-	getvec (image, bitpix, bz, bs, nextline, lwidth, svb);
+	memcpy (svb, dimage + nextline, lwidth * sizeof (double));
+	if (mesh != NULL)
+	    BkgMeshRow (mesh, y, bkgrow, rmsrow);
 	if (verbose)
 	    fprintf (stderr, "Row %5d Col     0:\r", y+1);
 
@@ -295,8 +433,18 @@ int	zap;		/* If 1, set star to background after reading */
 	    if (verbose && x%100 == 0)
 		fprintf (stderr, "Row %5d Col %5d:\r", y+1, x+1);
 
+	    /* Take background and noise from mesh at this pixel */
+	    if (mesh != NULL) {
+		noise = bkgrow[x];
+		minsig = rmsrow[x];
+		sigma = (noise > 0.0) ? sqrt (noise) : 0.0;
+		if (minsig < sigma)
+		    minsig = sigma;
+		minll = noise + (starsig * minsig);
+		}
+
 	    /* Redo stats once for every several pixels */
-	    if (ispix > 0 && nspix > 0 && ipix++ % ispix == 0) {
+	    else if (ispix > 0 && nspix > 0 && ipix++ % ispix == 0) {
 
 		/* Find stats to the left */
 		ilp = x - (nspix / 2);
@@ -321,18 +469,17 @@ int	zap;		/* If 1, set star to background after reading */
 	    if (svec[x] > minll) {
 		int sx, sy, r, rf;
 		double b;
-		int i;
 
 		/* Ignore faint stars */
 		if (svec[x] < bmin)
 		    continue;
 
 		/* Ignore hot pixels */
-		if (!HotPixel (image,bitpix,w,h,bz,bs, x, y, minll))
+		if (!HotPixel (image,bitpix,bz,bs,dimage,w,h, x, y, minll))
 		    continue;
 
 		/* Walkabout to find brightest pixel in neighborhood */
-		if (BrightWalk (image,bitpix,w,h,bz,bs,x,y,maxw,&sx,&sy,&b) < 0)
+		if (BrightWalk (dimage,w,h, x, y, maxw, &sx, &sy, &b) < 0)
 		    continue;
 
 		/* Ignore really bright stars */
@@ -340,25 +487,13 @@ int	zap;		/* If 1, set star to background after reading */
 		    continue;
 
 		/* Skip star if already in list */
-		for (i = 0; i < nstars; i++) {
-		    idy = iya[i] - sy;
-		    if (idy < 0)
-			idy = -idy;
-		    if (idy <= minsep) {
-			idx = ixa[i] - sx;
-			if (idx < 0)
-			    idx = -idx;
-			if (idx <= minsep)
-			    break;
-			}
-		    }
-		if (i < nstars)
+		if (StarGridBox (grid, (double) sx, (double) sy,
+				 (double) minsep) > -1)
 		    continue;
 
 		/* Keep it if it is within the size range for stars */
 		rmax = maxrad;
-		r = starRadius (image,bitpix,w,h,bz,bs, sx, sy, rmax,
-				minsig, noise);
+		r = starRadius (dimage,w,h, sx, sy, rmax, minsig, noise);
 		if (r > minrad && r <= maxrad) {
 
 		/* Centroid star */
@@ -367,16 +502,14 @@ int	zap;		/* If 1, set star to background after reading */
 			nstarmax = nstarmax * 2;
 			*xa= (double *) realloc(*xa, nstarmax*sizeof(double));
 			*ya= (double *) realloc(*ya, nstarmax*sizeof(double));
-			ixa= (int *) realloc(ixa, nstarmax*sizeof(int));
-			iya= (int *) realloc(iya, nstarmax*sizeof(int));
 			*ba= (double *) realloc(*ba, nstarmax*sizeof(double));
 			*pa= (int *) realloc(*pa, nstarmax*sizeof(int));
 			}
-		    starCentroid (image,bitpix,w,h,bz,bs, sx, sy, &xai, &yai); 
+		    starCentroid (dimage,w,h, sx, sy, &xai, &yai);
 		    (*xa)[nstars-1] = xai;
 		    (*ya)[nstars-1] = yai;
-		    ixa[nstars-1] = (int) (xai + 0.5);
-		    iya[nstars-1] = (int) (yai + 0.5);
+		    (void) StarGridAdd (grid, (double) (int) (xai + 0.5),
+					(double) (int) (yai + 0.5));
 		    (*pa)[nstars-1] = (int) b;
 
 		/* Find radius of star for photometry */
@@ -384,11 +517,11 @@ int	zap;		/* If 1, set star to background after reading */
 		    sx = (int) (xai + 0.5);
 		    sy = (int) (yai + 0.5);
 		    rmax = 2.0 * (double) maxrad;
-		    rf = starRadius (image,bitpix,w,h,bz,bs, sx, sy, rmax,
-				    minsig, noise);
+		    rf = starRadius (dimage,w,h, sx, sy, rmax, minsig, noise);
 
 		/* Find flux from star */
-		    bai = FindFlux (image,bitpix,w,h,bz,bs,sx,sy,rf,noise,zap);
+		    bai = FindFlux (image,bitpix,bz,bs,dimage,w,h, sx, sy, rf,
+				    noise, zap);
 		    (*ba)[nstars-1] = bai;
 		    if (verbose) {
 			fprintf (stderr, "Row %5d Col %5d: ", y+1, x+1);
@@ -407,10 +540,59 @@ int	zap;		/* If 1, set star to background after reading */
 	    }
 	}
 
+    /* Drop stars found above this strip */
+    if (nabove > 0) {
+	nstars = nstars - nabove;
+	memmove (*xa, *xa + nabove, nstars * sizeof (double));
+	memmove (*ya, *ya + nabove, nstars * sizeof (double));
+	memmove (*ba, *ba + nabove, nstars * sizeof (double));
+	memmove (*pa, *pa + nabove, nstars * sizeof (int));
+	}
+
+    /* Return star list from worker process */
+    if (child) {
+	if (fwrite (&nstars, sizeof (int), 1, fwork[iworker]) < 1 ||
+	    fwrite (*xa, sizeof (double), nstars, fwork[iworker]) < nstars ||
+	    fwrite (*ya, sizeof (double), nstars, fwork[iworker]) < nstars ||
+	    fwrite (*ba, sizeof (double), nstars, fwork[iworker]) < nstars ||
+	    fwrite (*pa, sizeof (int), nstars, fwork[iworker]) < nstars ||
+	    fflush (fwork[iworker]) != 0) {
+	    fprintf (stderr, "FindStars: Cannot write stars from worker %d\n",
+		     iworker);
+	    fflush (stderr);
+	    _exit (1);
+	    }
+	fflush (stderr);
+	_exit (0);
+	}
+
+    /* Add stars from worker processes, merging those found across seams */
+    if (nwork > 0) {
+	nstars = MergeWorkers (fwork, pids, nwork, w, h, xa, ya, ba, pa,
+			       nstars);
+	if (nstars < 0) {
+	    free (*xa);
+	    free (*ya);
+	    free (*ba);
+	    free (*pa);
+	    *xa = NULL;
+	    *ya = NULL;
+	    *ba = NULL;
+	    *pa = NULL;
+	    }
+	else if (verbose)
+	    fprintf (stderr, "FindStars: %d stars from %d processes\n",
+		     nstars, nwork + 1);
+	}
+    if (fwork != NULL) {
+	free (fwork);
+	free (pids);
+	}
+
     /* Turn fluxes into instrument magnitudes */
-    (void) FluxSortStars (*xa, *ya, *ba, *pa, nstars);
     if (nstars > 0) {
 	double *flux;
+	(void) FluxSortStars (*xa, *ya, *ba, *pa, nstars);
 	for (i = 0; i < nstars; i++) {
 	    flux = (*ba)+i;
 	    *flux = -2.5 * log10 (*flux);
@@ -418,24 +600,175 @@ int	zap;		/* If 1, set star to background after reading */
 	}
 
     free ((char *)svec);
+    free ((char *)dimage);
+    if (mesh != NULL) {
+	free (bkgrow);
+	free (rmsrow);
+	BkgMeshFree (mesh);
+	}
+    StarGridFree (grid);
     return (nstars);
 }
 
 
+/* Wait for worker processes and put their star lists, in strip order, ahead
+ * of the stars found in the last strip.  A star found in more than one strip,
+ * at the same peak counts within minsep pixels of where an earlier strip
+ * found it, is kept once, with the position and flux of the brighter
+ * measurement.  Return the number of stars kept, or -1 if a worker failed.
+ */
+
+static int
+MergeWorkers (fwork, pids, nwork, w, h, xa, ya, ba, pa, nstars)
+
+FILE	**fwork;	/* Star lists written by worker processes */
+pid_t	*pids;		/* Worker process IDs */
+int	nwork;		/* Number of worker processes */
+int	w;		/* Image width in pixels */
+int	h;		/* Image height in pixels */
+double	**xa, **ya;	/* X and Y coordinates of stars, arrays updated */
+double	**ba;		/* Fluxes of stars in counts, arrays updated */
+int	**pa;		/* Peak counts of stars, array updated */
+int	nstars;		/* Number of stars found by this process */
+
+{
+    double *xm, *ym, *bm;
+    int *pm, *nw;
+    int iwork, nmax, nm, is, js, is0, ns0, status, nfail;
+    struct StarGrid *grid;
+
+    /* Read star lists written by each worker */
+    nw = (int *) calloc (nwork + 1, sizeof (int));
+    nmax = nstars;
+    nfail = 0;
+    for (iwork = 0; iwork < nwork; iwork++) {
+	if (waitpid (pids[iwork], &status, 0) < 0) {
+	    fprintf (stderr, "FindStars: Cannot wait for worker %d\n", iwork);
+	    nfail++;
+	    }
+	else if (!WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+	    if (WIFSIGNALED (status))
+		fprintf (stderr, "FindStars: Worker %d killed by signal %d\n",
+			 iwork, WTERMSIG (status));
+	    else
+		fprintf (stderr, "FindStars: Worker %d exited with status %d\n",
+			 iwork, WEXITSTATUS (status));
+	    nfail++;
+	    }
+	rewind (fwork[iwork]);
+	if (fread (&nw[iwork], sizeof (int), 1, fwork[iwork]) < 1) {
+	    fprintf (stderr, "FindStars: No stars returned by worker %d\n",
+		     iwork);
+	    nw[iwork] = 0;
+	    nfail++;
+	    }
+	nmax = nmax + nw[iwork];
+	}
+    if (nfail > 0) {
+	for (iwork = 0; iwork < nwork; iwork++)
+	    fclose (fwork[iwork]);
+	free (nw);
+	return (-1);
+	}
+    if (nmax < 1)
+	nmax = 1;
+    xm = (double *) calloc (nmax, sizeof (double));
+    ym = (double *) calloc (nmax, sizeof (double));
+    bm = (double *) calloc (nmax, sizeof (double));
+    pm = (int *) calloc (nmax, sizeof (int));
+    nm = 0;
+    for (iwork = 0; iwork < nwork; iwork++) {
+	if (nw[iwork] > 0 &&
+	    (fread (xm+nm, sizeof (double), nw[iwork], fwork[iwork]) < nw[iwork] ||
+	     fread (ym+nm, sizeof (double), nw[iwork], fwork[iwork]) < nw[iwork] ||
+	     fread (bm+nm, sizeof (double), nw[iwork], fwork[iwork]) < nw[iwork] ||
+	     fread (pm+nm, sizeof (int), nw[iwork], fwork[iwork]) < nw[iwork])) {
+	    fprintf (stderr, "FindStars: Cannot read stars from worker %d\n",
+		     iwork);
+	    nfail++;
+	    }
+	nm = nm + nw[iwork];
+	fclose (fwork[iwork]);
+	}
+    if (nfail > 0) {
+	free (xm);
+	free (ym);
+	free (bm);
+	free (pm);
+	free (nw);
+	return (-1);
+	}
+    memcpy (xm+nm, *xa, nstars * sizeof (double));
+    memcpy (ym+nm, *ya, nstars * sizeof (double));
+    memcpy (bm+nm, *ba, nstars * sizeof (double));
+    memcpy (pm+nm, *pa, nstars * sizeof (int));
+    nw[nwork] = nstars;
+    nm = nm + nstars;
+
+    /* Merge stars already found by a process searching an earlier strip;
+     * the grid holds only stars from earlier strips, in the order kept */
+    grid = StarGridInit (w, h, minsep + 1);
+    nstars = 0;
+    is0 = 0;
+    for (iwork = 0; iwork <= nwork; iwork++) {
+	ns0 = nstars;
+	for (is = is0; is < is0 + nw[iwork]; is++) {
+	    js = StarGridBox (grid, (double) (int) (xm[is] + 0.5),
+			      (double) (int) (ym[is] + 0.5), (double) minsep);
+	    if (js > -1 && pm[js] == pm[is]) {
+		if (bm[is] > bm[js]) {
+		    xm[js] = xm[is];
+		    ym[js] = ym[is];
+		    bm[js] = bm[is];
+		    }
+		continue;
+		}
+	    xm[nstars] = xm[is];
+	    ym[nstars] = ym[is];
+	    bm[nstars] = bm[is];
+	    pm[nstars] = pm[is];
+	    nstars++;
+	    }
+	for (is = ns0; is < nstars; is++)
+	    (void) StarGridAdd (grid, (double) (int) (xm[is] + 0.5),
+				(double) (int) (ym[is] + 0.5));
+	is0 = is0 + nw[iwork];
+	}
+    StarGridFree (grid);
+    free (nw);
+
+    free (*xa);
+    free (*ya);
+    free (*ba);
+    free (*pa);
+    *xa = xm;
+    *ya = ym;
+    *ba = bm;
+    *pa = pm;
+    return (nstars);
+}
+
+
+/* Pixel at zero-based x, y in a scaled image buffer, 0 if off the image */
+#define FSPIX(im,w,h,x,y) (((x) < 0 || (x) >= (w) || (y) < 0 || (y) >= (h)) ?\
+			   0.0 : (im)[((y) * (w)) + (x)])
+
+
 /* Check pixel at x/y for being "hot", ie, a pixel surrounded by noise.
  * If any are greater than pixel at x/y then return -1.
  * Else set the pixel at x/y to llimit and return 0.
  */
 
 static int
-HotPixel (image, bitpix, w, h, bz, bs, x, y, llimit)
+HotPixel (image, bitpix, bz, bs, dimage, w, h, x, y, llimit)
 
 char	*image;		/* Image array origin pointer */
 int	bitpix;		/* Bits per pixel, negative for floating point or unsigned int */
-int	w;		/* Image width in pixels */
-int	h;		/* Image height in pixels */
 double	bz;		/* Zero point for pixel scaling */
 double	bs;		/* Scale factor for pixel scaling */
+double	*dimage;	/* Scaled copy of image */
+int	w;		/* Image width in pixels */
+int	h;		/* Image height in pixels */
 int	x, y;
 double	llimit;
 
@@ -443,40 +776,27 @@ double	llimit;
     double pix1, pix2, pix3;
 
     /* Check for hot row */
-    pix1 = getpix (image,bitpix,w,h,bz,bs,x-1,y-1);
-    pix2 = getpix (image,bitpix,w,h,bz,bs,x,y-1);
-    pix3 = getpix (image,bitpix,w,h,bz,bs,x+1,y-1);
+    pix1 = FSPIX (dimage,w,h,x-1,y-1);
+    pix2 = FSPIX (dimage,w,h,x,y-1);
+    pix3 = FSPIX (dimage,w,h,x+1,y-1);
     if (pix1 > llimit || pix2 > llimit || pix3 > llimit)
 	return (-1);
-    pix1 = getpix (image,bitpix,w,h,bz,bs,x-1,y+1);
-    pix2 = getpix (image,bitpix,w,h,bz,bs,x,y+1);
-    pix3 = getpix (image,bitpix,w,h,bz,bs,x+1,y+1);
-    if (pix1 > llimit || pix2 > llimit || pix3 > llimit)
-	return (-1);
-
-    /* Check for hot column */
-    pix1 = getpix (image,bitpix,w,h,bz,bs,x-1,y-1);
-    pix2 = getpix (image,bitpix,w,h,bz,bs,x-1,y);
-    pix3 = getpix (image,bitpix,w,h,bz,bs,x-1,y+1);
-    if (pix1 > llimit || pix2 > llimit || pix3 > llimit)
-	return (-1);
-    pix1 = getpix (image,bitpix,w,h,bz,bs,x+1,y-1);
-    pix2 = getpix (image,bitpix,w,h,bz,bs,x+1,y);
-    pix3 = getpix (image,bitpix,w,h,bz,bs,x+1,y+1);
+    pix1 = FSPIX (dimage,w,h,x-1,y+1);
+    pix2 = FSPIX (dimage,w,h,x,y+1);
+    pix3 = FSPIX (dimage,w,h,x+1,y+1);
     if (pix1 > llimit || pix2 > llimit || pix3 > llimit)
 	return (-1);
 
     /* Check for hot pixel */
-    pix1 = getpix (image,bitpix,w,h,bz,bs,x-1,y);
-    pix3 = getpix (image,bitpix,w,h,bz,bs,x+1,y);
-    if (pix1 > llimit || pix3 > llimit)
-	return (-1);
-    pix1 = getpix (image,bitpix,w,h,bz,bs,x,y-1);
-    pix3 = getpix (image,bitpix,w,h,bz,bs,x,y+1);
+    pix1 = FSPIX (dimage,w,h,x-1,y);
+    pix3 = FSPIX (dimage,w,h,x+1,y);
     if (pix1 > llimit || pix3 > llimit)
 	return (-1);
 
+    /* Set pixel in image, then copy it back as the image type stores it */
     putpix (image, bitpix, w, h, bz, bs, x, y, llimit);
+    if (x >= 0 && x < w && y >= 0 && y < h)
+	dimage[(y * w) + x] = getpix (image, bitpix, w, h, bz, bs, x, y);
     return (0);
 }
 
@@ -487,14 +807,11 @@ double	llimit;
  */
 
 static int
-starRadius (imp, bitpix, w, h, bz, bs, x0, y0, rmax, minsig, background)
+starRadius (dimage, w, h, x0, y0, rmax, minsig, background)
 
-char	*imp;		/* Image array origin pointer */
-int	bitpix;		/* Bits per pixel, negative for floating point or unsigned int */
+double	*dimage;	/* Scaled image pixels */
 int	w;		/* Image width in pixels */
 int	h;		/* Image height in pixels */
-double	bz;		/* Zero point for pixel scaling */
-double	bs;		/* Scale factor for pixel scaling */
 int	x0, y0;		/* Coordinates of center pixel of star */
 double	rmax;		/* Maximum allowable radius of star */
 double	minsig;		/* Minimum level for signal */
@@ -502,7 +819,7 @@ double	background;	/* Mean background level */
 
 {
     int r, irmax;
-    double dp, sum, mean;
+    double sum, mean;
     int xyrr, yrr, np;
     int inrr, outrr;
     int x, y;
@@ -523,8 +840,7 @@ double	background;	/* Mean background level */
 	    for (x = -r; x <= r; x++) {
 		xyrr = x*x + yrr;
 		if (xyrr >= inrr && xyrr < outrr) {
-		    dp = getpix (imp,bitpix,w,h,bz,bs,x0+x,y0+y);
-		    sum += dp;
+		    sum += FSPIX (dimage,w,h,x0+x,y0+y);
 		    np++;
 		    }
 		}
@@ -541,14 +857,11 @@ double	background;	/* Mean background level */
 /* Compute the fine location of the star peaking at [x0,y0] */
 
 static void
-starCentroid (imp, bitpix, w, h, bz, bs, x0, y0, xp, yp)
+starCentroid (dimage, w, h, x0, y0, xp, yp)
 
-char	*imp;
-int	bitpix;
+double	*dimage;	/* Scaled image pixels */
 int	w;
 int	h;
-double	bz;		/* Zero point for pixel scaling */
-double	bs;		/* Scale factor for pixel scaling */
 int	x0, y0;
 double	*xp, *yp;
 
@@ -559,16 +872,16 @@ double	*xp, *yp;
      * see Bevington, page 210
      */
 
-    p1 = getpix (imp,bitpix,w,h,bz,bs,x0-1,y0);
-    p2 = getpix (imp,bitpix,w,h,bz,bs,x0,y0);
+    p1 = FSPIX (dimage,w,h,x0-1,y0);
+    p2 = FSPIX (dimage,w,h,x0,y0);
     p22 = 2*p2;
-    p3 = getpix (imp,bitpix,w,h,bz,bs,x0+1,y0);
+    p3 = FSPIX (dimage,w,h,x0+1,y0);
     d = p3 - p22 + p1;
     *xp = (d == 0) ? x0 : x0 + 0.5 - (p3 - p2)/d;
     *xp = *xp + 1.0;
 
-    p1 = getpix (imp,bitpix,w,h,bz,bs,x0,y0-1);
-    p3 = getpix (imp,bitpix,w,h,bz,bs,x0,y0+1);
+    p1 = FSPIX (dimage,w,h,x0,y0-1);
+    p3 = FSPIX (dimage,w,h,x0,y0+1);
     d = p3 - p22 + p1;
     *yp = (d == 0) ? y0 : y0 + 0.5 - (p3 - p2)/d;
     *yp = *yp + 1.0;
@@ -583,14 +896,11 @@ static int dx[8]={1,0,-1,1,-1,1,0,-1};
 static int dy[8]={1,1,1,0,0,-1,-1,-1};
 
 static int
-BrightWalk (image, bitpix, w, h, bz, bs, x0, y0, maxr, xp, yp, bp)
+BrightWalk (dimage, w, h, x0, y0, maxr, xp, yp, bp)
 
-char	*image;
-int	bitpix;
+double	*dimage;	/* Scaled image pixels */
 int	w;
 int	h;
-double	bz;		/* Zero point for pixel scaling */
-double	bs;		/* Scale factor for pixel scaling */
 int	x0;
 int	y0;
 int	maxr;
@@ -604,7 +914,7 @@ double	*bp;
     int x, y, x1, y1, i, xa, ya;
 
     /* start by assuming seed point is brightest */
-    b = getpix (image,bitpix,w,h,bz,bs, x0,y0);
+    b = FSPIX (dimage,w,h, x0,y0);
     x = x0;
     y = y0;
     xa = x0;
@@ -620,7 +930,7 @@ double	*bp;
 	for (i = 0; i < 8; i++) {
 	    x1 = x + dx[i];
 	    y1 = y + dy[i];
-	    tmpb = getpix (image,bitpix,w,h,bz,bs, x1, y1);
+	    tmpb = FSPIX (dimage,w,h, x1, y1);
 	    if (tmpb >= newb) {
 		if (x1 == xa && y1 == ya)
 		    break;
@@ -655,14 +965,11 @@ double	*bp;
  */
 
 static void
-mean2d (image, bitpix, w, h, bz, bs, x1, x2, y1, y2, mean, sigma)
+mean2d (dimage, w, h, x1, x2, y1, y2, mean, sigma)
 
-char	*image;
-int	bitpix;
+double	*dimage;	/* Scaled image pixels */
 int	w;
 int	h;
-double	bz;		/* Zero point for pixel scaling */
-double	bs;		/* Scale factor for pixel scaling */
 int	x1,x2;
 int	y1, y2;
 double	*mean;
@@ -672,6 +979,7 @@ double	*sigma;
     double p, pmin, pmax;
     double pmean = 0.0;
     double sd = 0.0;
+    double *drow;
     int x, y;
     int i;
     double sum;
@@ -688,17 +996,17 @@ double	*sigma;
     /* Compute mean */
 	if (i == 0) {
 	    for (y = y1; y < y2; y++) {
-		for (x = x1; x < x2; x++) {
-		    p = getpix (image,bitpix,w,h,bz,bs, x, y);
-		    sum += p;
-		    npix++;
-		    }
+		drow = dimage + (y * w);
+		for (x = x1; x < x2; x++)
+		    sum += drow[x];
+		npix += x2 - x1;
 		}
 	    }
 	else {
 	    for (y = y1; y < y2; y++) {
+		drow = dimage + (y * w);
 		for (x = x1; x < x2; x++) {
-		    p = getpix (image,bitpix,w,h,bz,bs, x, y);
+		    p = drow[x];
 		    if (p > pmin && p < pmax) {
 			sum += p;
 			npix++;
@@ -713,8 +1021,9 @@ double	*sigma;
 	npix = 0;
 	sum = 0.0;
 	for (y = y1; y < y2; y++) {
+	    drow = dimage + (y * w);
 	    for (x = x1; x < x2; x++) {
-		p = getpix (image,bitpix,w,h,bz,bs, x, y);
+		p = drow[x];
 		if (p > pmin && p < pmax) {
 		    sum += fabs (p - pmean);
 		    npix++;
@@ -802,14 +1111,15 @@ double *sigma;		/* Average deviation of pixels (returned) */
 /* Find total flux within a circular region minus a mean background level */
 
 static double
-FindFlux (image, bitpix, w, h, bz, bs, x0, y0, r, background, zap)
+FindFlux (image, bitpix, bz, bs, dimage, w, h, x0, y0, r, background, zap)
 
 char	*image;
 int	bitpix;
-int	w;
-int	h;
 double	bz;		/* Zero point for pixel scaling */
 double	bs;		/* Scale factor for pixel scaling */
+double	*dimage;	/* Scaled copy of image */
+int	w;
+int	h;
 int	x0;
 int	y0;
 int	r;
@@ -826,7 +1136,7 @@ int	zap;		/* If 1, set star to background after reading */
     if (x0-r < 0)
 	x1 = 0;
     x2 = r;
-    if (x0+r > 0)
+    if (x2 > w)
 	x2 = w;
 
 /* Keep Y within image */
@@ -834,7 +1144,7 @@ int	zap;		/* If 1, set star to background after reading */
     if (y0-r < 0)
 	y1 = 0;
     y2 = r;
-    if (y0+r > 0)
+    if (y2 > h)
 	y2 = h;
 
 /* Integrate circular region around a star */
@@ -844,12 +1154,16 @@ int	zap;		/* If 1, set star to background after reading */
 	    xxyy = x*x + yy;
 	    if (xxyy <= rr) {
 		xi = x0 + x;
-		yi = y0 + x;
-		dp = getpix (image, bitpix, w,h,bz,bs, xi, yi);
+		yi = y0 + y;
+		dp = FSPIX (dimage,w,h, xi, yi);
 		if (dp > background) {
 		    sum += dp - background;
-		    if (zap)
+		    if (zap) {
 		        putpix (image, bitpix, w,h,bz,bs, xi, yi,background);
+			if (xi < w && yi >= 0 && yi < h)
+			    dimage[(yi * w) + xi] = getpix (image, bitpix,
+							    w,h,bz,bs, xi, yi);
+			}
 		    }
 		}
 	    }
@@ -909,6 +1223,20 @@ char *parstring;
 	setminid ((int) atof (parvalue));
     else if (!strcmp (parname, "nxydec"))
 	setnxydec ((int) atof (parvalue));
+    else if (!strcmp (parname, "nrefine"))
+	setnrefine ((int) atof (parvalue));
+    else if (!strcmp (parname, "refclip"))
+	setrefclip (atof (parvalue));
+    else if (!strcmp (parname, "quadcache"))
+	setquadcache (parvalue);
+    else if (!strcmp (parname, "quadtol"))
+	setquadtol (atof (parvalue));
+    else if (!strcmp (parname, "nworkers"))
+	setnworkers ((int) atof (parvalue));
+    else if (!strcmp (parname, "bkgmesh"))
+	setbkgmesh ((int) atof (parvalue));
+    else if (!strcmp (parname, "bkgfile"))
+	setbkgfile (parvalue);
     else if (!strcmp (parname, "rnoise"))
 	setrnoise ((int) atof (parvalue));
     return;
@@ -1030,6 +1358,640 @@ int	h;	/* Original height of image */
     return;
 }
 
+/* Set up an empty grid of cell by cell pixel boxes covering a w by h image
+ * so that stars near a position can be found by checking only nearby cells.
+ */
+
+struct StarGrid *
+StarGridInit (w, h, cell)
+
+int	w;		/* Image width in pixels */
+int	h;		/* Image height in pixels */
+int	cell;		/* Width of grid cell in pixels */
+
+{
+    struct StarGrid *grid;
+    int i, ncell;
+
+    if (cell < 1)
+	cell = 1;
+    grid = (struct StarGrid *) calloc (1, sizeof (struct StarGrid));
+    grid->cell = cell;
+    grid->ncx = (w / cell) + 2;
+    grid->ncy = (h / cell) + 2;
+    ncell = grid->ncx * grid->ncy;
+    grid->head = (int *) malloc (ncell * sizeof (int));
+    for (i = 0; i < ncell; i++)
+	grid->head[i] = -1;
+    grid->nmax = 100;
+    grid->next = (int *) malloc (grid->nmax * sizeof (int));
+    grid->x = (double *) malloc (grid->nmax * sizeof (double));
+    grid->y = (double *) malloc (grid->nmax * sizeof (double));
+    grid->nstars = 0;
+    return (grid);
+}
+
+
+/* Return cell index for a position, clamped to the grid */
+
+static int
+gridcell (grid, x, y, icx, icy)
+
+struct StarGrid *grid;	/* Star position grid */
+double	x, y;		/* Image coordinates in pixels */
+int	*icx, *icy;	/* Cell column and row (returned) */
+
+{
+    int cx, cy;
+
+    cx = (int) floor (x / (double) grid->cell);
+    cy = (int) floor (y / (double) grid->cell);
+    if (cx < 0)
+	cx = 0;
+    else if (cx >= grid->ncx)
+	cx = grid->ncx - 1;
+    if (cy < 0)
+	cy = 0;
+    else if (cy >= grid->ncy)
+	cy = grid->ncy - 1;
+    *icx = cx;
+    *icy = cy;
+    return (cy * grid->ncx + cx);
+}
+
+
+/* Add a star to the grid and return its index */
+
+int
+StarGridAdd (grid, x, y)
+
+struct StarGrid *grid;	/* Star position grid */
+double	x, y;		/* Image coordinates in pixels */
+
+{
+    int ic, is, cx, cy;
+
+    if (grid->nstars >= grid->nmax) {
+	grid->nmax = grid->nmax * 2;
+	grid->next = (int *) realloc (grid->next, grid->nmax * sizeof (int));
+	grid->x = (double *) realloc (grid->x, grid->nmax * sizeof (double));
+	grid->y = (double *) realloc (grid->y, grid->nmax * sizeof (double));
+	}
+    is = grid->nstars++;
+    grid->x[is] = x;
+    grid->y[is] = y;
+    ic = gridcell (grid, x, y, &cx, &cy);
+    grid->next[is] = grid->head[ic];
+    grid->head[ic] = is;
+    return (is);
+}
+
+
+/* Return the index of a star within d pixels in both x and y of x,y,
+ * or -1 if there is none */
+
+int
+StarGridBox (grid, x, y, d)
+
+struct StarGrid *grid;	/* Star position grid */
+double	x, y;		/* Image coordinates of box center in pixels */
+double	d;		/* Half-width of box in pixels */
+
+{
+    int cx, cx1, cx2, cy, cy1, cy2, is;
+
+    (void) gridcell (grid, x - d, y - d, &cx1, &cy1);
+    (void) gridcell (grid, x + d, y + d, &cx2, &cy2);
+    for (cy = cy1; cy <= cy2; cy++) {
+	for (cx = cx1; cx <= cx2; cx++) {
+	    for (is = grid->head[cy*grid->ncx + cx]; is > -1; is = grid->next[is]) {
+		if (fabs (grid->x[is] - x) <= d && fabs (grid->y[is] - y) <= d)
+		    return (is);
+		}
+	    }
+	}
+    return (-1);
+}
+
+
+/* Return the number of other stars within r pixels of star is, and set
+ * dnear to the distance to the nearest other star, searching outward
+ * until one is found, or to 0 if there are no other stars */
+
+int
+StarGridNear (grid, is, r, dnear)
+
+struct StarGrid *grid;	/* Star position grid */
+int	is;		/* Index of star in grid */
+double	r;		/* Search radius in pixels */
+double	*dnear;		/* Distance to nearest other star (returned) */
+
+{
+    int cx, cy, cx0, cy0, ring, maxring, nring, js, n;
+    double x, y, dx, dy, r2, d2, dmin2;
+
+    x = grid->x[is];
+    y = grid->y[is];
+    r2 = r * r;
+    (void) gridcell (grid, x, y, &cx0, &cy0);
+    nring = (int) (r / (double) grid->cell) + 1;
+    maxring = grid->ncx;
+    if (grid->ncy > maxring)
+	maxring = grid->ncy;
+    dmin2 = -1.0;
+    n = 0;
+
+    /* Check square rings of cells until past the radius and a star is found
+     * closer than any star in a cell not yet checked could be */
+    for (ring = 0; ring <= maxring; ring++) {
+	if (ring > nring && dmin2 >= 0.0) {
+	    d2 = (double) ((ring - 1) * grid->cell);
+	    if (dmin2 <= d2 * d2)
+		break;
+	    }
+	for (cy = cy0 - ring; cy <= cy0 + ring; cy++) {
+	    if (cy < 0 || cy >= grid->ncy)
+		continue;
+	    for (cx = cx0 - ring; cx <= cx0 + ring; cx++) {
+		if (cx < 0 || cx >= grid->ncx)
+		    continue;
+		if (cy != cy0 - ring && cy != cy0 + ring &&
+		    cx != cx0 - ring && cx != cx0 + ring)
+		    continue;
+		for (js = grid->head[cy*grid->ncx + cx]; js > -1; js = grid->next[js]) {
+		    if (js == is)
+			continue;
+		    dx = grid->x[js] - x;
+		    dy = grid->y[js] - y;
+		    d2 = dx * dx + dy * dy;
+		    if (d2 <= r2)
+			n++;
+		    if (dmin2 < 0.0 || d2 < dmin2)
+			dmin2 = d2;
+		    }
+		}
+	    }
+	}
+    if (dmin2 < 0.0)
+	*dnear = 0.0;
+    else
+	*dnear = sqrt (dmin2);
+    return (n);
+}
+
+
+/* Free star position grid */
+
+void
+StarGridFree (grid)
+
+struct StarGrid *grid;	/* Star position grid */
+
+{
+    if (grid == NULL)
+	return;
+    free (grid->head);
+    free (grid->next);
+    free (grid->x);
+    free (grid->y);
+    free (grid);
+    return;
+}
+
+
+/* Compute a mesh of background levels and noise over boxes of about cell
+ * by cell pixels covering a w by h image.  Each cell gets the median and standard
+ * deviation of its pixels after iterative sigma clipping, and the mesh is
+ * then median-filtered over 3x3 cells to drop cells covered by bright stars.
+ * Sorting each cell takes most of the time of a search, so if nworkers > 1,
+ * bands of cell rows are computed by that many processes.
+ */
+
+struct BkgMesh *
+BkgMeshInit (dimage, w, h, cell)
+
+double	*dimage;	/* Scaled image pixels */
+int	w;		/* Image width in pixels */
+int	h;		/* Image height in pixels */
+int	cell;		/* Width of mesh cell in pixels */
+
+{
+    struct BkgMesh *mesh;
+    double *wt;
+    double u, t, t2, t3;
+    int x, i, nband, iband, nwork, ncells, status;
+    int *icy1 = NULL;		/* First cell row of each band */
+    FILE **fband = NULL;	/* Cell values returned by worker processes */
+    pid_t *pids = NULL;
+
+    if (cell < 4)
+	cell = 4;
+    mesh = (struct BkgMesh *) calloc (1, sizeof (struct BkgMesh));
+    if (mesh == NULL) {
+	fprintf (stderr, "BkgMeshInit: Cannot allocate background mesh\n");
+	return (NULL);
+	}
+    mesh->cell = cell;
+    mesh->w = w;
+    mesh->h = h;
+
+    /* Stretch cells to cover the image evenly so their centers are known */
+    mesh->ncx = (w + (cell / 2)) / cell;
+    if (mesh->ncx < 1)
+	mesh->ncx = 1;
+    mesh->ncy = (h + (cell / 2)) / cell;
+    if (mesh->ncy < 1)
+	mesh->ncy = 1;
+    mesh->bkg = (double *) calloc (mesh->ncx * mesh->ncy, sizeof (double));
+    mesh->rms = (double *) calloc (mesh->ncx * mesh->ncy, sizeof (double));
+    mesh->cbkg = (double *) calloc (mesh->ncx, sizeof (double));
+    mesh->crms = (double *) calloc (mesh->ncx, sizeof (double));
+    mesh->ix = (int *) malloc (w * sizeof (int));
+    mesh->wx = (double *) malloc (4 * w * sizeof (double));
+    if (mesh->bkg == NULL || mesh->rms == NULL || mesh->cbkg == NULL ||
+	mesh->crms == NULL || mesh->ix == NULL || mesh->wx == NULL) {
+	fprintf (stderr, "BkgMeshInit: Cannot allocate %d x %d cell mesh\n",
+		 mesh->ncx, mesh->ncy);
+	BkgMeshFree (mesh);
+	return (NULL);
+	}
+
+    /* Hand bands of cell rows to worker processes; the last is done here */
+    nband = nfworkers;
+    if (nband > mesh->ncy)
+	nband = mesh->ncy;
+    nwork = 0;
+    if (nband > 1) {
+	icy1 = (int *) calloc (nband + 1, sizeof (int));
+	for (iband = 0; iband <= nband; iband++)
+	    icy1[iband] = (mesh->ncy * iband) / nband;
+	fband = (FILE **) calloc (nband, sizeof (FILE *));
+	pids = (pid_t *) calloc (nband, sizeof (pid_t));
+	fflush (stdout);
+	fflush (stderr);
+	for (iband = 0; iband < nband - 1; iband++) {
+	    if ((fband[iband] = tmpfile ()) == NULL)
+		break;
+	    if ((pids[iband] = fork ()) < 0) {
+		fclose (fband[iband]);
+		break;
+		}
+	    else if (pids[iband] == 0) {
+		bkgcells (mesh, dimage, icy1[iband], icy1[iband+1]);
+		i = icy1[iband] * mesh->ncx;
+		ncells = (icy1[iband+1] - icy1[iband]) * mesh->ncx;
+		if (fwrite (mesh->bkg+i, sizeof (double), ncells, fband[iband]) < ncells ||
+		    fwrite (mesh->rms+i, sizeof (double), ncells, fband[iband]) < ncells ||
+		    fflush (fband[iband]) != 0)
+		    _exit (1);
+		_exit (0);
+		}
+	    nwork++;
+	    }
+	bkgcells (mesh, dimage, icy1[nwork], mesh->ncy);
+
+	/* Read each band back, computing it here if its worker failed */
+	for (iband = 0; iband < nwork; iband++) {
+	    i = icy1[iband] * mesh->ncx;
+	    ncells = (icy1[iband+1] - icy1[iband]) * mesh->ncx;
+	    if (waitpid (pids[iband], &status, 0) < 0 ||
+		!WIFEXITED (status) || WEXITSTATUS (status) != 0 ||
+		fseek (fband[iband], 0L, SEEK_SET) != 0 ||
+		fread (mesh->bkg+i, sizeof (double), ncells, fband[iband]) < ncells ||
+		fread (mesh->rms+i, sizeof (double), ncells, fband[iband]) < ncells) {
+		fprintf (stderr, "BkgMeshInit: Worker %d failed; computing rows here\n",
+			 iband);
+		bkgcells (mesh, dimage, icy1[iband], icy1[iband+1]);
+		}
+	    fclose (fband[iband]);
+	    }
+	free (icy1);
+	free (fband);
+	free (pids);
+	}
+    else
+	bkgcells (mesh, dimage, 0, mesh->ncy);
+
+    bkgfilter (mesh->bkg, mesh->ncx, mesh->ncy);
+    bkgfilter (mesh->rms, mesh->ncx, mesh->ncy);
+
+    /* Precompute cubic convolution cells and weights along a row */
+    for (x = 0; x < w; x++) {
+	u = ((((double) x + 0.5) * mesh->ncx) / (double) w) - 0.5;
+	i = (int) floor (u);
+	t = u - (double) i;
+	t2 = t * t;
+	t3 = t2 * t;
+	mesh->ix[x] = i - 1;
+	wt = mesh->wx + (4 * x);
+	wt[0] = 0.5 * (-t3 + (2.0 * t2) - t);
+	wt[1] = 0.5 * ((3.0 * t3) - (5.0 * t2) + 2.0);
+	wt[2] = 0.5 * ((-3.0 * t3) + (4.0 * t2) + t);
+	wt[3] = 0.5 * (t3 - t2);
+	}
+
+    return (mesh);
+}
+
+
+/* Set the clipped median and standard deviation of each mesh cell in rows
+ * icy1 through icy2-1 */
+
+static void
+bkgcells (mesh, dimage, icy1, icy2)
+
+struct BkgMesh *mesh;	/* Background mesh, cell values set */
+double	*dimage;	/* Scaled image pixels */
+int	icy1;		/* First row of cells to compute */
+int	icy2;		/* Last+1 row of cells to compute */
+
+{
+    double *cpix, *drow;
+    double sum, sumsq, med, sd, plo, phi;
+    int icx, icy, x, y, x1, x2, y1, y2, np, lo, hi, nlo, nhi, i, iter, ic;
+    int w = mesh->w;
+    int h = mesh->h;
+
+    cpix = (double *) malloc ((size_t) ((w / mesh->ncx) + 1) *
+			      (size_t) ((h / mesh->ncy) + 1) * sizeof (double));
+
+    for (icy = icy1; icy < icy2; icy++) {
+	y1 = (int) (((double) icy * h) / mesh->ncy);
+	y2 = (int) (((double) (icy + 1) * h) / mesh->ncy);
+	for (icx = 0; icx < mesh->ncx; icx++) {
+	    x1 = (int) (((double) icx * w) / mesh->ncx);
+	    x2 = (int) (((double) (icx + 1) * w) / mesh->ncx);
+
+	    /* Sort pixels so clipping only moves the ends of a range */
+	    np = 0;
+	    for (y = y1; y < y2; y++) {
+		drow = dimage + ((size_t) y * w);
+		for (x = x1; x < x2; x++)
+		    cpix[np++] = drow[x];
+		}
+	    qsort (cpix, np, sizeof (double), dcompare);
+
+	    lo = 0;
+	    hi = np;
+	    med = 0.0;
+	    sd = 0.0;
+	    for (iter = 0; iter < niterate && hi > lo; iter++) {
+		med = 0.5 * (cpix[lo + (hi-lo-1)/2] + cpix[lo + (hi-lo)/2]);
+		sum = 0.0;
+		sumsq = 0.0;
+		for (i = lo; i < hi; i++) {
+		    sum = sum + (cpix[i] - med);
+		    sumsq = sumsq + ((cpix[i] - med) * (cpix[i] - med));
+		    }
+		sum = sum / (double) (hi - lo);
+		sd = sumsq / (double) (hi - lo) - (sum * sum);
+		sd = (sd > 0.0) ? sqrt (sd) : 0.0;
+		plo = med - (BKGCLIP * sd);
+		phi = med + (BKGCLIP * sd);
+		for (nlo = lo; nlo < hi && cpix[nlo] < plo; nlo++);
+		for (nhi = hi; nhi > nlo && cpix[nhi-1] > phi; nhi--);
+		if (nlo == lo && nhi == hi)
+		    break;
+		lo = nlo;
+		hi = nhi;
+		}
+	    ic = (icy * mesh->ncx) + icx;
+	    mesh->bkg[ic] = med;
+	    mesh->rms[ic] = sd;
+	    }
+	}
+    free (cpix);
+    return;
+}
+
+
+/* Replace each mesh value by the median of it and its neighbors, using a
+ * window centered on the cell so that edges are not pulled inward */
+
+static void
+bkgfilter (mval, ncx, ncy)
+
+double	*mval;		/* Mesh values, ncx by ncy */
+int	ncx;		/* Number of cells in x */
+int	ncy;		/* Number of cells in y */
+
+{
+    double *mcopy, nb[9];
+    int icx, icy, jcx, jcy, nnb, dcx, dcy;
+
+    if (ncx < 3 && ncy < 3)
+	return;
+    mcopy = (double *) malloc (ncx * ncy * sizeof (double));
+    memcpy (mcopy, mval, ncx * ncy * sizeof (double));
+    for (icy = 0; icy < ncy; icy++) {
+	for (icx = 0; icx < ncx; icx++) {
+	    nnb = 0;
+	    dcx = (icx > 0 && icx < ncx - 1) ? 1 : 0;
+	    dcy = (icy > 0 && icy < ncy - 1) ? 1 : 0;
+	    for (jcy = icy - dcy; jcy <= icy + dcy; jcy++) {
+		for (jcx = icx - dcx; jcx <= icx + dcx; jcx++)
+		    nb[nnb++] = mcopy[(jcy * ncx) + jcx];
+		}
+	    qsort (nb, nnb, sizeof (double), dcompare);
+	    mval[(icy * ncx) + icx] = 0.5 * (nb[(nnb-1)/2] + nb[nnb/2]);
+	    }
+	}
+    free (mcopy);
+    return;
+}
+
+
+/* Return the ith of n mesh values spaced by stride, extrapolating linearly
+ * from the nearest two values if i is off the mesh */
+
+static double
+meshval (mval, n, stride, i)
+
+double	*mval;		/* First mesh value */
+int	n;		/* Number of mesh values */
+int	stride;		/* Spacing of mesh values */
+int	i;		/* Index of value to return */
+
+{
+    if (i >= 0 && i < n)
+	return (mval[i * stride]);
+    else if (n < 2)
+	return (mval[0]);
+    else if (i < 0)
+	return (mval[0] + (double) i * (mval[stride] - mval[0]));
+    else
+	return (mval[(n-1) * stride] + (double) (i - n + 1) *
+		(mval[(n-1) * stride] - mval[(n-2) * stride]));
+}
+
+
+/* Compare two doubles for qsort() */
+
+static int
+dcompare (d1, d2)
+
+const void *d1, *d2;
+
+{
+    double dd1 = *(double *)d1;
+    double dd2 = *(double *)d2;
+
+    if (dd1 < dd2)
+	return (-1);
+    else if (dd1 > dd2)
+	return (1);
+    else
+	return (0);
+}
+
+
+/* Interpolate background and noise along one image row from the mesh
+ * using cubic convolution between cell centers
+ */
+
+void
+BkgMeshRow (mesh, y, bkg, rms)
+
+struct BkgMesh *mesh;	/* Background mesh */
+int	y;		/* Zero-based image row */
+double	*bkg;		/* Background for each pixel in row (returned) */
+double	*rms;		/* Noise for each pixel in row (returned) */
+
+{
+    double *cbkg, *crms, *wt;
+    double v, t, t2, t3, wy[4], b, r;
+    int j, k, icx, ncx, ncy, x;
+
+    ncx = mesh->ncx;
+    ncy = mesh->ncy;
+    cbkg = mesh->cbkg;
+    crms = mesh->crms;
+
+    /* Interpolate each column of cells to this row */
+    v = ((((double) y + 0.5) * ncy) / (double) mesh->h) - 0.5;
+    j = (int) floor (v);
+    t = v - (double) j;
+    t2 = t * t;
+    t3 = t2 * t;
+    wy[0] = 0.5 * (-t3 + (2.0 * t2) - t);
+    wy[1] = 0.5 * ((3.0 * t3) - (5.0 * t2) + 2.0);
+    wy[2] = 0.5 * ((-3.0 * t3) + (4.0 * t2) + t);
+    wy[3] = 0.5 * (t3 - t2);
+    for (icx = 0; icx < ncx; icx++) {
+	b = 0.0;
+	r = 0.0;
+	for (k = 0; k < 4; k++) {
+	    b = b + (wy[k] * meshval (mesh->bkg+icx, ncy, ncx, j-1+k));
+	    r = r + (wy[k] * meshval (mesh->rms+icx, ncy, ncx, j-1+k));
+	    }
+	cbkg[icx] = b;
+	crms[icx] = r;
+	}
+
+    /* Interpolate along the row */
+    for (x = 0; x < mesh->w; x++) {
+	wt = mesh->wx + (4 * x);
+	b = 0.0;
+	r = 0.0;
+	for (k = 0; k < 4; k++) {
+	    b = b + (wt[k] * meshval (cbkg, ncx, 1, mesh->ix[x] + k));
+	    r = r + (wt[k] * meshval (crms, ncx, 1, mesh->ix[x] + k));
+	    }
+	bkg[x] = b;
+	rms[x] = (r > 0.0) ? r : 0.0;
+	}
+
+    return;
+}
+
+
+/* Write interpolated background and noise from the mesh to a FITS file
+ * as two planes of a 32-bit floating point image with the image WCS.
+ * Return 1 if successful, else 0.
+ */
+
+int
+BkgMeshWrite (mesh, header, filename)
+
+struct BkgMesh *mesh;	/* Background mesh */
+char	*header;	/* FITS header of image */
+char	*filename;	/* Name of FITS file to write */
+
+{
+    char *bhead, *hend;
+    float *bimage, *bp, *rp;
+    double *bkg, *rms;
+    int lhead, nbhead, lhead0, x, y, iwrite;
+    size_t npix;
+
+    /* Copy image header with room for new keywords */
+    if ((hend = ksearch (header, "END")) == NULL) {
+	fprintf (stderr, "BkgMeshWrite: No END in FITS header\n");
+	return (0);
+	}
+    nbhead = hend + 80 - header;
+    lhead = nbhead + FITSBLOCK;
+    bhead = (char *) calloc (1, lhead);
+    memcpy (bhead, header, nbhead);
+    lhead0 = gethlength (header);
+    hlength (bhead, lhead);
+    hputi4 (bhead, "BITPIX", -32);
+    hputi4 (bhead, "NAXIS", 3);
+    hputi4 (bhead, "NAXIS3", 2);
+    hdel (bhead, "BZERO");
+    hdel (bhead, "BSCALE");
+    hdel (bhead, "BLANK");
+    hputs (bhead, "BKGPLANE", "1=background 2=noise");
+    hputi4 (bhead, "BKGCELL", mesh->cell);
+    hputcom (bhead, "BKGCELL", "Background mesh cell size in pixels");
+
+    /* Fill background and noise planes */
+    npix = (size_t) mesh->w * (size_t) mesh->h;
+    bimage = (float *) malloc (2 * npix * sizeof (float));
+    bkg = (double *) malloc (mesh->w * sizeof (double));
+    rms = (double *) malloc (mesh->w * sizeof (double));
+    for (y = 0; y < mesh->h; y++) {
+	BkgMeshRow (mesh, y, bkg, rms);
+	bp = bimage + ((size_t) y * mesh->w);
+	rp = bp + npix;
+	for (x = 0; x < mesh->w; x++) {
+	    bp[x] = (float) bkg[x];
+	    rp[x] = (float) rms[x];
+	    }
+	}
+    free (bkg);
+    free (rms);
+
+    iwrite = fitswimage (filename, bhead, (char *) bimage);
+    if (iwrite < 1)
+	fitserr ();
+    free (bimage);
+    free (bhead);
+    hlength (header, lhead0);
+    return (iwrite > 0);
+}
+
+
+/* Free background mesh */
+
+void
+BkgMeshFree (mesh)
+
+struct BkgMesh *mesh;	/* Background mesh */
+
+{
+    if (mesh == NULL)
+	return;
+    free (mesh->bkg);
+    free (mesh->rms);
+    free (mesh->cbkg);
+    free (mesh->crms);
+    free (mesh->ix);
+    free (mesh->wx);
+    free (mesh);
+    return;
+}
+
 /* May 21 1996	Return peak flux in counts
  * May 22 1996	Add arguments so GETPIX and PUTPIX can check coordinates
  * Jun  6 1996	Change name from findStars to FindStars
@@ -1094,4 +2056,21 @@ int	h;	/* Original height of image */
  * Oct 19 2007	Fix pointers in trim section processing
  *
  * Jun 24 2016	Fixed bug in TRIMSEC parsing found by Ole Streicher
+ *
+ * Oct 18 2026	Add StarGrid subroutines to find stars near a position
+ * Oct 18 2026	Use StarGridBox() instead of list search to skip found stars
+ * Oct 18 2026	Read pixels from a scaled double copy of the image, not getpix()
+ * Oct 18 2026	Limit FindFlux() loops to the star's radius, not the whole image
+ * Oct 18 2026	Add BkgMesh subroutines for an interpolated background mesh
+ * Oct 18 2026	Use background mesh for thresholds if bkgmesh or bkgfile is set
+ * Oct 18 2026	Search strips of rows in parallel processes if nworkers > 1
+ * Oct 18 2026	Add nrefine and refclip to setparm() for imsetwcs.c
+ * Oct 18 2026	Add quadcache and quadtol to setparm() for quadmatch.c
+ *
+ * Oct 19 2026	Integrate FindFlux() over rows, not a diagonal; free star lists on error
+ * Oct 19 2026	Search rows above each worker strip; merge seam stars; check worker status
+ * Oct 19 2026	Compute bands of background mesh cell rows in nworkers processes
+ * Oct 19 2026	Drop unused variable from star candidate block
+ * Oct 19 2026	Declare flux pointer before sorting stars by flux, as C89 requires
+ * Oct 19 2026	Allocate BkgMeshRow() cell rows once in BkgMeshInit(); check mesh allocation
  */
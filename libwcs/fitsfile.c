@@ -1,8 +1,8 @@
 /*** File libwcs/fitsfile.c
- *** September 23, 2019
+ *** October 18, 2026
  *** By Jessica Mink, jmink@cfa.harvard.edu
  *** Harvard-Smithsonian Center for Astrophysics
- *** Copyright (C) 1996-2019
+ *** Copyright (C) 1996-2026
  *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
 
     This library is free software; you can redistribute it and/or
@@ -64,16 +64,25 @@
  *		Write FITS header and image as extension to file descriptor
  * fitscimage (filename, header, filename0)
  *		Write FITS header and copy FITS image
+ * fitscdata (fdout, fdin, nbytes)
+ *		Copy data between open files without converting it
  * fitswhead (filename, header)
  *		Write FITS header and keep file open for further writing 
  * fitswexhead (filename, header)
  *		Write FITS header only to FITS extension without writing data
+ * fitsgrowhead (filename, header)
+ *		Write longer FITS header in place, moving data down in file
+ * setfitsspare (nspare)
+ *		Set number of spare header blocks to reserve when writing
  * isfits (filename)
  *		Return 1 if file is a FITS file, else 0
  * fitsheadsize (header)
  *  		Return size of FITS header in bytes
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE	/* for copy_file_range() */
+#endif
 #include <stdlib.h>
 #ifndef VMS
 #include <unistd.h>
@@ -81,6 +90,7 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <sys/file.h>
+#include <sys/stat.h>
 #include <errno.h>
 #include <string.h>
 #include "fitsfile.h"
@@ -95,6 +105,14 @@ int inh;
 
 static off_t ibhead = 0;	/* Number of bytes read before header starts */
 
+static int fitsspare = 0;	/* Spare header blocks to reserve on write */
+void
+setfitsspare (nspare)
+int nspare;
+{fitsspare = nspare; return;}
+
+static char *fitspadhead();
+
 off_t
 getfitsskip()
 {return (ibhead);}
@@ -1677,7 +1695,14 @@ char	*image;		/* FITS image pixels */
     /* Write header to file */
     endhead = ksearch (header,"END") + 80;
     nbhead = endhead - header;
-    nbhw = write (fd, header, nbhead);
+    if (fitsspare > 0) {
+	nbhead = fitsheadsize (header) + (fitsspare * FITSBLOCK);
+	padding = fitspadhead (header, nbhead);
+	nbhw = write (fd, padding, nbhead);
+	free (padding);
+	}
+    else
+	nbhw = write (fd, header, nbhead);
     if (nbhw < nbhead) {
 	snprintf (fitserrmsg,79, "FITSWHDU:  wrote %d / %d bytes of header to file %s\n",
 		 nbhw, nbhead, filename);
@@ -1794,47 +1819,28 @@ char	*filename0;	/* Name of input FITS image file */
 {
     int fdout, fdin;
     int nbhead, nbimage, nblocks, bytepix;
-    int bitpix, naxis, naxis1, naxis2, nbytes, nbw, nbpad, nbwp;
+    int bitpix, naxis, naxisi, iaxis, nbytes, nbw, nbpad, nbwp;
     char *endhead, *lasthead, *padding;
-    char *image;	/* FITS image pixels */
     char *oldhead;	/* Input file image header */
     int nbhead0;	/* Length of input file image header */
     int lhead0;
-    int nbbuff, nbuff, ibuff, nbr, nbdata;
+    int nbdata;
+    char keyword[16];
 
     /* Compute size of image in bytes using relevant header parameters */
-    naxis = 1;
-    hgeti4 (header, "NAXIS", &naxis);
-    naxis1 = 1;
-    hgeti4 (header, "NAXIS1", &naxis1);
-    naxis2 = 1;
-    hgeti4 (header, "NAXIS2", &naxis2);
+    bitpix = 0;
     hgeti4 (header, "BITPIX", &bitpix);
     bytepix = bitpix / 8;
     if (bytepix < 0) bytepix = -bytepix;
-
-    /* If either dimension is one and image is 3-D, read all three dimensions */
-    if (naxis == 3 && (naxis1 ==1 || naxis2 == 1)) {
-	int naxis3;
-	hgeti4 (header,"NAXIS3",&naxis3);
-	nbimage = naxis1 * naxis2 * naxis3 * bytepix;
+    nbimage = bytepix;
+    naxis = 1;
+    hgeti4 (header, "NAXIS", &naxis);
+    for (iaxis = 1; iaxis <= naxis; iaxis++) {
+	sprintf (keyword, "NAXIS%d", iaxis);
+	naxisi = 1;
+	hgeti4 (header,keyword,&naxisi);
+	nbimage = nbimage * naxisi;
 	}
-    else
-	nbimage = naxis1 * naxis2 * bytepix;
-
-    nblocks = nbimage / FITSBLOCK;
-    if (nblocks * FITSBLOCK < nbimage)
-	nblocks = nblocks + 1;
-    nbytes = nblocks * FITSBLOCK;
-
-    /* Allocate image buffer */
-    nbbuff = FITSBLOCK * 100;
-    if (nbytes < nbbuff)
-	nbbuff = nbytes;
-    image = (char *) calloc (1, nbbuff);
-    nbuff = nbytes / nbbuff;
-    if (nbytes > nbuff * nbbuff)
-	nbuff = nbuff + 1;
 
     /* Read input file header */
     if ((oldhead = fitsrhead (filename0, &lhead0, &nbhead0)) == NULL) {
@@ -1846,15 +1852,12 @@ char	*filename0;	/* Name of input FITS image file */
     /* Find size of output header */
     nbhead = fitsheadsize (header);
 
-    /* If overwriting, be more careful if new header is longer than old */
+    /* If overwriting with a longer header, move the data down in place */
     if (!strcmp (filename, filename0) && nbhead > nbhead0) {
-	if ((image = fitsrimage (filename0, nbhead0, oldhead)) == NULL) {
-	    snprintf (fitserrmsg,79, "FITSCIMAGE:  cannot read image from file %s\n",
-		     filename0);
-	    free (oldhead);
+	free (oldhead);
+	if (fitsgrowhead (filename, header))
 	    return (0);
-	    }
-	return (fitswimage (filename, header, image));
+	return (nbimage);
 	}
     free (oldhead);
 
@@ -1896,17 +1899,25 @@ char	*filename0;	/* Name of input FITS image file */
 	    }
 	}
 
-    /* Pad header with spaces */
-    endhead = ksearch (header,"END") + 80;
-    lasthead = header + nbhead;
-    while (endhead < lasthead)
-	*(endhead++) = ' ';
+    /* Pad header with spaces, reserving spare blocks if requested */
+    if (fitsspare > 0) {
+	nbhead = nbhead + (fitsspare * FITSBLOCK);
+	lasthead = fitspadhead (header, nbhead);
+	nbw = write (fdout, lasthead, nbhead);
+	free (lasthead);
+	}
+    else {
+	endhead = ksearch (header,"END") + 80;
+	lasthead = header + nbhead;
+	while (endhead < lasthead)
+	    *(endhead++) = ' ';
+	nbw = write (fdout, header, nbhead);
+	}
 
     /* Write header to file */
-    nbw = write (fdout, header, nbhead);
     if (nbw < nbhead) {
 	snprintf (fitserrmsg, 79,"FITSCIMAGE:  wrote %d / %d bytes of header to file %s\n",
-		 nbw, nbytes, filename);
+		 nbw, nbhead, filename);
 	(void)close (fdout);
 	(void)close (fdin);
 	return (0);
@@ -1919,14 +1930,8 @@ char	*filename0;	/* Name of input FITS image file */
 	return (nbhead);
 	}
 
-    nbdata = 0;
-    for (ibuff = 0; ibuff < nbuff; ibuff++) {
-	nbr = read (fdin, image, nbbuff);
-	if (nbr > 0) {
-	    nbw = write (fdout, image, nbr);
-	    nbdata = nbdata + nbw;
-	    }
-	}
+    /* Copy data without reading it all into memory */
+    nbdata = (int) fitscdata (fdout, fdin, (off_t) nbimage);
 
     /* Write extra to make integral number of 2880-byte blocks */
     nblocks = nbdata / FITSBLOCK;
@@ -1942,9 +1947,9 @@ char	*filename0;	/* Name of input FITS image file */
     (void)close (fdout);
     (void)close (fdin);
 
-    if (nbw < nbimage) {
+    if (nbdata < nbimage) {
 	snprintf (fitserrmsg, 79, "FITSWIMAGE:  wrote %d / %d bytes of image to file %s\n",
-		 nbw, nbimage, filename);
+		 nbdata, nbimage, filename);
 	return (0);
 	}
     else
@@ -1952,6 +1957,71 @@ char	*filename0;	/* Name of input FITS image file */
 }
 
 
+/* FITSCDATA -- Copy nbytes bytes from the current position of one open
+ *		file to the current position of another, letting the kernel
+ *		move the data if possible, else using large buffered reads.
+ *		Return the number of bytes copied */
+
+off_t
+fitscdata (fdout, fdin, nbytes)
+
+int	fdout;		/* File descriptor of output file */
+int	fdin;		/* File descriptor of input file */
+off_t	nbytes;		/* Number of bytes to copy */
+
+{
+    char *buff;
+    off_t nbleft;
+    size_t nbbuff;
+    ssize_t nbr, nbw;
+
+    nbleft = nbytes;
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+    /* Copy within the kernel; fall through to read/write if not supported */
+    while (nbleft > 0) {
+	nbr = copy_file_range (fdin, NULL, fdout, NULL, (size_t) nbleft, 0);
+	if (nbr <= 0)
+	    break;
+	nbleft = nbleft - nbr;
+	}
+    if (nbleft == 0)
+	return (nbytes);
+#endif
+
+    /* Copy through a buffer of whole FITS blocks */
+    nbbuff = FITSBLOCK * 1024;
+    if (nbleft < (off_t) nbbuff)
+	nbbuff = (size_t) nbleft;
+    if (nbbuff < 1)
+	return (nbytes - nbleft);
+    if ((buff = (char *) malloc (nbbuff)) == NULL) {
+	snprintf (fitserrmsg,79, "FITSCDATA:  cannot allocate %d-byte buffer\n",
+		 (int) nbbuff);
+	return (nbytes - nbleft);
+	}
+    while (nbleft > 0) {
+	if (nbleft < (off_t) nbbuff)
+	    nbbuff = (size_t) nbleft;
+	nbr = read (fdin, buff, nbbuff);
+	if (nbr <= 0)
+	    break;
+	nbw = write (fdout, buff, (size_t) nbr);
+	if (nbw < nbr) {
+	    if (nbw > 0)
+		nbleft = nbleft - nbw;
+	    break;
+	    }
+	nbleft = nbleft - nbr;
+	}
+    free (buff);
+    if (nbleft > 0)
+	snprintf (fitserrmsg,79, "FITSCDATA:  copied %lld / %lld bytes\n",
+		 (long long) (nbytes - nbleft), (long long) nbytes);
+    return (nbytes - nbleft);
+}
+
+
 /* FITSWHEAD -- Write FITS header and keep file open for further writing */
 
 int
@@ -1990,12 +2060,19 @@ char	*header;	/* FITS image header */
 	nblocks = nblocks + 1;
     nbytes = nblocks * FITSBLOCK;
 
-    /* Pad header with spaces */
-    lasthead = header + nbytes;
-    while (endhead < lasthead)
-	*(endhead++) = ' ';
-    
-    nbw = write (fd, header, nbytes);
+    /* Pad header with spaces, reserving spare blocks if requested */
+    if (fitsspare > 0) {
+	nbytes = nbytes + (fitsspare * FITSBLOCK);
+	lasthead = fitspadhead (header, nbytes);
+	nbw = write (fd, lasthead, nbytes);
+	free (lasthead);
+	}
+    else {
+	lasthead = header + nbytes;
+	while (endhead < lasthead)
+	    *(endhead++) = ' ';
+	nbw = write (fd, header, nbytes);
+	}
     if (nbw < nbytes) {
 	fprintf (stderr, "FITSWHEAD:  wrote %d / %d bytes of header to file %s\n",
 		 nbw, nbytes, filename);
@@ -2093,6 +2170,158 @@ char	*header;	/* FITS image header */
 }
 
 
+/* FITSGROWHEAD -- Write a FITS header which is longer than the one in the
+ *		   file in place, moving the data and anything after it down
+ *		   by whole FITS blocks without reading it all into memory.
+ *		   Return 0 if successful, else -1 */
+
+int
+fitsgrowhead (filename, header)
+
+char	*filename;	/* Name of FITS image file with ,extension */
+char	*header;	/* FITS image header */
+
+{
+    int fd;
+    int nbhead, lhead, nbold, nbnew;
+    off_t offhead;	/* Offset of header in file */
+    off_t offdata;	/* Offset of data in file */
+    off_t nbshift;	/* Number of bytes by which to move data */
+    off_t offset, nbfile;
+    int moved = 0;
+    size_t nbbuff, nbmove;
+    ssize_t nbr, nbw;
+    char *oldheader, *newhead, *buff;
+    char *ext, cext;
+    struct stat filestat;
+
+    /* Find where the header and data are in the file */
+    fitsinherit = 0;
+    oldheader = fitsrhead (filename, &lhead, &nbhead);
+    if (oldheader == NULL) {
+	snprintf (fitserrmsg, 79, "FITSGROWHEAD:  file %s cannot be read\n", filename);
+	return (-1);
+	}
+    nbold = fitsheadsize (oldheader);
+    free (oldheader);
+    offhead = ibhead;
+    offdata = offhead + nbold;
+
+    /* If the new header fits into the old space, just overwrite it */
+    nbnew = fitsheadsize (header);
+    if (nbnew <= nbold)
+	return (fitswexhead (filename, header));
+    nbnew = nbnew + (fitsspare * FITSBLOCK);
+    nbshift = (off_t) (nbnew - nbold);
+
+    /* Check for FITS extension and ignore for file opening */
+    ext = strchr (filename, ',');
+    if (ext == NULL)
+	ext = strchr (filename, '[');
+    if (ext != NULL) {
+	cext = *ext;
+	*ext = (char) 0;
+	}
+    fd = open (filename, O_RDWR);
+    if (ext != NULL)
+	*ext = cext;
+    if (fd < 0) {
+	snprintf (fitserrmsg, 79, "FITSGROWHEAD:  file %s not writeable\n", filename);
+	return (-1);
+	}
+    if (fstat (fd, &filestat) < 0) {
+	snprintf (fitserrmsg, 79, "FITSGROWHEAD:  cannot find size of %s\n", filename);
+	(void)close (fd);
+	return (-1);
+	}
+    nbfile = filestat.st_size;
+
+#if defined(__linux__) && defined(FALLOC_FL_INSERT_RANGE)
+    /* Let the file system insert the space if it is in whole blocks,
+       as long as the block boundary is not before this header */
+    if (offdata < nbfile && filestat.st_blksize > 0 &&
+	nbshift % filestat.st_blksize == 0) {
+	offset = offdata - (offdata % filestat.st_blksize);
+	if (offset >= offhead &&
+	    !fallocate (fd, FALLOC_FL_INSERT_RANGE, offset, nbshift))
+	    moved = 1;
+	}
+#endif
+
+    /* Otherwise move everything after the header, starting at the end */
+    if (!moved && offdata < nbfile) {
+	nbbuff = FITSBLOCK * 1024;
+	if (nbfile - offdata < (off_t) nbbuff)
+	    nbbuff = (size_t) (nbfile - offdata);
+	if ((buff = (char *) malloc (nbbuff)) == NULL) {
+	    snprintf (fitserrmsg, 79, "FITSGROWHEAD:  cannot allocate %d bytes\n",
+		     (int) nbbuff);
+	    (void)close (fd);
+	    return (-1);
+	    }
+	offset = nbfile;
+	while (offset > offdata) {
+	    nbmove = nbbuff;
+	    if (offset - offdata < (off_t) nbmove)
+		nbmove = (size_t) (offset - offdata);
+	    offset = offset - nbmove;
+	    nbw = 0;
+	    nbr = pread (fd, buff, nbmove, offset);
+	    if (nbr == (ssize_t) nbmove)
+		nbw = pwrite (fd, buff, nbmove, offset + nbshift);
+	    if (nbr < (ssize_t) nbmove || nbw < (ssize_t) nbmove) {
+		snprintf (fitserrmsg, 79, "FITSGROWHEAD:  cannot move data in %s\n",
+			 filename);
+		free (buff);
+		(void)close (fd);
+		return (-1);
+		}
+	    }
+	free (buff);
+	}
+
+    /* Write the new header into the space which has been opened up */
+    newhead = fitspadhead (header, nbnew);
+    nbw = pwrite (fd, newhead, nbnew, offhead);
+    free (newhead);
+    (void)close (fd);
+    if (nbw < nbnew) {
+	snprintf (fitserrmsg, 79, "FITSGROWHEAD:  wrote %d / %d bytes of header to file %s\n",
+		 (int) nbw, nbnew, filename);
+	return (-1);
+	}
+    return (0);
+}
+
+
+/* FITSPADHEAD -- Return a copy of a FITS header padded with blank lines to
+ *		  nbytes bytes, with END on the last line if more than one
+ *		  block of padding has been added */
+
+static char *
+fitspadhead (header, nbytes)
+
+char	*header;	/* FITS header */
+int	nbytes;		/* Length of padded header in bytes */
+
+{
+    char *newhead, *endhead;
+    int lhead;
+
+    endhead = ksearch (header, "END");
+    lhead = endhead - header;
+    newhead = (char *) malloc (nbytes + 1);
+    memset (newhead, ' ', nbytes);
+    newhead[nbytes] = (char) 0;
+    memcpy (newhead, header, lhead);
+    if (nbytes > fitsheadsize (header))
+	memcpy (newhead + nbytes - 80, "END", 3);
+    else
+	memcpy (newhead + lhead, "END", 3);
+    return (newhead);
+}
+
+
 /* ISFITS -- Return 1 if FITS file, else 0 */
 int
 isfits (filename)
@@ -2327,4 +2556,11 @@ char *from, *last, *to;
  * Jun 24 2016	Add 1 to allocation of pheader for trailing null, fix by Ole Streicher
  *
  * Sep 23 2019	Increase header length default to 288000 = 100 blocks
+ *
+ * Oct 18 2026	Add fitscdata() to copy data units with copy_file_range()
+ * Oct 18 2026	Add fitsgrowhead() to lengthen a header without reading data
+ * Oct 18 2026	Add setfitsspare() to reserve spare header blocks on write
+ * Oct 18 2026	In fitscimage(), copy any dimension image with fitscdata()
+ *
+ * Oct 19 2026	In fitsgrowhead(), never insert space before the header being grown
  */
@@ -1,8 +1,8 @@
 /*** File fitsfile.h  FITS and IRAF file access subroutines
- *** February 2, 2022
+ *** October 18, 2026
  *** By Jessica Mink, jmink@cfa.harvard.edu
  *** Harvard-Smithsonian Center for Astrophysics
- *** Copyright (C) 1996-2022
+ *** Copyright (C) 1996-2026
  *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
 
     This library is free software; you can redistribute it and/or
@@ -75,6 +75,20 @@ struct Range {
     int irange;         /* Index of current range */
 };
 
+/* Compiled arithmetic expression of image pixel values */
+#define PEMAXOP	128		/* Maximum number of operations */
+#define PEMAXSTACK 16		/* Maximum number of vectors on stack */
+#define PEMAXIMG 8		/* Maximum number of images, a through h */
+struct PixExpr {
+    int nop;			/* Number of operations */
+    int op[PEMAXOP];		/* Operations */
+    int iarg[PEMAXOP];		/* Image for each operation, 0 = a */
+    double con[PEMAXOP];	/* Constant for each operation */
+    int nstack;			/* Number of vectors left on stack */
+    int maxstack;		/* Largest number of vectors on stack */
+    int nimage;			/* Number of images used */
+};
+
 
 #ifdef __cplusplus /* C++ prototypes */
 extern "C" {
@@ -120,6 +134,11 @@ extern "C" {
     int fitswexhead(	/* Write FITS header in place */
 	char *filename,	/* Name of FITS image file */
 	char *header);	/* FITS header for image */
+    int fitsgrowhead(	/* Write longer FITS header in place, moving data */
+	char *filename,	/* Name of FITS image file */
+	char *header);	/* FITS header for image */
+    void setfitsspare(	/* Set number of spare header blocks to reserve */
+	int nspare);	/* Number of blank 2880-byte blocks to add on write */
     int fitswext(	/* Write FITS header and image as extension to a file */
 	char *filename,	/* Name of FITS image file */
 	char *header,	/* FITS image header */
@@ -137,6 +156,10 @@ extern "C" {
 	char *filename,	/* Name of output FITS image file */
 	char *header,	/* FITS image header */
 	char *filename0); /* Name of input FITS image file */
+    off_t fitscdata(	/* Copy data between open files, returning bytes copied */
+	int fdout,	/* File descriptor of output file */
+	int fdin,	/* File descriptor of input file */
+	off_t nbytes);	/* Number of bytes to copy */
     int isfits(		/* Return 1 if file is a FITS file */
 	char *filename); /* Name of file to check */
     void fitserr();	/* Print FITS error message to stderr */
@@ -358,6 +381,14 @@ float ftgetr4(		/* Extract column for keyword from FITS table line
 	int pix1,	/* Offset of first pixel to extract */
 	int npix,	/* Number of pixels to extract */
 	double *dvec0);	/* Vector of pixels (returned) */
+    void getvecfits(	/* Read vector from 2-D array in FITS byte order */
+	char *image,	/* Image array as 1-D vector */
+	int bitpix,	/* FITS bits per pixel */
+	double bzero,	/* Zero point for pixel scaling */
+	double bscale,	/* Scale factor for pixel scaling */
+	int pix1,	/* Offset of first pixel to extract */
+	int npix,	/* Number of pixels to extract */
+	double *dvec0);	/* Vector of pixels (returned) */
     void putvec(	/* Write vector into 2-D array */
 	char *image,	/* Image array as 1-D vector */
 	int bitpix,	/* FITS bits per pixel */
@@ -366,6 +397,14 @@ float ftgetr4(		/* Extract column for keyword from FITS table line
 	int pix1,	/* Offset of first pixel to insert */
 	int npix,	/* Number of pixels to insert */
 	double *dvec0);	/* Vector of pixels to insert */
+    void putvecfits(	/* Write vector into 2-D array in FITS byte order */
+	char *image,	/* Image array as 1-D vector */
+	int bitpix,	/* FITS bits per pixel */
+	double bzero,	/* Zero point for pixel scaling */
+	double bscale,	/* Scale factor for pixel scaling */
+	int pix1,	/* Offset of first pixel to insert */
+	int npix,	/* Number of pixels to insert */
+	double *dvec0);	/* Vector of pixels to insert */
     void fillvec(	/* Write constant into a vector */
 	char *image,	/* Image array as 1-D vector */
 	int bitpix,	/* FITS bits per pixel */
@@ -383,6 +422,23 @@ float ftgetr4(		/* Extract column for keyword from FITS table line
 	int npix,	/* Number of pixels to multiply */
 	double dpix);	/* Value to which to set pixels */
 
+/* Image pixel expression subroutines in imexpr.c */
+    struct PixExpr *pixexpr( /* Compile expression of image pixel values */
+	char *expr);	/* Expression, such as "(a - 100) * 1.02" */
+    int pixexprop(	/* Append operation with constant to expression */
+	struct PixExpr *pe, /* Compiled expression */
+	int op,		/* Operation: + - * / or = to set */
+	double dpix);	/* Constant for operation */
+    void pixexprvec(	/* Evaluate expression for a vector of pixels */
+	struct PixExpr *pe, /* Compiled expression */
+	double **rows,	/* Pixel vectors of images a, b, ... */
+	int npix,	/* Number of pixels to evaluate */
+	int x1,		/* One-based column of first pixel */
+	int y,		/* One-based row of pixels */
+	double *dvec);	/* Vector of values (returned) */
+    void pixexprfree(	/* Free compiled expression */
+	struct PixExpr *pe); /* Compiled expression */
+
 /* Image pixel byte-swapping subroutines in imio.c */
     void imswap(	/* Swap alternating bytes in a vector */
 	int bitpix,	/* Number of bits per pixel */
@@ -474,6 +530,13 @@ float ftgetr4(		/* Extract column for keyword from FITS table line
 			 * if =0, get whole string */
 	char *token,	/* token (returned) */
 	int maxchars);	/* Maximum length of token */
+    double strtor8(	/* Read a decimal number quickly */
+	char *string,	/* Character string starting with a number */
+	char **next);	/* Character after number (returned) */
+    int r8tostr(	/* Write a number with fixed decimal places quickly */
+	char *string,	/* Character string (returned) */
+	double num,	/* Number */
+	int ndec);	/* Number of decimal places */
 
 /* Subroutines to read values from keyword=value in blocks of text from fileutil.c */
     int agetl(		/* Get nth LF- or CR-terminated line from an ASCII string */
@@ -1046,10 +1109,13 @@ extern char *fitsrfull();
 extern char *fitsrsect();
 extern int fitswhead();
 extern int fitswexhead();
+extern int fitsgrowhead();	/* Write longer header in place, moving data */
+extern void setfitsspare();	/* Set spare header blocks to reserve */
 extern int fitswext();
 extern int fitswhdu();
 extern int fitswimage();
 extern int fitscimage();
+extern off_t fitscdata();	/* Copy data between open files */
 extern int isfits();		/* Return 1 if file is a FITS file */
 extern void fitserr();          /* Print FITS error message to stderr */
 extern void setfitsinherit();	/* Set flag to append primary data header */
@@ -1091,8 +1157,14 @@ extern void addvec();	/* Add constant to vector from 2-D array */
 extern void multvec();	/* Multiply vector from 2-D array by a constant */
 extern void getvec();	/* Read vector from 2-D array */
 extern void putvec();	/* Write vector into 2-D array */
+extern void getvecfits(); /* Read vector from 2-D array in FITS byte order */
+extern void putvecfits(); /* Write vector into 2-D array in FITS byte order */
 extern void fillvec();   /* Write constant into a vector */
 extern void fillvec1();   /* Write constant into a vector */
+extern struct PixExpr *pixexpr(); /* Compile expression of image pixel values */
+extern int pixexprop();	/* Append operation with constant to expression */
+extern void pixexprvec(); /* Evaluate expression for a vector of pixels */
+extern void pixexprfree(); /* Free compiled expression */
 extern void imswap();	/* Swap alternating bytes in a vector */
 extern void imswap2();	/* Swap bytes in a vector of 2-byte (short) integers */
 extern void imswap4();	/* Reverse bytes in a vector of 4-byte numbers */
@@ -1127,6 +1199,8 @@ double rgetr8();	/* Return next number in range as double */
 extern int setoken();	/* Tokenize a string for easy decoding */
 extern int nextoken();	/* Get next token from tokenized string */
 extern int getoken();	/* Get specified token from tokenized string */
+extern double strtor8(); /* Read a decimal number quickly */
+extern int r8tostr();	/* Write a number with fixed decimal places quickly */
 
 /* Subroutines to read values from keyword=value in blocks of text from fileutil.c */
 int agetl();	/* Get nth LF- or CR-terminated line from an ASCII string */
@@ -1400,4 +1474,10 @@ void compnut();	/* Compute nutation in longitude and obliquity and mean obliquit
  * Jan 21 2022	Add lt2mfd() to convert local time to ISO format with month name
  * Jan 31 2022	Add putfilebuff(), aget*(), polynomial routines from fileutil.c
  * Feb  2 2022	Add range subroutine declarations
+ *
+ * Oct 18 2026	Add fitscdata() to copy data between open files
+ * Oct 18 2026	Add fitsgrowhead() and setfitsspare()
+ * Oct 18 2026	Add getvecfits() and putvecfits()
+ * Oct 18 2026	Add strtor8() and r8tostr()
+ * Oct 19 2026	Add PixExpr structure and pixexpr*() from imexpr.c
  */
@@ -1,8 +1,8 @@
 /*** File libwcs/gsc2read.c
- *** August 7, 2018
+ *** October 18, 2026
  *** By Jessica Mink, jmink@cfa.harvard.edu
  *** Harvard-Smithsonian Center for Astrophysics
- *** Copyright (C) 2001-2018
+ *** Copyright (C) 2001-2026
  *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
 
     This library is free software; you can redistribute it and/or
@@ -121,7 +121,7 @@ int	nlog;		/* 1 for diagnostics */
 	fprintf (stderr,"%s%s\n", gsc2url, srchurl);
 
     /* Run search across the web */
-    if ((tabtable = webopen (gsc2url, srchurl, nlog)) == NULL) {
+    if ((tabtable = webopenstream (gsc2url, srchurl, nlog)) == NULL) {
 	if (nlog > 0)
 	    fprintf (stderr, "WEBREAD: %s failed\n", srchurl);
 	return (0);
@@ -393,4 +393,6 @@ gsc2t2t (tsvbuff)
  * Mar 24 2015	Drop concatenation of "empty" string to search URL
  *
  * Aug  7 2018	Set extra table keyword to objID
+ *
+ * Oct 18 2026	Read returned table as it arrives using webopenstream()
  */
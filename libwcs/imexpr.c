@@ -0,0 +1,707 @@
+/*** File libwcs/imexpr.c
+ *** October 19, 2026
+ *** By Jessica Mink, jmink@cfa.harvard.edu
+ *** Harvard-Smithsonian Center for Astrophysics
+ *** Copyright (C) 2026
+ *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+    Correspondence concerning WCSTools should be addressed as follows:
+           Internet email: jmink@cfa.harvard.edu
+           Postal address: Jessica Mink
+                           Smithsonian Astrophysical Observatory
+                           60 Garden St.
+                           Cambridge, MA 02138 USA
+ */
+
+/* struct PixExpr *pixexpr (expr)
+ *	Compile arithmetic expression of image pixel values
+ * void pixexprvec (pexpr, rows, npix, x1, y, dvec)
+ *	Evaluate compiled expression for a vector of pixels
+ * int pixexprop (pexpr, op, dpix)
+ *	Append operation with a constant (+ - * / or =) to compiled expression
+ * void pixexprfree (pexpr)
+ *	Free compiled expression
+ *
+ * Expressions use + - * / and ^ (or **), parentheses, numbers, the
+ * functions sqrt, log, log10, exp, abs, min and max, the pixel values
+ * a through h of up to eight images of the same size, and the one-based
+ * pixel coordinates x and y.  An expression is compiled into a list of
+ * operations on a stack of pixel vectors, with constants folded and
+ * operations with a constant done in place, and is evaluated in blocks
+ * of PEBLOCK pixels, so that the whole expression is applied to each
+ * block while it is in cache, in loops simple enough for a compiler to
+ * vectorize.  Compiled expressions are not changed by evaluation, so
+ * one may be used by several threads at once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "fitsfile.h"
+
+#define PEBLOCK		256	/* Number of pixels evaluated at once */
+
+/* Operations in a compiled expression */
+#define PE_IMG		1	/* Push pixels of image iarg */
+#define PE_CON		2	/* Push constant */
+#define PE_X		3	/* Push column numbers */
+#define PE_Y		4	/* Push row number */
+#define PE_ADD		5	/* Replace top two vectors by result */
+#define PE_SUB		6
+#define PE_MUL		7
+#define PE_DIV		8
+#define PE_POW		9
+#define PE_MIN		10
+#define PE_MAX		11
+#define PE_NEG		12	/* Replace top vector by result */
+#define PE_SQRT		13
+#define PE_LOG		14
+#define PE_LOG10	15
+#define PE_EXP		16
+#define PE_ABS		17
+#define PE_ADDC		18	/* Combine top vector with constant */
+#define PE_SUBC		19
+#define PE_MULC		20
+#define PE_DIVC		21
+#define PE_POWC		22
+#define PE_MINC		23
+#define PE_MAXC		24
+#define PE_CSUB		25	/* Constant minus top vector */
+#define PE_CDIV		26	/* Constant divided by top vector */
+#define PE_SET		27	/* Set top vector to constant */
+
+/* Parser state */
+struct PeParse {
+    char *expr;			/* Whole expression, for messages */
+    char *next;			/* Next character to parse */
+    struct PixExpr *pe;		/* Expression being compiled */
+    int err;			/* 1 if an error has been found */
+    };
+
+static void PeExpr();
+static void PeTerm();
+static void PeUnary();
+static void PePower();
+static void PePrimary();
+static void PeEmit();
+static void PeError();
+static void PeSkip();
+static double PeApply();
+
+
+/* PIXEXPR -- Compile arithmetic expression of image pixel values;
+ * return NULL after printing a message if it cannot be compiled */
+
+struct PixExpr *
+pixexpr (expr)
+
+char	*expr;		/* Expression, such as "(a - 100) * 1.02" */
+{
+    struct PeParse pp;
+    struct PixExpr *pe;
+
+    if ((pe = (struct PixExpr *) calloc (1, sizeof (struct PixExpr))) == NULL)
+	return (NULL);
+    pp.expr = expr;
+    pp.next = expr;
+    pp.pe = pe;
+    pp.err = 0;
+    PeExpr (&pp);
+    PeSkip (&pp);
+    if (!pp.err && *pp.next != (char) 0)
+	PeError (&pp, "unexpected character");
+    if (pp.err) {
+	free (pe);
+	return (NULL);
+	}
+    return (pe);
+}
+
+
+/* PIXEXPROP -- Append operation with a constant to a compiled expression;
+ * return 0 if there is no room for it */
+
+int
+pixexprop (pe, op, dpix)
+
+struct PixExpr *pe;	/* Compiled expression */
+int	op;		/* Operation: + - * / or = to set */
+double	dpix;		/* Constant for operation */
+{
+    if (pe->nop >= PEMAXOP - 1)
+	return (0);
+    if (op == '=') {
+	PeEmit (pe, PE_SET, 0, dpix);
+	return (1);
+	}
+    PeEmit (pe, PE_CON, 0, dpix);
+    switch (op) {
+	case '+':
+	    PeEmit (pe, PE_ADD, 0, 0.0);
+	    break;
+	case '-':
+	    PeEmit (pe, PE_SUB, 0, 0.0);
+	    break;
+	case '*':
+	    PeEmit (pe, PE_MUL, 0, 0.0);
+	    break;
+	case '/':
+	    PeEmit (pe, PE_DIV, 0, 0.0);
+	    break;
+	default:
+	    pe->nop--;
+	    pe->nstack--;
+	    return (0);
+	}
+    return (1);
+}
+
+
+/* PIXEXPRFREE -- Free compiled expression */
+
+void
+pixexprfree (pe)
+
+struct PixExpr *pe;	/* Compiled expression */
+{
+    if (pe != NULL)
+	free (pe);
+    return;
+}
+
+
+/* PIXEXPRVEC -- Evaluate compiled expression for a vector of pixels */
+
+void
+pixexprvec (pe, rows, npix, x1, y, dvec)
+
+struct PixExpr *pe;	/* Compiled expression */
+double	**rows;		/* Pixel vectors of images a, b, ... (may be dvec) */
+int	npix;		/* Number of pixels to evaluate */
+int	x1;		/* One-based column of first pixel, for x */
+int	y;		/* One-based row of pixels, for y */
+double	*dvec;		/* Vector of values (returned) */
+{
+    double stack[PEMAXSTACK][PEBLOCK];
+    double *s, *t, *r, con;
+    int ip, is, i, i1, n;
+
+    for (i1 = 0; i1 < npix; i1 = i1 + PEBLOCK) {
+	n = npix - i1;
+	if (n > PEBLOCK)
+	    n = PEBLOCK;
+	is = -1;
+	for (ip = 0; ip < pe->nop; ip++) {
+	    con = pe->con[ip];
+	    s = stack[is < 0 ? 0 : is];
+	    switch (pe->op[ip]) {
+
+		/* Push a new vector */
+		case PE_IMG:
+		    s = stack[++is];
+		    r = rows[pe->iarg[ip]] + i1;
+		    for (i = 0; i < n; i++)
+			s[i] = r[i];
+		    break;
+		case PE_CON:
+		    s = stack[++is];
+		    for (i = 0; i < n; i++)
+			s[i] = con;
+		    break;
+		case PE_X:
+		    s = stack[++is];
+		    for (i = 0; i < n; i++)
+			s[i] = (double) (x1 + i1 + i);
+		    break;
+		case PE_Y:
+		    s = stack[++is];
+		    for (i = 0; i < n; i++)
+			s[i] = (double) y;
+		    break;
+
+		/* Combine the top two vectors */
+		case PE_ADD:
+		    t = stack[is--];
+		    s = stack[is];
+		    for (i = 0; i < n; i++)
+			s[i] = s[i] + t[i];
+		    break;
+		case PE_SUB:
+		    t = stack[is--];
+		    s = stack[is];
+		    for (i = 0; i < n; i++)
+			s[i] = s[i] - t[i];
+		    break;
+		case PE_MUL:
+		    t = stack[is--];
+		    s = stack[is];
+		    for (i = 0; i < n; i++)
+			s[i] = s[i] * t[i];
+		    break;
+		case PE_DIV:
+		    t = stack[is--];
+		    s = stack[is];
+		    for (i = 0; i < n; i++)
+			s[i] = s[i] / t[i];
+		    break;
+		case PE_POW:
+		    t = stack[is--];
+		    s = stack[is];
+		    for (i = 0; i < n; i++)
+			s[i] = pow (s[i], t[i]);
+		    break;
+		case PE_MIN:
+		    t = stack[is--];
+		    s = stack[is];
+		    for (i = 0; i < n; i++)
+			s[i] = (t[i] < s[i]) ? t[i] : s[i];
+		    break;
+		case PE_MAX:
+		    t = stack[is--];
+		    s = stack[is];
+		    for (i = 0; i < n; i++)
+			s[i] = (t[i] > s[i]) ? t[i] : s[i];
+		    break;
+
+		/* Change the top vector in place */
+		case PE_NEG:
+		    for (i = 0; i < n; i++)
+			s[i] = -s[i];
+		    break;
+		case PE_SQRT:
+		    for (i = 0; i < n; i++)
+			s[i] = sqrt (s[i]);
+		    break;
+		case PE_LOG:
+		    for (i = 0; i < n; i++)
+			s[i] = log (s[i]);
+		    break;
+		case PE_LOG10:
+		    for (i = 0; i < n; i++)
+			s[i] = log10 (s[i]);
+		    break;
+		case PE_EXP:
+		    for (i = 0; i < n; i++)
+			s[i] = exp (s[i]);
+		    break;
+		case PE_ABS:
+		    for (i = 0; i < n; i++)
+			s[i] = fabs (s[i]);
+		    break;
+		case PE_ADDC:
+		    for (i = 0; i < n; i++)
+			s[i] = s[i] + con;
+		    break;
+		case PE_SUBC:
+		    for (i = 0; i < n; i++)
+			s[i] = s[i] - con;
+		    break;
+		case PE_MULC:
+		    for (i = 0; i < n; i++)
+			s[i] = s[i] * con;
+		    break;
+		case PE_DIVC:
+		    for (i = 0; i < n; i++)
+			s[i] = s[i] / con;
+		    break;
+		case PE_POWC:
+		    if (con == 2.0) {
+			for (i = 0; i < n; i++)
+			    s[i] = s[i] * s[i];
+			}
+		    else if (con == 0.5) {
+			for (i = 0; i < n; i++)
+			    s[i] = sqrt (s[i]);
+			}
+		    else {
+			for (i = 0; i < n; i++)
+			    s[i] = pow (s[i], con);
+			}
+		    break;
+		case PE_MINC:
+		    for (i = 0; i < n; i++)
+			s[i] = (con < s[i]) ? con : s[i];
+		    break;
+		case PE_MAXC:
+		    for (i = 0; i < n; i++)
+			s[i] = (con > s[i]) ? con : s[i];
+		    break;
+		case PE_CSUB:
+		    for (i = 0; i < n; i++)
+			s[i] = con - s[i];
+		    break;
+		case PE_CDIV:
+		    for (i = 0; i < n; i++)
+			s[i] = con / s[i];
+		    break;
+		case PE_SET:
+		    for (i = 0; i < n; i++)
+			s[i] = con;
+		    break;
+		default:
+		    break;
+		}
+	    }
+
+	/* Copy result, which is the only vector left */
+	s = stack[0];
+	r = dvec + i1;
+	for (i = 0; i < n; i++)
+	    r[i] = s[i];
+	}
+    return;
+}
+
+
+/* Add operation to compiled expression, folding constants and combining
+ * operations with a constant into one operation on the other vector */
+
+static void
+PeEmit (pe, op, iarg, con)
+
+struct PixExpr *pe;	/* Expression being compiled */
+int	op;		/* Operation (PE_*) */
+int	iarg;		/* Image index for PE_IMG */
+double	con;		/* Constant for PE_CON */
+{
+    int nop = pe->nop;
+    int last = (nop > 0) ? pe->op[nop-1] : 0;
+    int last2 = (nop > 1) ? pe->op[nop-2] : 0;
+    int cop;
+
+    if (nop > PEMAXOP)
+	return;
+
+    /* Constant operations on constants are done now */
+    if (op >= PE_ADD && op <= PE_MAX && last == PE_CON && last2 == PE_CON) {
+	pe->con[nop-2] = PeApply (op, pe->con[nop-2], pe->con[nop-1]);
+	pe->nop--;
+	pe->nstack--;
+	return;
+	}
+    if (op >= PE_NEG && op <= PE_ABS && last == PE_CON) {
+	pe->con[nop-1] = PeApply (op, pe->con[nop-1], 0.0);
+	return;
+	}
+
+    /* Vector followed by constant is changed in place */
+    if (op >= PE_ADD && op <= PE_MAX && last == PE_CON) {
+	cop = op - PE_ADD + PE_ADDC;
+	if (op == PE_ADD && pe->con[nop-1] == 0.0)
+	    pe->nop--;
+	else if ((op == PE_MUL || op == PE_DIV || op == PE_POW) &&
+		 pe->con[nop-1] == 1.0)
+	    pe->nop--;
+	else
+	    pe->op[nop-1] = cop;
+	pe->nstack--;
+	return;
+	}
+
+    /* Constant followed by one image is changed in place */
+    if (op >= PE_ADD && op <= PE_MAX && op != PE_POW &&
+	(last == PE_IMG || last == PE_X || last == PE_Y) && last2 == PE_CON) {
+	if (op == PE_SUB)
+	    cop = PE_CSUB;
+	else if (op == PE_DIV)
+	    cop = PE_CDIV;
+	else
+	    cop = op - PE_ADD + PE_ADDC;
+	con = pe->con[nop-2];
+	pe->op[nop-2] = pe->op[nop-1];
+	pe->iarg[nop-2] = pe->iarg[nop-1];
+	pe->op[nop-1] = cop;
+	pe->con[nop-1] = con;
+	pe->nstack--;
+	return;
+	}
+
+    if (nop >= PEMAXOP) {
+	pe->nop = PEMAXOP + 1;
+	return;
+	}
+    pe->op[nop] = op;
+    pe->iarg[nop] = iarg;
+    pe->con[nop] = con;
+    pe->nop++;
+    if (op == PE_IMG && iarg >= pe->nimage)
+	pe->nimage = iarg + 1;
+    if (op <= PE_Y)
+	pe->nstack++;
+    else if (op <= PE_MAX)
+	pe->nstack--;
+    if (pe->nstack > pe->maxstack)
+	pe->maxstack = pe->nstack;
+    return;
+}
+
+
+/* Apply operation to constants */
+
+static double
+PeApply (op, con1, con2)
+
+int	op;		/* Operation (PE_*) */
+double	con1;		/* First or only operand */
+double	con2;		/* Second operand */
+{
+    switch (op) {
+	case PE_ADD:	return (con1 + con2);
+	case PE_SUB:	return (con1 - con2);
+	case PE_MUL:	return (con1 * con2);
+	case PE_DIV:	return (con1 / con2);
+	case PE_POW:	return (pow (con1, con2));
+	case PE_MIN:	return ((con2 < con1) ? con2 : con1);
+	case PE_MAX:	return ((con2 > con1) ? con2 : con1);
+	case PE_NEG:	return (-con1);
+	case PE_SQRT:	return (sqrt (con1));
+	case PE_LOG:	return (log (con1));
+	case PE_LOG10:	return (log10 (con1));
+	case PE_EXP:	return (exp (con1));
+	case PE_ABS:	return (fabs (con1));
+	default:	return (con1);
+	}
+}
+
+
+/* expr := term { (+|-) term } */
+
+static void
+PeExpr (pp)
+
+struct PeParse *pp;	/* Parser state */
+{
+    char c;
+
+    PeTerm (pp);
+    while (!pp->err) {
+	PeSkip (pp);
+	c = *pp->next;
+	if (c != '+' && c != '-')
+	    break;
+	pp->next++;
+	PeTerm (pp);
+	PeEmit (pp->pe, (c == '+') ? PE_ADD : PE_SUB, 0, 0.0);
+	}
+    return;
+}
+
+
+/* term := unary { (*|/) unary } */
+
+static void
+PeTerm (pp)
+
+struct PeParse *pp;	/* Parser state */
+{
+    char c;
+
+    PeUnary (pp);
+    while (!pp->err) {
+	PeSkip (pp);
+	c = *pp->next;
+	if ((c != '*' && c != '/') || pp->next[1] == '*')
+	    break;
+	pp->next++;
+	PeUnary (pp);
+	PeEmit (pp->pe, (c == '*') ? PE_MUL : PE_DIV, 0, 0.0);
+	}
+    return;
+}
+
+
+/* unary := - unary | + unary | power */
+
+static void
+PeUnary (pp)
+
+struct PeParse *pp;	/* Parser state */
+{
+    PeSkip (pp);
+    if (*pp->next == '-') {
+	pp->next++;
+	PeUnary (pp);
+	PeEmit (pp->pe, PE_NEG, 0, 0.0);
+	}
+    else if (*pp->next == '+') {
+	pp->next++;
+	PeUnary (pp);
+	}
+    else
+	PePower (pp);
+    return;
+}
+
+
+/* power := primary [ (^|**) unary ] */
+
+static void
+PePower (pp)
+
+struct PeParse *pp;	/* Parser state */
+{
+    PePrimary (pp);
+    if (pp->err)
+	return;
+    PeSkip (pp);
+    if (*pp->next == '^')
+	pp->next++;
+    else if (!strncmp (pp->next, "**", 2))
+	pp->next = pp->next + 2;
+    else
+	return;
+    PeUnary (pp);
+    PeEmit (pp->pe, PE_POW, 0, 0.0);
+    return;
+}
+
+
+/* primary := number | a-h | x | y | function ( expr [, expr] ) | ( expr ) */
+
+static void
+PePrimary (pp)
+
+struct PeParse *pp;	/* Parser state */
+{
+    static char *fname[] = {"sqrt","log10","log","exp","abs","min","max"};
+    static int fop[] = {PE_SQRT,PE_LOG10,PE_LOG,PE_EXP,PE_ABS,PE_MIN,PE_MAX};
+    char *c, *cend;
+    double dval;
+    int i, lname, op;
+
+    PeSkip (pp);
+    c = pp->next;
+    if (*c == '(') {
+	pp->next++;
+	PeExpr (pp);
+	PeSkip (pp);
+	if (!pp->err && *pp->next != ')')
+	    PeError (pp, "missing )");
+	else
+	    pp->next++;
+	return;
+	}
+
+    if (isdigit ((int) *c) || (*c == '.' && isdigit ((int) c[1]))) {
+	dval = strtod (c, &cend);
+	pp->next = cend;
+	PeEmit (pp->pe, PE_CON, 0, dval);
+	return;
+	}
+
+    if (isalpha ((int) *c)) {
+	for (lname = 0; isalnum ((int) c[lname]); lname++);
+
+	/* Single letters are images or coordinates */
+	if (lname == 1) {
+	    pp->next++;
+	    if (*c >= 'a' && *c < 'a' + PEMAXIMG)
+		PeEmit (pp->pe, PE_IMG, *c - 'a', 0.0);
+	    else if (*c == 'x')
+		PeEmit (pp->pe, PE_X, 0, 0.0);
+	    else if (*c == 'y')
+		PeEmit (pp->pe, PE_Y, 0, 0.0);
+	    else {
+		pp->next--;
+		PeError (pp, "unknown variable");
+		}
+	    return;
+	    }
+
+	/* Longer names are functions */
+	for (i = 0; i < 7; i++) {
+	    if ((int) strlen (fname[i]) == lname && !strncmp (c, fname[i], lname))
+		break;
+	    }
+	if (i == 7) {
+	    PeError (pp, "unknown function");
+	    return;
+	    }
+	op = fop[i];
+	pp->next = c + lname;
+	PeSkip (pp);
+	if (*pp->next != '(') {
+	    PeError (pp, "missing ( after function");
+	    return;
+	    }
+	pp->next++;
+	PeExpr (pp);
+	if (!pp->err && (op == PE_MIN || op == PE_MAX)) {
+	    PeSkip (pp);
+	    if (*pp->next != ',') {
+		PeError (pp, "missing second argument");
+		return;
+		}
+	    pp->next++;
+	    PeExpr (pp);
+	    }
+	PeSkip (pp);
+	if (pp->err)
+	    return;
+	if (*pp->next != ')') {
+	    PeError (pp, "missing )");
+	    return;
+	    }
+	pp->next++;
+	PeEmit (pp->pe, op, 0, 0.0);
+	return;
+	}
+
+    if (*c == (char) 0)
+	PeError (pp, "unexpected end");
+    else
+	PeError (pp, "unexpected character");
+    return;
+}
+
+
+/* Skip spaces in expression, and stop parsing if it has grown too long */
+
+static void
+PeSkip (pp)
+
+struct PeParse *pp;	/* Parser state */
+{
+    while (*pp->next == ' ' || *pp->next == '\t')
+	pp->next++;
+    if (!pp->err && pp->pe->nop > PEMAXOP)
+	PeError (pp, "too many operations");
+    else if (!pp->err && pp->pe->maxstack > PEMAXSTACK)
+	PeError (pp, "too deeply nested");
+    return;
+}
+
+
+/* Print message showing where parsing stopped */
+
+static void
+PeError (pp, msg)
+
+struct PeParse *pp;	/* Parser state */
+char	*msg;		/* Description of error */
+{
+    if (!pp->err)
+	fprintf (stderr, "PIXEXPR: %s at column %d of %s\n", msg,
+		 (int) (pp->next - pp->expr) + 1, pp->expr);
+    pp->err = 1;
+    return;
+}
+
+/* Oct 19 2026	New subroutines to evaluate image pixel expressions
+ */
@@ -1,8 +1,8 @@
 /*** File wcslib/imio.c
- *** October 30, 2012
+ *** October 18, 2026
  *** By Jessica Mink, jmink@cfa.harvard.edu
  *** Harvard-Smithsonian Center for Astrophysics
- *** Copyright (C) 1996-2012
+ *** Copyright (C) 1996-2026
  *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
 
     This library is free software; you can redistribute it and/or
@@ -46,8 +46,12 @@
  *		Get minimum of vector from 2D image of any numeric type
  * Subroutine:	getvec (image, bitpix, bz, bs, pix1, npix, dvec)
  *		Get vector from 2D image of any numeric type
+ * Subroutine:	getvecfits (image, bitpix, bz, bs, pix1, npix, dvec)
+ *		Get vector from 2D image in FITS byte order, swapping as it goes
  * Subroutine:	putvec (image, bitpix, bz, bs, pix1, npix, dvec)
  *		Copy pixel vector into a vector of any numeric type
+ * Subroutine:	putvecfits (image, bitpix, bz, bs, pix1, npix, dvec)
+ *		Copy pixel vector into 2D image in FITS byte order
  * Subroutine:	addvec (image, bitpix, bz, bs, pix1, npix, dpix)
  *		Add constant to pixel values in a vector
  * Subroutine:	multvec (image, bitpix, bz, bs, pix1, npix, dpix)
@@ -1066,7 +1070,7 @@ double	dpix;		/* Value by which to multiply pixels */
 /* GETVEC -- Get vector from 2D image of any numeric type */
 
 void
-getvec (image, bitpix, bzero, bscale, pix1, npix, dvec0)
+getvec (image, bitpix, bzero, bscale, pix1, npix, dvec)
 
 char	*image;		/* Image array from which to extract vector */
 int	bitpix;		/* Number of bits per pixel in image */
@@ -1076,66 +1080,165 @@ double  bzero;		/* Zero point for pixel scaling */
 double  bscale;		/* Scale factor for pixel scaling */
 int	pix1;		/* Offset of first pixel to extract */
 int	npix;		/* Number of pixels to extract */
-double	*dvec0;		/* Vector of pixels (returned) */
+double	*dvec;		/* Vector of pixels (returned) */
 
 {
+    unsigned char *imc;
     short *im2;
     int *im4;
     unsigned short *imu;
     float *imr;
     double *imd;
-    double *dvec;
-    int ipix, pix2;
+    int ipix;
 
-    pix2 = pix1 + npix;
-    dvec = dvec0;
+    /* Scale data if either BZERO or BSCALE keyword has been set */
+    if (scale && (bzero != 0.0 || bscale != 1.0)) {
+	switch (bitpix) {
+	    case 8:
+		imc = (unsigned char *)image + pix1;
+		for (ipix = 0; ipix < npix; ipix++)
+		    dvec[ipix] = ((double) imc[ipix] * bscale) + bzero;
+		break;
+	    case 16:
+		im2 = (short *)image + pix1;
+		for (ipix = 0; ipix < npix; ipix++)
+		    dvec[ipix] = ((double) im2[ipix] * bscale) + bzero;
+		break;
+	    case 32:
+		im4 = (int *)image + pix1;
+		for (ipix = 0; ipix < npix; ipix++)
+		    dvec[ipix] = ((double) im4[ipix] * bscale) + bzero;
+		break;
+	    case -16:
+		imu = (unsigned short *)image + pix1;
+		for (ipix = 0; ipix < npix; ipix++)
+		    dvec[ipix] = ((double) imu[ipix] * bscale) + bzero;
+		break;
+	    case -32:
+		imr = (float *)image + pix1;
+		for (ipix = 0; ipix < npix; ipix++)
+		    dvec[ipix] = ((double) imr[ipix] * bscale) + bzero;
+		break;
+	    case -64:
+		imd = (double *)image + pix1;
+		for (ipix = 0; ipix < npix; ipix++)
+		    dvec[ipix] = (imd[ipix] * bscale) + bzero;
+		break;
+	    }
+	return;
+	}
 
     switch (bitpix) {
-
 	case 8:
-	    for (ipix = pix1; ipix < pix2; ipix++)
-		*dvec++ = (double) *(image + ipix);
+	    imc = (unsigned char *)image + pix1;
+	    for (ipix = 0; ipix < npix; ipix++)
+		dvec[ipix] = (double) imc[ipix];
 	    break;
-
 	case 16:
-	    im2 = (short *)image;
-	    for (ipix = pix1; ipix < pix2; ipix++)
-		*dvec++ = (double) *(im2 + ipix);
+	    im2 = (short *)image + pix1;
+	    for (ipix = 0; ipix < npix; ipix++)
+		dvec[ipix] = (double) im2[ipix];
 	    break;
-
 	case 32:
-	    im4 = (int *)image;
-	    for (ipix = pix1; ipix < pix2; ipix++)
-		*dvec++ = (double) *(im4 + ipix);
+	    im4 = (int *)image + pix1;
+	    for (ipix = 0; ipix < npix; ipix++)
+		dvec[ipix] = (double) im4[ipix];
 	    break;
-
 	case -16:
-	    imu = (unsigned short *)image;
-	    for (ipix = pix1; ipix < pix2; ipix++)
-		*dvec++ = (double) *(imu + ipix);
+	    imu = (unsigned short *)image + pix1;
+	    for (ipix = 0; ipix < npix; ipix++)
+		dvec[ipix] = (double) imu[ipix];
 	    break;
-
 	case -32:
-	    imr = (float *)image;
-	    for (ipix = pix1; ipix < pix2; ipix++)
-		*dvec++ = (double) *(imr + ipix);
+	    imr = (float *)image + pix1;
+	    for (ipix = 0; ipix < npix; ipix++)
+		dvec[ipix] = (double) imr[ipix];
 	    break;
-
 	case -64:
-	    imd = (double *)image;
-	    for (ipix = pix1; ipix < pix2; ipix++)
-		*dvec++ = (double) *(imd + ipix);
+	    imd = (double *)image + pix1;
+	    for (ipix = 0; ipix < npix; ipix++)
+		dvec[ipix] = imd[ipix];
 	    break;
+	}
+
+    return;
+}
+
+
+/* GETVECFITS -- Get vector from 2D image still in FITS (big-endian) byte
+ * order, swapping bytes as each pixel is converted instead of in a separate
+ * pass over the image */
+
+void
+getvecfits (image, bitpix, bzero, bscale, pix1, npix, dvec)
+
+char	*image;		/* Image array in FITS byte order */
+int	bitpix;		/* Number of bits per pixel in image */
+			/*  16 = short, -16 = unsigned short, 32 = int */
+			/* -32 = float, -64 = double */
+double  bzero;		/* Zero point for pixel scaling */
+double  bscale;		/* Scale factor for pixel scaling */
+int	pix1;		/* Offset of first pixel to extract */
+int	npix;		/* Number of pixels to extract */
+double	*dvec;		/* Vector of pixels (returned) */
 
+{
+    unsigned char *b;
+    union { unsigned int u; float r; } u4;
+    union { unsigned char c[8]; double d; } u8;
+    int ipix, doscale;
+
+    /* Pixels are already in machine order */
+    if (!imswapped () || bitpix == 8) {
+	getvec (image, bitpix, bzero, bscale, pix1, npix, dvec);
+	return;
 	}
 
-    /* Scale data if either BZERO or BSCALE keyword has been set */
-    if (scale && (bzero != 0.0 || bscale != 1.0)) {
-	dvec = dvec0;
-	for (ipix = pix1; ipix < pix2; ipix++) {
-	    *dvec = (*dvec * bscale) + bzero;
-	    dvec++;
-	    }
+    doscale = scale && (bzero != 0.0 || bscale != 1.0);
+    switch (bitpix) {
+	case 16:
+	    b = (unsigned char *)image + (2 * pix1);
+	    for (ipix = 0; ipix < npix; ipix++, b += 2)
+		dvec[ipix] = (double) (short) ((b[0] << 8) | b[1]);
+	    break;
+	case 32:
+	    b = (unsigned char *)image + (4 * pix1);
+	    for (ipix = 0; ipix < npix; ipix++, b += 4)
+		dvec[ipix] = (double) (int) (((unsigned int) b[0] << 24) |
+				(b[1] << 16) | (b[2] << 8) | b[3]);
+	    break;
+	case -16:
+	    b = (unsigned char *)image + (2 * pix1);
+	    for (ipix = 0; ipix < npix; ipix++, b += 2)
+		dvec[ipix] = (double) ((b[0] << 8) | b[1]);
+	    break;
+	case -32:
+	    b = (unsigned char *)image + (4 * pix1);
+	    for (ipix = 0; ipix < npix; ipix++, b += 4) {
+		u4.u = ((unsigned int) b[0] << 24) | (b[1] << 16) |
+		       (b[2] << 8) | b[3];
+		dvec[ipix] = (double) u4.r;
+		}
+	    break;
+	case -64:
+	    b = (unsigned char *)image + (8 * pix1);
+	    for (ipix = 0; ipix < npix; ipix++, b += 8) {
+		u8.c[0] = b[7];
+		u8.c[1] = b[6];
+		u8.c[2] = b[5];
+		u8.c[3] = b[4];
+		u8.c[4] = b[3];
+		u8.c[5] = b[2];
+		u8.c[6] = b[1];
+		u8.c[7] = b[0];
+		dvec[ipix] = u8.d;
+		}
+	    break;
+	}
+
+    if (doscale) {
+	for (ipix = 0; ipix < npix; ipix++)
+	    dvec[ipix] = (dvec[ipix] * bscale) + bzero;
 	}
 
     return;
@@ -1155,7 +1258,7 @@ double  bzero;		/* Zero point for pixel scaling */
 double  bscale;		/* Scale factor for pixel scaling */
 int	pix1;		/* Offset of first pixel of vector in image */
 int	npix;		/* Number of pixels to copy */
-double	*dvec;		/* Vector of pixels to copy */
+double	*dvec;		/* Vector of pixels to copy (not changed) */
 
 {
     short *im2;
@@ -1163,67 +1266,163 @@ double	*dvec;		/* Vector of pixels to copy */
     unsigned short *imu;
     float *imr;
     double *imd;
-    int ipix, pix2;
-    double *dp = dvec;
-
-    pix2 = pix1 + npix;
+    int ipix;
+    double dp, bz, bs;
 
     /* Scale data if either BZERO or BSCALE keyword has been set */
     if (scale && (bzero != 0.0 || bscale != 1.0)) {
-	for (ipix = pix1; ipix < pix2; ipix++) {
-	    *dp = (*dp - bzero) / bscale;
-	    dp++;
-	    }
-	dp = dvec;
+	bz = bzero;
+	bs = bscale;
+	}
+    else {
+	bz = 0.0;
+	bs = 1.0;
 	}
 
     switch (bitpix) {
 
 	case 8:
-	    for (ipix = pix1; ipix < pix2; ipix++)
-		*(image+ipix) = (char) *dp++;
+	    for (ipix = 0; ipix < npix; ipix++)
+		image[pix1+ipix] = (char) ((dvec[ipix] - bz) / bs);
 	    break;
 
 	case 16:
-	    im2 = (short *)image;
-	    for (ipix = pix1; ipix < pix2; ipix++) {
-		if (*dp < 0.0)
-		    *(im2+ipix) = (short) (*dp++ - 0.5);
-		else
-		    *(im2+ipix) = (short) (*dp++ + 0.5);
+	    im2 = (short *)image + pix1;
+	    for (ipix = 0; ipix < npix; ipix++) {
+		dp = (dvec[ipix] - bz) / bs;
+		im2[ipix] = (short) (dp < 0.0 ? dp - 0.5 : dp + 0.5);
 		}
 	    break;
 
 	case 32:
-	    im4 = (int *)image;
-	    for (ipix = pix1; ipix < pix2; ipix++) {
-		if (*dp < 0.0)
-		    *(im4+ipix) = (int) (*dp++ - 0.5);
-		else
-		    *(im4+ipix) = (int) (*dp++ + 0.5);
+	    im4 = (int *)image + pix1;
+	    for (ipix = 0; ipix < npix; ipix++) {
+		dp = (dvec[ipix] - bz) / bs;
+		im4[ipix] = (int) (dp < 0.0 ? dp - 0.5 : dp + 0.5);
 		}
 	    break;
 
 	case -16:
-	    imu = (unsigned short *)image;
-	    for (ipix = pix1; ipix < pix2; ipix++) {
-		if (*dp < 0.0)
-		    *(imu+ipix) = (unsigned short) 0;
-		else
-		    *(imu+ipix) = (unsigned short) (*dp++ + 0.5);
+	    imu = (unsigned short *)image + pix1;
+	    for (ipix = 0; ipix < npix; ipix++) {
+		dp = (dvec[ipix] - bz) / bs;
+		imu[ipix] = (unsigned short) (dp < 0.0 ? 0.0 : dp + 0.5);
 		}
 	    break;
 
 	case -32:
-	    imr = (float *)image;
-	    for (ipix = pix1; ipix < pix2; ipix++)
-		*(imr+ipix) = (float) *dp++;
+	    imr = (float *)image + pix1;
+	    for (ipix = 0; ipix < npix; ipix++)
+		imr[ipix] = (float) ((dvec[ipix] - bz) / bs);
 	    break;
 
 	case -64:
-	    imd = (double *)image;
-	    for (ipix = pix1; ipix < pix2; ipix++)
-		*(imd+ipix) = (double) *dp++;
+	    imd = (double *)image + pix1;
+	    for (ipix = 0; ipix < npix; ipix++)
+		imd[ipix] = (dvec[ipix] - bz) / bs;
+	    break;
+	}
+    return;
+}
+
+
+/* PUTVECFITS -- Copy pixel vector into 2D image in FITS (big-endian) byte
+ * order, swapping bytes as each pixel is converted */
+
+void
+putvecfits (image, bitpix, bzero, bscale, pix1, npix, dvec)
+
+char	*image;		/* Image in FITS byte order into which to copy vector */
+int	bitpix;		/* Number of bits per pixel im image */
+			/*  16 = short, -16 = unsigned short, 32 = int */
+			/* -32 = float, -64 = double */
+double  bzero;		/* Zero point for pixel scaling */
+double  bscale;		/* Scale factor for pixel scaling */
+int	pix1;		/* Offset of first pixel of vector in image */
+int	npix;		/* Number of pixels to copy */
+double	*dvec;		/* Vector of pixels to copy (not changed) */
+
+{
+    unsigned char *b;
+    unsigned int iv;
+    union { unsigned int u; float r; } u4;
+    union { unsigned char c[8]; double d; } u8;
+    int ipix;
+    double dp, bz, bs;
+
+    /* Pixels are written in machine order */
+    if (!imswapped () || bitpix == 8) {
+	putvec (image, bitpix, bzero, bscale, pix1, npix, dvec);
+	return;
+	}
+
+    if (scale && (bzero != 0.0 || bscale != 1.0)) {
+	bz = bzero;
+	bs = bscale;
+	}
+    else {
+	bz = 0.0;
+	bs = 1.0;
+	}
+
+    switch (bitpix) {
+
+	case 16:
+	    b = (unsigned char *)image + (2 * pix1);
+	    for (ipix = 0; ipix < npix; ipix++, b += 2) {
+		dp = (dvec[ipix] - bz) / bs;
+		iv = (unsigned int) (short) (dp < 0.0 ? dp - 0.5 : dp + 0.5);
+		b[0] = (iv >> 8) & 0xff;
+		b[1] = iv & 0xff;
+		}
+	    break;
+
+	case 32:
+	    b = (unsigned char *)image + (4 * pix1);
+	    for (ipix = 0; ipix < npix; ipix++, b += 4) {
+		dp = (dvec[ipix] - bz) / bs;
+		iv = (unsigned int) (int) (dp < 0.0 ? dp - 0.5 : dp + 0.5);
+		b[0] = (iv >> 24) & 0xff;
+		b[1] = (iv >> 16) & 0xff;
+		b[2] = (iv >> 8) & 0xff;
+		b[3] = iv & 0xff;
+		}
+	    break;
+
+	case -16:
+	    b = (unsigned char *)image + (2 * pix1);
+	    for (ipix = 0; ipix < npix; ipix++, b += 2) {
+		dp = (dvec[ipix] - bz) / bs;
+		iv = (unsigned short) (dp < 0.0 ? 0.0 : dp + 0.5);
+		b[0] = (iv >> 8) & 0xff;
+		b[1] = iv & 0xff;
+		}
+	    break;
+
+	case -32:
+	    b = (unsigned char *)image + (4 * pix1);
+	    for (ipix = 0; ipix < npix; ipix++, b += 4) {
+		u4.r = (float) ((dvec[ipix] - bz) / bs);
+		b[0] = (u4.u >> 24) & 0xff;
+		b[1] = (u4.u >> 16) & 0xff;
+		b[2] = (u4.u >> 8) & 0xff;
+		b[3] = u4.u & 0xff;
+		}
+	    break;
+
+	case -64:
+	    b = (unsigned char *)image + (8 * pix1);
+	    for (ipix = 0; ipix < npix; ipix++, b += 8) {
+		u8.d = (dvec[ipix] - bz) / bs;
+		b[0] = u8.c[7];
+		b[1] = u8.c[6];
+		b[2] = u8.c[5];
+		b[3] = u8.c[4];
+		b[4] = u8.c[3];
+		b[5] = u8.c[2];
+		b[6] = u8.c[1];
+		b[7] = u8.c[0];
+		}
 	    break;
 	}
     return;
@@ -1541,4 +1740,10 @@ imswapped ()
  * Oct 19 2012	Fix errors with character images in minvec() and maxvec()
  * Oct 31 2012	Fix errors with short images in minvec() and maxvec()
  * Oct 31 2012	Drop unused variable il2 from minvec()
+ *
+ * Oct 18 2026	Read 8-bit pixels as unsigned in getvec(), as getpix() does
+ * Oct 18 2026	Convert and scale in one pass in getvec() and putvec()
+ * Oct 18 2026	Do not rescale the caller's vector in putvec()
+ * Oct 18 2026	Fix putvec() repeating negative unsigned short pixel values
+ * Oct 18 2026	Add getvecfits() and putvecfits() to swap bytes while converting
  */
@@ -1,8 +1,8 @@
 /*** File libwcs/imrotate.c
- *** June 26, 2008
+ *** October 19, 2026
  *** By Jessica Mink, jmink@cfa.harvard.edu
  *** Harvard-Smithsonian Center for Astrophysics
- *** Copyright (C) 1996-2008
+ *** Copyright (C) 1996-2026
  *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
 
     This library is free software; you can redistribute it and/or
@@ -34,6 +34,11 @@
 #include "fitsfile.h"
 
 static void RotWCSFITS();	/* rotate all the C* fields */
+static int RotMap();		/* set where pixels move */
+static void RotRow();		/* copy a run of pixels */
+static void RevRow();		/* reverse a run of pixels in place */
+
+#define ROTBLOCK 64	/* Pixels on a side of blocks moved when rows become columns */
 
 /* Rotate an image by 90, 180, or 270 degrees, with an optional
  * reflection across the vertical or horizontal axis.
@@ -58,6 +63,7 @@ int	verbose;
 {
     int bitpix1, ny, nx, nax;
     int x1, y1, x2, y2, nbytes;
+    int ix, xb, yb, yend, nxb, nbpix, off0, dx, dy;
     char *rotimage;
     char *image;
     char history[128];
@@ -66,6 +72,7 @@ int	verbose;
 
     image = NULL;
     rotimage = NULL;
+    history[0] = (char) 0;
 
     if (rotate == 1)
 	rotate = 90;
@@ -147,6 +154,7 @@ int	verbose;
 		printf ("RotFITS: Illegal BITPIX (%d)\n", bitpix2);
 	    return (NULL);
 	}
+    nbpix = nbytes / (nx * ny);
 
     if (bitpix1 != bitpix2) {
 	sprintf (history,"Copy of image %s bits per pixel %d -> %d",
@@ -167,12 +175,23 @@ int	verbose;
 	    return (NULL);
 	    }
 
-	for (x1 = 0; x1 < nx; x1++) {
-	    x2 = x1 + xshift;
-	    for (y1 = 0; y1 < ny; y1++) {
-		y2 = y1 + yshift;
-		if (y2 < ny)
-		    movepix (image0,bitpix1,nx,x1,y1,image,bitpix2,nx,x2,y2);
+	/* Copy the part of each row which stays in the image */
+	x1 = 0;
+	if (xshift < 0)
+	    x1 = -xshift;
+	x2 = nx;
+	if (xshift > 0)
+	    x2 = nx - xshift;
+	for (y1 = 0; y1 < ny; y1++) {
+	    y2 = y1 + yshift;
+	    if (y2 < 0 || y2 >= ny || x2 <= x1)
+		continue;
+	    if (bitpix1 == bitpix2)
+		RotRow (image0, (y1 * nx) + x1, image, (y2 * nx) + x1 + xshift,
+			1, x2 - x1, nbpix);
+	    else {
+		for (ix = x1; ix < x2; ix++)
+		    movepix (image0,bitpix1,nx,ix,y1,image,bitpix2,nx,ix+xshift,y2);
 		}
 	    }
 	sprintf (history,"Copy of image %s shifted by dx=%d dy=%d",
@@ -180,6 +199,22 @@ int	verbose;
 	hputc (header,"HISTORY",history);
 	if (rotate == 0 && !mirror)
 	    return (image);
+	bitpix1 = bitpix2;
+	}
+
+    /* Change the number of bits per pixel before moving pixels */
+    else if (bitpix1 != bitpix2) {
+	image = (char *) calloc (nbytes, 1);
+	if (image == NULL) {
+	    if (verbose)
+		printf ("RotFITS: Cannot allocate %d bytes for new image\n", nbytes);
+	    return (NULL);
+	    }
+	for (y1 = 0; y1 < ny; y1++) {
+	    for (x1 = 0; x1 < nx; x1++)
+		movepix (image0,bitpix1,nx,x1,y1,image,bitpix2,nx,x1,y1);
+	    }
+	bitpix1 = bitpix2;
 	}
     else
 	image = image0;
@@ -189,172 +224,376 @@ int	verbose;
     if (rotimage == NULL) {
 	if (verbose)
 	    printf ("RotFITS: Cannot allocate %d bytes for new image\n", nbytes);
+	if (image != image0)
+	    free (image);
 	return (NULL);
 	}
 
+    /* Move pixels in rows or in blocks if rows become columns */
+    if (RotMap (filename, rotate, mirror, nx, ny, &off0, &dx, &dy, history)) {
+	if (dx == 1 || dx == -1) {
+	    for (y1 = 0; y1 < ny; y1++)
+		RotRow (image, y1 * nx, rotimage, off0 + (y1 * dy), dx, nx,
+			nbpix);
+	    }
+	else {
+	    for (yb = 0; yb < ny; yb = yb + ROTBLOCK) {
+		yend = yb + ROTBLOCK;
+		if (yend > ny)
+		    yend = ny;
+		for (xb = 0; xb < nx; xb = xb + ROTBLOCK) {
+		    nxb = nx - xb;
+		    if (nxb > ROTBLOCK)
+			nxb = ROTBLOCK;
+		    for (y1 = yb; y1 < yend; y1++)
+			RotRow (image, (y1 * nx) + xb, rotimage,
+				off0 + (y1 * dy) + (xb * dx), dx, nxb, nbpix);
+		    }
+		}
+	    }
+	if (history[0] != (char) 0)
+	    hputc (header,"HISTORY",history);
+	}
+
+    /* Exchange axis lengths if image was rotated by 90 or 270 degrees */
+    if ((rotate >= 45 && rotate < 135) || (rotate >= 225 && rotate < 315)) {
+	hputi4 (header,"NAXIS1",ny);
+	hputi4 (header,"NAXIS2",nx);
+	}
+    if (image != image0)
+	free (image);
+    
+    if (verbose)
+	fprintf (stderr,"%s\n",history);
+
+    return (rotimage);
+}
+
+
+/* Rotate an image by 180 degrees and/or reflect it across the vertical or
+ * horizontal axis in place, moving no pixel more than once.
+ * Return 1 if the image was changed, or 0 if it could not be changed in
+ * place because rows become columns or BITPIX changes.
+ */
+
+int
+FlipFITS (pathname,header,image,rotate,mirror,bitpix2,rotwcs,verbose)
+
+char	*pathname;	/* Name of file which is being changed */
+char	*header;	/* FITS header */
+char	*image;		/* Image pixels, changed in place */
+int	rotate;		/* Angle to by which to rotate image (0 or 180) */
+int	mirror;		/* Reflect image around 1=vertical, 2=horizontal axis */
+int	bitpix2;	/* Number of bits per pixel in output image, 0=same */
+int	rotwcs;		/* If not =0, rotate WCS keywords, else leave them */
+int	verbose;
+
+{
+    int bitpix, nx, ny, nbpix, off0, dx, dy, y1, y2, nbrow;
+    char history[128];
+    char *filename, *row;
+
+    if (rotate == 2)
+	rotate = 180;
+    else if (rotate < 0)
+	rotate = rotate + 360;
+    if (rotate != 0 && rotate != 180)
+	return (0);
+
+    filename = strrchr (pathname,'/');
+    if (filename)
+	filename = filename + 1;
+    else
+	filename = pathname;
+
+    if (hgeti4 (header,"NAXIS1",&nx) < 1 || hgeti4 (header,"NAXIS2",&ny) < 1)
+	return (0);
+    bitpix = 16;
+    hgeti4 (header,"BITPIX", &bitpix);
+    if (bitpix2 != 0 && bitpix2 != bitpix)
+	return (0);
+    nbpix = bitpix / 8;
+    if (nbpix < 0)
+	nbpix = -nbpix;
+    if (nbpix != 1 && nbpix != 2 && nbpix != 4 && nbpix != 8)
+	return (0);
+
+    if (!RotMap (filename, rotate, mirror, nx, ny, &off0, &dx, &dy, history))
+	return (0);
+
+    /* Rotate WCS fields in header */
+    if (rotwcs && (rotate != 0 || mirror))
+	RotWCSFITS (header, rotate, mirror, verbose);
+
+    /* Reverse the order of pixels in each row */
+    if (dx == -1 && dy == nx) {
+	for (y1 = 0; y1 < ny; y1++)
+	    RevRow (image, y1 * nx, nx, nbpix);
+	}
+
+    /* Exchange rows from top and bottom of image */
+    else if (dx == 1 && dy == -nx) {
+	nbrow = nx * nbpix;
+	if ((row = (char *) malloc (nbrow)) == NULL) {
+	    if (verbose)
+		printf ("FlipFITS: Cannot allocate %d bytes for row\n", nbrow);
+	    return (0);
+	    }
+	for (y1 = 0, y2 = ny - 1; y1 < y2; y1++, y2--) {
+	    memcpy (row, image + (y1 * nbrow), nbrow);
+	    memcpy (image + (y1 * nbrow), image + (y2 * nbrow), nbrow);
+	    memcpy (image + (y2 * nbrow), row, nbrow);
+	    }
+	free (row);
+	}
+
+    /* Reverse the order of all of the pixels */
+    else if (dx == -1 && dy == -nx)
+	RevRow (image, 0, nx * ny, nbpix);
+
+    if (history[0] != (char) 0) {
+	hputc (header,"HISTORY",history);
+	if (verbose)
+	    fprintf (stderr,"%s\n",history);
+	}
+    return (1);
+}
+
+
+/* Set where pixels move when an image is rotated and/or reflected.
+ * Pixel x,y (zero-based) moves to offset off0 + x*dx + y*dy in the new image.
+ * Return 0 if no pixels move, else 1.
+ */
+
+static int
+RotMap (filename, rotate, mirror, nx, ny, off0, dx, dy, history)
+
+char	*filename;	/* Name of file for history */
+int	rotate;		/* Angle to by which to rotate image (0, 90, 180, 270) */
+int	mirror;		/* Reflect image around 1=vertical, 2=horizontal axis */
+int	nx, ny;		/* Dimensions of image before rotation */
+int	*off0;		/* Offset of first pixel in new image (returned) */
+int	*dx;		/* Offset change for each column (returned) */
+int	*dy;		/* Offset change for each row (returned) */
+char	*history;	/* HISTORY line for header (returned) */
+
+{
+    history[0] = (char) 0;
+
     /* Mirror image without rotation */
     if (rotate < 45 && rotate > -45) {
 	if (mirror == 1) {
-	    for (x1 = 0; x1 < nx; x1++) {
-		x2 = nx - x1 - 1;
-		for (y1 = 0; y1 < ny; y1++) {
-		    movepix (image,bitpix1,nx,x1,y1,rotimage,bitpix2,nx,x2,y1);
-		    }
-		}
+	    *off0 = nx - 1;
+	    *dx = -1;
+	    *dy = nx;
 	    sprintf (history,"Copy of image %s reflected",filename);
-	    hputc (header,"HISTORY",history);
 	    }
 	else if (mirror == 2) {
-	    for (y1 = 0; y1 < ny; y1++) {
-		y2 = ny - y1 - 1;
-		for (x1 = 0; x1 < nx; x1++) {
-		    movepix (image,bitpix1,nx,x1,y1,rotimage,bitpix2,nx,x1,y2);
-		    }
-		}
+	    *off0 = (ny - 1) * nx;
+	    *dx = 1;
+	    *dy = -nx;
 	    sprintf (history,"Copy of image %s flipped",filename);
-	    hputc (header,"HISTORY",history);
 	    }
 	else {
-	    for (y1 = 0; y1 < ny; y1++) {
-		for (x1 = 0; x1 < nx; x1++) {
-		    movepix (image,bitpix1,nx,x1,y1,rotimage,bitpix2,nx,x1,y1);
-		    }
-		}
+	    *off0 = 0;
+	    *dx = 1;
+	    *dy = nx;
 	    }
 	}
 
     /* Rotate by 90 degrees */
     else if (rotate >= 45 && rotate < 135) {
 	if (mirror == 1) {
-	    for (y1 = 0; y1 < ny; y1++) {
-		x2 = ny - y1 - 1;
-		for (x1 = 0; x1 < nx; x1++) {
-		    y2 = nx - x1 - 1;
-		    movepix (image,bitpix1,nx,x1,y1,rotimage,bitpix2,ny,x2,y2);
-		    }
-		}
+	    *off0 = (nx * ny) - 1;
+	    *dx = -ny;
+	    *dy = -1;
 	    sprintf (history,"Copy of image %s reflected, rotated 90 degrees",
 		     filename);
-            hputc (header,"HISTORY",history);
 	    }
 	else if (mirror == 2) {
-	    for (y1 = 0; y1 < ny; y1++) {
-		for (x1 = 0; x1 < nx; x1++) {
-		    movepix (image,bitpix1,nx,x1,y1,rotimage,bitpix2,ny,y1,x1);
-		    }
-		}
+	    *off0 = 0;
+	    *dx = ny;
+	    *dy = 1;
 	    sprintf (history,"Copy of image %s flipped, rotated 90 degrees",
 		     filename);
-            hputc (header,"HISTORY",history);
 	    }
 	else {
-	    for (y1 = 0; y1 < ny; y1++) {
-		x2 = ny - y1 - 1;
-		for (x1 = 0; x1 < nx; x1++) {
-		    y2 = x1;
-		    movepix (image,bitpix1,nx,x1,y1,rotimage,bitpix2,ny,x2,y2);
-		    }
-		}
+	    *off0 = ny - 1;
+	    *dx = ny;
+	    *dy = -1;
 	    sprintf (history,"Copy of image %s rotated 90 degrees",filename);
-            hputc (header,"HISTORY",history);
 	    }
-	hputi4 (header,"NAXIS1",ny);
-	hputi4 (header,"NAXIS2",nx);
 	}
 
     /* Rotate by 180 degrees */
     else if (rotate >= 135 && rotate < 225) {
 	if (mirror == 1) {
-	    for (y1 = 0; y1 < ny; y1++) {
-		y2 = ny - y1 - 1;
-		for (x1 = 0; x1 < nx; x1++) {
-		    movepix (image,bitpix1,nx,x1,y1,rotimage,bitpix2,nx,x1,y2);
-		    }
-		}
+	    *off0 = (ny - 1) * nx;
+	    *dx = 1;
+	    *dy = -nx;
 	    sprintf (history,"Copy of image %s reflected, rotated 180 degrees",
 		     filename);
-            hputc (header,"HISTORY",history);
 	    }
 	else if (mirror == 2) {
-	    for (x1 = 0; x1 < nx; x1++) {
-		x2 = nx - x1 - 1;
-		for (y1 = 0; y1 < ny; y1++) {
-		    movepix (image,bitpix1,nx,x1,y1,rotimage,bitpix2,nx,x2,y1);
-		    }
-		}
+	    *off0 = nx - 1;
+	    *dx = -1;
+	    *dy = nx;
 	    sprintf (history,"Copy of image %s flipped, rotated 180 degrees",
 		     filename);
-            hputc (header,"HISTORY",history);
 	    }
 	else {
-	    for (y1 = 0; y1 < ny; y1++) {
-		y2 = ny - y1 - 1;
-		for (x1 = 0; x1 < nx; x1++) {
-		    x2 = nx - x1 - 1;
-		    movepix (image,bitpix1,nx,x1,y1,rotimage,bitpix2,nx,x2,y2);
-		    }
-		}
+	    *off0 = (nx * ny) - 1;
+	    *dx = -1;
+	    *dy = -nx;
 	    sprintf (history,"Copy of image %s rotated 180 degrees",filename);
-            hputc (header,"HISTORY",history);
 	    }
 	}
 
     /* Rotate by 270 degrees */
     else if (rotate >= 225 && rotate < 315) {
 	if (mirror == 1) {
-	    for (y1 = 0; y1 < ny; y1++) {
-		for (x1 = 0; x1 < nx; x1++) {
-		    movepix (image,bitpix1,nx,x1,y1,rotimage,bitpix2,ny,y1,x1);
-		    }
-		}
+	    *off0 = 0;
+	    *dx = ny;
+	    *dy = 1;
 	    sprintf (history,"Copy of image %s reflected, rotated 270 degrees",
 		     filename);
-            hputc (header,"HISTORY",history);
 	    }
 	else if (mirror == 2) {
-	    for (y1 = 0; y1 < ny; y1++) {
-		x2 = ny - y1 - 1;
-		for (x1 = 0; x1 < nx; x1++) {
-		    y2 = nx - x1 - 1;
-		    movepix (image,bitpix1,nx,x1,y1,rotimage,bitpix2,ny,x2,y2);
-		    }
-		}
+	    *off0 = (nx * ny) - 1;
+	    *dx = -ny;
+	    *dy = -1;
 	    sprintf (history,"Copy of image %s flipped, rotated 270 degrees",
 		     filename);
-            hputc (header,"HISTORY",history);
 	    }
 	else {
-	    for (y1 = 0; y1 < ny; y1++) {
-		x2 = y1;
-		for (x1 = 0; x1 < nx; x1++) {
-		    y2 = nx - x1 - 1;
-		    movepix (image,bitpix1,nx,x1,y1,rotimage,bitpix2,ny,x2,y2);
-		    }
-		}
+	    *off0 = (nx - 1) * ny;
+	    *dx = -ny;
+	    *dy = 1;
 	    sprintf (history,"Copy of image %s rotated 270 degrees",filename);
-            hputc (header,"HISTORY",history);
 	    }
-	hputi4 (header,"NAXIS1",ny);
-	hputi4 (header,"NAXIS2",nx);
 	}
 
     /* If rotating by more than 315 degrees, assume top-bottom reflection */
     else if (rotate >= 315 && mirror) {
-	for (y1 = 0; y1 < ny; y1++) {
-	    for (x1 = 0; x1 < nx; x1++) {
-		x2 = y1;
-		y2 = x1;
-		movepix (image,bitpix1,nx,x1,y1,rotimage,bitpix2,ny,x2,y2);
-		}
-	    }
+	*off0 = 0;
+	*dx = ny;
+	*dy = 1;
 	sprintf (history,"Copy of image %s reflected top to bottom",filename);
-        hputc (header,"HISTORY",history);
 	}
-    
-    if (verbose)
-	fprintf (stderr,"%s\n",history);
+    else
+	return (0);
 
-    return (rotimage);
+    return (1);
+}
+
+
+/* Copy a run of pixels from one image to another, stepping dx pixels
+ * in the output image for each pixel in the input image */
+
+static void
+RotRow (image1, pix1, image2, pix2, dx, npix, nbpix)
+
+char	*image1;	/* Input image */
+int	pix1;		/* Offset of first input pixel */
+char	*image2;	/* Output image */
+int	pix2;		/* Offset of first output pixel */
+int	dx;		/* Output pixels between successive pixels */
+int	npix;		/* Number of pixels to copy */
+int	nbpix;		/* Number of bytes per pixel */
+
+{
+    unsigned char *imc1, *imc2, *imcend;
+    short *ims1, *ims2, *imsend;
+    int *imi1, *imi2, *imiend;
+    double *imd1, *imd2, *imdend;
+
+    if (dx == 1) {
+	memcpy (image2 + (pix2 * nbpix), image1 + (pix1 * nbpix),
+		npix * nbpix);
+	return;
+	}
+
+    switch (nbpix) {
+	case 1:
+	    imc1 = (unsigned char *) image1 + pix1;
+	    imc2 = (unsigned char *) image2 + pix2;
+	    imcend = imc1 + npix;
+	    for (; imc1 < imcend; imc1++, imc2 += dx)
+		*imc2 = *imc1;
+	    break;
+	case 2:
+	    ims1 = (short *) image1 + pix1;
+	    ims2 = (short *) image2 + pix2;
+	    imsend = ims1 + npix;
+	    for (; ims1 < imsend; ims1++, ims2 += dx)
+		*ims2 = *ims1;
+	    break;
+	case 4:
+	    imi1 = (int *) image1 + pix1;
+	    imi2 = (int *) image2 + pix2;
+	    imiend = imi1 + npix;
+	    for (; imi1 < imiend; imi1++, imi2 += dx)
+		*imi2 = *imi1;
+	    break;
+	case 8:
+	    imd1 = (double *) image1 + pix1;
+	    imd2 = (double *) image2 + pix2;
+	    imdend = imd1 + npix;
+	    for (; imd1 < imdend; imd1++, imd2 += dx)
+		*imd2 = *imd1;
+	    break;
+	}
+    return;
+}
+
+
+/* Reverse the order of a run of pixels in place */
+
+static void
+RevRow (image, pix1, npix, nbpix)
+
+char	*image;		/* Image */
+int	pix1;		/* Offset of first pixel */
+int	npix;		/* Number of pixels to reverse */
+int	nbpix;		/* Number of bytes per pixel */
+
+{
+    unsigned char *imc1, *imc2, ctemp;
+    short *ims1, *ims2, stemp;
+    int *imi1, *imi2, itemp;
+    double *imd1, *imd2, dtemp;
+
+    switch (nbpix) {
+	case 1:
+	    imc1 = (unsigned char *) image + pix1;
+	    imc2 = imc1 + npix - 1;
+	    for (; imc1 < imc2; imc1++, imc2--) {
+		ctemp = *imc1; *imc1 = *imc2; *imc2 = ctemp;
+		}
+	    break;
+	case 2:
+	    ims1 = (short *) image + pix1;
+	    ims2 = ims1 + npix - 1;
+	    for (; ims1 < ims2; ims1++, ims2--) {
+		stemp = *ims1; *ims1 = *ims2; *ims2 = stemp;
+		}
+	    break;
+	case 4:
+	    imi1 = (int *) image + pix1;
+	    imi2 = imi1 + npix - 1;
+	    for (; imi1 < imi2; imi1++, imi2--) {
+		itemp = *imi1; *imi1 = *imi2; *imi2 = itemp;
+		}
+	    break;
+	case 8:
+	    imd1 = (double *) image + pix1;
+	    imd2 = imd1 + npix - 1;
+	    for (; imd1 < imd2; imd1++, imd2--) {
+		dtemp = *imd1; *imd1 = *imd2; *imd2 = dtemp;
+		}
+	    break;
+	}
+    return;
 }
 
 
@@ -657,4 +896,8 @@ int	verbose;	/* Print progress if 1 */
  * Aug 17 2005	Add mirror = 2 flag indicating a flip across x axis
  *
  * Jun 26 2008	Shift pixels if either xshift or yshift is not zero
+ *
+ * Oct 19 2026	Move pixels by rows or blocks with RotRow() instead of movepix()
+ * Oct 19 2026	Add FlipFITS() to rotate by 180 degrees or reflect in place
+ * Oct 19 2026	Rotate shifted image using its new BITPIX and free it after
  */
@@ -1,8 +1,8 @@
 /*** File libwcs/imsetwcs.c
- *** May 19, 2010
+ *** October 18, 2026
  *** By Jessica Mink, jmink@cfa.harvard.edu (based on UIowa code)
  *** Harvard-Smithsonian Center for Astrophysics
- *** Copyright (C) 1996-2010
+ *** Copyright (C) 1996-2026
  *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
 
     This library is free software; you can redistribute it and/or
@@ -41,10 +41,12 @@ extern int FindStars();
 extern int TriMatch();
 extern int FocasMatch();
 extern int StarMatch();
+extern int QuadMatch();
 extern int ReadMatch();
 extern int FitMatch();
 extern int WCSMatch();
 extern int FitPlate();
+extern int FitSIP();
 extern struct WorldCoor *GetFITSWCS ();
 extern char *getimcat();
 extern void SetFITSWCS();
@@ -70,6 +72,7 @@ static int nofit = 0;		/* if =1, do not fit WCS */
 static int maxcat = MAXSTARS;	/* Maximum number of catalog stars to use */
 static int fitwcs = 1;		/* If 1, fit WCS, else use current WCS */
 static int fitplate = 0;	/* If 1, fit polynomial, else do not */
+static int fitsip = 0;		/* If > 0, order of SIP distortion to fit */
 static double imfrac0 = 0.0;	/* If > 0.0, multiply image dimensions
 					   by this for search */
 static int iterate0 = 0;	/* If 1, search field again */
@@ -83,8 +86,13 @@ static int sortmag = 1;		/* Magnitude by which to sort stars */
 static int minstars0 = MINSTARS;	/* Number of star matches for fit */
 static int nmagmax = MAXNMAG;	/* Maximum number of magnitudes (etc.) per entry */
 static int nxydec = NXYDEC;	/* Number of decimal places in image coordinates */
+static int nrefine = 0;		/* Outlier rejection rounds after match */
+static int quadmatch = 0;	/* If 1, match quads without initial WCS */
+static double refclip = REFCLIP;	/* Reject matches this many sigma off */
 static void PrintRes();
 static void CompRes();
+static int RefineWCS();
+static void RefineRow();
 extern void SetFITSPlate();
 
 static char *kwt = NULL;        /* Keyword returned by ctgread() */
@@ -568,8 +576,11 @@ getstars:
 
 	/* Match offsets between all pairs of image stars and reference stars
 	   and fit WCS to matches */
-	nbin = StarMatch (nbs,sx,sy,refcat,nbg,gnum,gra,gdec,goff,gx,gy,
-			  tolerance,wcs,verbose);
+	if (quadmatch)
+	    nbin = QuadMatch (nbs,sx,sy,nbg,gra,gdec,tolerance,wcs,verbose);
+	else
+	    nbin = StarMatch (nbs,sx,sy,refcat,nbg,gnum,gra,gdec,goff,gx,gy,
+			      tolerance,wcs,verbose);
 
 	if (nbin < 0) {
 	    fprintf (stderr, "Star registration failed.\n");
@@ -703,6 +714,14 @@ match:
 	hputi4 (header, "WCSMATCH", nmatch);
 	hputi4 (header, "WCSNREF", nmax);
 	hputnr8 (header, "WCSTOL", 4, tolerance);
+
+	/* Drop outlying matches and refine the fit to the rest */
+	if (nrefine > 0 && fitwcs && !iterate && !recenter) {
+	    nmatch = RefineWCS (wcs, nmatch, sx1, sy1, sm1, gra1, gdec1,
+				gm1, gnum1, verbose);
+	    hputi4 (header, "WCSMATCH", nmatch);
+	    SetFITSWCS (header, wcs);
+	    }
 	if (rprint) {
 
 	    PrintRes (header,wcs,nmatch,sx1,sy1,sm1,gra1,gdec1,gm1,gnum1,
@@ -751,6 +770,39 @@ match:
 		SetFITSPlate (header, wcs);
 		}
 	    }
+
+	/* Fit the matched catalog and image stars with SIP distortion */
+	else if (!iterate && !recenter && fitsip) {
+
+	    if (verbose)
+		fprintf (stderr,"Fitting matched stars with order %d SIP distortion\n",
+			 fitsip);
+
+	    if (FitSIP (wcs, sx1, sy1, gra1, gdec1, nmatch, fitsip, 0,
+			verbose))
+		fprintf (stderr,"FitSIP cannot fit matches\n");
+
+	    /* Print the new residuals */
+	    else {
+		SetFITSWCS (header, wcs);
+		SetFITSDistort (header, wcs);
+		if (rprint) {
+		    PrintRes (header,wcs,nmatch,sx1,sy1,sm1,gra1,gdec1,gm1,
+			      gnum1,refcat,verbose);
+		    if (refcatname == NULL)
+			printf ("# nmatch= %d nstars= %d in %s niter= %d\n",
+				nmatch, nmax, matchcat, niter);
+		    else if (strlen (imcatname) == 0)
+			printf ("# nmatch= %d nstars= %d between %s and %s niter= %d\n",
+				nmatch, nmax, refcatname, filename, niter);
+		    else
+			printf ("# nmatch= %d nstars= %d between %s and %s niter= %d\n",
+				nmatch, nmax, refcatname, imcatname, niter);
+		    }
+		else
+		    CompRes (header,wcs,nmatch,sx1,sy1,sm1,gra1,gdec1,gm1,gnum1);
+		}
+	    }
 	}
 
     else {
@@ -1117,6 +1169,285 @@ double	*gnum1;		/* Reference catalog numbers */
     return;
 }
 
+/* Reject outlying matches and refine the WCS fit to those which remain.
+ * Reference stars are projected onto the image once with the current WCS,
+ * and a linear correction from image to reference star pixel positions is
+ * fit by least squares: offset, scale and rotation if the WCS uses CDELT
+ * and CROTA, or all six terms if it uses a CD matrix.  Each round drops
+ * matches more than refclip times the rms residual from the fit and
+ * subtracts their terms from the normal equations instead of rebuilding
+ * them.  The match lists are packed down to the kept stars, whose number
+ * is returned. */
+
+static int
+RefineWCS (wcs, nmatch, sx1, sy1, sm1, gra1, gdec1, gm1, gnum1, verbose)
+
+struct WorldCoor *wcs;	/* Image World Coordinate System (updated) */
+int	nmatch;		/* Number of image/catalog matches */
+double	*sx1, *sy1;	/* Image star pixel coordinates */
+double	*sm1;		/* Plate magnitudes */
+double	*gra1, *gdec1;	/* Reference catalog sky coordinates */
+double	*gm1;		/* Reference catalog magnitudes */
+double	*gnum1;		/* Reference catalog numbers */
+int	verbose;	/* Print rejections and rms for each round if 1 */
+
+{
+    double alpha[36], alphai[36], beta[6], vp[6], u[12], t[2];
+    double a[4], ai[4], cd[4], cdelt[2], crpix[2];
+    double *ux, *uy, *gx, *gy, *dr, *cdp;
+    double x, y, ex, ey, sumr, rms, rlim, scale, det, rot, ra, dec;
+    char *ok;
+    int i, j, k, np, nfit, nkeep, nmin, nrej, iter, goff;
+
+    if (nmatch < 2 || wcs->ncoeff1 > 0 || wcs->prjcode == WCS_PLT ||
+	wcs->coorflip)
+	return (nmatch);
+    if (wcs->rotmat)
+	np = 6;
+    else
+	np = 4;
+    nmin = minstars0;
+    if (nmin < np)
+	nmin = np;
+    if (nmatch < nmin)
+	return (nmatch);
+
+    ux = (double *) calloc (nmatch, sizeof (double));
+    uy = (double *) calloc (nmatch, sizeof (double));
+    gx = (double *) calloc (nmatch, sizeof (double));
+    gy = (double *) calloc (nmatch, sizeof (double));
+    dr = (double *) calloc (nmatch, sizeof (double));
+    ok = (char *) calloc (nmatch, sizeof (char));
+    if (ux == NULL || uy == NULL || gx == NULL || gy == NULL || dr == NULL ||
+	ok == NULL) {
+	fprintf (stderr, "RefineWCS: Cannot allocate %d matches\n", nmatch);
+	if (ux) free (ux);
+	if (uy) free (uy);
+	if (gx) free (gx);
+	if (gy) free (gy);
+	if (dr) free (dr);
+	if (ok) free (ok);
+	return (nmatch);
+	}
+
+    /* Project reference stars with the WCS from the match, and normalize
+       pixel offsets from the reference pixel to condition the fit */
+    crpix[0] = wcs->crpix[0];
+    crpix[1] = wcs->crpix[1];
+    scale = 0.0;
+    for (i = 0; i < nmatch; i++) {
+	wcs2pix (wcs, gra1[i], gdec1[i], &x, &y, &goff);
+	gx[i] = x - crpix[0];
+	gy[i] = y - crpix[1];
+	ux[i] = sx1[i] - crpix[0];
+	uy[i] = sy1[i] - crpix[1];
+	ok[i] = !goff;
+	if (fabs (ux[i]) > scale) scale = fabs (ux[i]);
+	if (fabs (uy[i]) > scale) scale = fabs (uy[i]);
+	}
+    if (scale <= 0.0)
+	scale = 1.0;
+
+    /* Accumulate normal equations; each star adds an x and a y row */
+    for (j = 0; j < np * np; j++)
+	alpha[j] = 0.0;
+    for (j = 0; j < np; j++)
+	beta[j] = 0.0;
+    nkeep = 0;
+    for (i = 0; i < nmatch; i++) {
+	gx[i] = gx[i] / scale;
+	gy[i] = gy[i] / scale;
+	ux[i] = ux[i] / scale;
+	uy[i] = uy[i] / scale;
+	if (ok[i]) {
+	    RefineRow (np, ux[i], uy[i], u);
+	    for (j = 0; j < np; j++) {
+		beta[j] += u[j] * gx[i] + u[np+j] * gy[i];
+		for (k = 0; k < np; k++)
+		    alpha[j*np+k] += u[j] * u[k] + u[np+j] * u[np+k];
+		}
+	    nkeep++;
+	    }
+	}
+
+    rms = 0.0;
+    nfit = 0;
+    for (iter = 0; iter <= nrefine && nkeep >= nmin; iter++) {
+	if (matinv (np, alpha, alphai))
+	    break;
+	for (j = 0; j < np; j++) {
+	    vp[j] = 0.0;
+	    for (k = 0; k < np; k++)
+		vp[j] += alphai[j*np+k] * beta[k];
+	    }
+	nfit++;
+
+	/* Squared residuals of kept matches from this fit */
+	sumr = 0.0;
+	for (i = 0; i < nmatch; i++) {
+	    if (ok[i]) {
+		RefineRow (np, ux[i], uy[i], u);
+		ex = -gx[i];
+		ey = -gy[i];
+		for (j = 0; j < np; j++) {
+		    ex += u[j] * vp[j];
+		    ey += u[np+j] * vp[j];
+		    }
+		dr[i] = ex * ex + ey * ey;
+		sumr += dr[i];
+		}
+	    }
+	rms = scale * sqrt (sumr / (double) nkeep);
+	if (iter == nrefine)
+	    break;
+
+	/* Subtract matches beyond the clipping limit from the normal equations */
+	rlim = refclip * rms / scale;
+	rlim = rlim * rlim;
+	nrej = 0;
+	for (i = 0; i < nmatch; i++) {
+	    if (ok[i] && dr[i] > rlim)
+		nrej++;
+	    }
+	if (nrej == 0 || nkeep - nrej < nmin)
+	    break;
+	for (i = 0; i < nmatch; i++) {
+	    if (ok[i] && dr[i] > rlim) {
+		RefineRow (np, ux[i], uy[i], u);
+		for (j = 0; j < np; j++) {
+		    beta[j] -= u[j] * gx[i] + u[np+j] * gy[i];
+		    for (k = 0; k < np; k++)
+			alpha[j*np+k] -= u[j] * u[k] + u[np+j] * u[np+k];
+		    }
+		ok[i] = 0;
+		}
+	    }
+	nkeep = nkeep - nrej;
+	if (verbose)
+	    fprintf (stderr,"RefineWCS: round %d rms %.3f pixels, %d of %d matches rejected\n",
+		     iter+1, rms, nrej, nkeep + nrej);
+	}
+
+    if (nfit > 0) {
+
+	/* Linear correction in pixels: catalog = a * image + t */
+	if (np == 6) {
+	    t[0] = vp[0] * scale;
+	    a[0] = vp[1];
+	    a[1] = vp[2];
+	    t[1] = vp[3] * scale;
+	    a[2] = vp[4];
+	    a[3] = vp[5];
+	    }
+	else {
+	    t[0] = vp[0] * scale;
+	    t[1] = vp[1] * scale;
+	    a[0] = vp[2];
+	    a[1] = -vp[3];
+	    a[2] = vp[3];
+	    a[3] = vp[2];
+	    }
+	det = a[0] * a[3] - a[1] * a[2];
+	ai[0] = a[3] / det;
+	ai[1] = -a[1] / det;
+	ai[2] = -a[2] / det;
+	ai[3] = a[0] / det;
+	x = crpix[0] - (ai[0] * t[0] + ai[1] * t[1]);
+	y = crpix[1] - (ai[2] * t[0] + ai[3] * t[1]);
+
+	/* Scale and rotate CDELT and CROTA, or multiply the CD matrix */
+	if (np == 4) {
+	    cdelt[0] = wcs->cdelt[0] * sqrt (det);
+	    cdelt[1] = wcs->cdelt[1] * sqrt (det);
+	    if (cdelt[0] * cdelt[1] < 0.0)
+		rot = wcs->rot - raddeg (atan2 (vp[3], vp[2]));
+	    else
+		rot = wcs->rot + raddeg (atan2 (vp[3], vp[2]));
+	    cdp = NULL;
+	    }
+	else {
+	    cd[0] = wcs->cd[0] * a[0] + wcs->cd[1] * a[2];
+	    cd[1] = wcs->cd[0] * a[1] + wcs->cd[1] * a[3];
+	    cd[2] = wcs->cd[2] * a[0] + wcs->cd[3] * a[2];
+	    cd[3] = wcs->cd[2] * a[1] + wcs->cd[3] * a[3];
+	    cdelt[0] = 0.0;
+	    cdelt[1] = 0.0;
+	    rot = 0.0;
+	    cdp = cd;
+	    }
+
+	/* Move the reference pixel, which keeps the projection center, then
+	   move it back if the center can be recomputed in the WCS system */
+	(void) wcsreset (wcs, x, y, wcs->crval[0], wcs->crval[1],
+			 cdelt[0], cdelt[1], rot, cdp);
+	if (wcs->sysout == wcs->syswcs &&
+	    (wcs->eqout == 0.0 || wcs->eqout == wcs->equinox)) {
+	    pix2wcs (wcs, crpix[0], crpix[1], &ra, &dec);
+	    (void) wcsreset (wcs, crpix[0], crpix[1], ra, dec,
+			     cdelt[0], cdelt[1], rot, cdp);
+	    }
+	}
+
+    /* Pack kept matches to the front of the lists */
+    nkeep = 0;
+    for (i = 0; i < nmatch; i++) {
+	if (ok[i]) {
+	    sx1[nkeep] = sx1[i];
+	    sy1[nkeep] = sy1[i];
+	    sm1[nkeep] = sm1[i];
+	    gra1[nkeep] = gra1[i];
+	    gdec1[nkeep] = gdec1[i];
+	    gm1[nkeep] = gm1[i];
+	    gnum1[nkeep] = gnum1[i];
+	    nkeep++;
+	    }
+	}
+    if (verbose)
+	fprintf (stderr,"RefineWCS: %d of %d matches kept after %d fits, rms %.3f pixels\n",
+		 nkeep, nmatch, nfit, rms);
+
+    free (ux);
+    free (uy);
+    free (gx);
+    free (gy);
+    free (dr);
+    free (ok);
+    return (nkeep);
+}
+
+
+/* Terms of the x and y rows of the linear correction for one star */
+
+static void
+RefineRow (np, x, y, u)
+
+int	np;		/* 6 for a full linear fit, 4 for scale and rotation */
+double	x, y;		/* Normalized image pixel offsets */
+double	*u;		/* x row in first np terms, y row in next np */
+{
+    int j;
+
+    for (j = 0; j < 2 * np; j++)
+	u[j] = 0.0;
+    if (np == 6) {
+	u[0] = 1.0;
+	u[1] = x;
+	u[2] = y;
+	u[9] = 1.0;
+	u[10] = x;
+	u[11] = y;
+	}
+    else {
+	u[0] = 1.0;
+	u[2] = x;
+	u[3] = -y;
+	u[5] = 1.0;
+	u[6] = y;
+	u[7] = x;
+	}
+    return;
+}
+
 /* Subroutines to initialize various parameters */
 
 void
@@ -1157,6 +1488,11 @@ setfitplate (nc)
 int nc;
 { fitplate = nc; return; }
 
+void
+setfitsip (order)
+int order;
+{ fitsip = order; return; }
+
 void
 setminstars (minstars)
 int minstars;
@@ -1224,6 +1560,25 @@ void
 setmagfit ()
 {magfit++; return;}
 
+/* Number of outlier rejection rounds after matching (0 for none) */
+void
+setnrefine (nround)
+int nround;
+{ nrefine = nround; return; }
+
+/* Match quads of stars instead of using the initial scale and rotation */
+void
+setquadmatch (quad)
+int quad;
+{ quadmatch = quad; return; }
+
+/* Reject matches more than this many times the rms residual from the fit */
+void
+setrefclip (clip)
+double clip;
+{ if (clip > 0.0) refclip = clip;
+  return; }
+
 /* Feb 29 1996	New program
  * Apr 30 1996	Add FOCAS-style catalog matching
  * May  1 1996	Add initial image center from command line
@@ -1405,4 +1760,8 @@ setmagfit ()
  * Nov 13 2009	Print catalog magnitude name  in residual output header
  *
  * May 19 2010	Allocate NMAXMAG instead of number of magnitudes, nmag
+ *
+ * Oct 18 2026	Add setfitsip() to fit SIP distortion to matched stars
+ * Oct 18 2026	Add RefineWCS() to reject outliers from match with incremental refits
+ * Oct 18 2026	Add setquadmatch() to match with QuadMatch() instead of StarMatch()
  */
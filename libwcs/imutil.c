@@ -1,8 +1,8 @@
 /*** File libwcs/imutil.c
- *** June 17, 2014
+ *** October 19, 2026
  *** By Jessica Mink, jmink@cfa.harvard.edu
  *** Harvard-Smithsonian Center for Astrophysics
- *** Copyright (C) 2006-2014
+ *** Copyright (C) 2006-2026
  *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
  */
 
@@ -53,18 +53,25 @@
  * gausspixr8 (image, ival, ix, iy, nx, ny)
  *	Compute Gaussian-weighted mean of a square group of pixels
  *
+ * setshrinkproc (nproc)
+ *	Set number of processes shrinking bands of rows of an image
  * char *ShrinkFITSImage (header, image, xfactor, yfactor, mean, bitpix, nlog)
  *	Return image buffer reduced by a given factor
  * char *ShrinkFITSHeader (filename, header, xfactor, yfactor, mean, bitpix)
  		Return image header with dimensions reduced by a given factor
  * double PhotPix (imbuff,header,cx,cy,rad,sumw)
  *	Compute counts within a strictly defined circular aperture
+ * int PhotStars (header,image,ns,xs,ys,nrad,rad,rin,rout,flux,area,sky)
+ *	Compute background-subtracted counts for many stars and apertures
  */
 
 #include <string.h>             /* NULL, strlen, strstr, strcpy */
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #include "fitsfile.h"
 
 #define MEDIAN 1
@@ -2382,6 +2389,18 @@ int	nx,ny;	/* Number of columns and rows in image */
 }
 
 
+static int nshrink = 1;		/* Number of processes shrinking an image */
+static int ShrinkRows();
+static double ShrinkMedian();
+
+/* Set number of processes shrinking bands of rows of an image */
+
+void
+setshrinkproc (nproc)
+int nproc;
+{ nshrink = (nproc < 1) ? 1 : nproc; return; }
+
+
 /* Return image buffer reduced by a given factor */
 
 char *
@@ -2391,7 +2410,7 @@ char	*header;	/* Image header */
 char	*image;		/* Image bytes to be filtered */
 int	xfactor;	/* Factor by which to reduce horizontal size of image */
 int	yfactor;	/* Factor by which to reduce vertical size of image */
-int	mean;		/* If 0, sum pixels, else substitute mean */
+int	mean;		/* If 0, sum pixels, 1 substitute mean, 2 median */
 int	bitpix;		/* Number of bits per output pixel (neg=f.p.) */
 int	nlog;		/* Logging interval in lines */
 
@@ -2400,26 +2419,23 @@ int	nlog;		/* Logging interval in lines */
 char	*image1;
 int	nx,ny;		/* Number of columns and rows in input image */
 int	nx1,ny1;	/* Number of columns and rows in input image */
-int	ix,iy;		/* Output pixel coordinates */
-int	jx,jy;		/* Input pixel coordinates */
-int	kx, ky;
-int	nxf, nyf;
+int	xf, yf;		/* Factors used, 1 if axis is not longer than factor */
+int	jy1, jy2;	/* First and last+1 output rows of a band */
 int	npix1;		/* Number of pixels in output image */
+int	nbout;		/* Number of bytes per output pixel */
 int	bitsin;		/* Number of bits per input pixel (<0=floating point) */
 int	naxes;
-double	pixij;		/* Summed value of rebinned pixel */
+int	iwork, nwork, status, nbband;
 double	bzero, bscale;
-double	pixval, dnp;
-short	*buffi2 = NULL;
-int	*buffi4 = NULL;
-float	*buffr4 = NULL;
-double	*buffr8 = NULL;
+FILE	**fwork = NULL;	/* Rows returned by each worker process */
+pid_t	*pids = NULL;
 
     /* Get bits per pixel in input image */
     hgeti4 (header, "BITPIX", &bitsin);
     if (bitpix == 0) {
 	bitpix = bitsin;
-	mean = 1;
+	if (!mean)
+	    mean = 1;
 	}
 
     /* Get scaling of input image, if any */
@@ -2432,10 +2448,14 @@ double	*buffr8 = NULL;
     hgeti4 (header, "NAXIS1", &nx);
 
     /* Set horizontal axis for output image */
-    if (nx > xfactor)
+    if (nx > xfactor) {
 	nx1 = nx / xfactor;
-    else
+	xf = xfactor;
+	}
+    else {
 	nx1 = nx;
+	xf = 1;
+	}
 
     /* Get number of axes */
     hgeti4 (header, "NAXIS", &naxes);
@@ -2443,102 +2463,315 @@ double	*buffr8 = NULL;
     /* Set vertical axis for output image */
     if (naxes > 1) {
 	hgeti4 (header, "NAXIS2", &ny);
-	if (ny > yfactor)
+	if (ny > yfactor) {
 	    ny1 = ny / yfactor;
-	else
+	    yf = yfactor;
+	    }
+	else {
 	    ny1 = ny;
+	    yf = 1;
+	    }
 	}
     else {
 	ny = 1;
 	ny1 = 1;
+	yf = 1;
 	}
     npix1 = nx1 * ny1;
 
-    /* Allocate output image buffer and initialize pointer into it */
+    /* Allocate output image buffer */
     image1 = NULL;
-    if (bitpix == 16) {
-	image1 = (char *) calloc (npix1, sizeof (short));
-	buffi2 = (short *) image1;
-	}
-    else if (bitpix == 32) {
-	image1 = (char *) calloc (npix1, sizeof (int));
-	buffi4 = (int *) image1;
+    if (bitpix == 16)
+	nbout = sizeof (short);
+    else if (bitpix == 32)
+	nbout = sizeof (int);
+    else if (bitpix == -32)
+	nbout = sizeof (float);
+    else if (bitpix == -64)
+	nbout = sizeof (double);
+    else
+	return (NULL);
+    if ((image1 = (char *) calloc (npix1, nbout)) == NULL)
+	return (NULL);
+
+    /* Shrink bands of output rows in separate processes, each returning
+     * its rows through a temporary file; the last band is done here */
+    jy1 = 0;
+    nwork = 0;
+    if (nshrink > 1 && ny1 >= nshrink * 2) {
+	fwork = (FILE **) calloc (nshrink, sizeof (FILE *));
+	pids = (pid_t *) calloc (nshrink, sizeof (pid_t));
+	fflush (stdout);
+	fflush (stderr);
+	for (iwork = 0; iwork < nshrink - 1; iwork++) {
+	    if ((fwork[iwork] = tmpfile ()) == NULL) {
+		fprintf (stderr, "ShrinkFITSImage: Cannot create output for worker %d\n",
+			 iwork);
+		break;
+		}
+	    if ((pids[iwork] = fork ()) < 0) {
+		fprintf (stderr, "ShrinkFITSImage: Cannot start worker %d\n", iwork);
+		fclose (fwork[iwork]);
+		break;
+		}
+	    else if (pids[iwork] == 0) {
+		jy1 = (int) (((long) ny1 * iwork) / nshrink);
+		jy2 = (int) (((long) ny1 * (iwork+1)) / nshrink);
+		nbband = (jy2 - jy1) * nx1 * nbout;
+		if (ShrinkRows (image, bitsin, bzero, bscale, nx, xf, yf, nx1,
+				jy1, jy2, mean, bitpix, image1, 0) ||
+		    fwrite (image1 + ((long) jy1 * nx1 * nbout), 1, nbband,
+			    fwork[iwork]) < nbband ||
+		    fflush (fwork[iwork]) != 0)
+		    _exit (1);
+		_exit (0);
+		}
+	    nwork++;
+	    }
+	jy1 = (int) (((long) ny1 * nwork) / nshrink);
 	}
-    else if (bitpix == -32) {
-	image1 = (char *) calloc (npix1, sizeof (float));
-	buffr4 = (float *) image1;
+
+    /* Fill output buffer */
+    status = ShrinkRows (image, bitsin, bzero, bscale, nx, xf, yf, nx1,
+			 jy1, ny1, mean, bitpix, image1, nlog);
+
+    /* Collect rows from worker processes, shrinking them here if one fails */
+    for (iwork = 0; iwork < nwork; iwork++) {
+	int wstatus;
+	jy1 = (int) (((long) ny1 * iwork) / nshrink);
+	jy2 = (int) (((long) ny1 * (iwork+1)) / nshrink);
+	nbband = (jy2 - jy1) * nx1 * nbout;
+	if (waitpid (pids[iwork], &wstatus, 0) < 0 ||
+	    !WIFEXITED (wstatus) || WEXITSTATUS (wstatus) != 0 ||
+	    fseek (fwork[iwork], 0L, SEEK_SET) != 0 ||
+	    fread (image1 + ((long) jy1 * nx1 * nbout), 1, nbband,
+		   fwork[iwork]) < nbband) {
+	    fprintf (stderr, "ShrinkFITSImage: Worker %d failed; shrinking its rows here\n",
+		     iwork);
+	    if (ShrinkRows (image, bitsin, bzero, bscale, nx, xf, yf, nx1,
+			    jy1, jy2, mean, bitpix, image1, 0))
+		status = -1;
+	    }
+	fclose (fwork[iwork]);
+	}
+    if (fwork != NULL) {
+	free (fwork);
+	free (pids);
 	}
-    else if (bitpix == -64) {
-	image1 = (char *) calloc (npix1, sizeof (double));
-	buffr8 = (double *) image1;
+    if (nlog > 0)
+	fprintf (stderr,"\n");
+
+    if (status) {
+	free (image1);
+	return (NULL);
 	}
+    return (image1);
+}
 
-    /* Fill output buffer */
-    for (jy = 0; jy < ny1; jy++) {
-	for (jx = 0; jx < nx1; jx++) {
-	    pixij = 0.0;
-	    ky = (jy * yfactor);
-	    if (ky + yfactor > ny)
-		nyf = ny - ky + 1;
-	    else
-		nyf = yfactor;
-	    dnp = 0.0;
-	    for (iy = 0; iy < nyf; iy++) {
-		kx = (jx * xfactor);
-		if (kx + xfactor > nx)
-		    nxf = nx - kx + 1;
-		else
-		    nxf = xfactor;
-		for (ix = 0; ix < nxf; ix++) {
-		    pixval = getpix (image, bitsin, nx,ny,bzero,bscale,kx++,ky);
-		    pixij = pixij + pixval;
-		    dnp++;
+
+/* Shrink a band of rows, summing each input row into whole output rows */
+
+static int
+ShrinkRows (image, bitsin, bzero, bscale, nx, xf, yf, nx1, jy1, jy2, mean,
+	    bitpix, image1, nlog)
+
+char	*image;		/* Input image */
+int	bitsin;		/* Number of bits per input pixel (<0=floating point) */
+double	bzero, bscale;	/* Scaling of input pixels */
+int	nx;		/* Number of columns in input image */
+int	xf, yf;		/* Horizontal and vertical reduction factors */
+int	nx1;		/* Number of columns in output image */
+int	jy1, jy2;	/* First and last+1 output rows to fill */
+int	mean;		/* If 0, sum pixels, 1 substitute mean, 2 median */
+int	bitpix;		/* Number of bits per output pixel (neg=f.p.) */
+char	*image1;	/* Output image */
+int	nlog;		/* Logging interval in lines */
+
+{
+    double *dacc;	/* Sums for one output row */
+    double *row;	/* One input row */
+    double *vals = NULL; /* Values in each block for medians */
+    int *iacc = NULL;	/* Integer sums for one output row */
+    short *ims;
+    double *dr, *dv, pixij, dnp;
+    int intsum;		/* 1 if 16-bit pixels are summed as integers */
+    int jx, jy, ix, iy, nb, nrow, pix1;
+
+    nb = xf * yf;
+    dnp = (double) nb;
+    nrow = nx1 * xf;
+    dacc = (double *) calloc (nx1, sizeof (double));
+    row = (double *) calloc (nrow, sizeof (double));
+    if (dacc == NULL || row == NULL) {
+	fprintf (stderr, "ShrinkFITSImage: Cannot allocate %d-pixel rows\n", nrow);
+	return (-1);
+	}
+    if (mean == 2) {
+	vals = (double *) calloc (nx1 * nb, sizeof (double));
+	if (vals == NULL) {
+	    fprintf (stderr, "ShrinkFITSImage: Cannot allocate %d values\n",
+		     nx1 * nb);
+	    free (dacc);
+	    free (row);
+	    return (-1);
+	    }
+	}
+
+    /* Integer sums are exact if pixels are only offset by a whole number */
+    intsum = (bitsin == 16 && bscale == 1.0 && bzero == floor (bzero) &&
+	      mean != 2 && nb < 65536);
+    if (intsum)
+	iacc = (int *) calloc (nx1, sizeof (int));
+    if (intsum && iacc == NULL)
+	intsum = 0;
+
+    for (jy = jy1; jy < jy2; jy++) {
+	for (jx = 0; jx < nx1; jx++)
+	    dacc[jx] = 0.0;
+	if (intsum) {
+	    for (jx = 0; jx < nx1; jx++)
+		iacc[jx] = 0;
+	    }
+
+	/* Add each input row of this band into the whole output row */
+	for (iy = 0; iy < yf; iy++) {
+	    pix1 = ((jy * yf) + iy) * nx;
+	    if (intsum) {
+		ims = (short *) image + pix1;
+		if (xf == 2) {
+		    for (jx = 0; jx < nx1; jx++, ims += 2)
+			iacc[jx] = iacc[jx] + ims[0] + ims[1];
 		    }
-		ky++;
-		}
-	    if (mean) {
-	 	switch (bitpix) {
-		    case 16:
-			*buffi2++ = (short) (pixij / dnp);
-			break;
-		    case 32:
-			*buffi4++ = (int) (pixij / dnp);
-			break;
-		    case -32:
-			*buffr4++ = (float) (pixij / dnp);
-			break;
-		    case -64:
-			*buffr8++ = (pixij / dnp);
-			break;
+		else if (xf == 4) {
+		    for (jx = 0; jx < nx1; jx++, ims += 4)
+			iacc[jx] = iacc[jx] + ims[0] + ims[1] + ims[2] + ims[3];
 		    }
+		else {
+		    for (jx = 0; jx < nx1; jx++) {
+			for (ix = 0; ix < xf; ix++)
+			    iacc[jx] = iacc[jx] + *ims++;
+			}
+		    }
+		continue;
+		}
+
+	    getvec (image, bitsin, bzero, bscale, pix1, nrow, row);
+	    dr = row;
+
+	    /* Save values of each block for its median */
+	    if (vals != NULL) {
+		for (jx = 0; jx < nx1; jx++) {
+		    dv = vals + (jx * nb) + (iy * xf);
+		    for (ix = 0; ix < xf; ix++)
+			*dv++ = *dr++;
+		    }
+		}
+
+	    /* Add pixels in the same order as one block at a time */
+	    else if (xf == 2) {
+		for (jx = 0; jx < nx1; jx++, dr += 2)
+		    dacc[jx] = (dacc[jx] + dr[0]) + dr[1];
+		}
+	    else if (xf == 4) {
+		for (jx = 0; jx < nx1; jx++, dr += 4)
+		    dacc[jx] = (((dacc[jx] + dr[0]) + dr[1]) + dr[2]) + dr[3];
 		}
 	    else {
-	 	switch (bitpix) {
-		    case 16:
-			if (pixij < 32768.0)
-			    *buffi2++ = (short) pixij;
-			else
-			    *buffi2++ = 32767;
-			break;
-		    case 32:
-			*buffi4++ = (int) pixij;
-			break;
-		    case -32:
-			*buffr4++ = (float) pixij;
-			break;
-		    case -64:
-			*buffr8++ = pixij;
-			break;
+		for (jx = 0; jx < nx1; jx++) {
+		    for (ix = 0; ix < xf; ix++)
+			dacc[jx] = dacc[jx] + *dr++;
 		    }
 		}
 	    }
-	if ((jy+1)%nlog == 0)
-	    fprintf (stderr,"IMRESIZE: %d/%d lines created\r", jy+1, ny1);
+
+	/* Set the value of each output pixel */
+	for (jx = 0; jx < nx1; jx++) {
+	    if (intsum)
+		pixij = (double) iacc[jx] + (dnp * bzero);
+	    else
+		pixij = dacc[jx];
+	    if (mean == 2)
+		pixij = ShrinkMedian (vals + (jx * nb), nb);
+	    else if (mean)
+		pixij = pixij / dnp;
+	    pix1 = (jy * nx1) + jx;
+	    switch (bitpix) {
+		case 16:
+		    if (pixij >= 32767.0)
+			((short *) image1)[pix1] = 32767;
+		    else if (pixij <= -32768.0)
+			((short *) image1)[pix1] = -32768;
+		    else
+			((short *) image1)[pix1] = (short) pixij;
+		    break;
+		case 32:
+		    if (pixij >= 2147483647.0)
+			((int *) image1)[pix1] = 2147483647;
+		    else if (pixij <= -2147483648.0)
+			((int *) image1)[pix1] = -2147483647 - 1;
+		    else
+			((int *) image1)[pix1] = (int) pixij;
+		    break;
+		case -32:
+		    ((float *) image1)[pix1] = (float) pixij;
+		    break;
+		case -64:
+		    ((double *) image1)[pix1] = pixij;
+		    break;
+		}
+	    }
+	if (nlog > 0 && (jy+1)%nlog == 0)
+	    fprintf (stderr,"IMRESIZE: %d/%d lines created\r", jy+1, jy2);
 	}
-    if (nlog > 0)
-	fprintf (stderr,"\n");
 
-    return (image1);
+    free (dacc);
+    free (row);
+    if (vals != NULL)
+	free (vals);
+    if (iacc != NULL)
+	free (iacc);
+    return (0);
+}
+
+
+/* Return the middle one of n values, partly reordering them */
+
+static double
+ShrinkMedian (vals, n)
+
+double	*vals;		/* Values in one block */
+int	n;		/* Number of values */
+
+{
+    double pivot, temp;
+    int left, right, i, j, k;
+
+    k = n / 2;
+    left = 0;
+    right = n - 1;
+    while (right > left) {
+	pivot = vals[(left + right) / 2];
+	i = left;
+	j = right;
+	while (i <= j) {
+	    while (vals[i] < pivot)
+		i++;
+	    while (vals[j] > pivot)
+		j--;
+	    if (i <= j) {
+		temp = vals[i]; vals[i] = vals[j]; vals[j] = temp;
+		i++;
+		j--;
+		}
+	    }
+	if (k <= j)
+	    right = j;
+	else if (k >= i)
+	    left = i;
+	else
+	    break;
+	}
+    return (vals[k]);
 }
 
 /* Return image header with dimensions reduced by a given factor */
@@ -2550,7 +2783,7 @@ char	*filename;	/* Name of image file before shrinking */
 char	*header;	/* Image header */
 int	xfactor;	/* Factor by which to reduce horizontal size of image */
 int	yfactor;	/* Factor by which to reduce vertical size of image */
-int	mean;		/* If 0, sum pixels, else substitute mean */
+int	mean;		/* If 0, sum pixels, 1 substitute mean, 2 median */
 int	bitpix;		/* Number of bits per output pixel (neg=f.p.) */
 
 {
@@ -2574,7 +2807,8 @@ int	bitpix;		/* Number of bits per output pixel (neg=f.p.) */
     /* Set pixel size in bits */
     if (bitpix == 0) {
 	hgeti4 (header, "BITPIX", &bitpix);
-	mean = 1;
+	if (!mean)
+	    mean = 1;
 	}
     hputi4 (newhead, "BITPIX", bitpix);
 
@@ -2604,7 +2838,7 @@ int	bitpix;		/* Number of bits per output pixel (neg=f.p.) */
     /* Fix WCS */
     dfac = (double) xfactor;
     if (hgetr8 (header, "CRPIX1", &crpix1)) {
-	crpix1 = (crpix1 / dfac) + 0.5;
+	crpix1 = ((crpix1 - 0.5) / dfac) + 0.5;
 	hputr8 (newhead, "CRPIX1", crpix1);
 	}
     if (hgetr8 (header, "CDELT1", &cdelt1)) {
@@ -2621,7 +2855,7 @@ int	bitpix;		/* Number of bits per output pixel (neg=f.p.) */
 	}
     dfac = (double) yfactor;
     if (hgetr8 (header, "CRPIX2", &crpix2)) {
-	crpix2 = (crpix2 / dfac) + 0.5;
+	crpix2 = ((crpix2 - 0.5) / dfac) + 0.5;
 	hputr8 (newhead, "CRPIX2", crpix2);
 	}
     if (hgetr8 (header, "CDELT2", &cdelt2)) {
@@ -2642,7 +2876,9 @@ int	bitpix;		/* Number of bits per output pixel (neg=f.p.) */
 	sprintf (history, "%s blocked %dx%d", filename, xfactor, yfactor);
     else
 	sprintf (history, "%40s blocked / %dx%d", filename, xfactor, yfactor);
-    if (mean)
+    if (mean == 2)
+	strcat (history, " median");
+    else if (mean)
 	strcat (history, " mean");
     else
 	strcat (history, " sum");
@@ -2652,6 +2888,7 @@ int	bitpix;		/* Number of bits per output pixel (neg=f.p.) */
 
 static double apint();
 static double imapfr();
+static double photkth();
 
 /* PhotPix -- Compute counts within a strictly defined circular aperture
  *	      returns sum of pixel flux
@@ -2677,7 +2914,9 @@ double	*sumw;		/* sum of values of pixel weights (returned) */
     hgeti4 (header, "BITPIX", &bitpix);
     hgeti4 (header, "NAXIS1", &nx);
     hgeti4 (header, "NAXIS2", &ny);
+    bs = 1.0;
     hgetr8 (header, "BSCALE", &bs);
+    bz = 0.0;
     hgetr8 (header, "BZERO", &bz);
 
     /* Find range of ys to check */
@@ -2717,306 +2956,309 @@ double	*sumw;		/* sum of values of pixel weights (returned) */
     return (wsum);
 }
 
-/* IMAPFR -- Determine the fraction of a square pixel that is included
- *	     within the boundary of a circle of arbitrary center and radius
+/* PhotStars -- Compute fluxes of many stars through several circular
+ *		apertures, less a median background from an annulus.
+ *		Fractions of pixels within each aperture are tabulated for
+ *		center offsets of 1/NPHOTSUB pixel, so imapfr() is called
+ *		only once for each offset and radius used.
+ *		Returns number of stars measured, or 0 if none.
  */
 
-static double
-imapfr (pcol,prow,ccol,crow,rad)
+#define NPHOTSUB	32
 
-double	pcol,prow;	/* column, row of pixel */
-double	ccol,crow;	/* column, row of center of circle */
-double	rad;		/* radius of circle in pixels */
+int
+PhotStars (header, image, ns, xs, ys, nrad, rad, rin, rout, flux, area, sky)
 
+char	*header;	/* image FITS header */
+char	*image;		/* address of start of image buffer */
+int	ns;		/* Number of stars */
+double	*xs, *ys;	/* One-based image coordinates of stars */
+int	nrad;		/* Number of aperture radii */
+double	*rad;		/* Radii of apertures in pixels */
+double	rin, rout;	/* Inner and outer radii of background annulus,
+			   no background subtracted if rout <= rin */
+double	*flux;		/* Flux less background for each star (ns x nrad),
+			   star by star (returned) */
+double	*area;		/* Pixels within each aperture (ns x nrad) (returned) */
+double	*sky;		/* Background per pixel for each star (returned) */
 {
-    int icorn[4], ncorn, j, i;
-    double dist, xdiff, y0, y1, ydiff, x0, x1, x, y, dc5, dr5;
-    double cterm, ulim, llim, dc, dr, dx, dy;
-    double frac;		/* fraction of pixel within circle */
-
-    /* Compute distance to center of circle from most distant corner of pixel */
-    dc = fabs (pcol - ccol);
-    dr = fabs (prow - crow);
-    dc5 = dc + 0.5;
-    dr5 = dr + 0.5;
-    dist = sqrt ((dc5 * dc5) + (dr5 * dr5));
-    dc5 = dc - 0.5;
-    dr5 = dr - 0.5;
-
-    /* if the pixel is completely enclosed by the aperture, return 1 */
-    if (dist <= rad)
-	return (1.0);
-
-    /* if the pixel is not completely included, compute distance from the
-       center of the circle to the nearest point on the periphery of the pixel*/
-    if ((pcol-0.5) < ccol && ccol < (pcol+.5)) {
-	dist = dr5;
-
-	/* the pixel is completely excluded from the aperture */
-	if (dist >= rad)
-	      return (0.0);
-
-	else if ((prow - 0.5) < crow && crow < (prow + 0.5)) {
-	    dist = dc5;
-
-	    /* the pixel is completely excluded from the aperture */
-	    if (dist >= rad)
-	      return (0.0);
-	    }
+    double ***ftab;	/* Pixel fractions by radius and center offset */
+    double *pbox, *psky, *ft;
+    double bs, bz, dx, dy, dxq, dyq, rmax, r2in, r2out, d2, p, sumf, sump;
+    int *nap, *order, *nrow;
+    int bitpix, nx, ny, is, js, ir, nb, nbox, iy, ix0, iy0, ix1, ix2, iy1, iy2;
+    int kx, ky, k, na, nsky, i, j, i1, i2, wbox, nphot;
 
-	else
-	    dist = sqrt (dc5*dc5 + dr5*dr5);
-
-	/* the pixel is completely excluded from the aperture */
-	if (dist >= rad)
-	    return (0.0);
-
-	}
-
-    /* If the pixel is partially included in the aperture, determine how
-       many corners are enclosed */
-    ncorn = 1;
-    y = prow - 1.5;
-    for (i = 0; i < 2; i++) {
-	y = y + 1.0;
-	x = pcol - 1.50;
-	for (j = 0; j < 2; j++) {
-	    icorn[j+(i*2)] = 0;
-	    x = x + 1.0;
-	    dx = x - ccol;
-	    dy = y - crow;
-	    dist = sqrt (dx*dx + dy*dy);
-	    if (dist < rad) {
-	        ncorn = ncorn + 1;
-	        icorn[j+(i*2)] = 1;
-	        }
-	    }
-	}
-
-    /* Depending on number of corners enclosed,
-       branch to appropriate computation */
-
-    /* If no corners are enclosed, determine whether the slice is vertical or
-       horizontal */
-    if (ncorn < 1) {
-
-	/* If the slice is vertical (at the sides of the aperture,
-	   at extreme x), determine the limits of integration */
-	if ((pcol - 0.5) >= ccol || ccol >= (pcol + 0.5)) {
-	    xdiff = fabs (pcol - ccol) - 0.5;
-	    dx = sqrt (rad*rad - xdiff*xdiff);
-	    y0 = crow - dx;
-	    y1 = crow + dx;
-	    if (ccol >= pcol)
-		x = pcol + 0.5;
-	    else
-		x = pcol - 0.5;
-
-	    /* Evaluate integral */
-	    frac = -xdiff * (y1 - y0) + apint ((y1 - crow), rad) -
-		   apint ((y0 - crow), rad);
-	    return (frac);
+    hgeti4 (header, "BITPIX", &bitpix);
+    hgeti4 (header, "NAXIS1", &nx);
+    hgeti4 (header, "NAXIS2", &ny);
+    bs = 1.0;
+    hgetr8 (header, "BSCALE", &bs);
+    bz = 0.0;
+    hgetr8 (header, "BZERO", &bz);
+    if (ns < 1 || nrad < 1)
+	return (0);
+
+    /* Box around each star holds the largest aperture and the annulus */
+    rmax = 0.0;
+    for (ir = 0; ir < nrad; ir++) {
+	if (rad[ir] > rmax)
+	    rmax = rad[ir];
+	}
+    if (rout > rin && rout > rmax)
+	rmax = rout;
+    nb = (int) ceil (rmax) + 1;
+    wbox = (2 * nb) + 1;
+    pbox = (double *) malloc (wbox * wbox * sizeof (double));
+    psky = (double *) malloc (wbox * wbox * sizeof (double));
+    r2in = rin * rin;
+    r2out = rout * rout;
+
+    /* Tables are filled the first time each center offset is used */
+    nap = (int *) malloc (nrad * sizeof (int));
+    ftab = (double ***) malloc (nrad * sizeof (double **));
+    for (ir = 0; ir < nrad; ir++) {
+	nap[ir] = (int) ceil (rad[ir]) + 1;
+	ftab[ir] = (double **) calloc (NPHOTSUB*NPHOTSUB, sizeof (double *));
+	}
+
+    /* Measure stars in row order so successive boxes share cached pixels */
+    order = (int *) malloc (ns * sizeof (int));
+    nrow = (int *) calloc (ny + 2, sizeof (int));
+    for (is = 0; is < ns; is++) {
+	iy = (int) floor (ys[is] + 0.5);
+	iy = (iy < 0) ? 0 : ((iy > ny) ? ny + 1 : iy);
+	nrow[iy]++;
+	}
+    for (iy = 1; iy < ny + 2; iy++)
+	nrow[iy] = nrow[iy] + nrow[iy-1];
+    for (is = ns - 1; is >= 0; is--) {
+	iy = (int) floor (ys[is] + 0.5);
+	iy = (iy < 0) ? 0 : ((iy > ny) ? ny + 1 : iy);
+	order[--nrow[iy]] = is;
+	}
+    free (nrow);
+
+    nphot = 0;
+    for (js = 0; js < ns; js++) {
+	is = order[js];
+
+	/* Nearest pixel to star center and quantized offset from it */
+	ix0 = (int) floor (xs[is] + 0.5);
+	iy0 = (int) floor (ys[is] + 0.5);
+	dx = xs[is] - (double) ix0;
+	dy = ys[is] - (double) iy0;
+	kx = (int) ((dx + 0.5) * NPHOTSUB);
+	ky = (int) ((dy + 0.5) * NPHOTSUB);
+	if (kx >= NPHOTSUB) kx = NPHOTSUB - 1;
+	if (ky >= NPHOTSUB) ky = NPHOTSUB - 1;
+	if (kx < 0) kx = 0;
+	if (ky < 0) ky = 0;
+	k = (ky * NPHOTSUB) + kx;
+
+	/* Read box of pixels around star, NaN off the image */
+	ix1 = ix0 - nb;
+	ix2 = ix0 + nb;
+	iy1 = iy0 - nb;
+	iy2 = iy0 + nb;
+	if (ix1 < 1 || ix2 > nx || iy1 < 1 || iy2 > ny) {
+	    for (i = 0; i < wbox * wbox; i++)
+		pbox[i] = NAN;
+	    if (ix1 < 1) ix1 = 1;
+	    if (ix2 > nx) ix2 = nx;
+	    if (iy1 < 1) iy1 = 1;
+	    if (iy2 > ny) iy2 = ny;
+	    }
+	if (ix1 > ix2 || iy1 > iy2) {
+	    for (ir = 0; ir < nrad; ir++) {
+		flux[(is * nrad) + ir] = 0.0;
+		area[(is * nrad) + ir] = 0.0;
+		}
+	    sky[is] = 0.0;
+	    continue;
+	    }
+	for (iy = iy1; iy <= iy2; iy++) {
+	    nbox = ((iy - iy0 + nb) * wbox) + (ix1 - ix0 + nb);
+	    getvec (image, bitpix, bz, bs, ((iy - 1) * nx) + (ix1 - 1),
+		    ix2 - ix1 + 1, pbox + nbox);
+	    }
+
+	/* Median of pixels whose centers are within the annulus */
+	sky[is] = 0.0;
+	if (rout > rin) {
+	    nsky = 0;
+	    for (j = -nb; j <= nb; j++) {
+		double dj2 = (j - dy) * (j - dy);
+		double *prow = pbox + ((j + nb) * wbox) + nb;
+		if (dj2 > r2out)
+		    continue;
+		i1 = (int) ceil (dx - sqrt (r2out - dj2));
+		i2 = (int) floor (dx + sqrt (r2out - dj2));
+		for (i = i1; i <= i2; i++) {
+		    d2 = ((i - dx) * (i - dx)) + dj2;
+		    p = prow[i];
+		    if (d2 >= r2in && !isnan (p))
+			psky[nsky++] = p;
+		    }
+		}
+	    if (nsky > 0) {
+		sky[is] = photkth (psky, nsky, (nsky-1) / 2);
+		if (nsky % 2 == 0)
+		    sky[is] = 0.5 * (sky[is] + photkth (psky, nsky, nsky / 2));
+		}
 	    }
 
-	/* If the slice is horizontal (at top or bottom of the aperture, at
-	   extreme y), determine the limits of integration. */
-	else {
-	    ydiff = fabs (prow - crow) - 0.5;
-	    dy = sqrt (rad*rad - ydiff*ydiff);
-	    x0 = ccol - dy;
-	    x1 = ccol + dy;
-	    if (crow >= prow)
-		y = prow + 0.5;
-	    else
-		y = prow - 0.5;
-
-	    /* Evaluate integral */
-	    frac = -ydiff*(x1 - x0) + apint ((x1 - ccol),rad) -
-		   apint ((x0 - ccol),rad);
-	    return (frac);
+	/* Sum pixels weighted by fraction within each aperture */
+	for (ir = 0; ir < nrad; ir++) {
+	    na = nap[ir];
+	    if ((ft = ftab[ir][k]) == NULL) {
+		dxq = ((kx + 0.5) / NPHOTSUB) - 0.5;
+		dyq = ((ky + 0.5) / NPHOTSUB) - 0.5;
+		ft = (double *) malloc ((2*na+1) * (2*na+1) * sizeof (double));
+		for (j = -na; j <= na; j++) {
+		    for (i = -na; i <= na; i++)
+			ft[((j + na) * (2*na+1)) + i + na] =
+			    imapfr ((double) i, (double) j, dxq, dyq, rad[ir]);
+		    }
+		ftab[ir][k] = ft;
+		}
+	    sumf = 0.0;
+	    sump = 0.0;
+	    for (j = -na; j <= na; j++) {
+		double *prow = pbox + ((j + nb) * wbox) + nb;
+		double *frow = ft + ((j + na) * (2*na+1)) + na;
+		for (i = -na; i <= na; i++) {
+		    if (frow[i] > 0.0 && !isnan (prow[i])) {
+			sumf = sumf + frow[i];
+			sump = sump + (frow[i] * prow[i]);
+			}
+		    }
+		}
+	    flux[(is * nrad) + ir] = sump - (sky[is] * sumf);
+	    area[(is * nrad) + ir] = sumf;
 	    }
+	nphot++;
 	}
 
-    /* if one corner is enclosed, find direction (ne,nw,se,sw) from the center*/
-    else if (ncorn < 2) {
-
-	if (pcol < ccol) {
-
-	    /* Determine the limits of integration */
-	    ydiff = fabs (prow - crow) - 0.5;;
-	    x0 = ccol - sqrt (rad*rad - ydiff*ydiff);
-	    if (crow >= prow)
-		y = prow + 0.5;
-	    else
-		y = prow - 0.5;
-
-	    /* Evaluate integral */
-	    frac = -ydiff*(pcol + 0.5 - x0) + apint ((pcol + 0.5 - ccol),rad) -
-		   apint ((x0 - ccol),rad);
-	    return (frac);
-	    }
-
-	else {
-
-	    /* Determine the limits of integration */
-	    ydiff = fabs (crow - prow) - 0.5;
-	    x1 = ccol + sqrt (rad*rad - ydiff*ydiff);
-	    if (crow >= prow)
-		y = prow + 0.5;
-	    else
-		y = prow - 0.5;
-
-	    /* Evaluate integral */
-	    frac = -ydiff*(x1 - pcol + 0.5) + apint ((x1 - ccol),rad) -
-		   apint ((pcol - .5 - ccol),rad);
-	    return (frac);
+    for (ir = 0; ir < nrad; ir++) {
+	for (k = 0; k < NPHOTSUB * NPHOTSUB; k++) {
+	    if (ftab[ir][k] != NULL)
+		free (ftab[ir][k]);
 	    }
+	free (ftab[ir]);
 	}
+    free (ftab);
+    free (nap);
+    free (order);
+    free (pbox);
+    free (psky);
+    return (nphot);
+}
 
-    /* If two corners are enclosed, this problem has two cases: one in
-       which the aperture boundary intersects the pixel boundary twice,
-       and another in which it intersects the pixel boundaries 4 times */
-
-    /* determine whether this may be a 4-intersection configuration */
-    else if (ncorn < 3) {
-
-	if (((pcol - 0.5) < ccol && ccol < (pcol + .5) &&
-	    (fabs(crow - prow) + 0.5) < rad) ||
-	    ((prow - 0.5) < crow && crow < (prow + 0.5) &&
-	    (fabs(ccol - pcol) + 0.5) < rad)) {
 
-/* if the pixel boundary intersects the aperture boundary in four places,
-   determine whether the pixel is east-west or north-south. */
+/* Return the kth smallest of n values, partially reordering them
+ * (N. Wirth, Algorithms + Data Structures = Programs, 1976) */
 
-	    /* pixel is east-west */
-	    if ((pcol - 0.5) >= ccol || (pcol + 0.5) <= ccol) {
-		xdiff = dc + 0.5;
+static double
+photkth (a, n, k)
 
-		/* Determine the limits of integration */
-		dx = sqrt (rad*rad - xdiff*xdiff);
-		y0 = crow - dx;
-		y1 = crow + dx;
-		if (pcol >= ccol)
-		    x = pcol + .5;
-		else
-		    x = pcol - .5;
-		frac = 1. - xdiff*(y0 - y1 + 1.0) +
-			apint ((y0 - crow), rad) -
-			apint ((prow - 0.5 - crow), rad) +
-			apint ((prow + 0.5 - crow), rad) -
-			apint ((y1 - crow), rad);
-		return (frac);
+double	*a;		/* Values, reordered on return */
+int	n;		/* Number of values */
+int	k;		/* Zero-based rank of value to return */
+{
+    int i, j, l, m;
+    double x, t;
+
+    l = 0;
+    m = n - 1;
+    while (l < m) {
+	x = a[k];
+	i = l;
+	j = m;
+	do {
+	    while (a[i] < x) i++;
+	    while (x < a[j]) j--;
+	    if (i <= j) {
+		t = a[i];
+		a[i] = a[j];
+		a[j] = t;
+		i++;
+		j--;
 		}
+	    } while (i <= j);
+	if (j < k) l = i;
+	if (k < i) m = j;
+	}
+    return (a[k]);
+}
 
-	    /* Pixel is north-south */
-
-	    else {
-		ydiff = dr + 0.5;
-
-		/* determine the limits of integration */
-		dy = sqrt (rad*rad - ydiff*ydiff);
-
-		/* x0 is the x-coordinate of the small x intercept */
-		x0 = ccol - dy;
 
-		/* x1 is the x-coordinate of the large x intercept */
-		x1 = ccol + dy;
-		if (prow >= crow)
-		    y = prow + 0.5;
-		else
-		    y = prow - 0.5;
-		frac = 1. - ydiff * (x0 - x1 + 1.0) +
-			apint ((x0 - ccol), rad) -
-			apint ((pcol - 0.5 - ccol), rad) +
-			apint ((pcol + 0.5 - ccol), rad) -
-			apint ((x1 - ccol), rad);
-		return (frac);
-		}
-	    }
+/* IMAPFR -- Determine the fraction of a square pixel that is included
+ *	     within the boundary of a circle of arbitrary center and radius
+ *	     as the sum of signed areas of the circle between its center
+ *	     and each corner of the pixel
+ */
 
-	/* in the two-intersection case, determine which corners are included */
-	else {
+static double
+imapfr (pcol,prow,ccol,crow,rad)
 
-	    /* the pixel is north or south of the center of the aperture */
-	    if (icorn[0]*icorn[1] == 1 || icorn[2]*icorn[3] == 1) {
-		cterm = 0.5 - dr;
-		ulim = apint ((pcol + 0.5 - ccol) ,rad);
-		llim = apint ((pcol - 0.5 - ccol) ,rad);
-		frac = cterm + ulim - llim;
-		return (frac);
-		}
+double	pcol,prow;	/* column, row of pixel */
+double	ccol,crow;	/* column, row of center of circle */
+double	rad;		/* radius of circle in pixels */
 
-	    /* the pixel is east or west of the center */
-	    else {
-		cterm = 0.5 - dc;
-		ulim = apint ((prow + 0.5 - crow), rad);
-		llim = apint ((prow - 0.5 - crow), rad);
-		frac = cterm + ulim - llim;
-		return (frac);
-		}
-	    }
-	}
+{
+    double x0, x1, y0, y1;
 
-    /* if three corners are enclosed, determine whether the corner in question
-       is east or west of the center of the aperture */
+    x0 = pcol - 0.5 - ccol;
+    x1 = pcol + 0.5 - ccol;
+    y0 = prow - 0.5 - crow;
+    y1 = prow + 0.5 - crow;
 
-    else {
-	if (pcol > ccol) {
-	    ydiff = dr + 0.5;
-	    if (prow >= crow)
-		y = prow + 0.5;
-	    else
-		y = prow - 0.5;
+    /* Pixel is completely outside of the circle */
+    if ((x0 > 0.0 && x0 >= rad) || (x1 < 0.0 && -x1 >= rad) ||
+	(y0 > 0.0 && y0 >= rad) || (y1 < 0.0 && -y1 >= rad))
+	return (0.0);
 
-	    x0 = ccol + sqrt (rad*rad - ydiff*ydiff);
-	    frac = 1.0 - (ydiff * (pcol + 0.5 - x0)) +
-		   apint ((pcol + 0.5 - ccol), rad) -
-		   apint ((x0 - ccol), rad);
-	    return (frac);
-	    }
-	else {
-	    ydiff = dr + 0.5;
-	    if (prow >= crow)
-		y = prow + 0.5;
-	    else
-		y = prow - 0.5;
-	    x0 = ccol - sqrt (rad*rad - ydiff*ydiff);
-	    frac = 1. - ydiff*(x0 - pcol + 0.5) +
-		   apint ((x0 - ccol),rad) -
-		   apint ((pcol - 0.5 - ccol),rad);
-	    return (frac);
-	    }
-	}
+    return (apint (x1,y1,rad) - apint (x0,y1,rad) - apint (x1,y0,rad) +
+	    apint (x0,y0,rad));
 }
 
 
-/* APINT -- Evaluate the integral of sqrt (rad**2 - x**2) dx at one limit */
+/* APINT -- Return the area of a circle centered at the origin which is
+ *	    between the origin and x, y, negative if only one of them is */
 
 static double
-apint (x, rad)
+apint (x, y, rad)
 
-double	x;
-double	rad;
+double	x, y;		/* Corner of rectangle from the circle center */
+double	rad;		/* Radius of circle */
 {
-    double x2,rad2,arg,arg2,arcsin,pi;
-
-    pi = 3.141592654;
-
-    arg = x / rad;
-    x2 = x * x;
+    double ax, ay, xc, area, rad2;
+
+    ax = (x < 0.0) ? -x : x;
+    ay = (y < 0.0) ? -y : y;
+    if (ax > rad)
+	ax = rad;
+    if (ay > rad)
+	ay = rad;
     rad2 = rad * rad;
-    arg2 = x2 / rad2;
 
-    arcsin = atan2 (arg, sqrt (1.0 - arg2));
+    /* Rectangle is inside the circle */
+    if ((ax * ax) + (ay * ay) <= rad2)
+	area = ax * ay;
 
-    if ((1. - fabs (arg)) < 0.000001) {
-	if (arg >= 0)
-	    arcsin = pi / 2.0;
-	else
-	    arcsin = -pi / 2.0;
+    /* Rectangle to where circle crosses y, then integrate circle to x */
+    else {
+	xc = sqrt (rad2 - (ay * ay));
+	area = (ay * xc) +
+	       0.5 * ((ax * sqrt (rad2 - (ax * ax))) + (rad2 * asin (ax / rad))) -
+	       0.5 * ((xc * sqrt (rad2 - (xc * xc))) + (rad2 * asin (xc / rad)));
 	}
 
-    return (0.5 * (x * sqrt (rad2 - x2) + rad2 * arcsin));
+    if ((x < 0.0) != (y < 0.0))
+	return (-area);
+    else
+	return (area);
 }
 
 
@@ -3045,4 +3287,15 @@ double	rad;
  * May 16 2012	Add medpixi1() and meanpixi1() to handle 8-bit images
  *
  * Jun 17 2014	Ignore NaN pixels
+ *
+ * Oct 18 2026	Add PhotStars() for multiple apertures and stars with sky annulus
+ * Oct 18 2026	Compute pixel fraction in imapfr() from exact circle areas
+ * Oct 18 2026	Default BSCALE to 1 and BZERO to 0 in PhotPix()
+ *
+ * Oct 19 2026	Shrink whole rows at a time in ShrinkRows() instead of by pixel
+ * Oct 19 2026	Add median blocking to ShrinkFITSImage() with mean=2
+ * Oct 19 2026	Add setshrinkproc() to shrink bands of rows in more processes
+ * Oct 19 2026	Keep edge of first pixel fixed when scaling CRPIX in ShrinkFITSHeader()
+ * Oct 19 2026	Drop unused variable from PhotStars()
+ * Oct 19 2026	Clamp shrunken integer pixels to BITPIX range; check worker status
  */
@@ -1,8 +1,8 @@
 /*** File lwcs.h
- *** April 25, 2006
+ *** October 18, 2026
  *** By Jessica Mink, jmink@cfa.harvard.edu
  *** Harvard-Smithsonian Center for Astrophysics
- *** Copyright (C) 1999-2006
+ *** Copyright (C) 1999-2026
  *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
 
     This library is free software; you can redistribute it and/or
@@ -34,6 +34,8 @@
 #define	BURNEDOUT	0	/* Clamp pixels brighter than this, if > 0 */
 #define NITERATE	5	/* Number of iterations for sigma clipping */
 #define RNOISE	 	50	/* Mean noise is from center +- this many pixels */
+#define BKGCELL		64	/* Background mesh cell size, if mesh is used */
+#define BKGCLIP		3.0	/* Sigma clipping limit for background mesh */
 
 #define STARSIGMA	5.0	/* Stars must be this many sigmas above mean */
 #define BORDER		10	/* Ignore this much of the edge */
@@ -57,6 +59,13 @@
 #define PSCALE		0	/* Plate scale in arcsec/pixel */
 				/* (if nonzero, this overrides image header) */
 #define NXYDEC		2	/* Number of decimal places in image coords */
+#define REFCLIP		3.0	/* Reject matches this many sigma from refit */
+
+/* The following are used in matching without an initial WCS (quadmatch.c) */
+#define QUADSTARS	50	/* Brightest image stars from which to make quads */
+#define QUADNEAR	6	/* Make quads from each star and these neighbors */
+#define QUADTOL		0.01	/* Largest difference of matching quad codes */
+#define QUADFRAC	0.25	/* Fraction of stars to match for solution */
 
 #define MAXCAT		100	/* Max reference stars to keep in scat or imcat */
 
@@ -68,4 +77,8 @@
  *
  * Mar 30 2006	Add NXYDEC and set default to 2 (constant value was 1)
  * Apr 25 2006	Add RNOISE and set default to previous constant value of 50
+ *
+ * Oct 18 2026	Add BKGCELL and BKGCLIP for background mesh
+ * Oct 18 2026	Add REFCLIP for outlier rejection in imsetwcs.c
+ * Oct 18 2026	Add QUADSTARS, QUADNEAR, QUADTOL, and QUADFRAC for quadmatch.c
  */
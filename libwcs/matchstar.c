@@ -1,8 +1,8 @@
 /*** File libwcs/matchstar.c
- *** June 9, 2016
+ *** October 18, 2026
  *** By Jessica Mink, jmink@cfa.harvard.edu
  *** Harvard-Smithsonian Center for Astrophysics
- *** Copyright (C) 1996-2016
+ *** Copyright (C) 1996-2026
  *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
 
     This library is free software; you can redistribute it and/or
@@ -39,7 +39,10 @@
  * FitMatch (ns, sx, sy, ng, gra, gdec, gx, gy, tol, wcs, nfit, debug)
  *  Fit shift, scale, and rotation of image stars to RA/Dec/X/Y matches
  *
+ * wcs_fit (wcs0) Fit WCS by least squares, falling back to wcs_amoeba()
+ * wcs_lmfit (wcs0) Fit WCS by Levenberg-Marquardt least squares
  * wcs_amoeba (wcs0) Set up temp arrays and call multivariate solver
+ * wcs_setv (v) Set WCS from the fit parameter vector v
  * chisqr (v) Compute the chisqr of the vector v
  * amoeba (p, y, ndim, ftol, itmax, funk, nfunk)
  *    Multivariate solver from Numerical Recipes
@@ -59,7 +62,10 @@
 
 #define ABS(a) ((a) < 0 ? (-(a)) : (a))
 
+static void wcs_fit ();
 static void wcs_amoeba ();
+static int wcs_lmfit ();
+static int wcs_setv ();
 extern void setnofit();
 extern int getfilelines();
 
@@ -79,6 +85,8 @@ static int	minbin=2;	/* Minimum number of coincidence hits needed */
 static int	minmatch0 = MINMATCH;	/* matches to drop out of loop */
 static int	nitmax0 = NMAX;		/* max iterations to stop fit */
 static int	binarray;	/* If =1, bin matched stars */
+static int	fitamoeba = 0;	/* If =1, always fit with amoeba() simplex */
+static int	lastamoeba = 0;	/* 1 if last fit used amoeba(), else 0 */
 static int	vfit[NPAR1]; /* Parameters being fit: index to value vector
 				1= RA,		  2= Dec,
 				3= X plate scale, 4= Y plate scale
@@ -516,10 +524,13 @@ int	debug;
 	cdfit = 0;
 
     /* Fit image star coordinates to reference star positions */
-    wcs_amoeba (wcs);
+    wcs_fit (wcs);
 
     if (debug) {
-	fprintf (stderr,"\nAmoeba fit:\n");
+	if (lastamoeba)
+	    fprintf (stderr,"\nAmoeba fit:\n");
+	else
+	    fprintf (stderr,"\nLeast squares fit:\n");
 	ra2str (rastr, 31, xref0, 3);
 	dec2str (decstr, 31, yref0, 2);
 	fprintf (stderr,"   initial guess:\n");
@@ -625,7 +636,7 @@ int	debug;
 	xrefpix = wcs->xrefpix;
 	yrefpix = wcs->yrefpix;
 	nbin_p = bestbin;
-	wcs_amoeba (wcs);
+	wcs_fit (wcs);
 
 	if (debug) {
 	    ra2str (rastr, 31, wcs->xref, 3);
@@ -1236,10 +1247,13 @@ int	debug;		/* Printed debugging information if not zero */
 	cdfit = 0;
 
     /* Fit image star coordinates to reference star positions */
-    wcs_amoeba (wcs);
+    wcs_fit (wcs);
 
     if (debug) {
-	fprintf (stderr,"\nAmoeba fit:\n");
+	if (lastamoeba)
+	    fprintf (stderr,"\nAmoeba fit:\n");
+	else
+	    fprintf (stderr,"\nLeast squares fit:\n");
 	ra2str (rastr, 31, xref0, 3);
 	dec2str (decstr, 31, yref0, 2);
 	fprintf (stderr,"   initial guess:\n");
@@ -1345,7 +1359,7 @@ int	debug;		/* Printed debugging information if not zero */
 	xrefpix = wcs->xrefpix;
 	yrefpix = wcs->yrefpix;
 	nbin_p = bestbin;
-	wcs_amoeba (wcs);
+	wcs_fit (wcs);
 
 	if (debug) {
 	    ra2str (rastr, 31, wcs->xref, 3);
@@ -1374,6 +1388,254 @@ void amoeba();
 static double amotry();
 
 
+/* Fit WCS to matched stars by least squares, or by amoeba() if requested
+ * or if the least squares fit cannot be used */
+
+static void
+wcs_fit (wcs0)
+
+struct WorldCoor *wcs0;
+
+{
+    lastamoeba = 0;
+    if (fitamoeba || wcs_lmfit (wcs0)) {
+	lastamoeba = 1;
+	wcs_amoeba (wcs0);
+	}
+    return;
+}
+
+
+/* Fit the parameters selected by vfit[] with Levenberg-Marquardt least
+ * squares, minimizing the same pixel residuals as wcs_chisqr().  Pixel
+ * positions are crpix + CD^-1 * (projected sky position), so the derivatives
+ * for the CD matrix or scale and rotation and for the reference pixel are
+ * computed directly; those for the sky reference position come from
+ * projecting the reference stars about a slightly shifted center.
+ * Return 0 if fit, -1 if this WCS cannot be fit this way.
+ */
+
+static int
+wcs_lmfit (wcs0)
+
+struct WorldCoor *wcs0;
+
+{
+    double v[NPAR], vtry[NPAR], delta[NPAR], beta[NPAR], h[NPAR];
+    double alpha[NPAR*NPAR], alpha1[NPAR*NPAR], alphai[NPAR*NPAR];
+    double cd0[4], dc0[4], dcd[4], crpix0[2];
+    double *xm, *ym, *xmh, *ymh, *jac;
+    double chsq, chsqtry, lambda, dx, dy, px, py;
+    int i, j, k, iter, nres, offscale, done, badstep;
+
+    wcsf = wcs0;
+    if (nfit > NPAR)
+	nfit = NPAR;
+
+    /* Need a WCSLIB projection with a linear pixel transformation */
+    if (wcsf->prjcode <= 0 || wcsf->prjcode == WCS_DSS ||
+	wcsf->prjcode == WCS_PLT || wcsf->prjcode == WCS_TNX ||
+	wcsf->prjcode == WCS_ZPX || wcsf->wcsproj == WCS_OLD ||
+	wcsf->distcode || wcsf->wcs != NULL)
+	return (-1);
+    nres = 2 * nbin_p;
+    if (nfit < 1 || nres < nfit)
+	return (-1);
+
+    /* Initial parameter values and derivative steps */
+    for (i = 0; i < NPAR; i++) {
+	v[i] = 0.0;
+	h[i] = 0.0;
+	}
+    if (vfit[1] > -1)
+	h[vfit[1]] = 0.01 * fabs (wcsf->xinc);
+    if (vfit[2] > -1)
+	h[vfit[2]] = 0.01 * fabs (wcsf->yinc);
+    if (vfit[6] > -1) {
+	wcsf->rotmat = 1;
+	v[vfit[3]] = wcsf->cd[0];
+	v[vfit[4]] = wcsf->cd[1];
+	v[vfit[5]] = wcsf->cd[2];
+	v[vfit[6]] = wcsf->cd[3];
+	for (k = 3; k < 7; k++)
+	    h[vfit[k]] = 0.0001 * fabs (wcsf->xinc);
+	}
+    else {
+	if (vfit[3] > -1) {
+	    v[vfit[3]] = wcsf->xinc;
+	    h[vfit[3]] = 0.0001 * fabs (wcsf->xinc);
+	    }
+	if (vfit[4] > -1) {
+	    v[vfit[4]] = wcsf->yinc;
+	    h[vfit[4]] = 0.0001 * fabs (wcsf->yinc);
+	    }
+	if (vfit[5] > -1) {
+	    v[vfit[5]] = wcsf->rot;
+	    h[vfit[5]] = 0.0001;
+	    }
+	}
+
+    xm = (double *) calloc (nbin_p, sizeof (double));
+    ym = (double *) calloc (nbin_p, sizeof (double));
+    xmh = (double *) calloc (nbin_p, sizeof (double));
+    ymh = (double *) calloc (nbin_p, sizeof (double));
+    jac = (double *) calloc (nres * nfit, sizeof (double));
+    if (xm == NULL || ym == NULL || xmh == NULL || ymh == NULL || jac == NULL) {
+	if (xm) free (xm);
+	if (ym) free (ym);
+	if (xmh) free (xmh);
+	if (ymh) free (ymh);
+	if (jac) free (jac);
+	return (-1);
+	}
+
+    lambda = 0.001;
+    chsq = wcs_chisqr (v, 0);
+    done = 0;
+    for (iter = 1; iter <= nitmax0 && !done; iter++) {
+
+	/* Model pixel positions for current parameters */
+	if (wcs_setv (v)) {
+	    done = -1;
+	    break;
+	    }
+	for (i = 0; i < nbin_p; i++)
+	    wcs2pix (wcsf, gra_p[i], gdec_p[i], &xm[i], &ym[i], &offscale);
+	for (k = 0; k < 4; k++) {
+	    cd0[k] = wcsf->cd[k];
+	    dc0[k] = wcsf->dc[k];
+	    }
+	crpix0[0] = wcsf->xrefpix;
+	crpix0[1] = wcsf->yrefpix;
+
+	/* Derivatives of model x and y with respect to each parameter */
+	for (j = 0; j < nfit; j++) {
+	    for (k = 0; k < nfit; k++)
+		vtry[k] = v[k];
+
+	    /* Reference pixel moves all positions equally */
+	    if (j == vfit[7] || j == vfit[8]) {
+		for (i = 0; i < nbin_p; i++) {
+		    jac[(2*i)*nfit + j] = (j == vfit[7]) ? 1.0 : 0.0;
+		    jac[(2*i+1)*nfit + j] = (j == vfit[8]) ? 1.0 : 0.0;
+		    }
+		}
+
+	    /* Sky reference position changes the projection */
+	    else if (j == vfit[1] || j == vfit[2]) {
+		vtry[j] = v[j] + h[j];
+		if (wcs_setv (vtry)) {
+		    done = -1;
+		    break;
+		    }
+		for (i = 0; i < nbin_p; i++) {
+		    wcs2pix (wcsf,gra_p[i],gdec_p[i],&xmh[i],&ymh[i],&offscale);
+		    jac[(2*i)*nfit + j] = (xmh[i] - xm[i]) / h[j];
+		    jac[(2*i+1)*nfit + j] = (ymh[i] - ym[i]) / h[j];
+		    }
+		}
+
+	    /* CD matrix: d(pixel) = -CD^-1 * dCD * (pixel - crpix) */
+	    else {
+		vtry[j] = v[j] + h[j];
+		if (wcs_setv (vtry)) {
+		    done = -1;
+		    break;
+		    }
+		for (k = 0; k < 4; k++)
+		    dcd[k] = (wcsf->cd[k] - cd0[k]) / h[j];
+		for (i = 0; i < nbin_p; i++) {
+		    px = xm[i] - crpix0[0];
+		    py = ym[i] - crpix0[1];
+		    dx = dcd[0] * px + dcd[1] * py;
+		    dy = dcd[2] * px + dcd[3] * py;
+		    jac[(2*i)*nfit + j] = -(dc0[0] * dx + dc0[1] * dy);
+		    jac[(2*i+1)*nfit + j] = -(dc0[2] * dx + dc0[3] * dy);
+		    }
+		}
+	    }
+	if (done)
+	    break;
+
+	/* Normal equations */
+	for (j = 0; j < nfit; j++) {
+	    beta[j] = 0.0;
+	    for (k = 0; k < nfit; k++)
+		alpha[j*nfit + k] = 0.0;
+	    }
+	for (i = 0; i < nbin_p; i++) {
+	    dx = xm[i] - sx_p[i];
+	    dy = ym[i] - sy_p[i];
+	    for (j = 0; j < nfit; j++) {
+		beta[j] += jac[(2*i)*nfit + j] * dx + jac[(2*i+1)*nfit + j] * dy;
+		for (k = 0; k <= j; k++)
+		    alpha[j*nfit + k] += jac[(2*i)*nfit + j] * jac[(2*i)*nfit + k] +
+				      jac[(2*i+1)*nfit + j] * jac[(2*i+1)*nfit + k];
+		}
+	    }
+	for (j = 0; j < nfit; j++) {
+	    for (k = j + 1; k < nfit; k++)
+		alpha[j*nfit + k] = alpha[k*nfit + j];
+	    }
+
+	/* Increase damping until a step reduces chi^2 */
+	for (;;) {
+	    for (k = 0; k < nfit * nfit; k++)
+		alpha1[k] = alpha[k];
+	    for (j = 0; j < nfit; j++)
+		alpha1[j*nfit + j] = alpha[j*nfit + j] * (1.0 + lambda);
+	    if (matinv (nfit, alpha1, alphai)) {
+		done = -1;
+		break;
+		}
+	    for (j = 0; j < nfit; j++) {
+		delta[j] = 0.0;
+		for (k = 0; k < nfit; k++)
+		    delta[j] -= alphai[j*nfit + k] * beta[k];
+		vtry[j] = v[j] + delta[j];
+		}
+
+	    /* A step to parameters which do not make a WCS is rejected */
+	    if (wcs_setv (vtry))
+		badstep = 1;
+	    else {
+		badstep = 0;
+		chsqtry = wcs_chisqr (vtry, iter);
+		}
+	    if (!badstep && chsqtry <= chsq) {
+		if (chsq - chsqtry <= FTOL * chsq)
+		    done = 1;
+		for (j = 0; j < nfit; j++)
+		    v[j] = vtry[j];
+		chsq = chsqtry;
+		lambda = lambda * 0.1;
+		break;
+		}
+	    lambda = lambda * 10.0;
+	    if (lambda > 1.0e10) {
+		done = 1;
+		break;
+		}
+	    }
+	}
+
+    free (xm);
+    free (ym);
+    free (xmh);
+    free (ymh);
+    free (jac);
+
+    /* Leave WCS set to best parameters */
+    if (done < 0) {
+	(void) wcs_setv (v);
+	return (-1);
+	}
+    if (wcs_setv (v))
+	return (-1);
+    return (0);
+}
+
+
 /* Set up the necessary temp arrays and call the amoeba() multivariate solver */
 
 static void
@@ -1676,26 +1938,16 @@ struct WorldCoor *wcs0;
 }
 
 
-/* Compute the chisqr of the vector v, where
- * v[0]=cra, v[1]=cdec, v[2]=ra deg/pix, v[3]=dec deg/pix,
- * v[4]=rotation, v[5]=2nd rotation->CD matrix, v[6]=ref x, and v[7] = ref y
- * chisqr is in arcsec^2
- */
+/* Set WCS parameters in wcsf from the fit parameter vector v */
 
-static double
-wcs_chisqr (v, iter)
+static int
+wcs_setv (v)
 
 double	*v;	/* Vector of parameter values */
-int	iter;	/* Number of iterations */
 
 {
-    double chsq;
-    char rastr[32],decstr[32];
-    double xmp, ymp, dx, dy, cd[4], *cdx;
+    double cd[4], *cdx;
     double crval1, crval2, cdelt1, cdelt2, crota, crpix1, crpix2;
-    int i, offscale;
-
-    /* Set WCS parameters from fit parameter vector */
 
     /* Sky coordinates at optical axis (degrees) */
     if (vfit[1] > -1)
@@ -1753,7 +2005,30 @@ int	iter;	/* Number of iterations */
 	crpix2 = yrefpix + v[vfit[8]];
     else
 	crpix2 = wcsf->yrefpix;
-    if (wcsreset (wcsf,crpix1,crpix2,crval1,crval2,cdelt1,cdelt2,crota,cdx)) {
+    return (wcsreset (wcsf,crpix1,crpix2,crval1,crval2,cdelt1,cdelt2,crota,cdx));
+}
+
+
+/* Compute the chisqr of the vector v, where
+ * v[0]=cra, v[1]=cdec, v[2]=ra deg/pix, v[3]=dec deg/pix,
+ * v[4]=rotation, v[5]=2nd rotation->CD matrix, v[6]=ref x, and v[7] = ref y
+ * chisqr is in arcsec^2
+ */
+
+static double
+wcs_chisqr (v, iter)
+
+double	*v;	/* Vector of parameter values */
+int	iter;	/* Number of iterations */
+
+{
+    double chsq;
+    char rastr[32],decstr[32];
+    double xmp, ymp, dx, dy;
+    int i, offscale;
+
+    /* Set WCS parameters from fit parameter vector */
+    if (wcs_setv (v)) {
 	fprintf (stderr,"CHISQR: Cannot reset WCS!\n");
 	return (0.0);
 	}
@@ -1961,6 +2236,15 @@ setnitmax (nitmax)
 int nitmax;
 { nitmax0 = nitmax; return; }
 
+void
+setfitamoeba (amoebaflag)
+int amoebaflag;
+{ fitamoeba = amoebaflag; return; }
+
+int
+getfitamoeba ()
+{ return (fitamoeba); }
+
 /* Aug  6 1996	New subroutine
  * Sep  1 1996	Move constants to lwcs.h
  * Sep  3 1996	Use offscale pixels for chi^2 computation
@@ -2047,4 +2331,10 @@ int nitmax;
  * Dec 13 2009	In WCSMatch(), add last x,y,ra,dec so means are means of all
  *
  * Jun  9 2016	Fix isnum() tests for added coloned times and dashed dates 
+ *
+ * Oct 18 2026	Add wcs_lmfit() Levenberg-Marquardt fit, used before amoeba()
+ * Oct 18 2026	Move fit vector to WCS conversion into wcs_setv()
+ * Oct 18 2026	Add setfitamoeba() to always use amoeba() fit
+ *
+ * Oct 19 2026	Reject wcs_lmfit() steps for which the WCS cannot be set
  */ 
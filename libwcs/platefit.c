@@ -1,8 +1,8 @@
 /*** File libwcs/platefit.c
- *** September 26, 2006
+ *** October 18, 2026
  *** By Jessica Mink, jmink@cfa.harvard.edu
  *** Harvard-Smithsonian Center for Astrophysics
- *** Copyright (C) 1998-2006
+ *** Copyright (C) 1998-2026
  *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
 
     This library is free software; you can redistribute it and/or
@@ -31,6 +31,9 @@
  *  at x and y to fit array starting at z.
  *  Contains convergence oscillation damping and optional normalization 
  *  Fits up to MAXPAR parameters
+ *
+ *  FitSIP (wcs, x, y, x1, y1, np, order, iorder, debug)
+ *	Fit SIP distortion polynomials and CD matrix to matched stars
  */
 
 #include <stdio.h>
@@ -40,6 +43,7 @@
 #include "lwcs.h"
 
 static void plate_amoeba();
+static int plate_lsfit();
 static double plate_chisqr();
 static int ncoeff=0;
 static double   *sx_p;
@@ -48,10 +52,16 @@ static double   *gx_p;
 static double   *gy_p;
 static int	nbin_p;
 extern int SetPlate();
+extern int getfitamoeba();
 
 #define MAXPAR 26
 #define MAXPAR1 27
 #define NITMAX 2500
+#define SIPCLIP 3.0	/* Reject SIP fit residuals over this many sigma */
+#define SIPNITER 10	/* Maximum number of SIP fit iterations */
+#define SIPNGRID 32	/* Grid points per axis for inverse SIP fit */
+
+static int sip_lsfit();
 
 int
 FitPlate (wcs, x, y, x1, y1, np, ncoeff0, debug)
@@ -71,14 +81,144 @@ int	debug;
     nbin_p = np;
     ncoeff = ncoeff0;
 
-    /* Fit polynomials */
-    plate_amoeba (wcs);
+    if (ncoeff > 13)
+	ncoeff = 13;
+
+    /* Fit polynomials by linear least squares, else by simplex */
+    if (getfitamoeba () || plate_lsfit (wcs, debug))
+	plate_amoeba (wcs);
 
     return (0);
 }
 
 static struct WorldCoor *wcsp;
 
+
+/* Fit the plate polynomials directly by linear least squares.  The model
+ * is linear in its coefficients, so one set of normal equations in the
+ * pixel offsets from the reference pixel serves both the xi and eta fits
+ * of the reference star standard coordinates.  The r^2 terms 10-12 are
+ * sums of lower terms, so they are left zero and the first 10 are fit.
+ * Return 0 if fit, else -1 */
+
+static int
+plate_lsfit (wcs0, debug)
+
+struct WorldCoor *wcs0;
+int	debug;
+
+{
+    static int pdeg[13] = {0, 1, 1, 2, 2, 2, 3, 3, 3, 3, 2, 3, 3};
+    double alpha[169], alphai[169], bxi[13], beta[13], b[13];
+    double vp[26];
+    double ra0, dec0, ctan, ccos, tdec, traoff, craoff, etar, xir, xi, eta;
+    double x, y, x2, y2, r2, scale, sumr, mx, my, ex, ey;
+    int i, j, k, nc;
+
+    nc = ncoeff;
+    if (nc > 10)
+	nc = 10;
+    if (nc < 1 || nbin_p < nc)
+	return (-1);
+
+    /* Normalize pixel offsets to keep the normal equations well conditioned */
+    scale = 0.0;
+    for (i = 0; i < nbin_p; i++) {
+	x = fabs (sx_p[i] - wcs0->crpix[0]);
+	y = fabs (sy_p[i] - wcs0->crpix[1]);
+	if (x > scale)
+	    scale = x;
+	if (y > scale)
+	    scale = y;
+	}
+    if (scale <= 0.0)
+	return (-1);
+
+    for (j = 0; j < nc; j++) {
+	bxi[j] = 0.0;
+	beta[j] = 0.0;
+	for (k = 0; k < nc; k++)
+	    alpha[j*nc + k] = 0.0;
+	}
+
+    ra0 = degrad (wcs0->crval[0]);
+    dec0 = degrad (wcs0->crval[1]);
+    ctan = tan (dec0);
+    ccos = cos (dec0);
+    for (i = 0; i < nbin_p; i++) {
+
+	/* Standard coordinates of reference star, as in platepix() */
+	tdec = tan (degrad (gy_p[i]));
+	traoff = tan (degrad (gx_p[i]) - ra0);
+	craoff = cos (degrad (gx_p[i]) - ra0);
+	etar = (1.0 - ctan * craoff / tdec) / (ctan + (craoff / tdec));
+	xir = traoff * ccos * (1.0 - (etar * ctan));
+	xi = raddeg (xir);
+	eta = raddeg (etar);
+
+	/* Plate model terms, as in platepos() */
+	x = (sx_p[i] - wcs0->crpix[0]) / scale;
+	y = (sy_p[i] - wcs0->crpix[1]) / scale;
+	x2 = x * x;
+	y2 = y * y;
+	r2 = x2 + y2;
+	b[0] = 1.0;
+	b[1] = x;
+	b[2] = y;
+	b[3] = x2;
+	b[4] = y2;
+	b[5] = x * y;
+	b[6] = x * x2;
+	b[7] = y * y2;
+	b[8] = x2 * y;
+	b[9] = x * y2;
+	b[10] = r2;
+	b[11] = x * r2;
+	b[12] = y * r2;
+
+	for (j = 0; j < nc; j++) {
+	    bxi[j] += b[j] * xi;
+	    beta[j] += b[j] * eta;
+	    for (k = 0; k < nc; k++)
+		alpha[j*nc + k] += b[j] * b[k];
+	    }
+	}
+
+    if (matinv (nc, alpha, alphai))
+	return (-1);
+
+    /* Solve for coefficients and undo pixel normalization */
+    for (j = 0; j < nc; j++) {
+	vp[j] = 0.0;
+	vp[ncoeff+j] = 0.0;
+	for (k = 0; k < nc; k++) {
+	    vp[j] += alphai[j*nc + k] * bxi[k];
+	    vp[ncoeff+j] += alphai[j*nc + k] * beta[k];
+	    }
+	vp[j] = vp[j] / pow (scale, (double) pdeg[j]);
+	vp[ncoeff+j] = vp[ncoeff+j] / pow (scale, (double) pdeg[j]);
+	}
+    for (j = nc; j < ncoeff; j++) {
+	vp[j] = 0.0;
+	vp[ncoeff+j] = 0.0;
+	}
+    wcsp = wcs0;
+    (void)SetPlate (wcsp, ncoeff, ncoeff, vp);
+
+    if (debug) {
+	sumr = 0.0;
+	for (i = 0; i < nbin_p; i++) {
+	    pix2wcs (wcsp, sx_p[i], sy_p[i], &mx, &my);
+	    ex = 3600.0 * (mx - gx_p[i]) * cos (degrad (gy_p[i]));
+	    ey = 3600.0 * (my - gy_p[i]);
+	    sumr = sumr + ex * ex + ey * ey;
+	    }
+	fprintf (stderr,"Plate fit of %d coefficients to %d stars: rms %.3f arcsec\n",
+		 ncoeff, nbin_p, sqrt (sumr / (double) nbin_p));
+	}
+    return (0);
+}
+
 /* Set up the necessary temp arrays and call the amoeba() multivariate solver */
 
 static void
@@ -295,6 +435,345 @@ int	iter;	/* Number of iterations */
     return (chsq);
 }
 
+/* Fit SIP distortion polynomials A and B of the given order, with the CD
+ * matrix, to matched stars, keeping the reference pixel and sky position.
+ * Intermediate world coordinates of the reference stars are linear in the
+ * CD matrix times the pixel offset polynomial terms, so the fit is a
+ * linear least squares problem.  The constant terms move the reference
+ * sky position, and the fit is repeated about the new position after
+ * dropping stars with residuals over SIPCLIP sigma.  The inverse AP and BP polynomials
+ * of order iorder are then fit on a grid over the image.
+ * Return 0 if fit, else 1 */
+
+int
+FitSIP (wcs, x, y, x1, y1, np, order, iorder, debug)
+
+struct WorldCoor *wcs;	/* World coordinate system structure */
+double	*x, *y;		/* Image pixel coordinates */
+double	*x1, *y1;	/* Reference star right ascensions and declinations */
+int	np;		/* Number of points to fit */
+int	order;		/* Order of A and B polynomials */
+int	iorder;		/* Order of AP and BP polynomials (order+1 if 0) */
+int	debug;
+
+{
+    double *du, *dv, *wx, *wy, *res, *gx, *gy, *fx, *fy;
+    double gcx[DISTMAX*DISTMAX], gcy[DISTMAX*DISTMAX];
+    double cd[4], dc[4], xmin, xmax, ymin, ymax, xstep, ystep;
+    double fxs, fys, ex, ey, rms, sumr, scale, spq, ra, dec;
+    int *ok, *gok, pp[DISTMAX*DISTMAX], qq[DISTMAX*DISTMAX];
+    int i, j, k, iter, nterm, nok, nrej, offscl, ig, ng, distcode;
+
+    if (nowcs (wcs) || wcs->prjcode <= 0 || wcs->wcsproj == WCS_OLD ||
+	wcs->prjcode == WCS_DSS || wcs->prjcode == WCS_PLT ||
+	wcs->prjcode == WCS_TNX || wcs->prjcode == WCS_ZPX) {
+	fprintf (stderr, "FitSIP: SIP distortion needs a WCSLIB projection\n");
+	return (1);
+	}
+    if (order < 2)
+	order = 2;
+    if (order > DISTMAX - 1)
+	order = DISTMAX - 1;
+    if (iorder < 1)
+	iorder = order + 1;
+    if (iorder > DISTMAX - 1)
+	iorder = DISTMAX - 1;
+
+    /* Constant terms fit the sky reference position, order 1 terms the CD
+     * matrix, and higher order terms the distortion */
+    nterm = 0;
+    for (k = 0; k <= order; k++) {
+	for (j = 0; j <= k; j++) {
+	    pp[nterm] = k - j;
+	    qq[nterm] = j;
+	    nterm++;
+	    }
+	}
+    if (np <= nterm) {
+	fprintf (stderr, "FitSIP: %d stars are too few for order %d\n",
+		 np, order);
+	return (1);
+	}
+
+    du = (double *) calloc (np, sizeof (double));
+    dv = (double *) calloc (np, sizeof (double));
+    wx = (double *) calloc (np, sizeof (double));
+    wy = (double *) calloc (np, sizeof (double));
+    res = (double *) calloc (np, sizeof (double));
+    ok = (int *) calloc (np, sizeof (int));
+    ng = SIPNGRID * SIPNGRID;
+    gx = (double *) calloc (ng, sizeof (double));
+    gy = (double *) calloc (ng, sizeof (double));
+    fx = (double *) calloc (ng, sizeof (double));
+    fy = (double *) calloc (ng, sizeof (double));
+    gok = (int *) calloc (ng, sizeof (int));
+
+    /* Pixel offsets of image stars from reference pixel */
+    distcode = wcs->distcode;
+    wcs->distcode = DISTORT_NONE;
+    xmin = x[0];
+    xmax = x[0];
+    ymin = y[0];
+    ymax = y[0];
+    scale = 0.0;
+    for (i = 0; i < np; i++) {
+	du[i] = x[i] - wcs->xrefpix;
+	dv[i] = y[i] - wcs->yrefpix;
+	ok[i] = 1;
+	if (fabs (du[i]) > scale)
+	    scale = fabs (du[i]);
+	if (fabs (dv[i]) > scale)
+	    scale = fabs (dv[i]);
+	if (x[i] < xmin) xmin = x[i];
+	if (x[i] > xmax) xmax = x[i];
+	if (y[i] < ymin) ymin = y[i];
+	if (y[i] > ymax) ymax = y[i];
+	}
+
+    /* Fit, rejecting outliers and moving the sky reference position by
+     * the constant term, until neither changes */
+    nok = np;
+    nrej = -1;
+    for (iter = 0; iter < SIPNITER; iter++) {
+
+	/* Intermediate world coordinates of reference stars */
+	for (i = 0; i < np; i++) {
+	    wcs2pix (wcs, x1[i], y1[i], &fxs, &fys, &offscl);
+	    fxs = fxs - wcs->xrefpix;
+	    fys = fys - wcs->yrefpix;
+	    wx[i] = wcs->cd[0] * fxs + wcs->cd[1] * fys;
+	    wy[i] = wcs->cd[2] * fxs + wcs->cd[3] * fys;
+	    }
+
+	if (sip_lsfit (np, du, dv, wx, wy, ok, scale, nterm, pp, qq, gcx, gcy)) {
+	    fprintf (stderr, "FitSIP: Cannot solve for order %d polynomial\n",
+		     order);
+	    nrej = -1;
+	    break;
+	    }
+	cd[0] = gcx[1];
+	cd[1] = gcx[2];
+	cd[2] = gcy[1];
+	cd[3] = gcy[2];
+	if (matinv (2, cd, dc)) {
+	    nrej = -1;
+	    break;
+	    }
+
+	/* Residuals in degrees of intermediate world coordinates */
+	sumr = 0.0;
+	for (i = 0; i < np; i++) {
+	    ex = wx[i];
+	    ey = wy[i];
+	    for (k = 0; k < nterm; k++) {
+		spq = pow (du[i], (double) pp[k]) * pow (dv[i], (double) qq[k]);
+		ex = ex - gcx[k] * spq;
+		ey = ey - gcy[k] * spq;
+		}
+	    res[i] = sqrt (ex * ex + ey * ey);
+	    if (ok[i])
+		sumr = sumr + res[i] * res[i];
+	    }
+	rms = sqrt (sumr / (double) nok);
+
+	/* Drop stars off by more than SIPCLIP sigma */
+	nrej = 0;
+	for (i = 0; i < np; i++) {
+	    if (ok[i] && res[i] > SIPCLIP * rms && nok - nrej > nterm + 1) {
+		ok[i] = 0;
+		nrej++;
+		}
+	    }
+	nok = nok - nrej;
+
+	/* Move sky reference position to the constant term */
+	fxs = wcs->dc[0] * gcx[0] + wcs->dc[1] * gcy[0];
+	fys = wcs->dc[2] * gcx[0] + wcs->dc[3] * gcy[0];
+	pix2wcs (wcs, wcs->xrefpix + fxs, wcs->yrefpix + fys, &ra, &dec);
+	if (debug)
+	    fprintf (stderr, "FitSIP: %d: %d stars, rms %.3f arcsec, %d rejected, center moved %.4f pixels\n",
+		     iter+1, nok+nrej, 3600.0 * rms, nrej,
+		     sqrt (fxs * fxs + fys * fys));
+	if (wcsreset (wcs, wcs->xrefpix, wcs->yrefpix, ra, dec, 0.0, 0.0, 0.0,
+		      cd)) {
+	    nrej = -1;
+	    break;
+	    }
+	if (nrej == 0 && fxs * fxs + fys * fys < 1.0e-8)
+	    break;
+	}
+    if (nrej < 0) {
+	wcs->distcode = distcode;
+	free (du); free (dv); free (wx); free (wy); free (ok); free (res);
+	free (gx); free (gy); free (fx); free (fy); free (gok);
+	return (1);
+	}
+
+    /* Set SIP coefficients, A = CD^-1 * higher order terms */
+    for (i = 0; i < DISTMAX; i++) {
+	for (j = 0; j < DISTMAX; j++) {
+	    wcs->distort.a[i][j] = 0.0;
+	    wcs->distort.b[i][j] = 0.0;
+	    wcs->distort.ap[i][j] = 0.0;
+	    wcs->distort.bp[i][j] = 0.0;
+	    }
+	}
+    for (k = 3; k < nterm; k++) {
+	wcs->distort.a[pp[k]][qq[k]] = dc[0] * gcx[k] + dc[1] * gcy[k];
+	wcs->distort.b[pp[k]][qq[k]] = dc[2] * gcx[k] + dc[3] * gcy[k];
+	}
+    wcs->distort.a_order = order;
+    wcs->distort.b_order = order;
+    wcs->distcode = DISTORT_SIRTF;
+
+    /* Fit inverse polynomials on a grid covering the image or the stars */
+    if (wcs->nxpix > 1.0 && wcs->nypix > 1.0) {
+	xmin = 0.5;
+	xmax = wcs->nxpix + 0.5;
+	ymin = 0.5;
+	ymax = wcs->nypix + 0.5;
+	}
+    xstep = (xmax - xmin) / (double) (SIPNGRID - 1);
+    ystep = (ymax - ymin) / (double) (SIPNGRID - 1);
+    for (j = 0; j < SIPNGRID; j++) {
+	ig = j * SIPNGRID;
+	pix2focrow (wcs, xmin, xstep, ymin + ystep * (double) j, SIPNGRID,
+		    fx + ig, fy + ig);
+	for (i = 0; i < SIPNGRID; i++) {
+	    gx[ig+i] = xmin + xstep * (double) i - fx[ig+i];
+	    gy[ig+i] = ymin + ystep * (double) j - fy[ig+i];
+	    fx[ig+i] = fx[ig+i] - wcs->xrefpix;
+	    fy[ig+i] = fy[ig+i] - wcs->yrefpix;
+	    }
+	}
+    nterm = 0;
+    for (k = 0; k <= iorder; k++) {
+	for (j = 0; j <= k; j++) {
+	    pp[nterm] = k - j;
+	    qq[nterm] = j;
+	    nterm++;
+	    }
+	}
+    scale = 0.0;
+    for (i = 0; i < ng; i++) {
+	gok[i] = 1;
+	if (fabs (fx[i]) > scale)
+	    scale = fabs (fx[i]);
+	if (fabs (fy[i]) > scale)
+	    scale = fabs (fy[i]);
+	}
+    if (sip_lsfit (ng, fx, fy, gx, gy, gok, scale, nterm, pp, qq, gcx, gcy)) {
+	fprintf (stderr, "FitSIP: Cannot fit order %d inverse polynomial\n",
+		 iorder);
+	wcs->distort.ap_order = 0;
+	wcs->distort.bp_order = 0;
+	}
+    else {
+	for (k = 0; k < nterm; k++) {
+	    wcs->distort.ap[pp[k]][qq[k]] = gcx[k];
+	    wcs->distort.bp[pp[k]][qq[k]] = gcy[k];
+	    }
+	wcs->distort.ap_order = iorder;
+	wcs->distort.bp_order = iorder;
+	}
+
+    if (debug) {
+	sumr = 0.0;
+	for (i = 0; i < np; i++) {
+	    wcs2pix (wcs, x1[i], y1[i], &fxs, &fys, &offscl);
+	    if (ok[i])
+		sumr = sumr + (fxs - x[i]) * (fxs - x[i]) +
+			      (fys - y[i]) * (fys - y[i]);
+	    }
+	fprintf (stderr, "FitSIP: order %d/%d fit to %d of %d stars: rms %.3f pixels\n",
+		 order, iorder, nok, np, sqrt (sumr / (double) nok));
+	}
+
+    free (du); free (dv); free (wx); free (wy); free (ok); free (res);
+    free (gx); free (gy); free (fx); free (fy); free (gok);
+    return (0);
+}
+
+
+/* Solve for coefficients of polynomials in u and v fitting zx and zy at
+ * points flagged ok, with u and v normalized by scale for conditioning.
+ * Return 0 if solved, else -1 */
+
+static int
+sip_lsfit (np, u, v, zx, zy, ok, scale, nterm, pp, qq, cx, cy)
+
+int	np;		/* Number of points */
+double	*u, *v;		/* Polynomial variables */
+double	*zx, *zy;	/* Values to fit */
+int	*ok;		/* 1 to use point, else 0 */
+double	scale;		/* Normalization for u and v */
+int	nterm;		/* Number of polynomial terms */
+int	*pp, *qq;	/* Powers of u and v for each term */
+double	*cx, *cy;	/* Coefficients (returned) */
+
+{
+    double *alpha, *alphai, bx[DISTMAX*DISTMAX], by[DISTMAX*DISTMAX];
+    double b[DISTMAX*DISTMAX], un[DISTMAX], vn[DISTMAX];
+    int i, j, k, maxp;
+
+    if (scale <= 0.0)
+	return (-1);
+    alpha = (double *) calloc (nterm * nterm, sizeof (double));
+    alphai = (double *) calloc (nterm * nterm, sizeof (double));
+    for (j = 0; j < nterm; j++) {
+	bx[j] = 0.0;
+	by[j] = 0.0;
+	}
+    maxp = 0;
+    for (j = 0; j < nterm; j++) {
+	if (pp[j] + qq[j] > maxp)
+	    maxp = pp[j] + qq[j];
+	}
+
+    for (i = 0; i < np; i++) {
+	if (!ok[i])
+	    continue;
+	un[0] = 1.0;
+	vn[0] = 1.0;
+	for (k = 1; k <= maxp; k++) {
+	    un[k] = un[k-1] * u[i] / scale;
+	    vn[k] = vn[k-1] * v[i] / scale;
+	    }
+	for (j = 0; j < nterm; j++)
+	    b[j] = un[pp[j]] * vn[qq[j]];
+	for (j = 0; j < nterm; j++) {
+	    bx[j] += b[j] * zx[i];
+	    by[j] += b[j] * zy[i];
+	    for (k = 0; k <= j; k++)
+		alpha[j*nterm + k] += b[j] * b[k];
+	    }
+	}
+    for (j = 0; j < nterm; j++) {
+	for (k = j + 1; k < nterm; k++)
+	    alpha[j*nterm + k] = alpha[k*nterm + j];
+	}
+
+    if (matinv (nterm, alpha, alphai)) {
+	free (alpha);
+	free (alphai);
+	return (-1);
+	}
+    for (j = 0; j < nterm; j++) {
+	cx[j] = 0.0;
+	cy[j] = 0.0;
+	for (k = 0; k < nterm; k++) {
+	    cx[j] += alphai[j*nterm + k] * bx[k];
+	    cy[j] += alphai[j*nterm + k] * by[k];
+	    }
+	cx[j] = cx[j] / pow (scale, (double) (pp[j] + qq[j]));
+	cy[j] = cy[j] / pow (scale, (double) (pp[j] + qq[j]));
+	}
+    free (alpha);
+    free (alphai);
+    return (0);
+}
+
+
 /* Mar 30 1998	New subroutines
  * Apr  7 1998	Add x^3 and y^3 terms
  * Apr 10 1998	Add second number of coefficients
@@ -305,4 +784,8 @@ int	iter;	/* Number of iterations */
  * Jan 11 2001	Print all messages to stderr
  *
  * Sep 26 2006	Increase length of rastr and destr from 16 to 32
+ *
+ * Oct 18 2026	Add plate_lsfit() to fit plate polynomials by linear least squares
+ * Oct 18 2026	Use plate_amoeba() only if least squares fit fails or is turned off
+ * Oct 18 2026	Add FitSIP() to fit SIP distortion with outlier rejection
  */
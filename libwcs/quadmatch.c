@@ -0,0 +1,821 @@
+/*** File libwcs/quadmatch.c
+ *** October 18, 2026
+ *** By Jessica Mink, jmink@cfa.harvard.edu
+ *** Harvard-Smithsonian Center for Astrophysics
+ *** Copyright (C) 2026
+ *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+    Correspondence concerning WCSTools should be addressed as follows:
+           Internet email: jmink@cfa.harvard.edu
+           Postal address: Jessica Mink
+                           Smithsonian Astrophysical Observatory
+                           60 Garden St.
+                           Cambridge, MA 02138 USA
+ */
+
+/* QuadMatch (ns, sx, sy, ng, gra, gdec, tol, wcs, debug)
+ *  Find center, scale, and rotation of image stars from reference stars
+ *  without an initial guess, by matching hashed four-star asterisms
+ *
+ * setquadcache (filename)  Keep reference star quads in this file
+ * setquadtol (tol)  Set largest difference between matching quad codes
+ *
+ * Each quad of four nearby stars is described by the positions of its
+ * inner two stars in a frame which puts the two most widely separated
+ * stars at 0,0 and 1,0.  These codes do not change with the scale,
+ * rotation, or position of the quad, so quads of image stars in pixels
+ * are looked up in a hash table of quads of reference stars in standard
+ * coordinates around the nominal field center.  Each matching pair of
+ * quads gives a trial scale, rotation, and center, which is checked by
+ * counting the reference stars which fall on image stars, and the first
+ * which matches enough stars is fit to all of its matches by FitMatch().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "wcs.h"
+#include "lwcs.h"
+#include "wcscat.h"
+
+extern int FitMatch();
+
+/* Four-star asterisms hashed by their codes */
+struct QuadIndex {
+    int		nstars;		/* Number of stars from which quads are made */
+    int		nquads;		/* Number of quads */
+    int		nmax;		/* Number of quads allocated */
+    int		*star;		/* Stars A, B, C, D of each quad */
+    double	*code;		/* C and D positions in A-B frame of each quad */
+    int		nhash;		/* Number of hash table entries (power of 2) */
+    int		*head;		/* First quad in each hash entry, -1 if none */
+    int		*next;		/* Next quad in same hash entry, -1 if none */
+    double	bin;		/* Width of hash cell in each code dimension */
+};
+
+static struct QuadIndex *QuadBuild();
+static int QuadCode();
+static void QuadHash();
+static int QuadCell();
+static struct QuadIndex *QuadRead();
+static void QuadWrite();
+static void QuadFree();
+static int QuadCheck();
+static int QuadSolve();
+static int QuadList();
+
+static char *quadcache = NULL;	/* File in which to keep reference quads */
+static double quadtol = QUADTOL;	/* Largest code difference for match */
+
+#define QUADHEAD	"QUADINDEX 1"
+
+
+/* Find the WCS of an image with no usable initial WCS by matching quads
+ * of image stars to quads of reference stars.  Only the nominal center
+ * in wcs is used, as the tangent point for the reference stars.
+ * Return number of matched stars after fit, else 0 if no solution */
+
+int
+QuadMatch (ns, sx, sy, ng, gra, gdec, tol, wcs, debug)
+
+int	ns;		/* Number of image stars, brightest first */
+double	*sx;		/* Image star X coordinates in pixels */
+double	*sy;		/* Image star Y coordinates in pixels */
+int	ng;		/* Number of reference stars, brightest first */
+double	*gra;		/* Reference star right ascensions in degrees */
+double	*gdec;		/* Reference star declinations in degrees */
+double	tol;		/* +/- this many pixels is a hit */
+struct WorldCoor *wcs;	/* World coordinate structure (fit returned) */
+int	debug;		/* Print progress if not zero */
+
+{
+    struct QuadIndex *gquad, *squad;
+    struct StarGrid *grid;
+    double *gxi, *geta, *nsx;
+    double ra0, dec0, sdec0, cdec0, sdec, cdec, dra, cosc;
+    double code[4], a[2], b[2], bin;
+    unsigned int key;
+    unsigned char *kb;
+    int nqs, nqg, parity, iq, ig, jq, i, nbin, nhit, nin, nneed, ntry;
+    int cell[4], probe[4], iprobe, hit, q[4];
+
+    nbin = 0;
+    if (ns < 4 || ng < 4)
+	return (0);
+
+    /* Use similar densities of image and reference stars */
+    nqs = ns;
+    if (nqs > QUADSTARS)
+	nqs = QUADSTARS;
+    nqg = (int) ((double) ng * (double) nqs / (double) ns + 0.5);
+    if (nqg < 4)
+	nqg = 4;
+
+    /* Project reference stars onto a plane tangent at the nominal center */
+    ra0 = wcs->xref;
+    dec0 = wcs->yref;
+    sdec0 = sin (degrad (dec0));
+    cdec0 = cos (degrad (dec0));
+    gxi = (double *) calloc (ng, sizeof (double));
+    geta = (double *) calloc (ng, sizeof (double));
+    nsx = (double *) calloc (ns, sizeof (double));
+    if (gxi == NULL || geta == NULL || nsx == NULL) {
+	fprintf (stderr, "QuadMatch: Cannot allocate %d stars\n", ng + ns);
+	if (gxi) free (gxi);
+	if (geta) free (geta);
+	if (nsx) free (nsx);
+	return (0);
+	}
+    for (ig = 0; ig < ng; ig++) {
+	sdec = sin (degrad (gdec[ig]));
+	cdec = cos (degrad (gdec[ig]));
+	dra = degrad (gra[ig] - ra0);
+	cosc = sdec * sdec0 + cdec * cdec0 * cos (dra);
+	gxi[ig] = raddeg (cdec * sin (dra) / cosc);
+	geta[ig] = raddeg ((sdec * cdec0 - cdec * sdec0 * cos (dra)) / cosc);
+	}
+
+    /* Reference quads from the cache file if they are for the same stars */
+    key = 2166136261U;
+    kb = (unsigned char *) &ra0;
+    for (i = 0; i < (int) sizeof (double); i++)
+	key = (key ^ kb[i]) * 16777619U;
+    kb = (unsigned char *) &dec0;
+    for (i = 0; i < (int) sizeof (double); i++)
+	key = (key ^ kb[i]) * 16777619U;
+    for (ig = 0; ig < nqg; ig++) {
+	kb = (unsigned char *) &gra[ig];
+	for (i = 0; i < (int) sizeof (double); i++)
+	    key = (key ^ kb[i]) * 16777619U;
+	kb = (unsigned char *) &gdec[ig];
+	for (i = 0; i < (int) sizeof (double); i++)
+	    key = (key ^ kb[i]) * 16777619U;
+	}
+    bin = 2.0 * quadtol;
+    gquad = NULL;
+    if (quadcache != NULL)
+	gquad = QuadRead (quadcache, key, nqg);
+    if (gquad == NULL) {
+	gquad = QuadBuild (nqg, gxi, geta, 0.0);
+	if (quadcache != NULL && gquad != NULL)
+	    QuadWrite (gquad, quadcache, key);
+	}
+    else if (debug)
+	fprintf (stderr,"QuadMatch: %d reference quads from %s\n",
+		 gquad->nquads, quadcache);
+    if (gquad == NULL) {
+	free (gxi);
+	free (geta);
+	free (nsx);
+	return (0);
+	}
+    QuadHash (gquad, bin);
+
+    /* Grid of all image stars for checking trial solutions */
+    grid = StarGridInit (wcs->nxpix, wcs->nypix, (int) (2.0 * tol) + 1);
+    for (i = 0; i < ns; i++)
+	(void) StarGridAdd (grid, sx[i], sy[i]);
+
+    if (debug)
+	fprintf (stderr,"QuadMatch: %d image stars, %d reference stars, %d reference quads\n",
+		 nqs, nqg, gquad->nquads);
+
+    /* Try both image parities, as the image may be mirrored */
+    ntry = 0;
+    for (parity = 0; parity < 2 && nbin == 0; parity++) {
+	for (i = 0; i < ns; i++)
+	    nsx[i] = parity ? -sx[i] : sx[i];
+	squad = QuadBuild (nqs, nsx, sy, 2.0 * tol);
+	if (squad == NULL)
+	    continue;
+
+	for (iq = 0; iq < squad->nquads && nbin == 0; iq++) {
+	    for (i = 0; i < 4; i++)
+		cell[i] = (int) floor (squad->code[4*iq+i] / bin);
+
+	    /* Matching codes may be in this cell or the nearer neighbor */
+	    for (iprobe = 0; iprobe < 16 && nbin == 0; iprobe++) {
+		for (i = 0; i < 4; i++) {
+		    probe[i] = cell[i];
+		    if (iprobe & (1 << i)) {
+			if (squad->code[4*iq+i] - bin * cell[i] < 0.5 * bin)
+			    probe[i]--;
+			else
+			    probe[i]++;
+			}
+		    }
+		hit = QuadCell (probe) & (gquad->nhash - 1);
+		for (jq = gquad->head[hit]; jq > -1 && nbin == 0;
+		     jq = gquad->next[jq]) {
+		    for (i = 0; i < 4; i++) {
+			code[i] = gquad->code[4*jq+i];
+			if ((int) floor (code[i] / bin) != probe[i])
+			    break;
+			code[i] = code[i] - squad->code[4*iq+i];
+			}
+		    if (i < 4)
+			continue;
+		    if (code[0]*code[0] + code[1]*code[1] + code[2]*code[2] +
+			code[3]*code[3] > quadtol * quadtol)
+			continue;
+
+		    /* Trial similarity transform and quick check */
+		    if (QuadCheck (squad->star + 4*iq, nsx, sy,
+				   gquad->star + 4*jq, gxi, geta, tol, a, b))
+			continue;
+		    ntry++;
+		    nhit = QuadList (parity, a, b, ng, gxi, geta, wcs, grid,
+				     tol, &nin);
+		    nneed = nin;
+		    if (nneed > ns)
+			nneed = ns;
+		    nneed = (int) (QUADFRAC * (double) nneed);
+		    if (nneed < MINSTARS + 2)
+			nneed = MINSTARS + 2;
+		    if (nhit < nneed)
+			continue;
+		    if (debug) {
+			for (i = 0; i < 4; i++)
+			    q[i] = gquad->star[4*jq+i];
+			fprintf (stderr,"QuadMatch: trial %d parity %d scale %.4f\"/pix: %d / %d stars with reference stars %d %d %d %d\n",
+				 ntry, parity, 3600.0 * sqrt (a[0]*a[0] + a[1]*a[1]),
+				 nhit, nin, q[0], q[1], q[2], q[3]);
+			}
+		    nbin = QuadSolve (parity, a, b, ra0, dec0, ns, sx, sy,
+				      ng, gra, gdec, tol, nneed, wcs, debug);
+		    }
+		}
+	    }
+	QuadFree (squad);
+	}
+
+    if (debug && nbin == 0)
+	fprintf (stderr,"QuadMatch: no solution after %d trials\n", ntry);
+    StarGridFree (grid);
+    QuadFree (gquad);
+    free (gxi);
+    free (geta);
+    free (nsx);
+    return (nbin);
+}
+
+
+/* Make quads from each star and three of its nearest neighbors.  Quads
+ * whose outer stars are closer than minsep are skipped. */
+
+static struct QuadIndex *
+QuadBuild (n, x, y, minsep)
+
+int	n;		/* Number of stars */
+double	*x, *y;		/* Star coordinates */
+double	minsep;		/* Minimum separation of outer stars in quad */
+
+{
+    struct QuadIndex *quad;
+    double *d2, dx, dy, dmax;
+    int *near, nnear, i, j, k, l, m, q[4];
+
+    quad = (struct QuadIndex *) calloc (1, sizeof (struct QuadIndex));
+    near = (int *) malloc (QUADNEAR * sizeof (int));
+    d2 = (double *) malloc (QUADNEAR * sizeof (double));
+    quad->nstars = n;
+    quad->nmax = n * (QUADNEAR * (QUADNEAR-1) * (QUADNEAR-2) / 6);
+    quad->star = (int *) malloc (4 * quad->nmax * sizeof (int));
+    quad->code = (double *) malloc (4 * quad->nmax * sizeof (double));
+    if (quad->star == NULL || quad->code == NULL) {
+	fprintf (stderr, "QuadBuild: Cannot allocate %d quads\n", quad->nmax);
+	free (near);
+	free (d2);
+	QuadFree (quad);
+	return (NULL);
+	}
+
+    for (i = 0; i < n; i++) {
+
+	/* Nearest neighbors by insertion into a short sorted list */
+	nnear = 0;
+	for (j = 0; j < n; j++) {
+	    if (j == i)
+		continue;
+	    dx = x[j] - x[i];
+	    dy = y[j] - y[i];
+	    dmax = dx * dx + dy * dy;
+	    if (nnear == QUADNEAR && dmax >= d2[nnear-1])
+		continue;
+	    if (nnear < QUADNEAR)
+		nnear++;
+	    for (k = nnear - 1; k > 0 && d2[k-1] > dmax; k--) {
+		d2[k] = d2[k-1];
+		near[k] = near[k-1];
+		}
+	    d2[k] = dmax;
+	    near[k] = j;
+	    }
+
+	for (j = 0; j < nnear; j++) {
+	    for (k = j + 1; k < nnear; k++) {
+		for (l = k + 1; l < nnear; l++) {
+		    q[0] = i;
+		    q[1] = near[j];
+		    q[2] = near[k];
+		    q[3] = near[l];
+		    m = quad->nquads;
+		    if (QuadCode (x, y, q, minsep, quad->code + 4*m))
+			continue;
+		    quad->star[4*m] = q[0];
+		    quad->star[4*m+1] = q[1];
+		    quad->star[4*m+2] = q[2];
+		    quad->star[4*m+3] = q[3];
+		    quad->nquads++;
+		    }
+		}
+	    }
+	}
+    free (near);
+    free (d2);
+    return (quad);
+}
+
+
+/* Compute the code of a quad and reorder its stars as A, B, C, D, where
+ * A and B are farthest apart, xC + xD <= 1, and xC <= xD.
+ * Return 0 if ok, else -1 if A and B are closer than minsep */
+
+static int
+QuadCode (x, y, q, minsep, code)
+
+double	*x, *y;		/* Star coordinates */
+int	*q;		/* Indices of four stars (reordered) */
+double	minsep;		/* Minimum separation of A and B */
+double	*code;		/* xC, yC, xD, yD (returned) */
+
+{
+    double dx, dy, d2, dmax, u[2], v[2], t;
+    int i, j, ia, ib, p[4], k;
+
+    dmax = -1.0;
+    ia = 0;
+    ib = 1;
+    for (i = 0; i < 4; i++) {
+	for (j = i + 1; j < 4; j++) {
+	    dx = x[q[j]] - x[q[i]];
+	    dy = y[q[j]] - y[q[i]];
+	    d2 = dx * dx + dy * dy;
+	    if (d2 > dmax) {
+		dmax = d2;
+		ia = i;
+		ib = j;
+		}
+	    }
+	}
+    if (dmax <= minsep * minsep || dmax <= 0.0)
+	return (-1);
+    p[0] = q[ia];
+    p[1] = q[ib];
+    k = 2;
+    for (i = 0; i < 4; i++) {
+	if (i != ia && i != ib)
+	    p[k++] = q[i];
+	}
+
+    /* Divide offsets from A as complex numbers by B - A */
+    dx = x[p[1]] - x[p[0]];
+    dy = y[p[1]] - y[p[0]];
+    for (k = 0; k < 2; k++) {
+	u[k] = ((x[p[k+2]] - x[p[0]]) * dx + (y[p[k+2]] - y[p[0]]) * dy) / dmax;
+	v[k] = ((y[p[k+2]] - y[p[0]]) * dx - (x[p[k+2]] - x[p[0]]) * dy) / dmax;
+	}
+
+    /* Swap A and B to put C and D nearer A */
+    if (u[0] + u[1] > 1.0) {
+	i = p[0];
+	p[0] = p[1];
+	p[1] = i;
+	for (k = 0; k < 2; k++) {
+	    u[k] = 1.0 - u[k];
+	    v[k] = -v[k];
+	    }
+	}
+
+    /* Then order C and D */
+    if (u[0] > u[1]) {
+	i = p[2];
+	p[2] = p[3];
+	p[3] = i;
+	t = u[0]; u[0] = u[1]; u[1] = t;
+	t = v[0]; v[0] = v[1]; v[1] = t;
+	}
+    code[0] = u[0];
+    code[1] = v[0];
+    code[2] = u[1];
+    code[3] = v[1];
+    for (k = 0; k < 4; k++)
+	q[k] = p[k];
+    return (0);
+}
+
+
+/* Hash quads by the cell of their code in a grid of bin-wide cells */
+
+static void
+QuadHash (quad, bin)
+
+struct QuadIndex *quad;	/* Quad index */
+double	bin;		/* Width of hash cell in each code dimension */
+
+{
+    int iq, ih, i, cell[4];
+
+    quad->bin = bin;
+    for (quad->nhash = 64; quad->nhash < 2 * quad->nquads; quad->nhash *= 2);
+    quad->head = (int *) malloc (quad->nhash * sizeof (int));
+    quad->next = (int *) malloc ((quad->nquads + 1) * sizeof (int));
+    for (ih = 0; ih < quad->nhash; ih++)
+	quad->head[ih] = -1;
+    for (iq = 0; iq < quad->nquads; iq++) {
+	for (i = 0; i < 4; i++)
+	    cell[i] = (int) floor (quad->code[4*iq+i] / bin);
+	ih = QuadCell (cell) & (quad->nhash - 1);
+	quad->next[iq] = quad->head[ih];
+	quad->head[ih] = iq;
+	}
+    return;
+}
+
+
+/* Hash value of a four-dimensional code cell */
+
+static int
+QuadCell (cell)
+
+int	*cell;		/* Cell indices in each dimension */
+{
+    unsigned int h;
+
+    h = ((unsigned int) cell[0] * 73856093U) ^
+	((unsigned int) cell[1] * 19349663U) ^
+	((unsigned int) cell[2] * 83492791U) ^
+	((unsigned int) cell[3] * 50331653U);
+    return ((int) (h & 0x7fffffff));
+}
+
+
+/* Fit a similarity transform, w = a * z + b as complex numbers, from image
+ * z = x + iy to reference w = xi + i eta for the stars of two quads.
+ * Return 0 if all four stars fit within tol pixels, else -1 */
+
+static int
+QuadCheck (qs, sx, sy, qg, gxi, geta, tol, a, b)
+
+int	*qs;		/* Image quad stars */
+double	*sx, *sy;	/* Image star coordinates (x reflected for parity) */
+int	*qg;		/* Reference quad stars */
+double	*gxi, *geta;	/* Reference star standard coordinates */
+double	tol;		/* Largest residual in pixels */
+double	*a, *b;		/* Scale and rotation, and offset (returned) */
+
+{
+    double zx, zy, wx, wy, dzx, dzy, dwx, dwy, sz2, a2, ex, ey;
+    int k;
+
+    zx = zy = wx = wy = 0.0;
+    for (k = 0; k < 4; k++) {
+	zx += sx[qs[k]];
+	zy += sy[qs[k]];
+	wx += gxi[qg[k]];
+	wy += geta[qg[k]];
+	}
+    zx *= 0.25;
+    zy *= 0.25;
+    wx *= 0.25;
+    wy *= 0.25;
+    a[0] = a[1] = sz2 = 0.0;
+    for (k = 0; k < 4; k++) {
+	dzx = sx[qs[k]] - zx;
+	dzy = sy[qs[k]] - zy;
+	dwx = gxi[qg[k]] - wx;
+	dwy = geta[qg[k]] - wy;
+	a[0] += dwx * dzx + dwy * dzy;
+	a[1] += dwy * dzx - dwx * dzy;
+	sz2 += dzx * dzx + dzy * dzy;
+	}
+    if (sz2 <= 0.0)
+	return (-1);
+    a[0] /= sz2;
+    a[1] /= sz2;
+    a2 = a[0] * a[0] + a[1] * a[1];
+    if (a2 <= 0.0)
+	return (-1);
+    b[0] = wx - (a[0] * zx - a[1] * zy);
+    b[1] = wy - (a[0] * zy + a[1] * zx);
+
+    for (k = 0; k < 4; k++) {
+	ex = a[0] * sx[qs[k]] - a[1] * sy[qs[k]] + b[0] - gxi[qg[k]];
+	ey = a[0] * sy[qs[k]] + a[1] * sx[qs[k]] + b[1] - geta[qg[k]];
+	if (ex * ex + ey * ey > tol * tol * a2)
+	    return (-1);
+	}
+    return (0);
+}
+
+
+/* Count reference stars which land within tol of an image star using a
+ * trial similarity transform, and set nin to the number on the image */
+
+static int
+QuadList (parity, a, b, ng, gxi, geta, wcs, grid, tol, nin)
+
+int	parity;		/* 1 if image x is reflected, else 0 */
+double	*a, *b;		/* Similarity transform from image to reference */
+int	ng;		/* Number of reference stars */
+double	*gxi, *geta;	/* Reference star standard coordinates */
+struct WorldCoor *wcs;	/* Image dimensions */
+struct StarGrid *grid;	/* Grid of image stars */
+double	tol;		/* +/- this many pixels is a hit */
+int	*nin;		/* Number of reference stars on image (returned) */
+
+{
+    double a2, wx, wy, x, y;
+    int ig, nhit;
+
+    a2 = a[0] * a[0] + a[1] * a[1];
+    nhit = 0;
+    *nin = 0;
+    for (ig = 0; ig < ng; ig++) {
+	wx = gxi[ig] - b[0];
+	wy = geta[ig] - b[1];
+	x = (wx * a[0] + wy * a[1]) / a2;
+	y = (wy * a[0] - wx * a[1]) / a2;
+	if (parity)
+	    x = -x;
+	if (x < 0.5 || y < 0.5 || x > wcs->nxpix + 0.5 || y > wcs->nypix + 0.5)
+	    continue;
+	(*nin)++;
+	if (StarGridBox (grid, x, y, tol) > -1)
+	    nhit++;
+	}
+    return (nhit);
+}
+
+
+/* Set the WCS from a trial transform, match all stars, and fit the WCS to
+ * the matches with FitMatch().  Return the number of matches to the fit
+ * WCS if there are at least nneed, else 0 */
+
+static int
+QuadSolve (parity, a, b, ra0, dec0, ns, sx, sy, ng, gra, gdec, tol, nneed,
+	   wcs, debug)
+
+int	parity;		/* 1 if image x is reflected, else 0 */
+double	*a, *b;		/* Similarity transform from image to reference */
+double	ra0, dec0;	/* Tangent point of reference coordinates */
+int	ns;		/* Number of image stars */
+double	*sx, *sy;	/* Image star X and Y coordinates in pixels */
+int	ng;		/* Number of reference stars */
+double	*gra, *gdec;	/* Reference star coordinates in degrees */
+double	tol;		/* +/- this many pixels is a hit */
+int	nneed;		/* Number of matches needed for a solution */
+struct WorldCoor *wcs;	/* World coordinate structure (fit returned) */
+int	debug;		/* Print progress if not zero */
+
+{
+    double cd[4], *cdx, cdelt1, cdelt2, crota, xrefpix, yrefpix;
+    double a2, s, x0, y0, ra, dec, dx, dy, dxy, dxys;
+    double *mx, *my, *mra, *mdec, *gpx, *gpy;
+    int *goff;
+    int is, ig, igs, nmatch, iter;
+
+    /* z = s*x + iy, so CD = [s*ar -ai; s*ai ar] and the tangent point is
+       at z0 = -b / a */
+    s = parity ? -1.0 : 1.0;
+    a2 = a[0] * a[0] + a[1] * a[1];
+    x0 = s * (-(b[0] * a[0] + b[1] * a[1]) / a2);
+    y0 = -(b[1] * a[0] - b[0] * a[1]) / a2;
+    if (wcs->rotmat) {
+	cd[0] = s * a[0];
+	cd[1] = -a[1];
+	cd[2] = s * a[1];
+	cd[3] = a[0];
+	cdx = cd;
+	cdelt1 = 0.0;
+	cdelt2 = 0.0;
+	crota = 0.0;
+	}
+    else {
+	cdx = NULL;
+	cdelt1 = s * sqrt (a2);
+	cdelt2 = sqrt (a2);
+	crota = raddeg (atan2 (a[1], a[0]));
+	}
+    xrefpix = wcs->xrefpix;
+    yrefpix = wcs->yrefpix;
+    (void) wcsreset (wcs, x0, y0, ra0, dec0, cdelt1, cdelt2, crota, cdx);
+
+    /* Keep the nominal reference pixel if its position can be set */
+    if (wcs->sysout == wcs->syswcs &&
+	(wcs->eqout == 0.0 || wcs->eqout == wcs->equinox)) {
+	pix2wcs (wcs, xrefpix, yrefpix, &ra, &dec);
+	(void) wcsreset (wcs, xrefpix, yrefpix, ra, dec, cdelt1, cdelt2,
+			 crota, cdx);
+	}
+
+    mx = (double *) calloc (ns, sizeof (double));
+    my = (double *) calloc (ns, sizeof (double));
+    mra = (double *) calloc (ns, sizeof (double));
+    mdec = (double *) calloc (ns, sizeof (double));
+    gpx = (double *) calloc (ng, sizeof (double));
+    gpy = (double *) calloc (ng, sizeof (double));
+    goff = (int *) calloc (ng, sizeof (int));
+    if (mx == NULL || my == NULL || mra == NULL || mdec == NULL ||
+	gpx == NULL || gpy == NULL || goff == NULL) {
+	fprintf (stderr, "QuadSolve: Cannot allocate %d matches\n", ns);
+	nmatch = 0;
+	}
+
+    /* Match each image star to the nearest reference star, then fit the
+       WCS to the matches and match again */
+    else {
+	for (iter = 0; iter < 2; iter++) {
+	    for (ig = 0; ig < ng; ig++)
+		wcs2pix (wcs, gra[ig], gdec[ig], &gpx[ig], &gpy[ig], &goff[ig]);
+	    nmatch = 0;
+	    for (is = 0; is < ns; is++) {
+		dxys = tol * tol;
+		igs = -1;
+		for (ig = 0; ig < ng; ig++) {
+		    if (goff[ig])
+			continue;
+		    dx = gpx[ig] - sx[is];
+		    dy = gpy[ig] - sy[is];
+		    dxy = dx * dx + dy * dy;
+		    if (dxy < dxys) {
+			dxys = dxy;
+			igs = ig;
+			}
+		    }
+		if (igs > -1) {
+		    mx[nmatch] = sx[is];
+		    my[nmatch] = sy[is];
+		    mra[nmatch] = gra[igs];
+		    mdec[nmatch] = gdec[igs];
+		    nmatch++;
+		    }
+		}
+	    if (debug)
+		fprintf (stderr,"QuadSolve: %d matches %s fit\n", nmatch,
+			 iter ? "after" : "before");
+	    if (nmatch < nneed) {
+		nmatch = 0;
+		break;
+		}
+	    if (iter == 0)
+		(void) FitMatch (nmatch, mx, my, mra, mdec, wcs, debug);
+	    }
+	}
+    if (mx) free (mx);
+    if (my) free (my);
+    if (mra) free (mra);
+    if (mdec) free (mdec);
+    if (gpx) free (gpx);
+    if (gpy) free (gpy);
+    if (goff) free (goff);
+    return (nmatch);
+}
+
+
+/* Read reference quads from a cache file if they were made from the same
+ * stars, as identified by key, else return NULL */
+
+static struct QuadIndex *
+QuadRead (filename, key, nstars)
+
+char	*filename;	/* Name of quad cache file */
+unsigned int key;	/* Checksum of tangent point and reference stars */
+int	nstars;		/* Number of reference stars */
+
+{
+    FILE *fd;
+    struct QuadIndex *quad;
+    char line[80];
+    unsigned int fkey;
+    int nst, nq, i;
+
+    if ((fd = fopen (filename, "r")) == NULL)
+	return (NULL);
+    if (fgets (line, 80, fd) == NULL || strncmp (line, QUADHEAD, 11) ||
+	sscanf (line+11, "%u %d %d", &fkey, &nst, &nq) < 3 ||
+	fkey != key || nst != nstars || nq < 1 ||
+	nq > nst * (QUADNEAR * (QUADNEAR-1) * (QUADNEAR-2) / 6)) {
+	fclose (fd);
+	return (NULL);
+	}
+    quad = (struct QuadIndex *) calloc (1, sizeof (struct QuadIndex));
+    if (quad == NULL) {
+	fclose (fd);
+	return (NULL);
+	}
+    quad->nstars = nst;
+    quad->nquads = nq;
+    quad->nmax = nq;
+    quad->star = (int *) malloc (4 * nq * sizeof (int));
+    quad->code = (double *) malloc (4 * nq * sizeof (double));
+    if (quad->star == NULL || quad->code == NULL ||
+	fread (quad->star, sizeof (int), 4 * nq, fd) != (size_t) (4 * nq) ||
+	fread (quad->code, sizeof (double), 4 * nq, fd) != (size_t) (4 * nq)) {
+	fprintf (stderr, "QuadRead: Cannot read %d quads from %s\n",
+		 nq, filename);
+	fclose (fd);
+	QuadFree (quad);
+	return (NULL);
+	}
+    fclose (fd);
+
+    /* Rebuild the quads if any star is not one of these reference stars */
+    for (i = 0; i < 4 * nq; i++) {
+	if (quad->star[i] < 0 || quad->star[i] >= nstars) {
+	    fprintf (stderr, "QuadRead: Star %d out of range in %s\n",
+		     quad->star[i], filename);
+	    QuadFree (quad);
+	    return (NULL);
+	    }
+	}
+    return (quad);
+}
+
+
+/* Write reference quads to a cache file, replacing any which are there */
+
+static void
+QuadWrite (quad, filename, key)
+
+struct QuadIndex *quad;	/* Quad index */
+char	*filename;	/* Name of quad cache file */
+unsigned int key;	/* Checksum of tangent point and reference stars */
+
+{
+    FILE *fd;
+    int nq;
+
+    if ((fd = fopen (filename, "w")) == NULL) {
+	fprintf (stderr, "QuadWrite: Cannot write %s\n", filename);
+	return;
+	}
+    nq = quad->nquads;
+    fprintf (fd, "%s %u %d %d\n", QUADHEAD, key, quad->nstars, nq);
+    if (fwrite (quad->star, sizeof (int), 4 * nq, fd) != (size_t) (4 * nq) ||
+	fwrite (quad->code, sizeof (double), 4 * nq, fd) != (size_t) (4 * nq))
+	fprintf (stderr, "QuadWrite: Cannot write %d quads to %s\n",
+		 nq, filename);
+    fclose (fd);
+    return;
+}
+
+
+static void
+QuadFree (quad)
+
+struct QuadIndex *quad;	/* Quad index */
+{
+    if (quad == NULL)
+	return;
+    if (quad->star) free (quad->star);
+    if (quad->code) free (quad->code);
+    if (quad->head) free (quad->head);
+    if (quad->next) free (quad->next);
+    free (quad);
+    return;
+}
+
+
+/* Keep reference star quads in this file between runs */
+void
+setquadcache (filename)
+char *filename;
+{ quadcache = filename; return; }
+
+/* Largest difference between codes of matching quads */
+void
+setquadtol (tol)
+double tol;
+{ if (tol > 0.0) quadtol = tol;
+  return; }
+
+/* Oct 18 2026	New subroutines for matching stars without an initial WCS
+ *
+ * Oct 19 2026	Ignore a quad cache with too many quads or star numbers out of range
+ */
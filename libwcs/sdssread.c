@@ -1,8 +1,8 @@
 /*** File libwcs/sdssread.c
- *** September 16, 2013
+ *** October 18, 2026
  *** By Jessica Mink, jmink@cfa.harvard.edu
  *** Harvard-Smithsonian Center for Astrophysics
- *** Copyright (C) 2004-2013
+ *** Copyright (C) 2004-2026
  *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
 
     This library is free software; you can redistribute it and/or
@@ -165,7 +165,7 @@ int	nlog;		/* 1 for diagnostics */
 	fprintf (stderr,"%s%s\n", sdssurl, srchurl);
 
     /* Run search across the web */
-    if ((tabtable = webopen (sdssurl, srchurl, nlog)) == NULL) {
+    if ((tabtable = webopenstream (sdssurl, srchurl, nlog)) == NULL) {
 	if (nlog > 0)
 	    fprintf (stderr, "WEBREAD: %s failed\n", srchurl);
 	return (0);
@@ -273,4 +273,6 @@ sdssc2t (csvbuff)
  * Sep 16 2013	Add alternate servers for SDSS
  *
  * Jan 13 2015	Add new main server for SDSS DR7
+ *
+ * Oct 18 2026	Read returned table as it arrives using webopenstream()
  */
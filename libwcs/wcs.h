@@ -1,7 +1,7 @@
 /*** File libwcs/wcs.h
- *** February 1, 2022
+ *** October 18, 2026
  *** By Jessica Mink, SAO Telescope Data Center
- *** Copyright (C) 1994-2022
+ *** Copyright (C) 1994-2026
 
     This library is free software; you can redistribute it and/or
     modify it under the terms of the GNU Lesser General Public
@@ -623,12 +623,23 @@ extern "C" {
     int DelDistort (	/* Delete all distortion-related fields */
 	char *header,	/* FITS header */
 	int verbose);	/* If !=0, print keywords as deleted */
+    void SetFITSDistort ( /* Set distortion coefficients in FITS header */
+	char *header,	/* FITS header */
+	struct WorldCoor *wcs);	/* World coordinate system structure */
     void pix2foc (	/* Convert pixel to focal plane coordinates */
 	struct WorldCoor *wcs,	/* World coordinate system structure */
 	double x,	/* Image pixel horizontal coordinate */
 	double y,	/* Image pixel vertical coordinate */
 	double *u,	/* Focal plane horizontal coordinate(returned) */
 	double *v);	/* Focal plane vertical coordinate (returned) */
+    void pix2focrow ( /* Convert row of pixels to focal plane coordinates */
+	struct WorldCoor *wcs,	/* World coordinate system structure */
+	double u0,	/* First image pixel horizontal coordinate */
+	double du,	/* Image pixel horizontal coordinate increment */
+	double v,	/* Image pixel vertical coordinate of row */
+	int nu,		/* Number of pixels in row */
+	double *x,	/* Focal plane horizontal coordinates (returned) */
+	double *y);	/* Focal plane vertical coordinates (returned) */
     void foc2pix (	/* Convert focal plane to pixel coordinates */
 	struct WorldCoor *wcs,	/* World coordinate system structure */
 	double u,	/* Focal plane horizontal coordinate */
@@ -804,7 +815,9 @@ void distortinit();	/* Set distortion coefficients from FITS header */
 void setdistcode();	/* Set WCS distortion code string from CTYPEi value */
 char *getdistcode();	/* Return distortion code string for CTYPEi */
 int DelDistort();	/* Delete all distortion-related fields */
+void SetFITSDistort();	/* Set distortion coefficients in FITS header */
 void pix2foc();		/*  pixel coordinates -> focal plane coordinates */
+void pix2focrow();	/*  row of pixels -> focal plane coordinates */
 void foc2pix();		/*  focal plane coordinates -> pixel coordinates */
 
 /* Other projection subroutines */
@@ -974,4 +987,6 @@ extern int zpxpix();	/* Inverse transform (world to physical) gnomonic projectio
  * Aug  2 2021	Add range, string-parsing, and polynomial-fitting subroutines from wcscat.h
  *
  * Feb  1 2022	Move range, string parsing, and polynomial-fitting subroutines to fitsfile.h
+ *
+ * Oct 18 2026	Add SetFITSDistort() and pix2focrow() to distort.c
  */
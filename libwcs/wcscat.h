@@ -1,7 +1,7 @@
 /*** File libwcs/wcscat.h
- *** August 2, 2021
+ *** October 18, 2026
  *** By Jessica Mink, SAO Telescope Data Center
- *** Copyright (C) 1998-2021
+ *** Copyright (C) 1998-2026
 
     This library is free software; you can redistribute it and/or
     modify it under the terms of the GNU Lesser General Public
@@ -72,6 +72,36 @@ struct Star {
 #define PM_MTSYR		8	/* milliseconds of time (RA) per year */
 #define PM_ARCSECHR		9	/* arcseconds per hour (solar system) */
 
+#define WCMAXPATH	1024	/* Maximum length of web cache file name */
+
+/* Grid of cells indexing image star positions for neighbor searches */
+struct StarGrid {
+    int		cell;		/* Width of a grid cell in pixels */
+    int		ncx;		/* Number of cells in x */
+    int		ncy;		/* Number of cells in y */
+    int		*head;		/* First star in each cell, -1 if none */
+    int		*next;		/* Next star in same cell, -1 if none */
+    double	*x;		/* X coordinates of stars in pixels */
+    double	*y;		/* Y coordinates of stars in pixels */
+    int		nstars;		/* Number of stars in grid */
+    int		nmax;		/* Number of stars allocated */
+};
+
+/* Mesh of image background and noise levels for star finding */
+struct BkgMesh {
+    int		cell;		/* Width of a mesh cell in pixels */
+    int		ncx;		/* Number of cells in x */
+    int		ncy;		/* Number of cells in y */
+    int		w;		/* Image width in pixels */
+    int		h;		/* Image height in pixels */
+    double	*bkg;		/* Sigma-clipped median of each cell */
+    double	*rms;		/* Sigma-clipped standard deviation of each cell */
+    double	*cbkg;		/* Background of each cell column at one row */
+    double	*crms;		/* Noise of each cell column at one row */
+    int		*ix;		/* First of 4 cells interpolated at each x */
+    double	*wx;		/* 4 interpolation weights at each x */
+};
+
 /* Data structure for SAO TDC ASCII and binary star catalogs */
 struct StarCat {
     int star0;		/* Subtract from star number for file sequence number */
@@ -1054,10 +1084,44 @@ extern "C" {
 	char *url,	/* URL to read */
 	int diag,	/* 1 to print diagnostic messages */
 	int *lbuff);	/* Length of buffer (returned) */
+    char **webbuffs(	/* Read URLs into buffers, pipelining requests */
+	char **urls,	/* URLs to read */
+	int nurl,	/* Number of URLs to read */
+	int diag,	/* 1 to print diagnostic messages */
+	int *lbuffs);	/* Lengths of buffers (returned) */
+    int webprefetch(	/* Read URLs ahead of later webbuff() calls */
+	char **urls,	/* URLs to read */
+	int nurl,	/* Number of URLs to read */
+	int diag);	/* 1 to print diagnostic messages */
+    void setwebconn(	/* Set number of connections per web server */
+	int nconn);	/* Number of persistent connections per server */
+    void setwebpipe(	/* Set number of requests sent before reading */
+	int npipe);	/* Number of pipelined requests per connection */
+    void webclose(void); /* Close persistent web connections */
+    char *webcacheget(	/* Return saved tab table for web query URL */
+	char *url,	/* Query URL */
+	int *lbuff);	/* Length of returned buffer (returned) */
+    void webcacheput(	/* Save tab table returned by web query URL */
+	char *url,	/* Query URL */
+	char *tabbuff,	/* Tab table converted from server return */
+	int lbuff,	/* Length of tab table in bytes */
+	int nlines);	/* Number of sources in tab table */
+    FILE *webcachenew(	/* Open file to save tab table as it is read */
+	char *url,	/* Query URL */
+	char *temppath); /* Temporary file name (returned) */
+    void webcachesave(	/* Save tab table file from webcachenew() */
+	FILE *fd,	/* File returned by webcachenew() */
+	char *url,	/* Query URL */
+	char *temppath,	/* Temporary file name from webcachenew() */
+	int nlines);	/* Number of sources in tab table, -1 to drop */
     struct TabTable *webopen(	/* Open tab table across the web */
 	char *caturl,	/* URL of search engine */
 	char *srchpar,	/* Search engine parameters to append */
 	int nlog);	/* 1 to print diagnostic messages */
+    struct TabTable *webopenstream( /* Open web tab table read as it arrives */
+	char *caturl,	/* URL of search engine */
+	char *srchpar,	/* Search engine parameters to append */
+	int nlog);	/* 1 to print diagnostic messages */
 
 /* Subroutines to read DAOPHOT-style catalogs of sources found in an image */
     int daoread(	/* Read image source positions from x y mag file */
@@ -1073,6 +1137,44 @@ extern "C" {
 	int iline,	/* Star sequence number in DAOFIND catalog */
 	char *line);	/* Pointer to iline'th entry (returned updated) */
 
+/* Subroutines for finding image star neighbors from findstar.c */
+    struct StarGrid *StarGridInit( /* Set up grid for image star positions */
+	int w,		/* Image width in pixels */
+	int h,		/* Image height in pixels */
+	int cell);	/* Width of grid cell in pixels */
+    int StarGridAdd(	/* Add a star to the grid, returning its index */
+	struct StarGrid *grid,	/* Star position grid */
+	double x,	/* Image X coordinate */
+	double y);	/* Image Y coordinate */
+    int StarGridBox(	/* Return index of star within a box, else -1 */
+	struct StarGrid *grid,	/* Star position grid */
+	double x,	/* Image X coordinate of box center */
+	double y,	/* Image Y coordinate of box center */
+	double d);	/* Half-width of box in pixels */
+    int StarGridNear(	/* Return number of other stars within radius */
+	struct StarGrid *grid,	/* Star position grid */
+	int is,		/* Index of star in grid */
+	double r,	/* Search radius in pixels */
+	double *dnear);	/* Distance to nearest other star (returned) */
+    void StarGridFree(	/* Free star position grid */
+	struct StarGrid *grid);	/* Star position grid */
+    struct BkgMesh *BkgMeshInit( /* Compute background mesh for an image */
+	double *dimage,	/* Scaled image pixels */
+	int w,		/* Image width in pixels */
+	int h,		/* Image height in pixels */
+	int cell);	/* Width of mesh cell in pixels */
+    void BkgMeshRow(	/* Interpolate background and noise along a row */
+	struct BkgMesh *mesh,	/* Background mesh */
+	int y,		/* Zero-based image row */
+	double *bkg,	/* Background for each pixel in row (returned) */
+	double *rms);	/* Noise for each pixel in row (returned) */
+    int BkgMeshWrite(	/* Write interpolated background and noise as FITS */
+	struct BkgMesh *mesh,	/* Background mesh */
+	char *header,	/* FITS header of image */
+	char *filename);	/* Name of FITS file to write */
+    void BkgMeshFree(	/* Free background mesh */
+	struct BkgMesh *mesh);	/* Background mesh */
+
 /* Subroutines for sorting tables of star positions and magnitudes from sortstar.c */
     void FluxSortStars(	/* Sort image stars by decreasing flux */
 	double *sx,	/* Image X coordinate */
@@ -1418,13 +1520,34 @@ int gettabndec();	/* Return number of decimal places in tab catalog ids */
 int webread();		/* Read sources by sky region from catalog on the World Wide Web */
 int webrnum();		/* Read sources by ID number from catalog on the World Wide Web */
 char *webbuff();	/* Read URL into buffer across the web */
+char **webbuffs();	/* Read URLs into buffers, pipelining requests */
+int webprefetch();	/* Read URLs ahead of later webbuff() calls */
+void setwebconn();	/* Set number of connections per web server */
+void setwebpipe();	/* Set number of requests sent before reading */
+void webclose();	/* Close persistent web connections */
 struct TabTable *webopen();	/* Open tab table across the web */
+struct TabTable *webopenstream(); /* Open web tab table read as it arrives */
+char *webcacheget();	/* Return saved tab table for web query URL */
+void webcacheput();	/* Save tab table returned by web query URL */
+FILE *webcachenew();	/* Open file to save tab table as it is read */
+void webcachesave();	/* Save tab table file from webcachenew() */
 
 /* Subroutines to read DAOPHOT-style catalogs of sources found in an image */
 int daoread();		/* Read image source positions from x y mag file */
 int daoopen();		/* Open image source position x y mag file */
 char *daoline();	/* Read line from image source position x y mag file */
 
+/* Subroutines for finding image star neighbors from findstar.c */
+struct StarGrid *StarGridInit(); /* Set up grid for image star positions */
+int StarGridAdd();	/* Add a star to the grid, returning its index */
+int StarGridBox();	/* Return index of star within a box, else -1 */
+int StarGridNear();	/* Return number of other stars within radius */
+void StarGridFree();	/* Free star position grid */
+struct BkgMesh *BkgMeshInit(); /* Compute background mesh for an image */
+void BkgMeshRow();	/* Interpolate background and noise along a row */
+int BkgMeshWrite();	/* Write interpolated background and noise as FITS */
+void BkgMeshFree();	/* Free background mesh */
+
 /* Subroutines for sorting tables of star positions and magnitudes from sortstar.c */
 void FluxSortStars();	/* Sort image stars by decreasing flux */
 void MagSortStars();	/* Sort image stars by increasing magnitude */
@@ -1623,4 +1746,12 @@ char *getrevmsg();	/* Return version/date string */
  * Feb 15 2013	Add UCAC4 to list of catalog codes
  *
  * Aug  2 2021	Move range, string-parsing, and polynomial-fitting subroutines to wcs.h
+ *
+ * Oct 18 2026	Add StarGrid structure and subroutines for image star neighbors
+ * Oct 18 2026	Add BkgMesh structure and subroutines for image background
+ * Oct 18 2026	Add webbuffs(), webprefetch(), setwebconn(), setwebpipe(), webclose()
+ * Oct 18 2026	Add webcacheget() and webcacheput()
+ * Oct 18 2026	Add webopenstream(), webcachenew(), and webcachesave()
+ *
+ * Oct 19 2026	Add cell row buffers cbkg and crms to BkgMesh
  */
@@ -0,0 +1,599 @@
+/*** File libwcs/webcache.c
+ *** October 18, 2026
+ *** By Jessica Mink, jmink@cfa.harvard.edu
+ *** Harvard-Smithsonian Center for Astrophysics
+ *** Copyright (C) 2026
+ *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+    Correspondence concerning WCSTools should be addressed as follows:
+           Internet email: jmink@cfa.harvard.edu
+           Postal address: Jessica Mink
+                           Smithsonian Astrophysical Observatory
+                           60 Garden St.
+                           Cambridge, MA 02138 USA
+ */
+
+/* char *webcacheget (url, lbuff)
+ *	Return tab table saved for this query URL, or one covering its cone
+ * void webcacheput (url, tabbuff, lbuff, nlines)
+ *	Save tab table returned for this query URL
+ * FILE *webcachenew (url, temppath)
+ *	Open file to which tab table for this query URL is written as read
+ * void webcachesave (fd, url, temppath, nlines)
+ *	Close file from webcachenew() and save it for this query URL
+ *
+ * Tab tables returned by webopen(), after conversion from the server's
+ * format, are saved in the directory named by the environment variable
+ * WCS_WEBCACHE, one file per query.  The file name is made from hashes
+ * of the query with its parameters sorted, with and without the cone
+ * center and radius, so a search of a smaller cone can use the table of
+ * a larger one with otherwise identical parameters; tabread() keeps only
+ * the sources in the smaller cone.  Files older than WCS_WEBCACHE_TTL
+ * seconds (default 86400) are not used, and the oldest files are deleted
+ * when the directory holds more than WCS_WEBCACHE_MB megabytes (default
+ * 100).  Nothing is saved if WCS_WEBCACHE is not set.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "wcs.h"
+#include "wcscat.h"
+
+#define MAXCPAR	64		/* Maximum number of query parameters */
+
+/* Cone searched by a query, if it can be found in its parameters */
+struct WebCone {
+    double ra;		/* Center right ascension or longitude in degrees */
+    double dec;		/* Center declination or latitude in degrees */
+    double rad;		/* Radius in degrees, 0 if not a cone */
+    int annulus;	/* 1 if inner radius is set */
+    int limit;		/* Maximum number of sources returned, 0 if none */
+    int nset;		/* Number of center and radius parameters found */
+    };
+
+static char *cachedir = NULL;	/* Cache directory, NULL if not caching */
+static int cacheinit = 0;	/* 1 after environment has been read */
+static double cachettl = 86400.0; /* Seconds before an entry expires */
+static double cachemax = 100.0;	/* Maximum megabytes in cache */
+
+static int WebCacheInit();
+static int WebCacheHead();
+static int WebCacheKey();
+static unsigned int WebCacheHash();
+static char *WebCacheRead();
+static void WebCachePrune();
+static int WebCacheCmp();
+
+
+/* WEBCACHEGET -- Return tab table saved for this URL, NULL if none */
+
+char *
+webcacheget (url, lbuff)
+
+char	*url;	/* Query URL */
+int	*lbuff;	/* Length of returned buffer (returned) */
+{
+    char *key, *base, *buff, *cbase;
+    char path[WCMAXPATH], bestpath[WCMAXPATH], line[4096];
+    char prefix[16];
+    struct WebCone cone;
+    struct stat st;
+    DIR *dir;
+    struct dirent *ent;
+    FILE *fd;
+    double ra, dec, rad, bestrad, sep;
+    int nlines, limit, annulus;
+    time_t now;
+
+    *lbuff = 0;
+    if (!WebCacheInit ())
+	return (NULL);
+    key = (char *) malloc (2 * strlen (url) + 4);
+    if (key == NULL)
+	return (NULL);
+    base = key + strlen (url) + 2;
+    if (!WebCacheKey (url, key, base, &cone)) {
+	free (key);
+	return (NULL);
+	}
+    now = time (NULL);
+
+    /* Look for a file saved by the same query */
+    sprintf (path, "%s/%08x-%08x.tab", cachedir,
+	     WebCacheHash (base), WebCacheHash (key));
+    if (stat (path, &st) == 0 && now - st.st_mtime < cachettl &&
+	(buff = WebCacheRead (path, key, lbuff)) != NULL) {
+	free (key);
+	return (buff);
+	}
+
+    /* Look for the smallest saved cone which covers this one */
+    buff = NULL;
+    if (cone.nset == 3 && cone.rad > 0.0 &&
+	(dir = opendir (cachedir)) != NULL) {
+	sprintf (prefix, "%08x-", WebCacheHash (base));
+	bestrad = 0.0;
+	bestpath[0] = (char) 0;
+	while ((ent = readdir (dir)) != NULL) {
+	    if (strncmp (ent->d_name, prefix, 9) ||
+		!strstr (ent->d_name, ".tab"))
+		continue;
+	    if (snprintf (path, sizeof (path), "%s/%s", cachedir,
+			  ent->d_name) >= (int) sizeof (path))
+		continue;
+	    if (stat (path, &st) != 0 || now - st.st_mtime >= cachettl)
+		continue;
+	    if ((fd = fopen (path, "r")) == NULL)
+		continue;
+	    if (fgets (line, sizeof (line), fd) == NULL ||
+		sscanf (line, "#wcscache %lf %lf %lf %d %d %d", &ra, &dec,
+			&rad, &annulus, &limit, &nlines) < 6) {
+		fclose (fd);
+		continue;
+		}
+	    fclose (fd);
+
+	    /* A truncated table or an annulus does not cover the cone */
+	    if (rad <= 0.0 || annulus || (limit > 0 && nlines >= limit))
+		continue;
+	    sep = wcsdist (ra, dec, cone.ra, cone.dec);
+	    if (sep + cone.rad > rad * (1.0 + 1.0e-9))
+		continue;
+
+	    /* Make sure that the other parameters really match */
+	    if ((cbase = strstr (line, " base=")) == NULL ||
+		strncmp (cbase+6, base, strlen (base)) ||
+		(cbase[6+strlen (base)] != '\n' && cbase[6+strlen (base)] != 0))
+		continue;
+	    if (bestpath[0] == (char) 0 || rad < bestrad) {
+		bestrad = rad;
+		strcpy (bestpath, path);
+		}
+	    }
+	closedir (dir);
+	if (bestpath[0] != (char) 0)
+	    buff = WebCacheRead (bestpath, NULL, lbuff);
+	}
+    free (key);
+    return (buff);
+}
+
+
+/* WEBCACHEPUT -- Save tab table returned by a query URL */
+
+void
+webcacheput (url, tabbuff, lbuff, nlines)
+
+char	*url;		/* Query URL */
+char	*tabbuff;	/* Tab table converted from server return */
+int	lbuff;		/* Length of tab table in bytes */
+int	nlines;		/* Number of sources in tab table */
+{
+    char temppath[WCMAXPATH];
+    FILE *fd;
+
+    if (tabbuff == NULL || lbuff < 1)
+	return;
+    if ((fd = webcachenew (url, temppath)) == NULL)
+	return;
+    if (fwrite (tabbuff, 1, lbuff, fd) != (size_t) lbuff)
+	nlines = -1;
+    webcachesave (fd, url, temppath, nlines);
+    return;
+}
+
+
+/* WEBCACHENEW -- Open a temporary file to which a tab table returned by a
+ * query URL can be written as it arrives, NULL if not caching */
+
+FILE *
+webcachenew (url, temppath)
+
+char	*url;		/* Query URL */
+char	*temppath;	/* Temporary file name (returned, WCMAXPATH long) */
+{
+    char *key, *base;
+    struct WebCone cone;
+    FILE *fd;
+
+    if (!WebCacheInit ())
+	return (NULL);
+    key = (char *) malloc (2 * strlen (url) + 4);
+    if (key == NULL)
+	return (NULL);
+    base = key + strlen (url) + 2;
+    if (!WebCacheKey (url, key, base, &cone)) {
+	free (key);
+	return (NULL);
+	}
+    sprintf (temppath, "%s/%08x-%08x.tab.%d", cachedir, WebCacheHash (base),
+	     WebCacheHash (key), (int) getpid ());
+    free (key);
+
+    /* Leave room for the number of sources, which is not yet known */
+    if ((fd = fopen (temppath, "w")) != NULL)
+	WebCacheHead (fd, url, 0);
+    return (fd);
+}
+
+
+/* WEBCACHESAVE -- Close a file opened by webcachenew() and make it the
+ * cache entry for its URL, or delete it if nlines is less than 0 */
+
+void
+webcachesave (fd, url, temppath, nlines)
+
+FILE	*fd;		/* File returned by webcachenew() */
+char	*url;		/* Query URL */
+char	*temppath;	/* Temporary file name from webcachenew() */
+int	nlines;		/* Number of sources in tab table, -1 if incomplete */
+{
+    char path[WCMAXPATH];
+    char *tab;
+    int ok;
+
+    if (fd == NULL)
+	return;
+    ok = (nlines >= 0);
+    if (ok && (fseek (fd, 0L, SEEK_SET) != 0 || !WebCacheHead (fd, url, nlines)))
+	ok = 0;
+    if (fclose (fd) != 0)
+	ok = 0;
+
+    /* Drop process number from the temporary file name */
+    strcpy (path, temppath);
+    if ((tab = strstr (path, ".tab.")) != NULL)
+	tab[4] = (char) 0;
+    if (!ok || tab == NULL || rename (temppath, path) != 0)
+	unlink (temppath);
+    else
+	WebCachePrune ();
+    return;
+}
+
+
+/* Write first line of cache file, with a fixed-width number of sources so
+ * that it can be rewritten in place */
+
+static int
+WebCacheHead (fd, url, nlines)
+
+FILE	*fd;	/* Cache file */
+char	*url;	/* Query URL */
+int	nlines;	/* Number of sources in tab table */
+{
+    char *key, *base;
+    struct WebCone cone;
+    int ok;
+
+    key = (char *) malloc (2 * strlen (url) + 4);
+    if (key == NULL)
+	return (0);
+    base = key + strlen (url) + 2;
+    if (!WebCacheKey (url, key, base, &cone)) {
+	free (key);
+	return (0);
+	}
+    if (cone.nset != 3)
+	cone.rad = 0.0;
+    ok = (fprintf (fd, "#wcscache %.7f %.7f %.7f %d %d %10d key=%s base=%s\n",
+		   cone.ra, cone.dec, cone.rad, cone.annulus, cone.limit,
+		   nlines, key, base) > 0);
+    free (key);
+    return (ok);
+}
+
+
+/* Read cache settings from the environment; return 0 if not caching */
+
+static int
+WebCacheInit ()
+{
+    char *str;
+    struct stat st;
+
+    if (!cacheinit) {
+	cacheinit = 1;
+	str = getenv ("WCS_WEBCACHE");
+	if (str != NULL && *str != (char) 0 && strlen (str) < WCMAXPATH-40 &&
+	    stat (str, &st) == 0 && S_ISDIR (st.st_mode)) {
+	    cachedir = (char *) malloc (strlen (str) + 1);
+	    if (cachedir != NULL)
+		strcpy (cachedir, str);
+	    }
+	if ((str = getenv ("WCS_WEBCACHE_TTL")) != NULL)
+	    cachettl = atof (str);
+	if ((str = getenv ("WCS_WEBCACHE_MB")) != NULL)
+	    cachemax = atof (str);
+	}
+    return (cachedir != NULL);
+}
+
+
+/* Normalize query URL, with its server name in lower case and its
+ * parameters sorted, with and without the cone center and radius */
+
+static int
+WebCacheKey (url, key, base, cone)
+
+char	*url;	/* Query URL */
+char	*key;	/* Normalized URL (returned) */
+char	*base;	/* Normalized URL without cone (returned) */
+struct WebCone *cone; /* Cone searched by query (returned) */
+{
+    char *copy, *query, *par, *next, *cval, *host;
+    char *pars[MAXCPAR];
+    char name[16];
+    int npar, nbase, i, lname, iscone;
+
+    cone->ra = 0.0;
+    cone->dec = 0.0;
+    cone->rad = 0.0;
+    cone->annulus = 0;
+    cone->limit = 0;
+    cone->nset = 0;
+
+    if ((copy = (char *) malloc (strlen (url) + 1)) == NULL)
+	return (0);
+    strcpy (copy, url);
+    host = copy;
+    if (!strncmp (host, "http://", 7))
+	host = host + 7;
+    for (; *host != (char) 0 && *host != '/' && *host != '?'; host++)
+	*host = tolower (*host);
+
+    /* Split parameters at ampersands, dropping empty ones */
+    npar = 0;
+    if ((query = strchr (copy, '?')) != NULL) {
+	*query++ = (char) 0;
+	for (par = query; par != NULL; par = next) {
+	    if ((next = strchr (par, '&')) != NULL)
+		*next++ = (char) 0;
+	    if (*par == (char) 0)
+		continue;
+	    if (npar >= MAXCPAR) {
+		free (copy);
+		return (0);
+		}
+	    pars[npar++] = par;
+	    }
+	qsort (pars, npar, sizeof (char *), WebCacheCmp);
+	}
+
+    strcpy (key, copy);
+    strcpy (base, copy);
+    nbase = 0;
+    for (i = 0; i < npar; i++) {
+	strcat (key, i == 0 ? "?" : "&");
+	strcat (key, pars[i]);
+
+	/* Find center and radius of cone in parameters of known servers */
+	iscone = 0;
+	if ((cval = strchr (pars[i], '=')) != NULL) {
+	    lname = cval - pars[i];
+	    if (lname > 15)
+		lname = 15;
+	    strncpy (name, pars[i], lname);
+	    name[lname] = (char) 0;
+	    cval++;
+	    iscone = 1;
+	    if (!strcasecmp (name, "ra") || !strcmp (name, "-ra"))
+		cone->ra = atof (cval);
+	    else if (!strcasecmp (name, "dec") || !strcmp (name, "-dec"))
+		cone->dec = atof (cval);
+	    else if (!strcmp (name, "rad"))
+		cone->rad = atof (cval) / 3600.0;
+	    else if (!strcasecmp (name, "sr") || !strcmp (name, "-rd"))
+		cone->rad = atof (cval);
+	    else if (!strcmp (name, "radius"))
+		cone->rad = atof (cval) / 60.0;
+	    else {
+		iscone = 0;
+		if (!strcmp (name, "inrad"))
+		    cone->annulus = 1;
+		else if (!strcmp (name, "nstar") || !strcmp (name, "topnum") ||
+			 !strcmp (name, "nout") || !strcmp (name, "n"))
+		    cone->limit = atoi (cval);
+		}
+	    }
+	if (iscone)
+	    cone->nset++;
+	else {
+	    strcat (base, nbase == 0 ? "?" : "&");
+	    strcat (base, pars[i]);
+	    nbase++;
+	    }
+	}
+    free (copy);
+    return (1);
+}
+
+
+/* Return hash of a string */
+
+static unsigned int
+WebCacheHash (str)
+
+char	*str;	/* String to hash */
+{
+    unsigned int hash = 5381;
+
+    while (*str)
+	hash = (hash * 33) ^ (unsigned char) *str++;
+    return (hash);
+}
+
+
+/* Read saved tab table, checking its key if not NULL */
+
+static char *
+WebCacheRead (path, key, lbuff)
+
+char	*path;	/* Cache file name */
+char	*key;	/* Normalized query URL, or NULL if not checked */
+int	*lbuff;	/* Length of returned buffer (returned) */
+{
+    FILE *fd;
+    struct stat st;
+    char *buff, *ckey, *cend;
+    int lhead, nbr;
+
+    *lbuff = 0;
+    if ((fd = fopen (path, "r")) == NULL)
+	return (NULL);
+    if (fstat (fileno (fd), &st) != 0 ||
+	(buff = (char *) malloc (st.st_size + 1)) == NULL) {
+	fclose (fd);
+	return (NULL);
+	}
+    nbr = fread (buff, 1, st.st_size, fd);
+    fclose (fd);
+    buff[nbr] = (char) 0;
+
+    /* Check that the file is a cache entry for the same query */
+    if (strncmp (buff, "#wcscache ", 10) || (cend = strchr (buff, '\n')) == NULL) {
+	free (buff);
+	return (NULL);
+	}
+    if (key != NULL) {
+	*cend = (char) 0;
+	ckey = strstr (buff, " key=");
+	if (ckey == NULL || strncmp (ckey+5, key, strlen (key)) ||
+	    ckey[5+strlen (key)] != ' ') {
+	    free (buff);
+	    return (NULL);
+	    }
+	}
+
+    /* Move the tab table to the start of the buffer */
+    lhead = cend - buff + 1;
+    *lbuff = nbr - lhead;
+    memmove (buff, buff + lhead, *lbuff + 1);
+    return (buff);
+}
+
+
+/* Delete expired entries, then the oldest until under the size limit */
+
+static void
+WebCachePrune ()
+{
+    DIR *dir;
+    struct dirent *ent;
+    struct stat st;
+    char path[WCMAXPATH];
+    char **names;
+    time_t *times, now, tmin;
+    double *sizes, total;
+    int nent, maxent, i, imin;
+
+    if ((dir = opendir (cachedir)) == NULL)
+	return;
+    now = time (NULL);
+    nent = 0;
+    maxent = 64;
+    names = (char **) malloc (maxent * sizeof (char *));
+    times = (time_t *) malloc (maxent * sizeof (time_t));
+    sizes = (double *) malloc (maxent * sizeof (double));
+    total = 0.0;
+    while (names != NULL && times != NULL && sizes != NULL &&
+	   (ent = readdir (dir)) != NULL) {
+	if (strlen (ent->d_name) != 21 ||
+	    strcmp (ent->d_name + 17, ".tab") || ent->d_name[8] != '-')
+	    continue;
+	if (snprintf (path, sizeof (path), "%s/%s", cachedir,
+		      ent->d_name) >= (int) sizeof (path))
+	    continue;
+	if (stat (path, &st) != 0)
+	    continue;
+	if (now - st.st_mtime >= cachettl) {
+	    unlink (path);
+	    continue;
+	    }
+	if (nent >= maxent) {
+	    maxent = maxent * 2;
+	    names = (char **) realloc (names, maxent * sizeof (char *));
+	    times = (time_t *) realloc (times, maxent * sizeof (time_t));
+	    sizes = (double *) realloc (sizes, maxent * sizeof (double));
+	    if (names == NULL || times == NULL || sizes == NULL)
+		break;
+	    }
+	if ((names[nent] = (char *) malloc (strlen (path) + 1)) == NULL)
+	    break;
+	strcpy (names[nent], path);
+	times[nent] = st.st_mtime;
+	sizes[nent] = (double) st.st_size;
+	total = total + sizes[nent];
+	nent++;
+	}
+    closedir (dir);
+
+    while (names != NULL && times != NULL && sizes != NULL &&
+	   total > cachemax * 1048576.0) {
+	imin = -1;
+	tmin = now;
+	for (i = 0; i < nent; i++) {
+	    if (names[i] != NULL && (imin < 0 || times[i] < tmin)) {
+		imin = i;
+		tmin = times[i];
+		}
+	    }
+	if (imin < 0)
+	    break;
+	unlink (names[imin]);
+	total = total - sizes[imin];
+	free (names[imin]);
+	names[imin] = NULL;
+	}
+
+    if (names != NULL) {
+	for (i = 0; i < nent; i++) {
+	    if (names[i] != NULL)
+		free (names[i]);
+	    }
+	free (names);
+	}
+    if (times != NULL)
+	free (times);
+    if (sizes != NULL)
+	free (sizes);
+    return;
+}
+
+
+/* Compare two query parameters for qsort() */
+
+static int
+WebCacheCmp (par1, par2)
+
+const void *par1, *par2;
+{
+    return (strcmp (*(char **) par1, *(char **) par2));
+}
+
+/* Oct 18 2026	New subroutines to save tab tables returned from web searches
+ * Oct 18 2026	Add webcachenew() and webcachesave() to save tables as they arrive
+ *
+ * Oct 19 2026	Build cache directory entry paths with snprintf(); skip if too long
+ */
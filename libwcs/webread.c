@@ -1,9 +1,9 @@
 /*** File webread.c
- *** February 4, 2022
+ *** October 18, 2026
  *** By Jessica Mink, SAO Telescope Data Center
  *** Harvard-Smithsonian Center for Astrophysics
  *** (http code originally from John Roll)
- *** Copyright (C) 2000-2022
+ *** Copyright (C) 2000-2026
  *** Smithsonian Astrophysical Observatory, Cambridge, MA, USA
 
     This library is free software; you can redistribute it and/or
@@ -50,6 +50,8 @@
 
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
 
 /* for MinGW */
 #ifdef MSWIN
@@ -72,6 +74,72 @@ static FILE *SokOpen();
 #define FileFd(fd)              fileno(fd)
 static char newline = '\n';
 
+#define WEBMAXCONN	8	/* Maximum number of open server connections */
+#define WEBMAXPIPE	32	/* Maximum requests sent before reading any */
+
+/* Server connection left open between requests */
+struct WebConn {
+    FILE *sok;			/* Socket stream, NULL if slot is unused */
+    char host[MAXHOSTNAMELENGTH]; /* Server name, with :port if present */
+    int port;			/* Server port */
+    int iconn;			/* Which of the connections to this server */
+    int ngen;			/* Number assigned when connection opened */
+    };
+static struct WebConn webconn[WEBMAXCONN];
+static int webgen = 0;		/* Number of connections opened */
+static int nwebconn = 0;	/* Connections used at once per server */
+static int nwebpipe = 0;	/* Requests sent per connection at once */
+
+/* Response read by webprefetch() before it was asked for */
+struct WebPre {
+    char *url;			/* URL which was read */
+    char *buff;			/* Returned body */
+    int lbuff;			/* Length of returned body */
+    };
+static struct WebPre *webpre = NULL;
+static int nwebpre = 0;		/* Number of responses read ahead */
+
+static void WebInit();
+static char *WebURL();
+static int WebSend();
+static char *WebResponse();
+static char *WebGrow();
+static char *WebGet();
+static int WebFormat();
+static struct WebConn *WebConnect();
+static struct WebConn *WebConnFind();
+static int WebAlive();
+static void WebDrop();
+static char *WebPreGet();
+static int WebHeader();
+static char *WebStream();
+static void WebStreamChild();
+static char *WebBodyLine();
+static void WebStreamData();
+
+/* Formats of catalog server returns which can be read as they arrive */
+#define WEB_TAB		1	/* Tab table (or other server table) */
+#define WEB_SCAT	2	/* Table from scat, which may use spaces */
+#define WEB_SDSS	3	/* Comma-separated table from SDSS */
+#define WEB_GALEX	4	/* Comma-separated table from MAST GALEX */
+#define WEB_GSSS	5	/* Tab-separated table from CASB GSC 2 */
+
+/* HTTP response body being read one line at a time */
+struct WebBody {
+    FILE *sok;			/* Socket stream */
+    int chunked;		/* 1 if body is sent in chunks */
+    int nleft;			/* Bytes left in chunk or body, -1 if unknown */
+    int eof;			/* 1 when no more can be read */
+    int done;			/* 1 if whole body has been read */
+    char buff[CHUNK];		/* Bytes read but not yet returned */
+    int nb;			/* Number of bytes in buff */
+    int ib;			/* Next byte to return from buff */
+    int partial;		/* 1 if last line had no newline */
+    };
+static int WebBodyRead();
+
+static int webstream = 0;	/* 1 to read returns as they arrive */
+
 
 /* WEBREAD -- Read a catalog over the web and return results */
 
@@ -239,7 +307,7 @@ int	nlog;		/* Logging interval (-1 to dump returned file) */
 	}
 
     /* Run search across the web */
-    if ((tabtable = webopen (caturl, srchurl, nlog)) == NULL) {
+    if ((tabtable = webopenstream (caturl, srchurl, nlog)) == NULL) {
 	if (nlog > 0)
 	    fprintf (stderr, "WEBREAD: %s failed\n", srchurl);
 	return (0);
@@ -419,6 +487,9 @@ int	nlog;		/* 1 to print diagnostic messages */
     int ltab, lname;
     int diag;
     int tabdiff;
+    int cached = 0;
+    int format;
+    FILE *fstream = NULL;
     char *space2tab();
 
     if (nlog == 1)
@@ -433,8 +504,22 @@ int	nlog;		/* 1 to print diagnostic messages */
     strcpy (srchurl, caturl);
     strcat (srchurl, srchpar);
 
+    /* Use tab table saved by an earlier search, if there is one */
+    if ((tabbuff = webcacheget (srchurl, &lbuff)) != NULL) {
+	cached = 1;
+	if (diag)
+	    fprintf (stderr,"WEBOPEN: Using saved table for %s\n", srchurl);
+	}
+
+    /* Read only header and first line of table, leaving rest in a pipe */
+    else if (webstream && nlog >= 0 && (format = WebFormat (srchurl)) > 0 &&
+	     (tabbuff = WebStream (srchurl, format, diag, &lbuff, &fstream)) != NULL) {
+	if (diag)
+	    fprintf (stderr,"WEBOPEN: Reading %s as it arrives\n", srchurl);
+	}
+
     /* Open port to HTTP server, send command, and fill buffer with return */
-    if ((tabbuff = webbuff (srchurl, diag, &lbuff)) == NULL) {
+    else if ((tabbuff = webbuff (srchurl, diag, &lbuff)) == NULL) {
 	fprintf (stderr,"WEBOPEN: cannot read URL %s\n", srchurl);
 	free (srchurl);
 	return (NULL);
@@ -444,12 +529,18 @@ int	nlog;		/* 1 to print diagnostic messages */
 	    fprintf (stderr,"Message returned from %s\n", srchurl);
 	    fprintf (stderr,"%s\n", tabbuff);
 	    }
+	if (fstream != NULL)
+	    (void) fclose (fstream);
 	free (srchurl);
 	return (NULL);
 	}
 
+    /* Saved and streamed tables have already been transformed */
+    if (cached || fstream != NULL)
+	;
+
     /* Transform SDSS return into tab table */
-    if (strsrch (srchurl, "sdss")) {
+    else if (strsrch (srchurl, "sdss")) {
 	tempbuff = tabbuff;
 	tabbuff = sdssc2t (tempbuff);
 	lbuff = strlen (tabbuff);
@@ -505,12 +596,15 @@ int	nlog;		/* 1 to print diagnostic messages */
     if ((tabtable = (struct TabTable *) calloc (1, ltab)) == NULL) {
 	fprintf (stderr,"WEBOPEN: cannot allocate Tab Table structure for %s",
 	         srchurl);
+	if (fstream != NULL)
+	    (void) fclose (fstream);
 	free (srchurl);
 	return (NULL);
 	}
 
     /* Save pointers to file contents */
     tabtable->tabbuff = tabbuff;
+    tabtable->tcat = fstream;
     tabtable->tabheader = tabtable->tabbuff;
     tabtable->lbuff = lbuff;
 
@@ -560,6 +654,30 @@ int	nlog;		/* 1 to print diagnostic messages */
 	return (NULL);
 	}
 
+    /* Read streamed table one line at a time, starting with first line */
+    if (fstream != NULL) {
+	tabtable->nlines = 10000000;
+	tabtable->lhead = 0;
+	lname = strlen (tabtable->tabdata);
+	tabtable->lline = 16384;
+	if (tabtable->lline < lname * 2)
+	    tabtable->lline = lname * 2;
+	if ((tabtable->tabline = (char *) calloc (tabtable->lline, 1)) == NULL) {
+	    fprintf (stderr,"WEBOPEN: cannot allocate line buffer for %s\n",
+		     srchurl);
+	    tabclose (tabtable);
+	    free (srchurl);
+	    return (NULL);
+	    }
+	strcpy (tabtable->tabline, tabtable->tabdata);
+	if (lname > 0 && tabtable->tabline[lname-1] == newline)
+	    tabtable->tabline[lname-1] = (char) 0;
+	tabtable->tabdata = tabtable->tabline;
+	tabtable->iline = 1;
+	free (srchurl);
+	return (tabtable);
+	}
+
     /* Enumerate entries in tab table catalog by counting newlines */
     tabnew = tabtable->tabdata;
     tabold = tabnew;
@@ -581,11 +699,34 @@ int	nlog;		/* 1 to print diagnostic messages */
     tabtable->tabline = tabtable->tabdata;
     tabtable->iline = 1;
 
+    /* Save transformed table for later searches */
+    if (!cached)
+	webcacheput (srchurl, tabtable->tabbuff, lbuff, tabtable->nlines);
+
     free (srchurl);
     return (tabtable);
 }
 
 
+/* WEBOPENSTREAM -- Open tab table across the web, reading data lines as
+ * they arrive instead of after the whole table has been returned */
+
+struct TabTable *
+webopenstream (caturl, srchpar, nlog)
+
+char	*caturl;	/* URL of search engine */
+char	*srchpar;	/* Search engine parameters to append */
+int	nlog;		/* 1 to print diagnostic messages */
+{
+    struct TabTable *tabtable;
+
+    webstream = 1;
+    tabtable = webopen (caturl, srchpar, nlog);
+    webstream = 0;
+    return (tabtable);
+}
+
+
 /* WEBBUFF -- Return character buffer from given URL */
 
 char *
@@ -595,283 +736,1146 @@ char	*url;	/* URL to read */
 int	diag;	/* 1 to print diagnostic messages */
 int	*lbuff;	/* Length of buffer (returned) */
 {
-    File sok;
-    char *server;
-    char linebuff[LINE];
-    char *buff;
     char *tabbuff;
-    char *newbuff;
-    char *urlpath;
-    char *servurl;
-    char *port;
-    int	status;
-    int lserver;
-    int lread;
-    int lchunk, lline;
-    int lcbuff;
-    int lb;
-    int ltbuff;
-    int lcom;
-    int i;
-    int chunked = 0;
-    int nport = 80;
-    int nbcont = 0;
-    char *cbcont;
-    char *newserver;
-    char *sokptr;
-    char *newpath;
-    char *encodeURL();
-    char czero;
+    char *newurl;
+    char location[LINE];
+    int status;
+    int nredir;
 
     *lbuff = 0;
-    newbuff = NULL;
     diag = 0;
-    czero = (char) 0;
 
-    /* Extract server name and path from URL */
-    servurl = url;
-    if (!strncmp(url, "http://", 7))
-	servurl = servurl + 7;
-    urlpath = strchr (servurl, '/');
-    if (urlpath != NULL) {
-	lserver = urlpath - servurl;
-	if ((server = (char *) malloc (lserver+2)) == NULL)
+    /* Return response if it has already been read by webprefetch() */
+    if ((tabbuff = WebPreGet (url, lbuff)) != NULL)
+	return (tabbuff);
+
+    /* If Redirect code encountered, go to alternate URL at Location: */
+    newurl = url;
+    for (nredir = 0; nredir < 5; nredir++) {
+	tabbuff = WebGet (newurl, diag, lbuff, &status, location);
+	if (status != 301 && status != 302 && status != 303 && status != 307)
+	    break;
+	if ((newurl = strsrch (location, "http://")) == NULL) {
+	    if (diag)
+		fprintf (stderr,"WEBBUFF: No forward URL for HTTP Code %d\n", status);
 	    return (NULL);
-	strncpy (server, servurl, lserver);
-	server[lserver] = (char) 0;
-	if ( (port = strchr (servurl,':')) ) {
-	    *port = '\0';
-	    port++;
-	    nport = atoi (port);
 	    }
+	if (diag)
+	    fprintf (stderr,"WEBBUFF: HTTP Code %d: Temporary Redirect to %s\n",
+		     status, newurl);
 	}
-    else {
-	if ((server = (char *) malloc (4)) == NULL)
-	    return (NULL);
-	server[0] = '/';
-	server[1] = '\0';
+
+    /* If status is not 200 return without data */
+    if (tabbuff == NULL && status > 0 && diag)
+	fprintf (stderr,"HTTP Code %d from  %s\n", status, newurl);
+
+    return (tabbuff);
+}
+
+
+/* WEBBUFFS -- Return character buffers from a list of URLs, sending
+ * consecutive requests to the same server down one or more persistent
+ * connections before reading any of the responses */
+
+char **
+webbuffs (urls, nurl, diag, lbuffs)
+
+char	**urls;	/* URLs to read */
+int	nurl;	/* Number of URLs to read */
+int	diag;	/* 1 to print diagnostic messages */
+int	*lbuffs; /* Lengths of buffers (returned) */
+{
+    struct WebConn *conn;
+    char **buffs;
+    char host[MAXHOSTNAMELENGTH], host1[MAXHOSTNAMELENGTH];
+    char location[LINE];
+    char *path;
+    int *status, *ngen;
+    int iurl, nb, k, ic, port, port1, reused;
+
+    buffs = (char **) calloc (nurl, sizeof (char *));
+    status = (int *) calloc (nurl, sizeof (int));
+    ngen = (int *) calloc (nurl, sizeof (int));
+    if (buffs == NULL || status == NULL || ngen == NULL) {
+	fprintf (stderr, "WEBBUFFS: Cannot allocate %d responses\n", nurl);
+	if (buffs != NULL) free (buffs);
+	if (status != NULL) free (status);
+	if (ngen != NULL) free (ngen);
+	return (NULL);
+	}
+    WebInit ();
+
+    iurl = 0;
+    while (iurl < nurl) {
+	lbuffs[iurl] = 0;
+	if (WebURL (urls[iurl], host, &port) == NULL) {
+	    iurl++;
+	    continue;
+	    }
+
+	/* Send as many consecutive requests to this server as will be
+	   pipelined, alternating between its connections */
+	for (nb = 0; iurl + nb < nurl && nb < nwebconn * nwebpipe; nb++) {
+	    k = iurl + nb;
+	    lbuffs[k] = 0;
+	    path = WebURL (urls[k], host1, &port1);
+	    if (path == NULL || strcmp (host1, host) || port1 != port)
+		break;
+	    conn = WebConnect (host, port, nb % nwebconn, &reused);
+	    if (conn == NULL || !WebSend (conn, path, 0))
+		continue;
+	    ngen[k] = conn->ngen;
+	    }
+	for (ic = 0; ic < nwebconn && ic < nb; ic++) {
+	    conn = WebConnFind (host, port, ic);
+	    if (conn != NULL && !WebSend (conn, NULL, 1))
+		WebDrop (conn);
+	    }
+
+	/* Read the responses in the order in which they were requested */
+	for (k = iurl; k < iurl + nb; k++) {
+	    conn = WebConnFind (host, port, (k - iurl) % nwebconn);
+	    if (ngen[k] == 0 || conn == NULL || conn->ngen != ngen[k])
+		continue;
+	    buffs[k] = WebResponse (conn, diag, &lbuffs[k], &status[k],
+				    location);
+	    }
+	iurl = iurl + nb;
+	}
+
+    /* Read redirected requests and those lost when a connection closed
+       one at a time */
+    for (k = 0; k < nurl; k++) {
+	if (buffs[k] == NULL &&
+	    (status[k] == 0 || (status[k] > 300 && status[k] < 400)))
+	    buffs[k] = webbuff (urls[k], diag, &lbuffs[k]);
+	}
+
+    free (status);
+    free (ngen);
+    return (buffs);
+}
+
+
+/* WEBPREFETCH -- Read a list of URLs with webbuffs() and save the responses
+ * to be returned by later webbuff() calls for the same URLs */
+
+int
+webprefetch (urls, nurl, diag)
+
+char	**urls;	/* URLs to read */
+int	nurl;	/* Number of URLs to read */
+int	diag;	/* 1 to print diagnostic messages */
+{
+    char **buffs;
+    int *lbuffs;
+    int k, npre;
+    struct WebPre *newpre;
+
+    npre = 0;
+    if (nurl < 1)
+	return (0);
+    if ((lbuffs = (int *) calloc (nurl, sizeof (int))) == NULL)
+	return (0);
+    if ((buffs = webbuffs (urls, nurl, diag, lbuffs)) == NULL) {
+	free (lbuffs);
+	return (0);
 	}
+    newpre = (struct WebPre *) realloc (webpre,
+				(nwebpre + nurl) * sizeof (struct WebPre));
+    if (newpre != NULL)
+	webpre = newpre;
+    for (k = 0; k < nurl; k++) {
+	if (buffs[k] == NULL)
+	    continue;
+	if (newpre == NULL ||
+	    (webpre[nwebpre].url = (char *) malloc (strlen (urls[k])+1)) == NULL) {
+	    free (buffs[k]);
+	    continue;
+	    }
+	strcpy (webpre[nwebpre].url, urls[k]);
+	webpre[nwebpre].buff = buffs[k];
+	webpre[nwebpre].lbuff = lbuffs[k];
+	nwebpre++;
+	npre++;
+	}
+    free (buffs);
+    free (lbuffs);
+    return (npre);
+}
+
+
+/* SETWEBCONN -- Set number of connections used at once to each web server */
+
+void
+setwebconn (nconn)
+
+int	nconn;	/* Number of persistent connections per server */
+{
+    if (nconn < 1)
+	nconn = 1;
+    else if (nconn > WEBMAXCONN)
+	nconn = WEBMAXCONN;
+    nwebconn = nconn;
+    return;
+}
+
+
+/* SETWEBPIPE -- Set number of requests sent down a connection before
+ * reading any responses */
+
+void
+setwebpipe (npipe)
+
+int	npipe;	/* Number of pipelined requests per connection */
+{
+    if (npipe < 1)
+	npipe = 1;
+    else if (npipe > WEBMAXPIPE)
+	npipe = WEBMAXPIPE;
+    nwebpipe = npipe;
+    return;
+}
 
-    /* Open port to HTTP server */
-    if ( !(sok = SokOpen (server, nport, XFREAD | XFWRITE)) ) {
-	if (port != NULL)
-	    fprintf(stderr, "Can't read URL %s:%s\n", server, port);
+
+/* WEBCLOSE -- Close all persistent web connections and drop responses
+ * read ahead by webprefetch() */
+
+void
+webclose ()
+{
+    int i;
+
+    for (i = 0; i < WEBMAXCONN; i++) {
+	if (webconn[i].sok != NULL)
+	    WebDrop (&webconn[i]);
+	}
+    for (i = 0; i < nwebpre; i++) {
+	free (webpre[i].url);
+	free (webpre[i].buff);
+	}
+    if (webpre != NULL)
+	free (webpre);
+    webpre = NULL;
+    nwebpre = 0;
+    return;
+}
+
+
+/* Set connection limits from the environment if they have not been set */
+
+static void
+WebInit ()
+{
+    char *str;
+
+    if (nwebconn < 1) {
+	if ((str = getenv ("WCS_WEBCONN")) != NULL)
+	    setwebconn (atoi (str));
 	else
-	    fprintf(stderr, "Can't read URL %s\n", server);
-	free (server);
-	return (NULL);
+	    nwebconn = 1;
+	}
+    if (nwebpipe < 1) {
+	if ((str = getenv ("WCS_WEBPIPE")) != NULL)
+	    setwebpipe (atoi (str));
+	else
+	    nwebpipe = 8;
+	}
+    return;
+}
+
+
+/* Split URL into server (with :port if present) and port, returning path */
+
+static char *
+WebURL (url, host, port)
+
+char	*url;	/* URL to parse */
+char	*host;	/* Server name, with :port if present (returned) */
+int	*port;	/* Server port (returned) */
+{
+    char *servurl, *urlpath, *cport;
+    int lserver;
+
+    servurl = url;
+    if (!strncmp (url, "http://", 7))
+	servurl = servurl + 7;
+    if ((urlpath = strchr (servurl, '/')) != NULL)
+	lserver = urlpath - servurl;
+    else {
+	lserver = strlen (servurl);
+	urlpath = "/";
 	}
+    if (lserver < 1 || lserver >= MAXHOSTNAMELENGTH)
+	return (NULL);
+    strncpy (host, servurl, lserver);
+    host[lserver] = (char) 0;
+    *port = 80;
+    if ((cport = strchr (host, ':')) != NULL)
+	*port = atoi (cport+1);
+    return (urlpath);
+}
+
+
+/* Send one GET request, or flush those already sent if path is NULL;
+ * return 0 if the connection has failed */
+
+static int
+WebSend (conn, path, flush)
+
+struct WebConn *conn;	/* Open server connection */
+char	*path;		/* Path of URL to request, NULL to only flush */
+int	flush;		/* 1 to flush buffered requests to server */
+{
+    int ok = 1;
+#ifdef SIGPIPE
+    void (*oldsig)();
 
-    /* Make sure that URL contains only legal characters */
-    /* newpath = encodeURL (urlpath); */
-    newpath = urlpath;
+    /* A server which has closed the connection returns an error, not a signal */
+    oldsig = signal (SIGPIPE, SIG_IGN);
+#endif
 
-    /* Send HTTP GET command */
-    fprintf (sok, "GET %s HTTP/1.1\r\nHost: %s\r\n\r\n", newpath, server);
-    fflush (sok);
-    free (server);
-    if (newpath != urlpath) {
-	free (newpath);
+    if (path != NULL) {
+	if (fprintf (conn->sok, "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: keep-alive\r\n\r\n",
+		     path, conn->host) < 0)
+	    ok = 0;
 	}
+    if (ok && flush && fflush (conn->sok) != 0)
+	ok = 0;
+    if (ok && ferror (conn->sok))
+	ok = 0;
+
+#ifdef SIGPIPE
+    (void) signal (SIGPIPE, oldsig);
+#endif
+    return (ok);
+}
 
-    for (i = 0; i < LINE; i++)
-	linebuff[i] = czero;
-    (void) fscanf(sok, "%*s %d %s\r\n", &status, linebuff);
 
-    /* If Redirect code encounter, go to alternate URL at Location: */
-    if ( status == 301 || status == 302 || status == 303 || status == 307 ) {
-	char redirect[LINE];
-	while ((servurl = fgets (redirect, LINE, sok))) {
-	    if (!(strncmp (redirect, "Location:", 9)))
-		break;
+/* Read the status line and header of an HTTP response, skipping 100
+ * Continue responses; return 0 if there is no response */
+
+static int
+WebHeader (conn, diag, status, chunked, nbcont, keep, location)
+
+struct WebConn *conn;	/* Open server connection */
+int	diag;		/* 1 to print diagnostic messages */
+int	*status;	/* HTTP status, 0 if no response (returned) */
+int	*chunked;	/* 1 if body is sent in chunks (returned) */
+int	*nbcont;	/* Length of body, -1 if not sent (returned) */
+int	*keep;		/* 1 if server keeps connection open (returned) */
+char	*location;	/* Location: of a redirect (returned) */
+{
+    FILE *sok = conn->sok;
+    char linebuff[LINE];
+    char *cval, *cend;
+    int minor;
+
+    *status = 0;
+    *keep = 0;
+    *chunked = 0;
+    *nbcont = -1;
+    location[0] = (char) 0;
+
+    do {
+	if (fgets (linebuff, LINE, sok) == NULL ||
+	    sscanf (linebuff, "HTTP/1.%d %d", &minor, status) < 2) {
+	    *status = 0;
+	    return (0);
 	    }
-	(void) fclose (sok);
-	if (servurl == NULL) {
+	*keep = (minor > 0);
+	*chunked = 0;
+	*nbcont = -1;
+	while (fgets (linebuff, LINE, sok) != NULL) {
 	    if (diag)
-		fprintf (stderr,"WEBBUFF: No forward for HTTP Code %d\n", status);
-	    return (NULL);
+		fprintf (stderr, "%s", linebuff);
+	    if (*linebuff == '\n' || *linebuff == '\r')
+		break;
+	    if ((cval = strchr (linebuff, ':')) == NULL)
+		continue;
+	    cval++;
+	    while (*cval == ' ')
+		cval++;
+	    if (!strncasecmp (linebuff, "Content-length:", 15))
+		*nbcont = atoi (cval);
+	    else if (!strncasecmp (linebuff, "Transfer-encoding:", 18) &&
+		     strcsrch (cval, "chunked") != NULL)
+		*chunked = 1;
+	    else if (!strncasecmp (linebuff, "Connection:", 11)) {
+		if (strcsrch (cval, "close") != NULL)
+		    *keep = 0;
+		else if (strcsrch (cval, "keep-alive") != NULL)
+		    *keep = 1;
+		}
+	    else if (!strncasecmp (linebuff, "Location:", 9)) {
+		strncpy (location, cval, LINE-1);
+		location[LINE-1] = (char) 0;
+		if ((cend = strchr (location, '\r')) != NULL)
+		    *cend = (char) 0;
+		if ((cend = strchr (location, '\n')) != NULL)
+		    *cend = (char) 0;
+		}
 	    }
-	if ((servurl = strsrch (servurl, "http://")) == NULL) {
+	} while (*status >= 100 && *status < 200);
+    return (1);
+}
+
+
+/* Read one HTTP response, returning its body if the status is 200 and
+ * keeping the connection open if the server allows it */
+
+static char *
+WebResponse (conn, diag, lbuff, status, location)
+
+struct WebConn *conn;	/* Open server connection */
+int	diag;		/* 1 to print diagnostic messages */
+int	*lbuff;		/* Length of returned buffer (returned) */
+int	*status;	/* HTTP status, 0 if no response (returned) */
+char	*location;	/* Location: of a redirect (returned) */
+{
+    FILE *sok = conn->sok;
+    char linebuff[LINE];
+    char *buff;
+    int keep, chunked, nbcont, lchunk, lread, nb, lb;
+
+    *lbuff = 0;
+    if (!WebHeader (conn, diag, status, &chunked, &nbcont, &keep, location)) {
+	WebDrop (conn);
+	return (NULL);
+	}
+
+    lb = CHUNK;
+    if ((buff = (char *) malloc (lb + 1)) == NULL) {
+	fprintf (stderr, "WEBBUFF: unable to allocate buffer of %d bytes\n", lb+1);
+	WebDrop (conn);
+	return (NULL);
+	}
+    nb = 0;
+
+    /* No body follows these codes */
+    if (*status == 204 || *status == 304)
+	;
+
+    /* Read chunks, each preceded by its length in hex, until a 0 length */
+    else if (chunked) {
+	while (1) {
+	    if (fgets (linebuff, LINE, sok) == NULL) {
+		keep = 0;
+		break;
+		}
+	    lchunk = (int) strtol (linebuff, NULL, 16);
+	    if (lchunk < 1) {
+		while (fgets (linebuff, LINE, sok) != NULL &&
+		       *linebuff != '\r' && *linebuff != '\n') {
+		    }
+		break;
+		}
 	    if (diag)
-		fprintf (stderr,"WEBBUFF: No forward URL for HTTP Code %d\n", status);
-	    return (NULL);
+		fprintf (stderr, "%s", linebuff);
+	    if ((buff = WebGrow (buff, &lb, nb + lchunk)) == NULL) {
+		WebDrop (conn);
+		return (NULL);
+		}
+	    lread = fread (buff+nb, 1, lchunk, sok);
+	    nb = nb + lread;
+	    if (lread < lchunk) {
+		keep = 0;
+		break;
+		}
+	    (void) fgets (linebuff, LINE, sok);
 	    }
-	servurl = servurl + 7;
-	urlpath = strchr (servurl, '/');
-	lserver = urlpath - servurl;
-	if ((server = (char *) malloc (lserver+2)) == NULL) {
+	}
+
+    /* Read body all at once if total length is passed */
+    else if (nbcont >= 0) {
+	if ((buff = WebGrow (buff, &lb, nbcont)) == NULL) {
+	    WebDrop (conn);
 	    return (NULL);
 	    }
-	strncpy (server, servurl, lserver);
-	server[lserver] = (char) 0;
+	nb = fread (buff, 1, nbcont, sok);
+	if (nb < nbcont)
+	    keep = 0;
+	}
 
-	if (diag)
-	    fprintf (stderr,"WEBBUFF: HTTP Code %d: Temporary Redirect to %s\n",
-		     status, server);
+    /* Otherwise the server closes the connection after the body */
+    else {
+	while ((lread = fread (buff+nb, 1, lb-nb, sok)) > 0) {
+	    nb = nb + lread;
+	    if (nb == lb && (buff = WebGrow (buff, &lb, 2 * lb)) == NULL) {
+		WebDrop (conn);
+		return (NULL);
+		}
+	    }
+	keep = 0;
+	}
+    buff[nb] = (char) 0;
+
+    if (!keep)
+	WebDrop (conn);
+    if (*status != 200) {
+	free (buff);
+	return (NULL);
+	}
+    *lbuff = nb;
+    return (buff);
+}
 
-	/* Open port to HTTP server */
-	if ( (sok = SokOpen (server, 80, XFREAD | XFWRITE)) == NULL ) {
-	    free (server);
+
+/* Reallocate buffer to hold at least nbytes plus a terminating null */
+
+static char *
+WebGrow (buff, lb, nbytes)
+
+char	*buff;	/* Buffer to enlarge */
+int	*lb;	/* Allocated length less 1 (returned) */
+int	nbytes;	/* Number of bytes needed */
+{
+    char *newbuff;
+    int lnew;
+
+    if (nbytes <= *lb)
+	return (buff);
+    lnew = *lb;
+    while (lnew < nbytes)
+	lnew = lnew * 2;
+    if ((newbuff = (char *) realloc (buff, lnew + 1)) == NULL) {
+	fprintf (stderr, "WEBBUFF: unable to allocate buffer of %d bytes\n",
+		 lnew + 1);
+	free (buff);
+	return (NULL);
+	}
+    *lb = lnew;
+    return (newbuff);
+}
+
+
+/* Read one URL over a persistent connection, reconnecting once if the
+ * server has closed a connection which was left open */
+
+static char *
+WebGet (url, diag, lbuff, status, location)
+
+char	*url;		/* URL to read */
+int	diag;		/* 1 to print diagnostic messages */
+int	*lbuff;		/* Length of returned buffer (returned) */
+int	*status;	/* HTTP status, 0 if no response (returned) */
+char	*location;	/* Location: of a redirect (returned) */
+{
+    struct WebConn *conn;
+    char host[MAXHOSTNAMELENGTH];
+    char *path, *buff;
+    int port, ntry, reused;
+
+    *status = 0;
+    *lbuff = 0;
+    WebInit ();
+    if ((path = WebURL (url, host, &port)) == NULL)
+	return (NULL);
+    for (ntry = 0; ntry < 2; ntry++) {
+	if ((conn = WebConnect (host, port, 0, &reused)) == NULL) {
+	    fprintf (stderr, "Can't read URL %s\n", host);
 	    return (NULL);
 	    }
+	if (WebSend (conn, path, 1)) {
+	    buff = WebResponse (conn, diag, lbuff, status, location);
+	    if (*status > 0)
+		return (buff);
+	    }
+	else
+	    WebDrop (conn);
+	if (!reused)
+	    break;
+	}
+    return (NULL);
+}
+
+
+/* Return a persistent connection to a server, opening it if necessary */
 
-	/* Make sure that URL contains only legal characters */
-	/* newpath = encodeURL (urlpath); */
-	newpath = urlpath;
+static struct WebConn *
+WebConnect (host, port, iconn, reused)
 
-	/* Send HTTP GET command (simbad forward fails if HTTP/1.1 included) */
-	fprintf(sok, "GET %s HTTP/1.1\r\nHost: %s\r\n\r\n", newpath, server);
-	fflush (sok);
-	free (server);
-	if (newpath != urlpath) {
-	    free (newpath);
+char	*host;	/* Server name, with :port if present */
+int	port;	/* Server port */
+int	iconn;	/* Which of the connections to this server */
+int	*reused; /* 1 if connection was already open (returned) */
+{
+    struct WebConn *conn;
+    int i;
+    static int inext = 0;
+
+    *reused = 0;
+    if ((conn = WebConnFind (host, port, iconn)) != NULL) {
+	if (WebAlive (conn)) {
+	    *reused = 1;
+	    return (conn);
 	    }
+	WebDrop (conn);
+	}
 
-	(void) fscanf(sok, "%*s %d %*s\r\n", &status);
+    /* Use an unused slot, else close the next one in turn */
+    conn = NULL;
+    for (i = 0; i < WEBMAXCONN; i++) {
+	if (webconn[i].sok == NULL) {
+	    conn = &webconn[i];
+	    break;
+	    }
 	}
+    if (conn == NULL) {
+	conn = &webconn[inext];
+	inext = (inext + 1) % WEBMAXCONN;
+	WebDrop (conn);
+	}
+
+    if ((conn->sok = SokOpen (host, port, XFREAD | XFWRITE)) == NULL)
+	return (NULL);
+    strcpy (conn->host, host);
+    conn->port = port;
+    conn->iconn = iconn;
+    conn->ngen = ++webgen;
+    return (conn);
+}
 
-    /* Skip continue lines
-    if (status == 100) {
-	while (status == 100)
-	    fscanf(sok, "%*s %d %*s\r\n", &status);
-	} */
 
-    /* If status is not 200 return without data */
-    if ( status != 200 ) {
-	if (diag)
-	    fprintf (stderr,"HTTP Code %d from  %s\n", status, server);
+/* Return an open connection to a server, or NULL if there is none */
+
+static struct WebConn *
+WebConnFind (host, port, iconn)
+
+char	*host;	/* Server name, with :port if present */
+int	port;	/* Server port */
+int	iconn;	/* Which of the connections to this server */
+{
+    int i;
+
+    for (i = 0; i < WEBMAXCONN; i++) {
+	if (webconn[i].sok != NULL && webconn[i].port == port &&
+	    webconn[i].iconn == iconn && !strcmp (webconn[i].host, host))
+	    return (&webconn[i]);
+	}
+    return (NULL);
+}
+
+
+/* Return 0 if an idle connection has been closed by the server */
+
+static int
+WebAlive (conn)
+
+struct WebConn *conn;	/* Open server connection */
+{
+    fd_set readfds;
+    struct timeval tv;
+    int fd;
+    char c;
+
+    fd = FileFd (conn->sok);
+    FD_ZERO (&readfds);
+    FD_SET (fd, &readfds);
+    tv.tv_sec = 0;
+    tv.tv_usec = 0;
+
+    /* An idle connection should have nothing to read unless it is closed */
+    if (select (fd+1, &readfds, NULL, NULL, &tv) == 0)
+	return (1);
+    if (recv (fd, &c, 1, MSG_PEEK) > 0)
+	return (1);
+    return (0);
+}
+
+
+/* Close a server connection and free its slot */
+
+static void
+WebDrop (conn)
+
+struct WebConn *conn;	/* Server connection */
+{
+    if (conn->sok != NULL)
+	(void) fclose (conn->sok);
+    conn->sok = NULL;
+    conn->host[0] = (char) 0;
+    conn->ngen = 0;
+    return;
+}
+
+
+/* Return and forget a response read by webprefetch() */
+
+static char *
+WebPreGet (url, lbuff)
+
+char	*url;	/* URL to look for */
+int	*lbuff;	/* Length of buffer (returned) */
+{
+    char *buff;
+    int i;
+
+    for (i = 0; i < nwebpre; i++) {
+	if (!strcmp (webpre[i].url, url)) {
+	    buff = webpre[i].buff;
+	    *lbuff = webpre[i].lbuff;
+	    free (webpre[i].url);
+	    nwebpre--;
+	    webpre[i] = webpre[nwebpre];
+	    return (buff);
+	    }
+	}
+    return (NULL);
+}
+
+/* Return format of a catalog server return if it can be read as it
+ * arrives, else 0 */
+
+static int
+WebFormat (url)
+
+char	*url;	/* Search URL */
+{
+    if (strsrch (url, "sdss"))
+	return (WEB_SDSS);
+    else if (strsrch (url, "galex"))
+	return (WEB_GALEX);
+    else if (strsrch (url, "gsss"))
+	return (WEB_GSSS);
+
+    /* SkyBot returns are rearranged as a whole */
+    else if (strsrch (url, "skybot"))
+	return (0);
+    else if (strsrch (url, "scat"))
+	return (WEB_SCAT);
+    else
+	return (WEB_TAB);
+}
+
+
+/* Send query, start a process to convert the return to a tab table as it
+ * arrives, and return its header and first line, leaving the rest to be
+ * read from a pipe; return NULL if the return cannot be streamed.
+ * The blocking socket reads and cache writes are left to that process, so
+ * the caller only reads converted lines through stdio, as from a file. */
+
+static char *
+WebStream (url, format, diag, lbuff, fstream)
+
+char	*url;		/* URL to read */
+int	format;		/* Format of server return (WEB_*) */
+int	diag;		/* 1 to print diagnostic messages */
+int	*lbuff;		/* Length of returned buffer (returned) */
+FILE	**fstream;	/* Pipe from which rest of table is read (returned) */
+{
+    struct WebConn *conn;
+    struct WebBody *body;
+    char host[MAXHOSTNAMELENGTH];
+    char location[LINE];
+    char *path, *buff;
+    int port, reused, status, chunked, nbcont, keep, lb, nb, ndash;
+    int pfd[2];
+    pid_t pid;
+    FILE *fd;
+
+    *lbuff = 0;
+    *fstream = NULL;
+    WebInit ();
+    if ((path = WebURL (url, host, &port)) == NULL)
+	return (NULL);
+    if ((conn = WebConnect (host, port, 0, &reused)) == NULL)
+	return (NULL);
+    if (!WebSend (conn, path, 1)) {
+	WebDrop (conn);
 	return (NULL);
 	}
-    for (i = 0; i < LINE; i++)
-	linebuff[i] = czero;
 
-    /* Skip over http header of returned stuff */
-    while (fgets (linebuff, LINE, sok) ) {
-	if (diag)
-	    fprintf (stderr, "%s", linebuff);
-	if (strcsrch (linebuff, "chunked") != NULL)
-	    chunked = 1;
-	if (strcsrch (linebuff, "Content-length") != NULL) {
-	    if ((cbcont = strchr (linebuff, ':')) != NULL)
-		nbcont = atoi (cbcont+1);
+    /* Leave redirects and errors to webbuff() */
+    if (!WebHeader (conn, diag, &status, &chunked, &nbcont, &keep, location) ||
+	status != 200) {
+	WebDrop (conn);
+	return (NULL);
+	}
+    body = (struct WebBody *) calloc (1, sizeof (struct WebBody));
+    if (body == NULL || pipe (pfd) != 0) {
+	if (body != NULL)
+	    free (body);
+	WebDrop (conn);
+	return (NULL);
+	}
+    body->sok = conn->sok;
+    body->chunked = chunked;
+    body->nleft = chunked ? 0 : nbcont;
+
+    /* The second child reads the body, so the first can exit at once */
+    fflush (NULL);
+    if ((pid = fork ()) < 0) {
+	close (pfd[0]);
+	close (pfd[1]);
+	free (body);
+	WebDrop (conn);
+	return (NULL);
+	}
+    if (pid == 0) {
+	close (pfd[0]);
+	if (fork () == 0) {
+	    WebStreamChild (body, format, pfd[1], url);
+	    _exit (0);
 	    }
-	if (*linebuff == '\n') break;
-	if (*linebuff == '\r') break;
-	for (i = 0; i < LINE; i++)
-	    linebuff[i] = czero;
-	}
-
-    /* Read table into buffer in memory a chunk at a time */
-    tabbuff = NULL;
-    for (i = 0; i < LINE; i++)
-	linebuff[i] = czero;
-    lb = 0;
-    if (chunked) {
-	lchunk = 1;
-	lline = 1;
-	*lbuff = 0;
-	ltbuff = 0;
-	while (lline > 0) {
-	    (void) fgets (linebuff, LINE, sok);
-	    lline = strlen (linebuff);
-	    if (lline < 1)
-		break;
-	    if (linebuff[lline-1] < 32)
-		linebuff[lline-1] = (char) 0;
-	    if (linebuff[lline-2] < 32)
-		linebuff[lline-2] = (char) 0;
-	    if (strlen (linebuff) <= 0)
-		continue;
-	    lchunk = (int) strtol (linebuff, NULL, 16);
-	    if (lchunk < 1)
-		break;
-	    /* else if (lchunk == 1)
-		continue; */
-	    if (diag)
-		fprintf (stderr, "%s (=%d)\n", linebuff, lchunk);
-	    lcbuff = ltbuff;
-	    ltbuff = ltbuff + lchunk;
-
-	    /* Allocate buffer on first time through */
-	    if (tabbuff == NULL) {
-		lb = 10 * ltbuff;
-		tabbuff = (char *) calloc ((size_t)lb, (size_t)1);
-		buff = tabbuff;
-		}
+	_exit (0);
+	}
+    (void) waitpid (pid, &status, 0);
+    close (pfd[1]);
+    free (body);
+
+    /* The body is read only by the child, so the connection cannot be reused */
+    WebDrop (conn);
+    if ((fd = fdopen (pfd[0], "r")) == NULL) {
+	close (pfd[0]);
+	return (NULL);
+	}
 
-	    /* Increase buffer size if this chunk will push it over current limit */
-	    else if (ltbuff > lb) {
-		lb = lb * 10;
-		newbuff = (char *) calloc ((size_t)lb, (size_t)1); 
-		movebuff (tabbuff, newbuff, lcbuff, 0, 0);
-		free (tabbuff);
-		tabbuff = newbuff;
-		buff = tabbuff + lcbuff;
-		newbuff = NULL;
+    /* Read header through line of dashes and the first line of data */
+    lb = CHUNK;
+    if ((buff = (char *) malloc (lb + 1)) == NULL) {
+	(void) fclose (fd);
+	return (NULL);
+	}
+    nb = 0;
+    ndash = -1;
+    while (fgets (buff+nb, lb-nb+1, fd) != NULL) {
+	if (ndash < 0 && buff[nb] == '-')
+	    ndash = 0;
+	nb = nb + strlen (buff+nb);
+	if (nb > 0 && buff[nb-1] != newline) {
+	    if ((buff = WebGrow (buff, &lb, 2 * lb)) == NULL) {
+		(void) fclose (fd);
+		return (NULL);
 		}
-	    else {
-		buff = tabbuff + lcbuff;
+	    continue;
+	    }
+	if (ndash >= 0 && ndash++ > 0)
+	    break;
+	if (nb + LINE > lb && (buff = WebGrow (buff, &lb, 2 * lb)) == NULL) {
+	    (void) fclose (fd);
+	    return (NULL);
+	    }
+	}
+    buff[nb] = (char) 0;
+    *lbuff = nb;
+    *fstream = fd;
+    return (buff);
+}
+
+
+/* Read the body of a catalog server return, converting each line to tab
+ * table format, writing it to a pipe and saving the result in the cache */
+
+static void
+WebStreamChild (body, format, pfd, url)
+
+struct WebBody *body;	/* Response body to read */
+int	format;		/* Format of server return (WEB_*) */
+int	pfd;		/* Pipe to which tab table is written */
+char	*url;		/* URL being read, to name cache file */
+{
+    FILE *fd, *fcache;
+    char temppath[WCMAXPATH];
+    char *line, *head, *tabhead, *ic;
+    int lline, lhead, nhead, nline, ndata, ok, space, ntab;
+    int formfeed = (char) 12;
+    char *space2tab();
+
+#ifdef SIGPIPE
+    /* Stop with an error if the reader closes the pipe */
+    (void) signal (SIGPIPE, SIG_IGN);
+#endif
+
+    if ((fd = fdopen (pfd, "w")) == NULL)
+	return;
+    fcache = webcachenew (url, temppath);
+    lline = LINE;
+    line = (char *) malloc (lline);
+    lhead = CHUNK;
+    head = (char *) malloc (lhead);
+    if (line == NULL || head == NULL) {
+	(void) fclose (fd);
+	webcachesave (fcache, url, temppath, -1);
+	return;
+	}
+
+    /* Collect header lines and the first line of data */
+    if (format == WEB_GSSS)
+	nhead = 2;
+    else if (format == WEB_SDSS || format == WEB_GALEX)
+	nhead = 1;
+    else
+	nhead = -1;
+    nline = 0;
+    ndata = 0;
+    space = 0;
+    *head = (char) 0;
+    ok = 1;
+    while (WebBodyLine (body, &line, &lline) != NULL) {
+	if (*line == formfeed || !strncasecmp (line, "[EOD]", 5)) {
+	    body->done = 1;
+	    break;
+	    }
+	if ((int) (strlen (head) + strlen (line) + 2) > lhead) {
+	    lhead = 2 * (lhead + strlen (line));
+	    if ((head = (char *) realloc (head, lhead)) == NULL) {
+		ok = 0;
+		break;
 		}
-            (void) fread (buff, 1, lchunk, sok);
-	    buff[lchunk] = (char) 0;
-	    if (diag)
-		fprintf (stderr, "%s\n", buff);
-	    *lbuff = ltbuff;
-	    for (i = 0; i < LINE; i++)
-		linebuff[i] = czero;
+	    }
+	strcat (head, line);
+	strcat (head, "\n");
+	nline++;
+	if (nhead < 0 && *line == '-')
+	    nhead = nline;
+	else if (nhead > 0 && nline > nhead) {
+	    ndata = 1;
+	    break;
 	    }
 	}
 
-    /* Read table all at once if total length is passed */
-    else if (nbcont > 0) {
-	tabbuff = (char *) calloc (1, nbcont+1);
-	tabbuff[nbcont] = (char) 0;
-	if ((lread = fread (tabbuff, 1, nbcont, sok)) <= 0) {
-	    free (tabbuff);
-	    tabbuff = NULL;
+    /* Convert header the same way as a whole return */
+    tabhead = NULL;
+    if (ok && ndata == 0 && format == WEB_SDSS)
+	ok = 0;
+    else if (ok && format == WEB_SDSS)
+	tabhead = sdssc2t (head);
+    else if (ok && format == WEB_GALEX)
+	tabhead = gsc2c2t (head);
+    else if (ok && format == WEB_GSSS)
+	tabhead = gsc2t2t (head);
+    else if (ok && format == WEB_SCAT) {
+	/* Make sure that scat data is tab-separated (3 tabs found) */
+	ntab = 0;
+	for (ic = head; *ic != (char) 0 && ntab < 3; ic++) {
+	    if (*ic == '\t')
+		ntab++;
+	    }
+	space = (ntab < 3);
+	if (space)
+	    tabhead = space2tab (head);
+	}
+    if (ok) {
+	if (tabhead == NULL)
+	    tabhead = head;
+	if (fputs (tabhead, fd) < 0)
+	    ok = 0;
+	if (fcache != NULL && fputs (tabhead, fcache) < 0) {
+	    (void) fclose (fcache);
+	    unlink (temppath);
+	    fcache = NULL;
 	    }
+	if (tabhead != head)
+	    free (tabhead);
 	}
+    free (head);
 
-    /* Read table into buffer in memory a buffer-full at a time */
-    else {
-	lchunk = 8192;
-	*lbuff = 0;
-	buff = (char *) calloc (1, lchunk+8);
-	if (buff == NULL) {
-	    fprintf (stderr, "WEBBUFF: unable to allocate chunk buffer of %d bytes\n", lchunk + 8);
-	    return (NULL);
+    /* Convert and pass on the rest of the table one line at a time */
+    while (ok && ndata > 0 && WebBodyLine (body, &line, &lline) != NULL) {
+	if (*line == formfeed || !strncasecmp (line, "[EOD]", 5)) {
+	    body->done = 1;
+	    break;
 	    }
-	while ( (lread = fread (buff, 1, lchunk, sok)) > 0 ) {
-	    lcbuff = *lbuff;
-	    *lbuff = *lbuff + lread;
-	    if (tabbuff == NULL) {
-		tabbuff = (char *) malloc (*lbuff+8);
-		if (tabbuff == NULL) {
-		    fprintf (stderr, "WEBBUFF: unable to allocate buffer of %d bytes\n", *lbuff + 8);
-		    return (NULL);
+
+	/* Drop partial last line of comma-separated returns */
+	if (body->partial && (format == WEB_SDSS || format == WEB_GALEX))
+	    break;
+
+	WebStreamData (line, format, space);
+	if (fputs (line, fd) < 0 || putc (newline, fd) == EOF)
+	    ok = 0;
+	if (fcache != NULL && (fputs (line, fcache) < 0 ||
+	    putc (newline, fcache) == EOF)) {
+	    (void) fclose (fcache);
+	    unlink (temppath);
+	    fcache = NULL;
+	    }
+	ndata++;
+	}
+    if (fclose (fd) != 0)
+	ok = 0;
+
+    /* Save table only if all of it was read and passed on */
+    if (fcache != NULL)
+	webcachesave (fcache, url, temppath, (ok && body->done) ? ndata : -1);
+    free (line);
+    return;
+}
+
+
+/* Convert one data line of a catalog server return to tab table format */
+
+static void
+WebStreamData (line, format, space)
+
+char	*line;		/* Line to convert in place */
+int	format;		/* Format of server return (WEB_*) */
+int	space;		/* 1 if scat table is separated by spaces */
+{
+    char *ic, *icn;
+    char last;
+
+    ic = line;
+    icn = line;
+    last = (char) 0;
+    switch (format) {
+	case WEB_SDSS:
+	    for (; *ic; ic++) {
+		if (*ic == ',')
+		    *ic = '\t';
+		}
+	    return;
+	case WEB_GALEX:
+	    for (; *ic; ic++) {
+		if (*ic == ',')
+		    *icn++ = '\t';
+		else if (*ic != ' ' && *ic != '\r')
+		    *icn++ = *ic;
+		}
+	    break;
+	case WEB_GSSS:
+	    for (; *ic; ic++) {
+		if (*ic != ' ' && *ic != '\r') {
+		    if (last == '\t' && *ic == '\t')
+			*icn++ = '0';
+		    *icn++ = *ic;
+		    last = *ic;
 		    }
-		movebuff (buff, tabbuff, lread, 0, 0);
 		}
-	    else {
-		newbuff = (char *) malloc (*lbuff+8);
-		if (newbuff == NULL) {
-		    fprintf (stderr, "WEBBUFF: unable to allocate new buffer of %d bytes\n", *lbuff + 8);
+	    break;
+	case WEB_SCAT:
+	    if (!space)
+		return;
+	    for (; *ic; ic++) {
+		if (*ic != ' ')
+		    *icn++ = *ic;
+		else if (last != ' ')
+		    *icn++ = '\t';
+		last = *ic;
+		}
+	    break;
+	default:
+	    return;
+	}
+    *icn = (char) 0;
+    return;
+}
+
+
+/* Return next line of an HTTP response body without its newline, growing
+ * the line buffer if necessary; return NULL at the end of the body */
+
+static char *
+WebBodyLine (body, line, lline)
+
+struct WebBody *body;	/* Response body being read */
+char	**line;		/* Line buffer (returned) */
+int	*lline;		/* Allocated length of line buffer (returned) */
+{
+    char *newbuff;
+    char c;
+    int nc = 0;
+
+    body->partial = 0;
+    while (1) {
+	if (body->ib >= body->nb) {
+	    body->ib = 0;
+	    if ((body->nb = WebBodyRead (body, body->buff, CHUNK)) < 1) {
+		body->nb = 0;
+		if (nc == 0)
 		    return (NULL);
+		body->partial = 1;
+		break;
+		}
+	    }
+	c = body->buff[body->ib++];
+	if (c == '\n')
+	    break;
+	if (nc + 2 > *lline) {
+	    if ((newbuff = (char *) realloc (*line, 2 * *lline)) == NULL)
+		return (NULL);
+	    *line = newbuff;
+	    *lline = 2 * *lline;
+	    }
+	(*line)[nc++] = c;
+	}
+    if (nc > 0 && (*line)[nc-1] == '\r')
+	nc--;
+    (*line)[nc] = (char) 0;
+    return (*line);
+}
+
+
+/* Read up to nbuff bytes of an HTTP response body, decoding chunks;
+ * return the number of bytes read, 0 at the end of the body */
+
+static int
+WebBodyRead (body, buff, nbuff)
+
+struct WebBody *body;	/* Response body being read */
+char	*buff;		/* Buffer to fill */
+int	nbuff;		/* Maximum number of bytes to read */
+{
+    char linebuff[LINE];
+    int nread;
+
+    if (body->eof)
+	return (0);
+
+    if (body->chunked) {
+
+	/* Read length of next chunk, ending body at a 0 length */
+	if (body->nleft == 0) {
+	    if (fgets (linebuff, LINE, body->sok) == NULL) {
+		body->eof = 1;
+		return (0);
+		}
+	    if ((body->nleft = (int) strtol (linebuff, NULL, 16)) < 1) {
+		while (fgets (linebuff, LINE, body->sok) != NULL &&
+		       *linebuff != '\r' && *linebuff != '\n') {
 		    }
-		movebuff (tabbuff, newbuff, lcbuff, 0, 0);
-		free (tabbuff);
-		tabbuff = newbuff;
-		movebuff (buff, tabbuff, lread, 0, lcbuff);
+		body->eof = 1;
+		body->done = 1;
+		return (0);
 		}
-	    if (diag)
-		fprintf (stderr, "%s\n", buff);
 	    }
-	free (buff);
-	buff = NULL;
+	if (nbuff > body->nleft)
+	    nbuff = body->nleft;
+	if ((nread = fread (buff, 1, nbuff, body->sok)) < 1) {
+	    body->eof = 1;
+	    return (0);
+	    }
+	body->nleft = body->nleft - nread;
+	if (body->nleft == 0)
+	    (void) fgets (linebuff, LINE, body->sok);
+	return (nread);
 	}
-    (void) fclose (sok);
 
-    return (tabbuff);
+    /* Stop after length sent in header */
+    else if (body->nleft >= 0) {
+	if (body->nleft == 0) {
+	    body->eof = 1;
+	    body->done = 1;
+	    return (0);
+	    }
+	if (nbuff > body->nleft)
+	    nbuff = body->nleft;
+	if ((nread = fread (buff, 1, nbuff, body->sok)) < 1) {
+	    body->eof = 1;
+	    return (0);
+	    }
+	body->nleft = body->nleft - nread;
+	return (nread);
+	}
+
+    /* Otherwise the body ends when the server closes the connection */
+    if ((nread = fread (buff, 1, nbuff, body->sok)) < 1) {
+	body->eof = 1;
+	body->done = 1;
+	return (0);
+	}
+    return (nread);
 }
 
 /* sokFile.c
@@ -1135,4 +2139,11 @@ char *encodeURL (char *str) {
  *
  * Feb  4 2022	Include ctype.h, which is needed on some systems
  * 		Add extra parentheses in if statement on line 642
+ *
+ * Oct 18 2026	Keep server connections open between requests in webbuff()
+ * Oct 18 2026	Read Content-Length or chunked bodies, reconnecting if closed
+ * Oct 18 2026	Add webbuffs() and webprefetch() to pipeline requests
+ * Oct 18 2026	Add setwebconn(), setwebpipe(), and webclose()
+ * Oct 18 2026	Save and reuse transformed tab tables in webopen()
+ * Oct 18 2026	Add webopenstream() to convert and read tables as they arrive
  */
@@ -1,9 +1,9 @@
 /* File sethead.c
- * August 10, 2020
+ * October 18, 2026
  * By Jessica Mink Harvard-Smithsonian Center for Astrophysics)
  * Send bug reports to jmink@cfa.harvard.edu
 
-   Copyright (C) 1996-2020
+   Copyright (C) 1996-2026
    Smithsonian Astrophysical Observatory, Cambridge, MA USA
 
    This program is free software; you can redistribute it and/or
@@ -28,6 +28,9 @@
 #include <errno.h>
 #include <unistd.h>
 #include <math.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
 #include "libwcs/fitsfile.h"
 #include "libwcs/wcs.h"
 #include "libwcs/wcscat.h"
@@ -45,6 +48,15 @@ static int maxnfile = MAXFILES;
 
 static void usage();
 static int SetValues ();
+static int SetTable ();
+
+/* One keyword assignment read from a -t table */
+struct KeySet {
+    char *file;		/* Name of file whose header is changed */
+    char *kwd;		/* keyword=value string for SetValues() */
+    char *comment;	/* Comment for keyword (NULL if none) */
+    int line;		/* Line number in table, to keep order within a file */
+};
 
 static int addecliptic = 0;
 static int addgalactic = 0;
@@ -65,6 +77,8 @@ static char *extension;		/* Extension number or name to read */
 static int addwcs = 0;
 static int errflag = 0;		/* Error return from program */
 static char *rootdir=NULL;	/* Root directory for input files */
+static char *tabfile=NULL;	/* Table of file, keyword, value lines */
+static int nworkers = 1;	/* Number of processes to use with -t */
 
 static char *RevMsg = "SETHEAD WCSTools 3.9.7, 26 April 2022, Jessica Mink (jmink@cfa.harvard.edu)";
 
@@ -202,6 +216,29 @@ char **av;
 		    newimage0++;
 		    break;
 
+		case 'p':	/* Reserve spare header blocks when header grows */
+		    if (ac < 2)
+			usage();
+		    setfitsspare (atoi (*++av));
+		    ac--;
+		    break;
+
+		case 't':	/* Table of file, keyword, and value */
+		    if (ac < 2)
+			usage();
+		    tabfile = *++av;
+		    ac--;
+		    break;
+
+		case 'w':	/* Number of files to update at once with -t */
+		    if (ac < 2)
+			usage();
+		    nworkers = atoi (*++av);
+		    if (nworkers < 1)
+			nworkers = 1;
+		    ac--;
+		    break;
+
 		case 'r':	/* Rename keywords with replaced values */
 		    krename++;
 		    if (ac > 1) {
@@ -406,6 +443,14 @@ char **av;
 
     if (nerr > 0)
 	exit (1);
+
+    /* Set values from a table of file, keyword, and value */
+    if (tabfile != NULL) {
+	if (nkwd > 0 || nfile > 0)
+	    fprintf (stderr, "SETHEAD: ignoring files and keywords with -t\n");
+	exit (SetTable (tabfile));
+	}
+
     if (nkwd <= 0 && nfile <= 0 )
 	usage ();
     else if (nfile <= 0 ) {
@@ -558,6 +603,7 @@ usage ()
     fprintf(stderr,"  or : [-eghjknv][-r [char]][-s char] file1.fits [... filen.fits] @keywordfile]\n");
     fprintf(stderr,"  or : [-eghjknv][-r [char]][-s char] @listfile kw1=val1 [ ... kwn=valuen]\n");
     fprintf(stderr,"  or : [-eghjknv][-r [char]][-s char] @listfile @keywordfile\n");
+    fprintf(stderr,"  or : [-hknv][-r [char]][-s char][-w num] -t tablefile\n");
     fprintf(stderr,"  -e: Add ecliptic WCS\n");
     fprintf(stderr,"  -g: Add galactic WCS\n");
     fprintf(stderr,"  -j: Add J2000 WCS\n");
@@ -566,15 +612,237 @@ usage ()
     fprintf(stderr,"  -l: Log files as processed (on one line)\n");
     fprintf(stderr,"  -m num: Change max number of keywords changed to num\n");
     fprintf(stderr,"  -n: Write a new file (add e before the extension)\n");
+    fprintf(stderr,"  -p num: Reserve num spare header blocks if header grows\n");
     fprintf(stderr,"  -r [char]: Rename reset keywords with char or X prefixed\n");
     fprintf(stderr,"  -s [char]: Replace this character with space in string values\n");
+    fprintf(stderr,"  -t file: Set values from lines of filename keyword value [/ comment]\n");
     fprintf(stderr,"  -v: Verbose\n");
+    fprintf(stderr,"  -w num: Update num files at once with -t\n");
     fprintf(stderr,"  -x [range]: Read header for these extensions (no arg=all)\n");
     fprintf(stderr,"  / comment: Add this comment to previous keyword\n");
     exit (0);
 }
 
 
+/* Compare two table entries by file name, then by line in table */
+
+static int
+KeySetComp (ks1, ks2)
+
+const void *ks1, *ks2;
+{
+    struct KeySet *k1 = (struct KeySet *) ks1;
+    struct KeySet *k2 = (struct KeySet *) ks2;
+    int icomp;
+
+    if ((icomp = strcmp (k1->file, k2->file)))
+	return (icomp);
+    return (k1->line - k2->line);
+}
+
+
+/* Read a table of file, keyword, value [/ comment] lines, sort it by file,
+ * and set all of the keywords for each file with one header read and write.
+ * Each keyword is still found in the header by its own search in hput*().
+ * If nworkers > 1, files are handed out one at a time through a pipe to
+ * that many child processes; the header subroutines keep static state, so
+ * separate processes are used rather than threads. */
+
+static int
+SetTable (tablefile)
+
+char	*tablefile;	/* Name of table file */
+{
+    char *tabbuff, *line, *nextline, *kw, *kwe, *val, *c, *sl;
+    struct KeySet *ks;
+    char **kwd, **comment;
+    int *gstart;
+    int nlines, nks, ngroup, nkmax, igroup, ik, nk, iline, iworker;
+    int status, nstart;
+    int worker = 0;		/* 1 in a worker process */
+    int pfd[2];			/* Pipe handing out files to workers */
+    pid_t pid;
+    char squote = (char) 39;
+    char dquote = (char) 34;
+
+    if ((nlines = getfilelines (tablefile)) < 1) {
+	fprintf (stderr, "SETHEAD: Table file %s cannot be read\n", tablefile);
+	return (1);
+	}
+    if ((tabbuff = getfilebuff (tablefile)) == NULL) {
+	fprintf (stderr, "SETHEAD: Table file %s cannot be read\n", tablefile);
+	return (1);
+	}
+    ks = (struct KeySet *) calloc (nlines + 1, sizeof (struct KeySet));
+
+    /* Split each line into file name, keyword=value, and comment */
+    nks = 0;
+    iline = 0;
+    for (line = tabbuff; line != NULL && *line != (char) 0; line = nextline) {
+	iline++;
+	if ((nextline = strchr (line, '\n')) != NULL)
+	    *nextline++ = (char) 0;
+	if ((c = strchr (line, '\r')) != NULL)
+	    *c = (char) 0;
+	while (*line == ' ' || *line == '\t')
+	    line++;
+	if (*line == (char) 0 || *line == '#')
+	    continue;
+	if (nks > nlines)
+	    break;
+
+	/* File name */
+	for (c = line; *c != (char) 0 && *c != ' ' && *c != '\t'; c++);
+	if (*c == (char) 0) {
+	    fprintf (stderr, "SETHEAD: No keyword on line %d of %s\n",
+		     iline, tablefile);
+	    continue;
+	    }
+	*c++ = (char) 0;
+
+	/* Keyword, which may be followed by = instead of white space */
+	while (*c == ' ' || *c == '\t')
+	    c++;
+	kw = c;
+	while (*c != (char) 0 && *c != ' ' && *c != '\t' && *c != '=')
+	    c++;
+	kwe = c;
+	while (*c == ' ' || *c == '\t')
+	    c++;
+	if (*c == '=')
+	    c++;
+	while (*c == ' ' || *c == '\t')
+	    c++;
+	val = c;
+
+	/* Comment follows a slash past any quoted value */
+	c = val;
+	if (*val == squote || *val == dquote) {
+	    if ((c = strchr (val+1, *val)) == NULL)
+		c = val;
+	    }
+	if ((sl = strsrch (c, " / ")) != NULL) {
+	    *sl = (char) 0;
+	    ks[nks].comment = sl + 3;
+	    if (spchar)
+		stc2s (&spchar, ks[nks].comment);
+	    }
+
+	/* Rebuild keyword=value as SetValues() expects */
+	ks[nks].file = line;
+	ks[nks].kwd = (char *) calloc (1, (kwe - kw) + strlen (val) + 2);
+	strncpy (ks[nks].kwd, kw, kwe - kw);
+	if (*val != (char) 0) {
+	    strcat (ks[nks].kwd, "=");
+	    strcat (ks[nks].kwd, val);
+	    }
+	ks[nks].line = iline;
+	nks++;
+	}
+    if (nks < 1) {
+	fprintf (stderr, "SETHEAD: No keywords in table %s\n", tablefile);
+	return (1);
+	}
+
+    /* Group all of the keywords for each file together */
+    qsort ((void *) ks, nks, sizeof (struct KeySet), KeySetComp);
+    gstart = (int *) calloc (nks + 1, sizeof (int));
+    ngroup = 0;
+    nkmax = 0;
+    for (ik = 0; ik < nks; ik++) {
+	if (ik == 0 || strcmp (ks[ik].file, ks[ik-1].file)) {
+	    if (ngroup > 0 && ik - gstart[ngroup-1] > nkmax)
+		nkmax = ik - gstart[ngroup-1];
+	    gstart[ngroup++] = ik;
+	    }
+	}
+    gstart[ngroup] = nks;
+    if (nks - gstart[ngroup-1] > nkmax)
+	nkmax = nks - gstart[ngroup-1];
+    kwd = (char **) calloc (nkmax, sizeof (char *));
+    comment = (char **) calloc (nkmax, sizeof (char *));
+    if (nworkers > ngroup)
+	nworkers = ngroup;
+
+    /* Start worker processes, each of which asks for one file at a time */
+    if (nworkers > 1 && pipe (pfd) < 0) {
+	fprintf (stderr, "SETHEAD: Cannot make pipe to workers; updating serially\n");
+	nworkers = 1;
+	}
+    if (nworkers > 1) {
+	fflush (stdout);
+	fflush (stderr);
+	nstart = 0;
+	for (iworker = 0; iworker < nworkers; iworker++) {
+	    if ((pid = fork ()) == 0) {
+		close (pfd[1]);
+		worker = 1;
+		break;
+		}
+	    else if (pid < 0) {
+		fprintf (stderr, "SETHEAD: Cannot start worker %d\n", iworker);
+		break;
+		}
+	    nstart++;
+	    }
+
+	/* If no worker could be started, update all of the files here */
+	if (!worker && nstart == 0) {
+	    close (pfd[0]);
+	    close (pfd[1]);
+	    nworkers = 1;
+	    }
+
+	/* Parent hands out files, then waits for all workers to finish */
+	else if (!worker) {
+	    close (pfd[0]);
+	    signal (SIGPIPE, SIG_IGN);
+	    for (igroup = 0; igroup < ngroup; igroup++) {
+		if (write (pfd[1], &igroup, sizeof (int)) != sizeof (int)) {
+		    errflag = 1;
+		    break;
+		    }
+		}
+	    close (pfd[1]);
+	    while (wait (&status) > 0) {
+		if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+		    errflag = 1;
+		}
+	    return (errflag);
+	    }
+	}
+
+    igroup = 0;
+    while (igroup < ngroup) {
+	if (worker && read (pfd[0], &igroup, sizeof (int)) != sizeof (int))
+	    break;
+	nk = 0;
+	for (ik = gstart[igroup]; ik < gstart[igroup+1]; ik++) {
+	    kwd[nk] = ks[ik].kwd;
+	    comment[nk] = ks[ik].comment;
+	    nk++;
+	    }
+	if (SetValues (ks[gstart[igroup]].file, nk, kwd, comment) < 0)
+	    errflag = 1;
+
+	if (verbose)
+	    printf ("\n");
+
+	/* Log the processing of this file, if requested */
+	if (logfile) {
+	    nproc++;
+	    fprintf (stderr, "%d: %s processed.\r", nproc, ks[gstart[igroup]].file);
+	    }
+	if (!worker)
+	    igroup++;
+	}
+
+    if (worker)
+	exit (errflag);
+    return (errflag);
+}
+
+
 static int
 SetValues (filename, nkwd, kwd, comment)
 
@@ -614,7 +882,6 @@ char	*comment[];	/* Comments for those keywords (none if NULL) */
     int dquote = 34;
     int naxis = 0;
     int nbold, nbnew;
-    int imageread = 0;
     char cval[24];
     char history[128];
     char *endchar;
@@ -688,7 +955,6 @@ char	*comment[];	/* Comments for those keywords (none if NULL) */
     else {
 	iraffile = 0;
 	setfitsinherit (0);
-	imageread = 0;
 	if ((header = fitsrhead (filepath, &lhead, &nbhead)) == NULL) {
 	    fprintf (stderr, "Cannot read FITS file %s\n", filepath);
 	    return (-1);
@@ -1360,31 +1626,33 @@ char	*comment[];	/* Comments for those keywords (none if NULL) */
 	    }
 	}
 
-    /* Rewrite header and data to a new image file */
-    else if (naxis > 0) {
-	if (!imageread) {
-	    if ((image = fitsrfull (filename, nbhead, header)) == NULL) {
-		errflag = 1;
-		if (verbose) {
-		    fitserr();
-		    fprintf (stderr, "*** New header not written\n");
-		    }
+    /* If header is longer than original, move data down to make room */
+    else if (!newimage) {
+	if (!fitsgrowhead (newname, header)) {
+	    if (verbose)
+		printf ("%s: rewritten successfully.\n", newname);
+	    }
+	else {
+	    if (verbose) {
+		fitserr();
+		fprintf (stderr, "*** New header not written\n");
 		}
-	    else
-		imageread = 1;
+	    errflag = 1;
 	    }
-	if (imageread) {
-	    if (fitswimage (newname, header, image) > 0 && verbose)
+	}
+
+    /* Copy header and data to a new image file */
+    else if (naxis > 0) {
+	if (fitscimage (newname, header, filepath) > 0) {
+	    if (verbose)
 		printf ("%s: rewritten successfully.\n", newname);
-	    else {
-		errflag = 1;
-		if (verbose) {
-		    fitserr();
-		    fprintf (stderr, "*** New header not written\n");
-		    }
+	    }
+	else {
+	    errflag = 1;
+	    if (verbose) {
+		fitserr();
+		fprintf (stderr, "*** New header not written\n");
 		}
-	    free (image);
-	    image = NULL;
 	    }
 	}
 
@@ -1501,4 +1769,14 @@ char	*comment[];	/* Comments for those keywords (none if NULL) */
  * Mar 30 2017	If isnum() returns >2, quote value as string
  *
  * Aug 10 2020	If isnum is 3, allow addition or subtraction of days from date
+ *
+ * Oct 18 2026	Lengthen header in place with fitsgrowhead() instead of
+ *		reading and rewriting the whole image
+ * Oct 18 2026	Add -p to reserve spare header blocks when header grows
+ * Oct 18 2026	Copy data to new file with fitscimage() without reading it
+ * Oct 18 2026	Add -t to set values from a table of file, keyword, value
+ * Oct 18 2026	Add -w to update files from a table in parallel processes
+ *
+ * Oct 19 2026	Hand out files to -w workers one at a time; update here if none start
+ * Oct 19 2026	Note that table keywords are still searched for one at a time
  */
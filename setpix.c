@@ -1,9 +1,9 @@
 /* File setpix.c
- * August 31, 2020
+ * October 19, 2026
  * By Jessica Mink, Harvard-Smithsonian Center for Astrophysics
  * Send bug reports to jmink@cfa.harvard.edu
 
-   Copyright (C) 1996-2020
+   Copyright (C) 1996-2026
    Smithsonian Astrophysical Observatory, Cambridge, MA USA
 
    This program is free software; you can redistribute it and/or
@@ -40,6 +40,7 @@
 
 static void usage();
 static void SetPix();
+static void SetRows();
 
 static int newimage = 0;
 static int verbose = 0;		/* verbose flag */
@@ -364,35 +365,39 @@ char	**value;	/* value to insert into pixel */
 	if (!strcmp (rrange[i], "0") && !strcmp (crange[i], "0")) {
 	    nx = xdim;
 	    ny = ydim;
-	    for (x = 0; x < nx; x++) {
-		for (y = 0; y < ny; y++) {
-		    if (op == PIX_SET) {
-			putpix (image,bitpix,xdim,ydim,bzero,bscale,x,y,dpix);
-			dpi = dpix;
-			}
-		    else {
-			dpi = getpix (image,bitpix,xdim,ydim,bzero,bscale,x,y);
-			if (op == PIX_MUL)
-			    dpi = dpi * dpix;
-			else if (op == PIX_ADD)
-			    dpi = dpi + dpix;
-			else if (op == PIX_SUB)
-			    dpi = dpi - dpix;
-			else if (op == PIX_DIV)
-			    dpi = dpi / dpix;
-			putpix (image,bitpix,xdim,ydim,bzero,bscale,x,y,dpi);
-			}
-	            if (bitpix > 0) {
-			if (dpi > 0)
-	 		    ipix = (int) (dpi + 0.5);
-			else if (dpi < 0)
-		 	    ipix = (int) (dpi - 0.5);
-			else
-			    ipix = 0;
-			}
-		    if (eachpix) {
+
+	    /* Operate on one row at a time if not listing pixels */
+	    if (!eachpix)
+		SetRows (image, bitpix, xdim, bzero, bscale, NULL, ny, op, dpix);
+	    else {
+		for (x = 0; x < nx; x++) {
+		    for (y = 0; y < ny; y++) {
+			if (op == PIX_SET) {
+			    putpix (image,bitpix,xdim,ydim,bzero,bscale,x,y,dpix);
+			    dpi = dpix;
+			    }
+			else {
+			    dpi = getpix (image,bitpix,xdim,ydim,bzero,bscale,x,y);
+			    if (op == PIX_MUL)
+				dpi = dpi * dpix;
+			    else if (op == PIX_ADD)
+				dpi = dpi + dpix;
+			    else if (op == PIX_SUB)
+				dpi = dpi - dpix;
+			    else if (op == PIX_DIV)
+				dpi = dpi / dpix;
+			    putpix (image,bitpix,xdim,ydim,bzero,bscale,x,y,dpi);
+			    }
+			if (bitpix > 0) {
+			    if (dpi > 0)
+				ipix = (int) (dpi + 0.5);
+			    else if (dpi < 0)
+				ipix = (int) (dpi - 0.5);
+			    else
+				ipix = 0;
+			    }
 			printf ("%s[%d,%d] = ", filename,x+1,y+1);
-		        if (bitpix > 0)
+			if (bitpix > 0)
 			    printf (pform, ipix);
 			else
 			    printf (pform, dpi);
@@ -461,31 +466,33 @@ char	**value;	/* value to insert into pixel */
 	    yrange = RangeInit (rrange[i], xdim);
 	    ny = rgetn (yrange);
 	    nx = xdim;
-	    for (iy = 0; iy < ny; iy++) {
-		y = rgeti4 (yrange) - 1;
-		for (x = 0; x < nx; x++) {
-		    if (op == PIX_SET) {
-			putpix (image,bitpix,xdim,ydim,bzero,bscale,x,y,dpix);
-			dpi = dpix;
-			}
-		    else {
-			dpi = getpix (image,bitpix,xdim,ydim,bzero,bscale,x,y);
-			if (op == PIX_MUL)
-			    dpi = dpi * dpix;
-			else if (op == PIX_ADD)
-			    dpi = dpi + dpix;
-			else if (op == PIX_SUB)
-			    dpi = dpi - dpix;
-			else if (op == PIX_DIV)
-			    dpi = dpi / dpix;
-			putpix (image,bitpix,xdim,ydim,bzero,bscale,x,y,dpi);
-			}
-		    if (eachpix) {
+	    if (!eachpix)
+		SetRows (image, bitpix, xdim, bzero, bscale, yrange, ny, op, dpix);
+	    else {
+		for (iy = 0; iy < ny; iy++) {
+		    y = rgeti4 (yrange) - 1;
+		    for (x = 0; x < nx; x++) {
+			if (op == PIX_SET) {
+			    putpix (image,bitpix,xdim,ydim,bzero,bscale,x,y,dpix);
+			    dpi = dpix;
+			    }
+			else {
+			    dpi = getpix (image,bitpix,xdim,ydim,bzero,bscale,x,y);
+			    if (op == PIX_MUL)
+				dpi = dpi * dpix;
+			    else if (op == PIX_ADD)
+				dpi = dpi + dpix;
+			    else if (op == PIX_SUB)
+				dpi = dpi - dpix;
+			    else if (op == PIX_DIV)
+				dpi = dpi / dpix;
+			    putpix (image,bitpix,xdim,ydim,bzero,bscale,x,y,dpi);
+			    }
 			if (bitpix > 0) {
 			    if (dpi > 0)
-	 			ipix = (int) (dpi + 0.5);
+				ipix = (int) (dpi + 0.5);
 			    else if (dpi < 0)
-		 		ipix = (int) (dpi - 0.5);
+				ipix = (int) (dpi - 0.5);
 			    else
 				ipix = 0;
 			    }
@@ -671,6 +678,67 @@ char	**value;	/* value to insert into pixel */
     return;
 }
 
+
+/* Apply one constant operation to entire rows of an image */
+
+static void
+SetRows (image, bitpix, xdim, bzero, bscale, yrange, ny, op, dpix)
+
+char	*image;		/* Image array */
+int	bitpix;		/* FITS bits per pixel */
+int	xdim;		/* Number of pixels per row */
+double	bzero;		/* Zero point for pixel scaling */
+double	bscale;		/* Scale factor for pixel scaling */
+struct Range *yrange;	/* Rows to change, or NULL for all */
+int	ny;		/* Number of rows to change */
+int	op;		/* Operation to perform */
+double	dpix;		/* Constant for operation */
+{
+    struct PixExpr *pe;
+    double *dvec;
+    int iy, y, opchar;
+
+    if (op == PIX_ADD)
+	opchar = '+';
+    else if (op == PIX_SUB)
+	opchar = '-';
+    else if (op == PIX_MUL)
+	opchar = '*';
+    else if (op == PIX_DIV)
+	opchar = '/';
+    else
+	opchar = '=';
+
+    if ((pe = pixexpr ("a")) == NULL)
+	return;
+    if (!pixexprop (pe, opchar, dpix)) {
+	pixexprfree (pe);
+	return;
+	}
+    dvec = (double *) calloc (xdim, sizeof (double));
+    if (dvec == NULL) {
+	fprintf (stderr, "SETPIX: Cannot allocate %d-pixel row\n", xdim);
+	pixexprfree (pe);
+	return;
+	}
+
+    /* Read, change, and write each row in one pass */
+    for (iy = 0; iy < ny; iy++) {
+	if (yrange != NULL)
+	    y = rgeti4 (yrange) - 1;
+	else
+	    y = iy;
+	if (op != PIX_SET)
+	    getvec (image, bitpix, bzero, bscale, y*xdim, xdim, dvec);
+	pixexprvec (pe, &dvec, xdim, 1, y+1, dvec);
+	putvec (image, bitpix, bzero, bscale, y*xdim, xdim, dvec);
+	}
+
+    free (dvec);
+    pixexprfree (pe);
+    return;
+}
+
 /* Dec  6 1996	New program
  *
  * Feb 21 1997  Check pointers against NULL explicitly for Linux
@@ -709,4 +777,6 @@ char	**value;	/* value to insert into pixel */
  * Jun  9 2016	Fix isnum() tests for added coloned times and dashed dates
  *
  * Aug 31 2020	Fix bug which wrongly reallocated buffers (found by David Binderman)
+ *
+ * Oct 19 2026	Change whole rows in one pass using pixexprvec() unless -i
  */
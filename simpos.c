@@ -1,5 +1,5 @@
 /*** simpos.c - search object by its name from command line arguments
- *** May 15, 2015
+ *** October 18, 2026
  *** By Jessica Mink, sort of after IPAC byname.c for searching NED
  */
 
@@ -14,6 +14,7 @@ extern int   ned_errno;
 static char searchorder[4];
 static int printall = 0;
 static void PrintUsage();
+static void SimURL();
 static char *RevMsg = "SIMPOS 3.9.7, 26 April 2022, Jessica Mink (jmink@cfa.harvard.edu)";
 
 int
@@ -22,7 +23,6 @@ int  ac;
 char *av[];
 {
    
-    int lobj;
     int i;
     int verbose = 0;
     int printid = 0;
@@ -42,15 +42,18 @@ char *av[];
     char *str, *objname, *posdec, *posra, *iend, *ieq;
     char *listfile;
     char rastr[32], decstr[32];
-    char newobj[32];
+    char newobj[256];
     char *buff, *buffid, *idline, *posline, *errline, *id, *errend;
     char url[256];
     char *xbuff;
+    char **urls;
     int lbuff;
+    int nurl;
     FILE *flist;
     char cr, lf, eq;
 
     listfile = NULL;
+    flist = NULL;
     cr = (char) 13;
     lf = (char) 10;
     eq = '=';
@@ -159,6 +162,7 @@ char *av[];
 		if ((flist = fopen (listfile, "r")) == NULL) {
 		    fprintf (stderr,"SIMPOS: List file %s cannot be read\n",
 			     listfile);
+		    listfile = NULL;
 		    }
 		}
 	    else {
@@ -176,47 +180,47 @@ char *av[];
     /* Set searches to SNV if not otherwise set */
     if ( searchorder[0] == (char) 0 )
 	strcpy (searchorder, "SNV");
-    if (listfile) {
+    if (listfile)
 	ac = nfobj;
-	objname = newobj;
+    objname = newobj;
+
+    /* Send all of the queries to the server before reading any returns */
+    if (ac > 1 && (urls = (char **) calloc (ac, sizeof (char *))) != NULL) {
+	for (nurl = 0; nurl < ac; nurl++) {
+	    if (listfile) {
+		if (fgets (newobj, sizeof (newobj), flist) == NULL)
+		    break;
+		}
+	    else
+		strncpy (newobj, av[nurl], sizeof (newobj) - 1);
+	    newobj[sizeof (newobj) - 1] = (char) 0;
+	    if ((urls[nurl] = (char *) malloc (256)) == NULL)
+		break;
+	    SimURL (urls[nurl], newobj, cds, printid || printall);
+	    }
+	(void) webprefetch (urls, nurl, verbose);
+	for (i = 0; i < nurl; i++)
+	    free (urls[i]);
+	free (urls);
+	if (listfile)
+	    rewind (flist);
 	}
+
     while (ac > 0) {
 
+	/* Copy each name as it was copied for the prefetch, so URLs match */
 	if (listfile)
-	    fgets (newobj, 32, flist);
+	    fgets (newobj, sizeof (newobj), flist);
 	else
-	    objname = *av++;
+	    strncpy (newobj, *av++, sizeof (newobj) - 1);
+	newobj[sizeof (newobj) - 1] = (char) 0;
 	ac--;
 
-	/* Replace underscores and spaces with plusses */
-	lobj = strlen (objname);
-	for (i = 0; i < lobj; i++) {
-	    if (objname[i] == '_')
-		objname[i] = '+';
-	    if (objname[i] == ' ') {
-		if (i == lobj-1)
-		    objname = (char) 0;
-		else
-		    objname[i] = '+';
-		}
-	    }
-	if (verbose)
+	SimURL (url, objname, cds, printid || printall);
+	if (verbose) {
 	    printf ("%s -> ", objname);
-
-	for (i = 0; i < 256; i++) {
-	    url[i] = (char) 0;
-	    }
-	if (cds)
-	    strcpy (url, "http://cdsweb.u-strasbg.fr/cgi-bin/nph-sesame/-oI/");
-	else
-	    strcpy (url, "http://vizier.cfa.harvard.edu/viz-bin/nph-sesame/-oI/");
-	strcat (url, searchorder);
-	if ((printid || printall) && !strcmp (searchorder, "V"))
-	    strcat (url, "A");
-	strcat (url, "?");
-	strcat (url, objname);
-	if (verbose)
 	    printf ("%s\n", url);
+	    }
 	buff = webbuff (url, verbose, &lbuff);
 
 	if (buff == NULL) {
@@ -430,6 +434,51 @@ char *av[];
     exit (0);
 }
 
+/* Set URL of name resolver query, replacing underscores and spaces in
+ * the object name with plusses */
+
+static void
+SimURL (url, objname, cds, allid)
+
+char	*url;		/* URL (returned, 256 characters) */
+char	*objname;	/* Object name, edited in place */
+int	cds;		/* 1 to use CDS server in France */
+int	allid;		/* 1 to return all IDs from Vizier */
+{
+    int i, lobj;
+
+    lobj = strlen (objname);
+    for (i = 0; i < lobj; i++) {
+	if (objname[i] == '_')
+	    objname[i] = '+';
+	if (objname[i] == '\n' || objname[i] == '\r') {
+	    objname[i] = (char) 0;
+	    break;
+	    }
+	if (objname[i] == ' ') {
+	    if (i == lobj-1)
+		objname[i] = (char) 0;
+	    else
+		objname[i] = '+';
+	    }
+	}
+
+    for (i = 0; i < 256; i++) {
+	url[i] = (char) 0;
+	}
+    if (cds)
+	strcpy (url, "http://cdsweb.u-strasbg.fr/cgi-bin/nph-sesame/-oI/");
+    else
+	strcpy (url, "http://vizier.cfa.harvard.edu/viz-bin/nph-sesame/-oI/");
+    strcat (url, searchorder);
+    if (allid && !strcmp (searchorder, "V"))
+	strcat (url, "A");
+    strcat (url, "?");
+    strncat (url, objname, 255 - strlen (url));
+    return;
+}
+
+
 static void
 PrintUsage (command)
 
@@ -478,4 +527,10 @@ char	*command;	/* Command where error occurred or NULL */
  *
  * May  5 2015	Switch to CfA Vizier server as default
  * May 15 2015	Explicitly search SIMBAD, NED, or Vizier (nedpos or vizpos)
+ *
+ * Oct 18 2026	Send all queries for a list of names before reading any returns
+ * Oct 18 2026	Drop newline from names read from @file
+ *
+ * Oct 19 2026	Copy names the same way for prefetch and search, in 256 bytes
+ * Oct 19 2026	Drop unused lobj; ignore an @file which cannot be opened
  */
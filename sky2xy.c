@@ -1,9 +1,9 @@
 /* File sky2xy.c
- * July 22, 2015
+ * October 18, 2026
  * By Jessica Mink, Harvard-Smithsonian Center for Astrophysics
  * Send bug reports to jmink@cfa.harvard.edu
 
-   Copyright (C) 1996-2015
+   Copyright (C) 1996-2026
    Smithsonian Astrophysical Observatory, Cambridge, MA USA
 
    This program is free software; you can redistribute it and/or
@@ -31,6 +31,9 @@
 #include "libwcs/fitswcs.h"
 
 static void PrintUsage();
+static void StreamList();
+
+#define NBSTREAM 1048576	/* Bytes of list file read at once with -r or -u */
 extern void setrot(),setsys(),setcenter(),setsecpix(),setrefpix(),setdateobs();
 extern void setnpix();
 extern struct WorldCoor *GetFITSWCS ();	/* Read WCS from FITS or IRAF header */
@@ -72,6 +75,7 @@ char **av;
     int ndec = 3;		/* Number of decimal places in output coords */
     char printonly = 'b';
     int modwcs = 0;		/* 1 if image WCS modified on command line */
+    int streamio = 0;		/* 1 to stream list in blocks, 2 if binary */
 
     wcs = NULL;
 
@@ -244,6 +248,10 @@ char **av;
 		ac--;
 		break;
 	
+	    case 'r':	/* Stream binary RA Dec from list file to binary X Y */
+		streamio = 2;
+		break;
+
 	    case 's':	/* Size of image in X and Y pixels */
 		if (ac < 3)
 		    PrintUsage(str);
@@ -255,6 +263,10 @@ char **av;
 		modwcs = 1;
     		break;
 
+	    case 'u':	/* Stream list file in blocks, writing only X Y */
+		streamio = 1;
+		break;
+
 	    case 'x':	/* X and Y coordinates of reference pixel */
 		if (ac < 3)
 		    PrintUsage (str);
@@ -351,7 +363,21 @@ char **av;
 	    ln = listname;
 	    while (*ln++)
 		*(ln-1) = *ln;
-	    if ((fd = fopen (listname, "r"))) {
+
+	    /* Convert large lists quickly in blocks */
+	    if (streamio) {
+		if (!strcmp (listname,"STDIN") || !strcmp (listname,"stdin"))
+		    fd = stdin;
+		else if ((fd = fopen (listname, "r")) == NULL) {
+		    fprintf (stderr, "Cannot read file %s\n", listname);
+		    exit (1);
+		    }
+		StreamList (wcs, fd, streamio - 1, ndec,
+			    *coorsys ? coorsys : NULL);
+		if (fd != stdin)
+		    fclose (fd);
+		}
+	    else if ((fd = fopen (listname, "r"))) {
 		while (fgets (line, 80, fd)) {
 		    csys[0] = (char) 0;
 		    n = sscanf (line,"%s %s %s", rastr, decstr, csys);
@@ -455,6 +481,167 @@ char **av;
     return (0);
 }
 
+/* STREAMLIST -- Convert a list of sky positions read in large blocks,
+ * writing image X and Y, or binary doubles if rawio is set */
+
+static void
+StreamList (wcs, fd, rawio, ndec, coorsys)
+
+struct WorldCoor *wcs;	/* World coordinate system structure */
+FILE	*fd;		/* List of RA Dec positions */
+int	rawio;		/* 1 to read native binary RA Dec and write X Y */
+int	ndec;		/* Number of decimal places in output X and Y */
+char	*coorsys;	/* Input coordinate system, NULL if image system */
+{
+    char *buff, *obuff, *line, *lend, *bend, *cnum, *cnext, *op;
+    char token[32];
+    double *pos;
+    double x, y, ra, dec;
+    int nread, nbuff, nleft, npos, i, offscale;
+
+    /* Native binary RA Dec pairs in, X Y pairs out; NaN if offscale */
+    if (rawio) {
+	pos = (double *) malloc (NBSTREAM);
+	if (pos == NULL) {
+	    fprintf (stderr, "SKY2XY: Cannot allocate %d-byte buffer\n",
+		     NBSTREAM);
+	    return;
+	    }
+	nleft = 0;
+	while ((nread = fread ((char *) pos + nleft, 1, NBSTREAM - nleft,
+			       fd)) > 0) {
+	    nbuff = nleft + nread;
+	    npos = nbuff / (2 * sizeof (double));
+	    nleft = nbuff - (npos * 2 * sizeof (double));
+	    for (i = 0; i < 2 * npos; i = i + 2) {
+		wcsc2pix (wcs, pos[i], pos[i+1], coorsys, &x, &y, &offscale);
+		if (offscale == 1) {
+		    pos[i] = NAN;
+		    pos[i+1] = NAN;
+		    }
+		else {
+		    pos[i] = x;
+		    pos[i+1] = y;
+		    }
+		}
+	    if (fwrite (pos, 2 * sizeof (double), npos, stdout) < npos) {
+		fprintf (stderr, "SKY2XY: Cannot write output\n");
+		nleft = 0;
+		break;
+		}
+
+	    /* Keep a partial pair for the next read */
+	    if (nleft > 0)
+		memmove (pos, (char *) pos + (nbuff - nleft), nleft);
+	    }
+	if (nleft > 0)
+	    fprintf (stderr, "SKY2XY: Ignoring %d bytes after last RA Dec pair\n",
+		     nleft);
+	free (pos);
+	return;
+	}
+
+    buff = (char *) malloc (NBSTREAM + 1);
+    obuff = (char *) malloc (2 * NBSTREAM + 256);
+    if (buff == NULL || obuff == NULL) {
+	fprintf (stderr, "SKY2XY: Cannot allocate %d-byte buffers\n",
+		 NBSTREAM);
+	if (buff != NULL) free (buff);
+	if (obuff != NULL) free (obuff);
+	return;
+	}
+    op = obuff;
+    nleft = 0;
+    while (1) {
+	nread = fread (buff + nleft, 1, NBSTREAM - nleft, fd);
+	nbuff = nleft + nread;
+	if (nbuff == 0)
+	    break;
+	buff[nbuff] = (char) 0;
+
+	/* Convert through the last complete line, unless the file has ended
+	   or one line fills the buffer */
+	bend = buff + nbuff;
+	if (nread > 0) {
+	    while (bend > buff && *(bend-1) != '\n')
+		bend--;
+	    if (bend == buff)
+		bend = buff + nbuff;
+	    }
+
+	for (line = buff; line < bend; line = lend + 1) {
+	    lend = memchr (line, '\n', bend - line);
+	    if (lend == NULL)
+		lend = bend;
+
+	    /* Skip comments and lines without two coordinates */
+	    cnum = line;
+	    while (cnum < lend && (*cnum == ' ' || *cnum == '\t'))
+		cnum++;
+	    if (cnum == lend || *cnum == '#')
+		continue;
+	    ra = strtor8 (cnum, &cnext);
+	    if (cnext == cnum)
+		continue;
+
+	    /* Read sexagesimal RA the slow way */
+	    if (cnext < lend && *cnext != ' ' && *cnext != '\t' &&
+		*cnext != '\r') {
+		for (i = 0; i < 31 && cnum < lend && *cnum != ' ' &&
+		     *cnum != '\t'; i++)
+		    token[i] = *cnum++;
+		token[i] = (char) 0;
+		ra = str2ra (token);
+		cnext = cnum;
+		}
+	    cnum = cnext;
+	    while (cnum < lend && (*cnum == ' ' || *cnum == '\t'))
+		cnum++;
+	    dec = strtor8 (cnum, &cnext);
+	    if (cnext == cnum)
+		continue;
+	    if (cnext < lend && *cnext != ' ' && *cnext != '\t' &&
+		*cnext != '\r') {
+		for (i = 0; i < 31 && cnum < lend && *cnum != ' ' &&
+		     *cnum != '\t'; i++)
+		    token[i] = *cnum++;
+		token[i] = (char) 0;
+		dec = str2dec (token);
+		}
+
+	    wcsc2pix (wcs, ra, dec, coorsys, &x, &y, &offscale);
+	    op = op + r8tostr (op, x, ndec);
+	    *op++ = ' ';
+	    op = op + r8tostr (op, y, ndec);
+	    if (offscale == 2) {
+		strcpy (op, " (off image)");
+		op = op + 12;
+		}
+	    else if (offscale) {
+		strcpy (op, " (offscale)");
+		op = op + 11;
+		}
+	    *op++ = '\n';
+	    if (op - obuff > NBSTREAM) {
+		fwrite (obuff, 1, op - obuff, stdout);
+		op = obuff;
+		}
+	    }
+
+	/* Keep the partial last line for the next block */
+	if (nread == 0)
+	    break;
+	nleft = nbuff - (bend - buff);
+	if (nleft > 0)
+	    memmove (buff, bend, nleft);
+	}
+    if (op > obuff)
+	fwrite (obuff, 1, op - obuff, stdout);
+    free (buff);
+    free (obuff);
+    return;
+}
+
 static void
 PrintUsage (command)
 char	*command;
@@ -480,7 +667,9 @@ char	*command;
     fprintf (stderr,"  -n num: number of decimal places in output\n");
     fprintf (stderr,"  -o x|y|z: print only x, y, or x and y coordinate\n");
     fprintf (stderr,"  -p scale: plate scale in arcsec/pixel\n");
+    fprintf (stderr,"  -r: @listfile is binary RA Dec doubles; write binary X Y\n");
     fprintf (stderr,"  -s nx ny: size of image in pixels\n");
+    fprintf (stderr,"  -u: read @listfile in blocks and write only X Y\n");
     fprintf (stderr,"  -x x y: reference image position in pixels\n");
     fprintf (stderr,"  -v: verbose\n");
     fprintf (stderr,"  -y date: Epoch as fractional year or FITS date\n");
@@ -555,4 +744,8 @@ char	*command;
  * Sep 24 2013	Use fitswcs.h
  *
  * Jul 22 2015	Add z option to print only x and y coordinates
+ *
+ * Oct 18 2026	Add -u and -r to convert large lists in blocks, as text or binary
+ *
+ * Oct 19 2026	Warn about a partial binary pair at the end of -r input
  */
@@ -1,9 +1,9 @@
 /* File skycoor.c
- * September 27, 2019
+ * October 18, 2026
  * By Jessica Mink, Harvard-Smithsonian Center for Astrophysics
  * Send bug reports to jmink@cfa.harvard.edu
 
-   Copyright (C) 1996-2019
+   Copyright (C) 1996-2026
    Smithsonian Astrophysical Observatory, Cambridge, MA USA
 
    This program is free software; you can redistribute it and/or
@@ -28,12 +28,19 @@
 #include <errno.h>
 #include <unistd.h>
 #include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include "libwcs/wcs.h"
 #include "libwcs/fitsfile.h"
 #include "libwcs/wcscat.h"
 
 static void usage();
 static void skycons();
+static void BatchInit();
+static void BatchCon();
+static void BatchRange();
+static void BatchList();
 extern void s2v3();
 extern void v2s3();
 
@@ -51,6 +58,16 @@ static double decpm = 0.0;	/* Declination proper motion in mas/year */
 static int epset = 0;
 static int inhours = 0;
 
+#define NBBATCH 1048576		/* Bytes of list file read at once in batches */
+#define MAXBCOL 100		/* Last column which can be read in batches */
+static char batchsys[32];	/* Input system for batches of degrees */
+static int binio = 0;		/* If 1, batches are native binary doubles */
+static int batchpm = 0;		/* If 1, batches include proper motions */
+static int nbproc = 1;		/* Number of processes converting batches */
+static int bsys0, bsys1;	/* Batch input and output systems */
+static int brot = 0;		/* If 1, convert batches by rotation matrix */
+static double bmat[9];		/* Batch rotation matrix */
+
 static char *RevMsg = "SKYCOOR WCSTools 3.9.7, 26 April 2022, Jessica Mink (jmink@cfa.harvard.edu)";
 
 int
@@ -155,6 +172,13 @@ char **av;
 	    sys1 = WCS_B1950;
     	    break;
 
+	case 'c':	/* Convert @listfile of degrees from this system */
+	    if (ac < 2)
+		usage("Missing input coordinate system for -c");
+	    strncpy (batchsys, *++av, 31);
+	    ac--;
+    	    break;
+
 	case 'd':	/* Output always in degrees */
 	    degout++;
 	    if (!ndecset)
@@ -257,6 +281,14 @@ char **av;
 		}
 	    break;
 
+	case 'l':	/* Batches of positions are binary doubles */
+	    binio++;
+    	    break;
+
+	case 'm':	/* Batches of positions include proper motions */
+	    batchpm++;
+    	    break;
+
 	case 'n':	/* Number of decimal places in output */
 	    if (ac < 2)
 		usage("Missing number of decimal places for -n");
@@ -474,6 +506,15 @@ char **av;
 	    ac--;
     	    break;
 
+	case 'z':	/* Number of processes converting batches */
+	    if (ac < 2)
+		usage("Missing number of processes for -z");
+	    nbproc = atoi (*++av);
+	    if (nbproc < 1)
+		nbproc = 1;
+	    ac--;
+    	    break;
+
     	default:
 	    if (notnum (str)) {
 		sprintf (errmsg, "Unrecognized command %s\n",str);
@@ -493,6 +534,32 @@ char **av;
 	    ln = listname;
 	    while (*ln++)
 		*(ln-1) = *ln;
+
+	    /* Convert columns of degrees in large batches */
+	    if (*batchsys) {
+		sys0 = wcscsys (batchsys);
+		eqin = wcsceq (batchsys);
+		if (strlen (coorout) > 0)
+		    sys1 = wcscsys (coorout);
+		else if (sys1 < 0) {
+		    if (degout)
+			sys1 = sys0;
+		    else if (sys0 == WCS_J2000)
+			sys1 = WCS_B1950;
+		    else
+			sys1 = WCS_J2000;
+		    }
+		if (strlen (coorout) == 0)
+		    wcscstr (coorout, sys1, 0.0, 0.0);
+		eqout = wcsceq (coorout);
+		if (epout == 0.0)
+		    epout = eqout;
+		BatchInit (sys0, sys1);
+		BatchList (listname, ndecset ? ndec : 6);
+		listname = NULL;
+		av++;
+		continue;
+		}
 	    if ((fd = fopen (listname, "r"))) {
 		if (verbose)
 		    printf (" Reading positions from %s\n", listname);
@@ -745,6 +812,446 @@ int	ndec;		/* Number of decimal places in output RA seconds */
 }
 
 
+/* BATCHINIT -- Set up batch conversion, using one rotation matrix if the
+ * conversion is a pure rotation of the sphere */
+
+static void
+BatchInit (sys0, sys1)
+
+int	sys0;		/* Input coordinate system */
+int	sys1;		/* Output coordinate system */
+{
+    double ra, dec, r, pos[3], err;
+    int i, j, k;
+    static double ra0[3] = {0.0, 90.0, 0.0};
+    static double dec0[3] = {0.0, 0.0, 90.0};
+
+    bsys0 = sys0;
+    bsys1 = sys1;
+    brot = 0;
+
+    /* FK4 conversions include E-terms and proper motions change with
+       position, so only conversions among FK5, ICRS, galactic, and
+       ecliptic coordinates without proper motion are rotations */
+    if (batchpm || sys0 == WCS_B1950 || sys1 == WCS_B1950)
+	return;
+    if (sys0 != WCS_J2000 && sys0 != WCS_ICRS && sys0 != WCS_GALACTIC &&
+	sys0 != WCS_ECLIPTIC)
+	return;
+    if (sys1 != WCS_J2000 && sys1 != WCS_ICRS && sys1 != WCS_GALACTIC &&
+	sys1 != WCS_ECLIPTIC)
+	return;
+
+    /* Columns of the matrix are the converted unit vectors */
+    for (j = 0; j < 3; j++) {
+	ra = ra0[j];
+	dec = dec0[j];
+	wcscon (sys0, sys1, eqin, eqout, &ra, &dec, epout);
+	s2v3 (degrad (ra), degrad (dec), 1.0, pos);
+	for (i = 0; i < 3; i++)
+	    bmat[(3 * i) + j] = pos[i];
+	}
+
+    /* Use the matrix only if it is orthonormal */
+    for (i = 0; i < 3; i++) {
+	for (j = 0; j < 3; j++) {
+	    r = 0.0;
+	    for (k = 0; k < 3; k++)
+		r = r + (bmat[(3 * k) + i] * bmat[(3 * k) + j]);
+	    err = (i == j) ? r - 1.0 : r;
+	    if (err > 1.0e-12 || err < -1.0e-12)
+		return;
+	    }
+	}
+    brot = 1;
+    if (verbose)
+	fprintf (stderr, "SKYCOOR: Converting by rotation matrix\n");
+    return;
+}
+
+
+/* BATCHCON -- Convert one position and proper motion in place */
+
+static void
+BatchCon (ra, dec, pmra, pmdec)
+
+double	*ra;		/* Right ascension or longitude in degrees */
+double	*dec;		/* Declination or latitude in degrees */
+double	*pmra;		/* RA proper motion * cos (Dec) in mas/year */
+double	*pmdec;		/* Dec proper motion in mas/year */
+{
+    double pos[3], pos1[3], rra, rdec, r, cosd;
+
+    if (brot) {
+	s2v3 (degrad (*ra), degrad (*dec), 1.0, pos);
+	pos1[0] = (bmat[0] * pos[0]) + (bmat[1] * pos[1]) + (bmat[2] * pos[2]);
+	pos1[1] = (bmat[3] * pos[0]) + (bmat[4] * pos[1]) + (bmat[5] * pos[2]);
+	pos1[2] = (bmat[6] * pos[0]) + (bmat[7] * pos[1]) + (bmat[8] * pos[2]);
+	v2s3 (pos1, &rra, &rdec, &r);
+	*ra = raddeg (rra);
+	*dec = raddeg (rdec);
+	}
+
+    /* Proper motions in RA degrees per year through wcsconp() */
+    else if (batchpm) {
+	cosd = cosdeg (*dec);
+	*pmra = (cosd > 1.0e-12) ? *pmra / (3600000.0 * cosd) : 0.0;
+	*pmdec = *pmdec / 3600000.0;
+	wcsconp (bsys0, bsys1, eqin, eqout, epin, epout, ra, dec, pmra, pmdec);
+	cosd = cosdeg (*dec);
+	*pmra = *pmra * 3600000.0 * cosd;
+	*pmdec = *pmdec * 3600000.0;
+	}
+    else
+	wcscon (bsys0, bsys1, eqin, eqout, ra, dec, epout);
+
+    if (*ra < 0.0)
+	*ra = *ra + 360.0;
+    else if (*ra >= 360.0)
+	*ra = *ra - 360.0;
+    return;
+}
+
+
+/* BATCHRANGE -- Convert the positions between two offsets in a list file,
+ * reading and writing in large blocks */
+
+static void
+BatchRange (fd, off1, off2, fout, ndec, cols, ntab)
+
+FILE	*fd;		/* List of positions */
+off_t	off1;		/* Offset of first line to convert */
+off_t	off2;		/* Offset after last line to convert, -1 for end */
+FILE	*fout;		/* Output file */
+int	ndec;		/* Number of decimal places in output degrees */
+int	*cols;		/* Columns of RA, Dec, and RA and Dec proper motions */
+int	ntab;		/* 1 if columns are separated by tabs only */
+{
+    char *buff, *obuff, *line, *lend, *bend, *cnum, *cnext, *op;
+    char *field[MAXBCOL+1];
+    char sep;
+    double val[4];
+    int nread, nbuff, nleft, nval, nmax, i, nf, nrec, nwant;
+    off_t nbrem;
+
+    nval = batchpm ? 4 : 2;
+    if (fseeko (fd, off1, SEEK_SET)) {
+	fprintf (stderr, "SKYCOOR: Cannot seek to %lld in list\n",
+		 (long long) off1);
+	return;
+	}
+    nbrem = (off2 < 0) ? -1 : off2 - off1;
+
+    /* Binary records of RA, Dec, and proper motions in and out */
+    if (binio) {
+	double *rec = (double *) malloc (NBBATCH);
+	if (rec == NULL) {
+	    fprintf (stderr, "SKYCOOR: Cannot allocate %d-byte buffer\n",
+		     NBBATCH);
+	    return;
+	    }
+	nmax = NBBATCH / (nval * sizeof (double));
+	while (nbrem != 0) {
+	    nwant = nmax;
+	    if (nbrem > 0 && nbrem / (off_t) (nval * sizeof (double)) < nwant)
+		nwant = (int) (nbrem / (off_t) (nval * sizeof (double)));
+	    if (nwant < 1 || (nrec = fread (rec, nval * sizeof (double),
+					    nwant, fd)) < 1)
+		break;
+	    for (i = 0; i < nrec * nval; i = i + nval) {
+		if (batchpm)
+		    BatchCon (&rec[i], &rec[i+1], &rec[i+2], &rec[i+3]);
+		else
+		    BatchCon (&rec[i], &rec[i+1], &val[2], &val[3]);
+		}
+	    fwrite (rec, nval * sizeof (double), nrec, fout);
+	    if (nbrem > 0)
+		nbrem = nbrem - (nrec * nval * sizeof (double));
+	    }
+	free (rec);
+	return;
+	}
+
+    buff = (char *) malloc (NBBATCH + 1);
+    obuff = (char *) malloc (2 * NBBATCH + 256);
+    if (buff == NULL || obuff == NULL) {
+	fprintf (stderr, "SKYCOOR: Cannot allocate %d-byte buffers\n", NBBATCH);
+	if (buff != NULL) free (buff);
+	if (obuff != NULL) free (obuff);
+	return;
+	}
+    nf = 0;
+    for (i = 0; i < nval; i++) {
+	if (cols[i] > nf)
+	    nf = cols[i];
+	}
+    sep = ntab ? '\t' : ' ';
+    op = obuff;
+    nleft = 0;
+    while (1) {
+	nwant = NBBATCH - nleft;
+	if (nbrem >= 0 && nbrem < nwant)
+	    nwant = (int) nbrem;
+	nread = (nwant > 0) ? fread (buff + nleft, 1, nwant, fd) : 0;
+	if (nbrem > 0)
+	    nbrem = nbrem - nread;
+	nbuff = nleft + nread;
+	if (nbuff == 0)
+	    break;
+	buff[nbuff] = (char) 0;
+
+	/* Convert through the last complete line, unless the range has
+	   ended or one line fills the buffer */
+	bend = buff + nbuff;
+	if (nread > 0) {
+	    while (bend > buff && *(bend-1) != '\n')
+		bend--;
+	    if (bend == buff)
+		bend = buff + nbuff;
+	    }
+
+	for (line = buff; line < bend; line = lend + 1) {
+	    lend = memchr (line, '\n', bend - line);
+	    if (lend == NULL)
+		lend = bend;
+	    if (*line == '#')
+		continue;
+
+	    /* Find the start of each field up to the last one needed */
+	    cnum = line;
+	    for (i = 1; i <= nf; i++) {
+		if (!ntab) {
+		    while (cnum < lend && (*cnum == ' ' || *cnum == '\t'))
+			cnum++;
+		    }
+		if (cnum >= lend)
+		    break;
+		field[i] = cnum;
+		while (cnum < lend && *cnum != '\t' && (ntab || *cnum != ' '))
+		    cnum++;
+		if (ntab && cnum < lend)
+		    cnum++;
+		}
+
+	    /* Skip lines without all of the numbers */
+	    if (i <= nf)
+		continue;
+	    for (i = 0; i < nval; i++) {
+		val[i] = strtor8 (field[cols[i]], &cnext);
+		if (cnext == field[cols[i]] || (cnext < lend && *cnext != ' ' &&
+		    *cnext != '\t' && *cnext != '\r'))
+		    break;
+		}
+	    if (i < nval)
+		continue;
+
+	    BatchCon (&val[0], &val[1], &val[2], &val[3]);
+	    op = op + r8tostr (op, val[0], ndec);
+	    *op++ = sep;
+	    op = op + r8tostr (op, val[1], ndec);
+	    if (batchpm) {
+		*op++ = sep;
+		op = op + r8tostr (op, val[2], 3);
+		*op++ = sep;
+		op = op + r8tostr (op, val[3], 3);
+		}
+	    *op++ = '\n';
+	    if (op - obuff > NBBATCH) {
+		fwrite (obuff, 1, op - obuff, fout);
+		op = obuff;
+		}
+	    }
+
+	/* Keep the partial last line for the next block */
+	if (nread == 0)
+	    break;
+	nleft = nbuff - (bend - buff);
+	if (nleft > 0)
+	    memmove (buff, bend, nleft);
+	}
+    if (op > obuff)
+	fwrite (obuff, 1, op - obuff, fout);
+    free (buff);
+    free (obuff);
+    return;
+}
+
+
+/* BATCHLIST -- Convert a list of positions in degrees, splitting a file
+ * into ranges of lines converted by separate processes if nbproc > 1 */
+
+static void
+BatchList (listname, ndec)
+
+char	*listname;	/* Name of list file, or stdin */
+int	ndec;		/* Number of decimal places in output degrees */
+{
+    FILE *fd, **fwork;
+    struct TabTable *tabtable;
+    pid_t *pids;
+    off_t off0, fsize, *offs;
+    int cols[4];
+    int ntab, nrec, iproc, nproc, status, nr, i;
+    FILE *fdw;
+    char *buff;
+    struct stat st;
+
+    cols[0] = 1;
+    cols[1] = 2;
+    cols[2] = 3;
+    cols[3] = 4;
+    ntab = 0;
+    off0 = 0;
+
+    /* Find columns by name in a tab table */
+    if (!binio && strcmp (listname, "stdin") && istab (listname)) {
+	if ((tabtable = tabopen (listname, 1)) == NULL) {
+	    fprintf (stderr, "SKYCOOR: Cannot read tab table %s\n", listname);
+	    return;
+	    }
+	ntab = 1;
+	cols[0] = tabccol (tabtable, "ra");
+	cols[1] = tabccol (tabtable, "dec");
+	if (batchpm) {
+	    if (!(cols[2] = tabccol (tabtable, "rapm")))
+		cols[2] = tabccol (tabtable, "pmra");
+	    if (!(cols[3] = tabccol (tabtable, "decpm")))
+		cols[3] = tabccol (tabtable, "pmdec");
+	    }
+	off0 = (off_t) tabtable->lhead;
+	tabclose (tabtable);
+	if (cols[0] < 1 || cols[1] < 1 || (batchpm && (cols[2] < 1 ||
+	    cols[3] < 1))) {
+	    fprintf (stderr, "SKYCOOR: No ra and dec%s columns in %s\n",
+		     batchpm ? " or proper motion" : "", listname);
+	    return;
+	    }
+	printf ("ra	dec");
+	if (batchpm)
+	    printf ("	rapm	decpm");
+	printf ("\n---------	---------");
+	if (batchpm)
+	    printf ("	-------	-------");
+	printf ("\n");
+	}
+    if (cols[0] > MAXBCOL || cols[1] > MAXBCOL || cols[2] > MAXBCOL ||
+	cols[3] > MAXBCOL) {
+	fprintf (stderr, "SKYCOOR: Columns past %d in %s cannot be read\n",
+		 MAXBCOL, listname);
+	return;
+	}
+
+    if (!strcmp (listname, "stdin"))
+	fd = stdin;
+    else if ((fd = fopen (listname, "r")) == NULL) {
+	fprintf (stderr, "SKYCOOR: Cannot read file %s\n", listname);
+	return;
+	}
+    fflush (stdout);
+
+    /* Standard input and short files are converted in one piece */
+    nproc = nbproc;
+    fsize = 0;
+    if (fd == stdin || fstat (fileno (fd), &st) || !S_ISREG (st.st_mode))
+	nproc = 1;
+    else
+	fsize = st.st_size;
+    if (fsize - off0 < (off_t) nproc * NBBATCH)
+	nproc = (int) ((fsize - off0) / NBBATCH) + 1;
+    if (nproc < 2) {
+	BatchRange (fd, off0, (off_t) -1, stdout, ndec, cols, ntab);
+	if (fd != stdin)
+	    fclose (fd);
+	fflush (stdout);
+	return;
+	}
+
+    /* Start each range at the beginning of a line or binary record */
+    offs = (off_t *) calloc (nproc + 1, sizeof (off_t));
+    pids = (pid_t *) calloc (nproc, sizeof (pid_t));
+    fwork = (FILE **) calloc (nproc, sizeof (FILE *));
+    buff = (char *) malloc (NBBATCH);
+    nrec = (batchpm ? 4 : 2) * sizeof (double);
+    offs[0] = off0;
+    offs[nproc] = fsize;
+    for (iproc = 1; iproc < nproc; iproc++) {
+	offs[iproc] = off0 + ((fsize - off0) / nproc) * iproc;
+	if (binio)
+	    offs[iproc] = offs[iproc] - ((offs[iproc] - off0) % nrec);
+	else {
+	    fseeko (fd, offs[iproc], SEEK_SET);
+	    nr = fread (buff, 1, NBBATCH, fd);
+	    for (i = 0; i < nr && buff[i] != '\n'; i++);
+	    offs[iproc] = offs[iproc] + i + 1;
+	    if (offs[iproc] > fsize)
+		offs[iproc] = fsize;
+	    }
+	}
+    free (buff);
+
+    /* Each process reopens the list, which does not share its offset,
+       and writes its range to a temporary file, so no range's output
+       has to be held in memory until the ranges before it are written */
+    for (iproc = 0; iproc < nproc; iproc++) {
+	pids[iproc] = -1;
+	if ((fwork[iproc] = tmpfile ()) == NULL) {
+	    fprintf (stderr, "SKYCOOR: Cannot open temporary file\n");
+	    continue;
+	    }
+	if ((pids[iproc] = fork ()) < 0) {
+	    fprintf (stderr, "SKYCOOR: Cannot start process %d\n", iproc);
+	    fclose (fwork[iproc]);
+	    fwork[iproc] = NULL;
+	    }
+	else if (pids[iproc] == 0) {
+	    if ((fdw = fopen (listname, "r")) == NULL) {
+		fprintf (stderr, "SKYCOOR: Process %d cannot read file %s\n",
+			 iproc, listname);
+		_exit (1);
+		}
+	    BatchRange (fdw, offs[iproc], offs[iproc+1], fwork[iproc],
+			ndec, cols, ntab);
+	    if (fflush (fwork[iproc]) != 0)
+		_exit (1);
+	    _exit (0);
+	    }
+	}
+
+    /* Copy the converted ranges to standard output in order, converting
+       any range without a process, or whose process failed, here */
+    buff = (char *) malloc (NBBATCH);
+    for (iproc = 0; iproc < nproc; iproc++) {
+	if (pids[iproc] < 0) {
+	    BatchRange (fd, offs[iproc], offs[iproc+1], stdout, ndec,
+			cols, ntab);
+	    fflush (stdout);
+	    continue;
+	    }
+	if (waitpid (pids[iproc], &status, 0) < 0 ||
+	    !WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+	    fprintf (stderr, "SKYCOOR: Process %d failed; converting its range here\n",
+		     iproc);
+	    fclose (fwork[iproc]);
+	    BatchRange (fd, offs[iproc], offs[iproc+1], stdout, ndec,
+			cols, ntab);
+	    fflush (stdout);
+	    continue;
+	    }
+	rewind (fwork[iproc]);
+	while ((nr = fread (buff, 1, NBBATCH, fwork[iproc])) > 0)
+	    fwrite (buff, 1, nr, stdout);
+	fclose (fwork[iproc]);
+	}
+    fflush (stdout);
+    free (buff);
+    free (offs);
+    free (pids);
+    free (fwork);
+    fclose (fd);
+    return;
+}
+
+
 static void
 usage (errstring)
 char *errstring;
@@ -763,6 +1270,7 @@ char *errstring;
     fprintf (stderr,"sysn: B1950 or FK4, J2000 or FK5, equinox epoch, galactic, ecliptic\n");
     fprintf (stderr,"  -a ra dec ra dec: Position angle (N->E) between two RA, Dec pairs\n");
     fprintf (stderr,"  -b: B1950 (FK4) output\n");
+    fprintf (stderr,"  -c sys: Convert @listfile of degrees from sys in batches\n");
     fprintf (stderr,"  -d: RA and Dec output in degrees\n");
     fprintf (stderr,"  -e: Ecliptic longitude and latitude output\n");
     fprintf (stderr,"  -f file: File of coordinates (one position per line) to convert\n");
@@ -771,6 +1279,8 @@ char *errstring;
     fprintf (stderr,"  -i code: Input units (r=radians, d=degrees, ...\n");
     fprintf (stderr,"  -j: J2000 (FK5) output\n");
     fprintf (stderr,"  -k ra dec ra dec: Return separate RA and DEC angular differences\n");
+    fprintf (stderr,"  -l: -c @listfile is binary doubles, as is output\n");
+    fprintf (stderr,"  -m: -c @listfile has RA*cos(Dec) and Dec proper motions in mas/yr\n");
     fprintf (stderr,"  -n num: Number of decimal places in output RA seconds\n");
     fprintf (stderr,"  -o num1[,num2] : Add arcseconds to position (both same if 1 arg)\n");
     fprintf (stderr,"  -p rapm decpm: RA and Dec proper motion in milliarcseconds/year\n");
@@ -782,6 +1292,7 @@ char *errstring;
     fprintf (stderr,"  -w: Convert RA, Dec equatorial coordinates to x,y,z\n");
     fprintf (stderr,"  -x: Convert x,y,z equatorial coordinates to RA, Dec\n");
     fprintf (stderr,"  -y date: Epoch of coordinates in years\n");
+    fprintf (stderr,"  -z num: Number of processes converting -c batches\n");
     exit (1);
 }
 /* Oct 30 1996	New program
@@ -849,4 +1360,9 @@ char *errstring;
  * Aug 17 2011	Allow 99 in input list file for longitudes and RA
  *
  * Sep 27 2011	Add -k to return separate RA and DEC differences
+ *
+ * Oct 18 2026	Add -c to convert lists of degrees in batches, with -l for binary
+ * Oct 18 2026	Add -m for batch proper motions and -z for parallel processes
+ *
+ * Oct 19 2026	Convert a range here if its -z process fails
  */
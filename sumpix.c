@@ -1,9 +1,9 @@
 /* File sumpix.c
- * June 9, 2016
+ * October 19, 2026
  * By Jessica Mink Harvard-Smithsonian Center for Astrophysics)
  * Send bug reports to jmink@cfa.harvard.edu
 
-   Copyright (C) 1999-2016
+   Copyright (C) 1999-2026
    Smithsonian Astrophysical Observatory, Cambridge, MA USA
 
    This program is free software; you can redistribute it and/or
@@ -28,6 +28,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <math.h>
+#include <pthread.h>
 #include "libwcs/wcs.h"
 #include "libwcs/fitsfile.h"
 #include "libwcs/wcscat.h"
@@ -35,8 +36,57 @@
 #define MAXFILES 2000
 static int maxnfile = MAXFILES;
 
+#define REG_BOX 1	/* Region is a box between column and row limits */
+#define REG_CIRCLE 2	/* Region is a circle around a center */
+#define MAXPCT 20	/* Maximum number of percentiles */
+
+/* Running statistics of some or all pixels of a region */
+struct StatSum {
+    int n;		/* Number of pixels */
+    double mean;	/* Mean pixel value */
+    double m2;		/* Sum of squared differences from mean */
+    double dmin;	/* Minimum pixel value */
+    double dmax;	/* Maximum pixel value */
+};
+
+/* Region of an image over which statistics are computed */
+struct StatRegion {
+    int type;		/* REG_BOX or REG_CIRCLE */
+    char name[64];	/* Region as it is printed */
+    double xc, yc;	/* Center of circle in pixels */
+    double r;		/* Radius of circle in pixels */
+    int x1, x2;		/* First and last column of bounding box */
+    int y1, y2;		/* First and last row of bounding box */
+    int *rowoff;	/* Offset of pixels of each row in vals */
+    double *vals;	/* Pixel values for percentiles */
+    struct StatSum stat; /* Statistics of all pixels */
+};
+
+/* Image and regions shared by threads */
+struct StatJob {
+    char *image;	/* Image pixels */
+    int bitpix;		/* FITS bits per pixel */
+    double bzero;	/* Zero point for pixel scaling */
+    double bscale;	/* Scale factor for pixel scaling */
+    int xdim;		/* Number of columns */
+    int x1, x2;		/* First and last column in any region */
+    int y2;		/* Last row in any region */
+    int nreg;		/* Number of regions */
+    struct StatRegion *regs; /* Regions */
+    struct StatSum *sums; /* Statistics of each region for each thread */
+    int nextrow;	/* First row of next band */
+    int nextthread;	/* Index of next thread to start */
+    pthread_mutex_t lock; /* Lock for nextrow and nextthread */
+};
+
 static void usage();
 static void SumPix();
+static void StatPix();
+static int SetRegion();
+static int RegionSpan();
+static void *StatRows();
+static void StatAdd();
+static double SelectPix();
 extern double PhotPix();
 
 static char *RevMsg = "SUMPIX WCSTools 3.9.7, 26 April 2022, Jessica Mink (jmink@cfa.harvard.edu)";
@@ -58,6 +108,14 @@ static char *ystr;	/* Y coordinate of center of aperture */
 static double rad;	/* Radius of aperture in pixels */
 static int printfile = 0;/* If 1, print file name at start of line */
 static int ndec = -1;	/* Number of decimal places in outout */
+static char *rstr;	/* Radius of aperture as entered */
+static int compstat = 0; /* If 1, compute region statistics */
+static int nthreads = 1; /* Number of threads computing statistics */
+static int nrband = 32;	/* Number of rows per band claimed by a thread */
+static int nregspec = 0; /* Number of regions for statistics */
+static char **regspec[3]; /* x, y, and radius strings for each region */
+static double pcts[MAXPCT]; /* Percentiles to compute */
+static int npct = 0;	/* Number of percentiles to compute */
 
 int
 main (ac, av)
@@ -74,6 +132,11 @@ char **av;
     char *rrange;	/* Row range string */
     char *crange;	/* Column range string */
     char *zrange;
+    char *regfile = NULL;	/* File of regions for statistics */
+    char line[256];
+    char rx[64], ry[64], rr[64];
+    char *pstr;
+    int i, ntok;
 
     int nfile = 0;
 
@@ -107,7 +170,8 @@ char **av;
 		    ac--;
 		    ystr = *++av;
 		    ac--;
-		    rad = atof (*++av);
+		    rstr = *++av;
+		    rad = atof (rstr);
 		    ac--;
 		    compstd++;
 		    break;
@@ -120,6 +184,14 @@ char **av;
 		    compmed++;
 		    break;
 
+		case 'g':	/* Compute statistics in regions from file */
+		    if (ac < 2)
+			usage();
+		    regfile = *++av;
+		    ac--;
+		    compstat++;
+		    break;
+
 		case 'h':	/* Print column headers for output values */
 		    printhead++;
 		    break;
@@ -128,6 +200,15 @@ char **av;
 		    printindex++;
 		    break;
 
+		case 'j':	/* Number of threads */
+		    if (ac < 2)
+			usage();
+		    nthreads = (int) atof (*++av);
+		    if (nthreads < 1)
+			nthreads = 1;
+		    ac--;
+		    break;
+
 		case 'l':	/* Compute limits */
 		    complim++;
 		    break;
@@ -147,6 +228,10 @@ char **av;
 		    printfile++;
 		    break;
 
+		case 'q':	/* Compute region statistics */
+		    compstat++;
+		    break;
+
 		case 'r':	/* Compute variance */
 		    compvar++;
 		    break;
@@ -155,6 +240,18 @@ char **av;
 		    compsum++;
 		    break;
 
+		case 'u':	/* Percentiles to compute */
+		    if (ac < 2)
+			usage();
+		    pstr = strtok (*++av, ",");
+		    while (pstr != NULL && npct < MAXPCT) {
+			pcts[npct++] = atof (pstr);
+			pstr = strtok (NULL, ",");
+			}
+		    ac--;
+		    compstat++;
+		    break;
+
 		case 't':	/* Tab-separate values */
 		    printtab++;
 		    printhead++;
@@ -202,6 +299,62 @@ char **av;
     if (!compmean && !compvar && !compstd)
 	compsum++;
 
+    /* Set regions for statistics */
+    if (compstat) {
+	if (compmed && npct < MAXPCT) {
+	    for (i = 0; i < npct; i++) {
+		if (pcts[i] == 50.0)
+		    break;
+		}
+	    if (i == npct)
+		pcts[npct++] = 50.0;
+	    }
+	for (i = 0; i < npct; i++) {
+	    if (pcts[i] < 0.0 || pcts[i] > 100.0) {
+		fprintf (stderr,"SUMPIX: Percentile %g not between 0 and 100\n",
+			 pcts[i]);
+		exit (1);
+		}
+	    }
+	if (regfile != NULL) {
+	    nregspec = getfilelines (regfile);
+	    if ((flist = fopen (regfile, "r")) == NULL) {
+		fprintf (stderr,"SUMPIX: Region file %s cannot be read\n",
+			 regfile);
+		exit (1);
+		}
+	    }
+	else
+	    nregspec = 1;
+	for (i = 0; i < 3; i++)
+	    regspec[i] = (char **) calloc (nregspec, sizeof (char *));
+	if (regfile != NULL) {
+	    nregspec = 0;
+	    while (fgets (line, 256, flist) != NULL) {
+		if (line[0] == '#')
+		    continue;
+		ntok = sscanf (line, "%63s %63s %63s", rx, ry, rr);
+		if (ntok < 2)
+		    continue;
+		regspec[0][nregspec] = strdup (rx);
+		regspec[1][nregspec] = strdup (ry);
+		if (ntok > 2)
+		    regspec[2][nregspec] = strdup (rr);
+		nregspec++;
+		}
+	    fclose (flist);
+	    }
+	else if (xstr != NULL) {
+	    regspec[0][0] = xstr;
+	    regspec[1][0] = ystr;
+	    regspec[2][0] = rstr;
+	    }
+	else {
+	    regspec[0][0] = crange;
+	    regspec[1][0] = rrange;
+	    }
+	}
+
     /* Process files from listfile one at a time */
     if (listfile && isimlist (listfile)) {
 	nfile = getfilelines (listfile);
@@ -235,18 +388,23 @@ usage ()
 	exit (-1);
     fprintf (stderr,"Sum row, column, or region of a FITS or IRAF image\n");
     fprintf(stderr,"Usage: sumpix [-dmrsv][-n num] x_range  y_range file.fit ...\n");
+    fprintf(stderr,"  or : sumpix -q|-g file [-u pct,...][-j num] [x_range y_range] file.fit ...\n");
     fprintf(stderr,"  -c x y r: Compute total counts in circle r from (x,y)\n");
     fprintf(stderr,"  -d: Compute and print standard deviation\n");
     fprintf(stderr,"  -e: Compute and print median\n");
+    fprintf(stderr,"  -g file: Compute statistics in boxes (x_range y_range) or circles (x y r) in file\n");
     fprintf(stderr,"  -h: Print column headers for output values\n");
     fprintf(stderr,"  -i: Print row or column number if other is 0\n");
+    fprintf(stderr,"  -j num: Compute statistics in num threads\n");
     fprintf(stderr,"  -l: Compute and print min and max values\n");
     fprintf(stderr,"  -m: Compute and print mean\n");
     fprintf(stderr,"  -n: Number of decimal places in output\n");
     fprintf(stderr,"  -p: Print file name at start of line\n");
+    fprintf(stderr,"  -q: Compute number, mean, stdev, min, and max of box or -c circle\n");
     fprintf(stderr,"  -r: Compute and print variance (sum of squares)\n");
     fprintf(stderr,"  -s: Compute and print sum (default)\n");
     fprintf(stderr,"  -t: Separate output values with tabs and add column headers\n");
+    fprintf(stderr,"  -u p1,p2...: Also compute percentiles with -q or -g (-e adds 50)\n");
     fprintf(stderr,"  -v: Verbose\n");
     fprintf(stderr,"  a range of 0 implies the full dimension\n");
     fprintf(stderr,"  an absence of ranges uses the entire image\n");
@@ -361,6 +519,14 @@ char *rrange;	/* Row range string */
     bscale = 1.0;
     hgetr8 (header,"BSCALE",&bscale);
 
+    /* Compute statistics in one pass over the rows of all regions */
+    if (compstat) {
+	StatPix (name, header, image, bitpix, xdim, ydim, bzero, bscale);
+	free (header);
+	free (image);
+	return;
+	}
+
     if (printfile)
 	printf ("%s ", name);
 
@@ -813,6 +979,523 @@ char *rrange;	/* Row range string */
     free (image);
     return;
 }
+
+/* Compute statistics of pixels in all regions of one image */
+
+static void
+StatPix (name, header, image, bitpix, xdim, ydim, bzero, bscale)
+
+char	*name;		/* Image file name */
+char	*header;	/* FITS image header */
+char	*image;		/* Image pixels */
+int	bitpix;		/* FITS bits per pixel */
+int	xdim, ydim;	/* Image dimensions in pixels */
+double	bzero;		/* Zero point for pixel scaling */
+double	bscale;		/* Scale factor for pixel scaling */
+{
+    struct StatRegion *regs, *reg;
+    struct StatSum *sum;
+    struct StatJob job;
+    struct WorldCoor *wcs = NULL;
+    pthread_t *threads;
+    char numform[16];
+    char sep;
+    double pos, frac, dpix, dpix1;
+    int ireg, nreg, ithread, ipct, n, k, i;
+
+    if (ndec > -1)
+	snprintf (numform, sizeof (numform), "%%.%df", ndec);
+    else
+	sprintf (numform, "%%.2f");
+    if (printtab)
+	sep = '\t';
+    else
+	sep = ' ';
+
+    /* Set pixel limits of each region */
+    regs = (struct StatRegion *) calloc (nregspec, sizeof (struct StatRegion));
+    if (regs == NULL) {
+	fprintf (stderr, "SUMPIX: Cannot allocate %d regions\n", nregspec);
+	return;
+	}
+    nreg = 0;
+    for (ireg = 0; ireg < nregspec; ireg++) {
+	if (SetRegion (name, header, &wcs, regspec[0][ireg], regspec[1][ireg],
+		       regspec[2][ireg], xdim, ydim, &regs[nreg]))
+	    nreg++;
+	}
+    if (wcs != NULL)
+	wcsfree (wcs);
+
+    /* Allocate space for pixel values if percentiles are wanted */
+    job.x1 = xdim + 1;
+    job.x2 = 0;
+    job.nextrow = ydim;
+    job.y2 = 0;
+    for (ireg = 0; ireg < nreg; ireg++) {
+	reg = &regs[ireg];
+	if (reg->y2 < reg->y1)
+	    continue;
+	if (reg->x1 < job.x1)
+	    job.x1 = reg->x1;
+	if (reg->x2 > job.x2)
+	    job.x2 = reg->x2;
+	if (reg->y1 - 1 < job.nextrow)
+	    job.nextrow = reg->y1 - 1;
+	if (reg->y2 > job.y2)
+	    job.y2 = reg->y2;
+	if (npct > 0) {
+	    n = reg->rowoff[reg->y2 - reg->y1 + 1];
+	    reg->vals = (double *) calloc (n + 1, sizeof (double));
+	    if (reg->vals == NULL) {
+		fprintf (stderr, "SUMPIX: Cannot allocate %d values for %s\n",
+			 n, reg->name);
+		}
+	    }
+	}
+
+    /* Compute statistics of bands of rows in as many threads as requested */
+    job.image = image;
+    job.bitpix = bitpix;
+    job.bzero = bzero;
+    job.bscale = bscale;
+    job.xdim = xdim;
+    job.nreg = nreg;
+    job.regs = regs;
+    job.nextthread = 0;
+    job.sums = (struct StatSum *) calloc (nthreads * nreg + 1,
+					  sizeof (struct StatSum));
+    pthread_mutex_init (&job.lock, NULL);
+    if (nthreads > 1) {
+	threads = (pthread_t *) calloc (nthreads, sizeof (pthread_t));
+	for (ithread = 0; ithread < nthreads; ithread++) {
+	    if (pthread_create (&threads[ithread], NULL, StatRows,
+				(void *) &job))
+		break;
+	    }
+	if (ithread == 0)
+	    (void) StatRows ((void *) &job);
+	while (ithread-- > 0)
+	    pthread_join (threads[ithread], NULL);
+	free (threads);
+	}
+    else
+	(void) StatRows ((void *) &job);
+    pthread_mutex_destroy (&job.lock);
+
+    /* Combine statistics from all threads */
+    for (ireg = 0; ireg < nreg; ireg++) {
+	reg = &regs[ireg];
+	for (ithread = 0; ithread < job.nextthread; ithread++) {
+	    sum = job.sums + (ithread * nreg) + ireg;
+	    StatAdd (&reg->stat, sum->n, sum->mean, sum->m2, sum->dmin,
+		     sum->dmax);
+	    }
+	}
+
+    /* Print column headings */
+    if (printhead) {
+	if (printfile)
+	    printf ("file%c", sep);
+	printf ("region%cnpix%cmean%cstdev%cmin%cmax", sep,sep,sep,sep,sep);
+	for (ipct = 0; ipct < npct; ipct++)
+	    printf ("%cp%g", sep, pcts[ipct]);
+	printf ("\n");
+	if (printtab) {
+	    if (printfile)
+		printf ("----\t");
+	    printf ("------\t----\t----\t-----\t---\t---");
+	    for (ipct = 0; ipct < npct; ipct++)
+		printf ("\t---");
+	    printf ("\n");
+	    }
+	}
+
+    /* Print statistics and percentiles of each region */
+    for (ireg = 0; ireg < nreg; ireg++) {
+	reg = &regs[ireg];
+	n = reg->stat.n;
+	if (printfile)
+	    printf ("%s%c", name, sep);
+	printf ("%s%c%d", reg->name, sep, n);
+	if (n < 1) {
+	    for (i = 0; i < 4 + npct; i++)
+		printf ("%c-", sep);
+	    printf ("\n");
+	    continue;
+	    }
+	printf ("%c", sep);
+	printf (numform, reg->stat.mean);
+	printf ("%c", sep);
+	printf (numform, sqrt (reg->stat.m2 / (double) n));
+	printf ("%c", sep);
+	printf (numform, reg->stat.dmin);
+	printf ("%c", sep);
+	printf (numform, reg->stat.dmax);
+
+	/* Select order statistics instead of sorting all values */
+	for (ipct = 0; ipct < npct; ipct++) {
+	    printf ("%c", sep);
+	    if (reg->vals == NULL) {
+		printf ("-");
+		continue;
+		}
+	    pos = pcts[ipct] * 0.01 * (double) (n - 1);
+	    k = (int) pos;
+	    frac = pos - (double) k;
+	    dpix = SelectPix (reg->vals, n, k);
+
+	    /* Next value is the smallest of those above the k'th */
+	    if (frac > 0.0 && k < n - 1) {
+		dpix1 = reg->vals[k+1];
+		for (i = k + 2; i < n; i++) {
+		    if (reg->vals[i] < dpix1)
+			dpix1 = reg->vals[i];
+		    }
+		dpix = dpix + frac * (dpix1 - dpix);
+		}
+	    printf (numform, dpix);
+	    }
+	printf ("\n");
+	}
+
+    for (ireg = 0; ireg < nreg; ireg++) {
+	if (regs[ireg].vals != NULL)
+	    free (regs[ireg].vals);
+	if (regs[ireg].rowoff != NULL)
+	    free (regs[ireg].rowoff);
+	}
+    free (job.sums);
+    free (regs);
+    return;
+}
+
+
+/* Set the pixel limits of a box or circle in an image */
+
+static int
+SetRegion (name, header, wcs, xs, ys, rs, xdim, ydim, reg)
+
+char	*name;		/* Image file name */
+char	*header;	/* FITS image header */
+struct WorldCoor **wcs;	/* World coordinate system, set if needed */
+char	*xs;		/* Column range or center column or right ascension */
+char	*ys;		/* Row range or center row or declination */
+char	*rs;		/* Radius in pixels, or NULL for a box */
+int	xdim, ydim;	/* Image dimensions in pixels */
+struct StatRegion *reg;	/* Region (returned) */
+{
+    struct WorldCoor *GetWCSFITS();
+    struct Range *range;
+    int offscl, y, ny, xa, xb;
+
+    reg->stat.n = 0;
+    reg->vals = NULL;
+    reg->rowoff = NULL;
+
+    /* Box between column and row limits */
+    if (rs == NULL) {
+	reg->type = REG_BOX;
+	if (!strcmp (xs, "0")) {
+	    reg->x1 = 1;
+	    reg->x2 = xdim;
+	    }
+	else {
+	    range = RangeInit (xs, xdim);
+	    reg->x1 = (int) range->valmin;
+	    reg->x2 = (int) range->valmax;
+	    free (range);
+	    }
+	if (!strcmp (ys, "0")) {
+	    reg->y1 = 1;
+	    reg->y2 = ydim;
+	    }
+	else {
+	    range = RangeInit (ys, ydim);
+	    reg->y1 = (int) range->valmin;
+	    reg->y2 = (int) range->valmax;
+	    free (range);
+	    }
+	if (strlen (xs) + strlen (ys) < 62)
+	    snprintf (reg->name, sizeof (reg->name), "%s,%s", xs, ys);
+	else
+	    snprintf (reg->name, sizeof (reg->name), "%d-%d,%d-%d",
+		      reg->x1, reg->x2, reg->y1, reg->y2);
+	}
+
+    /* Circle around a center given in pixels or world coordinates */
+    else {
+	reg->type = REG_CIRCLE;
+	if (strchr (xs, ':') != NULL || strchr (ys, ':') != NULL) {
+	    if (*wcs == NULL)
+		*wcs = GetWCSFITS (name, header, verbose);
+	    if (nowcs (*wcs)) {
+		fprintf (stderr, "SUMPIX: No WCS in %s for %s %s\n", name, xs, ys);
+		return (0);
+		}
+	    wcs2pix (*wcs, str2ra (xs), str2dec (ys), &reg->xc, &reg->yc,
+		     &offscl);
+	    }
+	else {
+	    reg->xc = atof (xs);
+	    reg->yc = atof (ys);
+	    }
+	reg->r = atof (rs);
+	reg->x1 = (int) ceil (reg->xc - reg->r);
+	reg->x2 = (int) floor (reg->xc + reg->r);
+	reg->y1 = (int) ceil (reg->yc - reg->r);
+	reg->y2 = (int) floor (reg->yc + reg->r);
+	if (strlen (xs) + strlen (ys) + strlen (rs) < 61)
+	    snprintf (reg->name, sizeof (reg->name), "%s,%s,%s", xs, ys, rs);
+	else
+	    snprintf (reg->name, sizeof (reg->name), "%.3f,%.3f,%s",
+		      reg->xc, reg->yc, rs);
+	}
+
+    /* Keep region within image */
+    if (reg->x1 < 1)
+	reg->x1 = 1;
+    if (reg->x2 > xdim)
+	reg->x2 = xdim;
+    if (reg->y1 < 1)
+	reg->y1 = 1;
+    if (reg->y2 > ydim)
+	reg->y2 = ydim;
+    if (reg->x2 < reg->x1)
+	reg->y2 = 0;
+
+    /* Find where the pixels of each row start in the list of values */
+    ny = reg->y2 - reg->y1 + 1;
+    if (ny < 0)
+	ny = 0;
+    reg->rowoff = (int *) calloc (ny + 1, sizeof (int));
+    if (reg->rowoff == NULL) {
+	fprintf (stderr, "SUMPIX: Cannot allocate rows for %s\n", reg->name);
+	return (0);
+	}
+    for (y = 0; y < ny; y++)
+	reg->rowoff[y+1] = reg->rowoff[y] +
+			   RegionSpan (reg, reg->y1 + y, &xa, &xb);
+    return (1);
+}
+
+
+/* Return number and first and last columns of region pixels in a row */
+
+static int
+RegionSpan (reg, y, xa, xb)
+
+struct StatRegion *reg;	/* Region */
+int	y;		/* One-based row */
+int	*xa, *xb;	/* First and last one-based columns (returned) */
+{
+    double dy2, r2, dx;
+
+    if (y < reg->y1 || y > reg->y2)
+	return (0);
+    *xa = reg->x1;
+    *xb = reg->x2;
+
+    /* Pixel centers within the radius of the center */
+    if (reg->type == REG_CIRCLE) {
+	dy2 = ((double) y - reg->yc) * ((double) y - reg->yc);
+	r2 = reg->r * reg->r;
+	if (dy2 > r2)
+	    return (0);
+	dx = sqrt (r2 - dy2);
+	*xa = (int) ceil (reg->xc - dx);
+	while (*xa <= *xb &&
+	       ((double) *xa - reg->xc) * ((double) *xa - reg->xc) + dy2 > r2)
+	    (*xa)++;
+	*xb = (int) floor (reg->xc + dx);
+	while (*xb >= *xa &&
+	       ((double) *xb - reg->xc) * ((double) *xb - reg->xc) + dy2 > r2)
+	    (*xb)--;
+	if (*xa < reg->x1)
+	    *xa = reg->x1;
+	if (*xb > reg->x2)
+	    *xb = reg->x2;
+	}
+    if (*xb < *xa)
+	return (0);
+    return (*xb - *xa + 1);
+}
+
+
+/* Compute statistics of regions in bands of rows claimed by one thread */
+
+static void *
+StatRows (arg)
+
+void	*arg;		/* Image and regions shared by threads */
+{
+    struct StatJob *job = (struct StatJob *) arg;
+    struct StatRegion *reg;
+    struct StatSum *sums;
+    double *dvec, *v, *vend, dpix, sum, mean, m2, dmin, dmax;
+    int ithread, ireg, n, y, y0, y1, xa, xb, nx;
+
+    /* Claim this thread's statistics */
+    pthread_mutex_lock (&job->lock);
+    ithread = job->nextthread;
+    job->nextthread++;
+    pthread_mutex_unlock (&job->lock);
+    sums = job->sums + (ithread * job->nreg);
+
+    nx = job->x2 - job->x1 + 1;
+    if (nx < 1)
+	return (NULL);
+    if (!(dvec = (double *) calloc (nx, sizeof (double))))
+	return (NULL);
+
+    while (1) {
+
+	/* Claim the next band of rows */
+	pthread_mutex_lock (&job->lock);
+	y0 = job->nextrow;
+	job->nextrow = job->nextrow + nrband;
+	pthread_mutex_unlock (&job->lock);
+	if (y0 >= job->y2)
+	    break;
+	y1 = y0 + nrband;
+	if (y1 > job->y2)
+	    y1 = job->y2;
+
+	/* Read each row once for all of the regions which include it */
+	for (y = y0; y < y1; y++) {
+	    getvec (job->image, job->bitpix, job->bzero, job->bscale,
+		    (y * job->xdim) + job->x1 - 1, nx, dvec);
+	    for (ireg = 0; ireg < job->nreg; ireg++) {
+		reg = &job->regs[ireg];
+		if ((n = RegionSpan (reg, y+1, &xa, &xb)) < 1)
+		    continue;
+		v = dvec + xa - job->x1;
+		vend = v + n;
+
+		/* Mean, limits, and squared differences of this row */
+		sum = 0.0;
+		dmin = *v;
+		dmax = *v;
+		for (; v < vend; v++) {
+		    dpix = *v;
+		    sum = sum + dpix;
+		    if (dpix < dmin)
+			dmin = dpix;
+		    if (dpix > dmax)
+			dmax = dpix;
+		    }
+		mean = sum / (double) n;
+		m2 = 0.0;
+		for (v = vend - n; v < vend; v++)
+		    m2 = m2 + (*v - mean) * (*v - mean);
+		StatAdd (&sums[ireg], n, mean, m2, dmin, dmax);
+
+		if (reg->vals != NULL)
+		    memcpy (reg->vals + reg->rowoff[y+1-reg->y1], vend - n,
+			    n * sizeof (double));
+		}
+	    }
+	}
+
+    free (dvec);
+    return (NULL);
+}
+
+
+/* Add statistics of a set of pixels to running statistics */
+
+static void
+StatAdd (stat, n, mean, m2, dmin, dmax)
+
+struct StatSum *stat;	/* Running statistics */
+int	n;		/* Number of pixels to add */
+double	mean;		/* Mean of pixels to add */
+double	m2;		/* Sum of squared differences from their mean */
+double	dmin, dmax;	/* Limits of pixels to add */
+{
+    double delta, dn, dnt;
+
+    if (n < 1)
+	return;
+    if (stat->n < 1) {
+	stat->n = n;
+	stat->mean = mean;
+	stat->m2 = m2;
+	stat->dmin = dmin;
+	stat->dmax = dmax;
+	return;
+	}
+
+    /* Combine means and squared differences of the two sets */
+    dn = (double) n;
+    dnt = (double) (stat->n + n);
+    delta = mean - stat->mean;
+    stat->mean = stat->mean + (delta * dn / dnt);
+    stat->m2 = stat->m2 + m2 + (delta * delta * (double) stat->n * dn / dnt);
+    stat->n = stat->n + n;
+    if (dmin < stat->dmin)
+	stat->dmin = dmin;
+    if (dmax > stat->dmax)
+	stat->dmax = dmax;
+    return;
+}
+
+
+/* Return the k'th smallest of n values, partly reordering them */
+
+static double
+SelectPix (vals, n, k)
+
+double	*vals;		/* Values, reordered so k'th is in place */
+int	n;		/* Number of values */
+int	k;		/* Zero-based order of value to return */
+{
+    double pivot, temp;
+    int left, right, i, j, mid;
+
+    left = 0;
+    right = n - 1;
+    while (right > left) {
+
+	/* Use median of first, middle, and last values as pivot */
+	mid = (left + right) / 2;
+	if (vals[mid] < vals[left]) {
+	    temp = vals[mid]; vals[mid] = vals[left]; vals[left] = temp;
+	    }
+	if (vals[right] < vals[left]) {
+	    temp = vals[right]; vals[right] = vals[left]; vals[left] = temp;
+	    }
+	if (vals[right] < vals[mid]) {
+	    temp = vals[right]; vals[right] = vals[mid]; vals[mid] = temp;
+	    }
+	pivot = vals[mid];
+
+	/* Move smaller values left and larger values right of pivot */
+	i = left;
+	j = right;
+	while (i <= j) {
+	    while (vals[i] < pivot)
+		i++;
+	    while (vals[j] > pivot)
+		j--;
+	    if (i <= j) {
+		temp = vals[i]; vals[i] = vals[j]; vals[j] = temp;
+		i++;
+		j--;
+		}
+	    }
+
+	/* Keep only the side which includes the k'th value */
+	if (k <= j)
+	    right = j;
+	else if (k >= i)
+	    left = i;
+	else
+	    break;
+	}
+    return (vals[k]);
+}
+
 /* Jul  2 1999	New program
  * Jul  6 1999	Fix bug with x computation in patch adding section
  * Oct 22 1999	Drop unused variables after lint
@@ -839,4 +1522,8 @@ char *rrange;	/* Row range string */
  * Jan 10 2014	Add list file with @ as command line option
  *
  * Jun  9 2016	Fix isnum() tests for added coloned times and dashed dates
+ *
+ * Oct 19 2026	Add -q, -g, and -u to compute region statistics and percentiles
+ * Oct 19 2026	Add -j to compute region statistics in threads
+ * Oct 19 2026	Limit region names and number format to their buffers
  */
@@ -1,9 +1,9 @@
 /* File xy2sky.c
- * September 22, 2010
+ * October 18, 2026
  * By Jessica Mink, Harvard-Smithsonian Center for Astrophysics
  * Send bug reports to jmink@cfa.harvard.edu
 
-   Copyright (C) 1996-2010
+   Copyright (C) 1996-2026
    Smithsonian Astrophysical Observatory, Cambridge, MA USA
 
    This program is free software; you can redistribute it and/or
@@ -36,6 +36,9 @@ static void PrintUsage();
 extern struct WorldCoor *GetWCSFITS();	/* Read WCS from FITS or IRAF header */
 extern void setsys(),setcenter(),setsecpix(),setnpix(),setrefpix(),setdateobs();
 static void PrintHead();
+static void StreamList();
+
+#define NBSTREAM 1048576	/* Bytes of list file read at once with -r or -u */
 
 static int verbose = 0;		/* verbose/debugging flag */
 static int append = 0;		/* append input line flag */
@@ -48,6 +51,7 @@ static int ncm = 0;
 static int printhead = 0;
 static char printonly = 'n';
 static int version = 0;		/* If 1, print only program name and version */
+static int streamio = 0;	/* 1 to stream list in blocks, 2 if binary */
 
 static char *RevMsg = "XY2SKY WCSTools 3.9.7, 26 April 2022, Jessica Mink (jmink@cfa.harvard.edu)";
 
@@ -295,6 +299,10 @@ char **av;
 	    ac--;
 	    break;
 
+	case 'r':	/* Stream binary X Y from list file to binary RA Dec */
+	    streamio = 2;
+	    break;
+
 	case 's':   /* Size of image in X and Y pixels */
 	    if (ac < 3)
 		PrintUsage(str);
@@ -310,6 +318,10 @@ char **av;
 	    tabtable++;
     	    break;
 
+	case 'u':	/* Stream list file in blocks, writing RA Dec in degrees */
+	    streamio = 1;
+	    break;
+
 	case 'x':       /* X and Y coordinates of reference pixel */
 	    if (ac < 3)
 		PrintUsage (str);
@@ -420,6 +432,30 @@ char **av;
 	    while (*ln++)
 		*(ln-1) = *ln;
 	    *ln = (char) 0;
+
+	    /* Convert large lists quickly in blocks */
+	    if (streamio) {
+		if (strcmp (listname,"STDIN")==0 || strcmp (listname,"stdin")==0)
+		    fd = stdin;
+		else if ((fd = fopen (listname, "r")) == NULL) {
+		    fprintf (stderr, "Cannot read file %s\n", listname);
+		    av++;
+		    continue;
+		    }
+		if (streamio == 1 && (printhead || verbose))
+		    PrintHead (fn, wcs, NULL, listname);
+		if (ncx > 0)
+		    i = ncx;
+		else if (identifier)
+		    i = 2;
+		else
+		    i = 1;
+		StreamList (wcs, fd, streamio - 1, ndecset ? ndec : 5, i);
+		if (fd != stdin)
+		    fclose (fd);
+		av++;
+		continue;
+		}
 	    if (strcmp (listname,"STDIN")==0 || strcmp (listname,"stdin")==0) {
 		fd = stdin;
 		nlines = 10000;
@@ -660,6 +696,157 @@ char **av;
     return (0);
 }
 
+/* STREAMLIST -- Convert a list of image positions read in large blocks,
+ * writing RA and Dec in degrees, or binary doubles if rawio is set */
+
+static void
+StreamList (wcs, fd, rawio, ndec, ncol)
+
+struct WorldCoor *wcs;	/* World coordinate system structure */
+FILE	*fd;		/* List of X Y positions */
+int	rawio;		/* 1 to read native binary X Y and write RA Dec */
+int	ndec;		/* Number of decimal places in output degrees */
+int	ncol;		/* Column containing X; Y follows */
+{
+    char *buff, *obuff, *line, *lend, *bend, *cnum, *cnext, *op;
+    double *xy;
+    double x, y, ra, dec;
+    int nread, nbuff, nleft, npos, i, icol;
+
+    /* Native binary X Y pairs in, RA Dec pairs out; NaN if offscale */
+    if (rawio) {
+	xy = (double *) malloc (NBSTREAM);
+	if (xy == NULL) {
+	    fprintf (stderr, "XY2SKY: Cannot allocate %d-byte buffer\n",
+		     NBSTREAM);
+	    return;
+	    }
+	nleft = 0;
+	while ((nread = fread ((char *) xy + nleft, 1, NBSTREAM - nleft,
+			       fd)) > 0) {
+	    nbuff = nleft + nread;
+	    npos = nbuff / (2 * sizeof (double));
+	    nleft = nbuff - (npos * 2 * sizeof (double));
+	    for (i = 0; i < 2 * npos; i = i + 2) {
+		pix2wcs (wcs, xy[i], xy[i+1], &ra, &dec);
+		if (wcs->offscl) {
+		    xy[i] = NAN;
+		    xy[i+1] = NAN;
+		    }
+		else {
+		    xy[i] = ra;
+		    xy[i+1] = dec;
+		    }
+		}
+	    if (fwrite (xy, 2 * sizeof (double), npos, stdout) < npos) {
+		fprintf (stderr, "XY2SKY: Cannot write output\n");
+		nleft = 0;
+		break;
+		}
+
+	    /* Keep a partial pair for the next read */
+	    if (nleft > 0)
+		memmove (xy, (char *) xy + (nbuff - nleft), nleft);
+	    }
+	if (nleft > 0)
+	    fprintf (stderr, "XY2SKY: Ignoring %d bytes after last X Y pair\n",
+		     nleft);
+	free (xy);
+	return;
+	}
+
+    buff = (char *) malloc (NBSTREAM + 1);
+    obuff = (char *) malloc (2 * NBSTREAM + 256);
+    if (buff == NULL || obuff == NULL) {
+	fprintf (stderr, "XY2SKY: Cannot allocate %d-byte buffers\n",
+		 NBSTREAM);
+	if (buff != NULL) free (buff);
+	if (obuff != NULL) free (obuff);
+	return;
+	}
+    op = obuff;
+    nleft = 0;
+    while (1) {
+	nread = fread (buff + nleft, 1, NBSTREAM - nleft, fd);
+	nbuff = nleft + nread;
+	if (nbuff == 0)
+	    break;
+	buff[nbuff] = (char) 0;
+
+	/* Convert through the last complete line, unless the file has ended
+	   or one line fills the buffer */
+	bend = buff + nbuff;
+	if (nread > 0) {
+	    while (bend > buff && *(bend-1) != '\n')
+		bend--;
+	    if (bend == buff)
+		bend = buff + nbuff;
+	    }
+
+	for (line = buff; line < bend; line = lend + 1) {
+	    lend = memchr (line, '\n', bend - line);
+	    if (lend == NULL)
+		lend = bend;
+
+	    /* Skip comments, then find the X column */
+	    cnum = line;
+	    while (cnum < lend && (*cnum == ' ' || *cnum == '\t'))
+		cnum++;
+	    if (cnum == lend || *cnum == '#')
+		continue;
+	    for (icol = 1; icol < ncol; icol++) {
+		while (cnum < lend && *cnum != ' ' && *cnum != '\t')
+		    cnum++;
+		while (cnum < lend && (*cnum == ' ' || *cnum == '\t'))
+		    cnum++;
+		}
+
+	    /* Skip lines without two numbers */
+	    x = strtor8 (cnum, &cnext);
+	    if (cnext == cnum || cnext > lend)
+		continue;
+	    cnum = cnext;
+	    y = strtor8 (cnum, &cnext);
+	    if (cnext == cnum || cnext > lend)
+		continue;
+
+	    pix2wcs (wcs, x, y, &ra, &dec);
+	    op = op + r8tostr (op, ra, ndec);
+	    *op++ = ' ';
+	    op = op + r8tostr (op, dec, ndec);
+	    if (wcs->offscl) {
+		strcpy (op, " (offscale)");
+		op = op + 11;
+		}
+	    if (append) {
+		*op++ = ' ';
+		i = lend - line;
+		if (i > 0 && line[i-1] == '\r')
+		    i--;
+		memcpy (op, line, i);
+		op = op + i;
+		}
+	    *op++ = '\n';
+	    if (op - obuff > NBSTREAM) {
+		fwrite (obuff, 1, op - obuff, stdout);
+		op = obuff;
+		}
+	    }
+
+	/* Keep the partial last line for the next block */
+	if (nread == 0)
+	    break;
+	nleft = nbuff - (bend - buff);
+	if (nleft > 0)
+	    memmove (buff, bend, nleft);
+	}
+    if (op > obuff)
+	fwrite (obuff, 1, op - obuff, stdout);
+    free (buff);
+    free (obuff);
+    return;
+}
+
 static void
 PrintUsage (command)
 char	*command;
@@ -694,8 +881,10 @@ char	*command;
     fprintf (stderr,"  -o r|d|s: print only ra, dec, or coordinate system\n");
     fprintf (stderr,"  -p num: Initial plate scale in arcsec per pixel\n");
     fprintf (stderr,"  -q: output equinox if not 2000 or 1950\n");
+    fprintf (stderr,"  -r: @listfile is binary X Y doubles; write binary RA Dec\n");
     fprintf (stderr,"  -s x y: horizontal and vertical dimensions of image \n");
     fprintf (stderr,"  -t: tab table output\n");
+    fprintf (stderr,"  -u: read @listfile in blocks and write RA Dec in degrees\n");
     fprintf (stderr,"  -v: verbose\n");
     fprintf (stderr,"  -x x y: X and Y coordinates of reference pixel (default is center)\n");
     fprintf (stderr,"  -y date: Epoch of image in FITS date format or year\n");
@@ -881,4 +1070,8 @@ char *listfile;		/* Name of file with list of input coordinates */
  * Sep 25 2009	Drop unused variables; declare setting subroutines
  *
  * Sep 22 2010	Fix use of input list file
+ *
+ * Oct 18 2026	Add -u and -r to convert large lists in blocks, as text or binary
+ *
+ * Oct 19 2026	Warn about a partial binary pair at the end of -r input
  */